@@ -0,0 +1,686 @@
+/**
+ * @file loadgen.c
+ * @brief HTTP Server C - Closed-Loop HTTP Load Generator
+ * @version 1.0.0
+ * @date 2025-06-07
+ * @author David Dev (@DavidDevGt)
+ *
+ * @description
+ * Multi-threaded closed-loop load generator used by `make bench`. Each
+ * thread drives its share of the connections with its own epoll loop: a
+ * connection sends a batch of requests (the pipelining depth), waits for
+ * every response, and then sends the next batch. Latencies go into
+ * log-linear (HDR-style) histograms, merged at the end and printed as
+ * a single JSON object.
+ *
+ * Features:
+ * - keep-alive and connection-per-request modes
+ * - configurable concurrency, threads and pipelining depth
+ * - URL mix, cycled round-robin per connection
+ * - optional browser-like header block to load the request parser
+ * - p50/p90/p99/p99.9/max latency with ~1% relative precision
+ * - server-side parse cost per request, read from /metrics
+ *
+ * @license MIT License
+ */
+
+#define _GNU_SOURCE  // for strcasestr and memmem
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <pthread.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+
+#define MAX_PIPELINE 64
+#define MAX_URLS 32
+#define CONN_RBUF_SIZE (64 * 1024)
+#define MAX_HEADER_BYTES 3072
+#define CONN_WBUF_SIZE (MAX_PIPELINE * (256 + MAX_HEADER_BYTES))
+#define METRICS_BUF_SIZE (256 * 1024)
+
+// Log-linear histogram: 64 linear sub-buckets per power of two
+#define HIST_SUB_BITS 7
+#define HIST_SUB_COUNT (1 << HIST_SUB_BITS)
+#define HIST_HALF (HIST_SUB_COUNT / 2)
+#define HIST_BUCKETS (HIST_SUB_COUNT + 58 * HIST_HALF)
+
+typedef struct {
+    uint64_t counts[HIST_BUCKETS];
+    uint64_t total;
+    uint64_t max;
+    double sum;
+} histogram_t;
+
+typedef struct {
+    const char *host;
+    int port;
+    int threads;
+    int connections;
+    double duration;
+    int keep_alive;
+    int pipeline;
+    const char *urls[MAX_URLS];
+    int url_count;
+    const char *label;
+    int header_bytes;                 // size of the extra header block
+} options_t;
+
+typedef struct {
+    int fd;
+    int connecting;
+    char rbuf[CONN_RBUF_SIZE];
+    size_t rlen;
+    char wbuf[CONN_WBUF_SIZE];
+    size_t wlen;
+    size_t woff;
+    int outstanding;                  // requests awaiting a response
+    int completed;                    // responses received in this batch
+    uint64_t sent_at[MAX_PIPELINE];
+    int in_body;
+    size_t body_left;
+    int server_closes;                // last response said Connection: close
+    int url_cursor;
+} conn_t;
+
+typedef struct {
+    int id;
+    int conn_count;
+    conn_t *conns;
+    histogram_t hist;
+    uint64_t requests;
+    uint64_t non_2xx;
+    uint64_t errors;
+    uint64_t bytes;
+    pthread_t thread;
+} thread_ctx_t;
+
+static options_t opts;
+static struct sockaddr_in target;
+static uint64_t deadline_ns;
+static char extra_headers[MAX_HEADER_BYTES + 1];
+
+// Typical browser fields (no Accept-Encoding, so the served variant does
+// not change); a Cookie pads the block to the requested size.
+static const char *const browser_headers[] = {
+    "Accept: text/html,application/xhtml+xml,application/xml;q=0.9,"
+    "image/avif,image/webp,*/*;q=0.8\r\n",
+    "Accept-Language: en-US,en;q=0.9,de;q=0.8\r\n",
+    "Referer: http://localhost/some/longer/path/index.html?utm_source=bench\r\n",
+    "Upgrade-Insecure-Requests: 1\r\n",
+    "Sec-Fetch-Dest: document\r\n",
+    "Sec-Fetch-Mode: navigate\r\n",
+    "Sec-Fetch-Site: same-origin\r\n",
+    "Sec-Fetch-User: ?1\r\n",
+    "Cache-Control: max-age=0\r\n",
+};
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static int hist_index(uint64_t value)
+{
+    if (value < HIST_SUB_COUNT)
+        return (int)value;
+    int msb = 63 - __builtin_clzll(value);
+    int shift = msb - (HIST_SUB_BITS - 1);
+    int index = shift * HIST_HALF + (int)(value >> shift);
+    return index < HIST_BUCKETS ? index : HIST_BUCKETS - 1;
+}
+
+static uint64_t hist_value(int index)
+{
+    if (index < HIST_SUB_COUNT)
+        return index;
+    int shift = index / HIST_HALF - 1;
+    uint64_t mantissa = index % HIST_HALF + HIST_HALF;
+    // Middle of the bucket's range
+    return (mantissa << shift) + ((1ull << shift) >> 1);
+}
+
+static void hist_record(histogram_t *hist, uint64_t value)
+{
+    hist->counts[hist_index(value)]++;
+    hist->total++;
+    hist->sum += (double)value;
+    if (value > hist->max)
+        hist->max = value;
+}
+
+static void hist_merge(histogram_t *dst, const histogram_t *src)
+{
+    for (int i = 0; i < HIST_BUCKETS; i++)
+        dst->counts[i] += src->counts[i];
+    dst->total += src->total;
+    dst->sum += src->sum;
+    if (src->max > dst->max)
+        dst->max = src->max;
+}
+
+static uint64_t hist_percentile(const histogram_t *hist, double pct)
+{
+    if (hist->total == 0)
+        return 0;
+    uint64_t rank = (uint64_t)(pct / 100.0 * hist->total + 0.5);
+    if (rank == 0)
+        rank = 1;
+    uint64_t seen = 0;
+    for (int i = 0; i < HIST_BUCKETS; i++)
+    {
+        seen += hist->counts[i];
+        if (seen >= rank)
+        {
+            uint64_t value = hist_value(i);
+            return value < hist->max ? value : hist->max;
+        }
+    }
+    return hist->max;
+}
+
+static void watch(int epfd, conn_t *conn, int op, unsigned events)
+{
+    struct epoll_event ev = { .events = events, .data.ptr = conn };
+    epoll_ctl(epfd, op, conn->fd, &ev);
+}
+
+static void conn_reset(conn_t *conn)
+{
+    conn->rlen = 0;
+    conn->wlen = 0;
+    conn->woff = 0;
+    conn->outstanding = 0;
+    conn->completed = 0;
+    conn->in_body = 0;
+    conn->body_left = 0;
+    conn->server_closes = 0;
+}
+
+static int conn_open(int epfd, conn_t *conn)
+{
+    conn_reset(conn);
+    conn->fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (conn->fd < 0)
+        return -1;
+    int one = 1;
+    setsockopt(conn->fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    conn->connecting = 1;
+    if (connect(conn->fd, (struct sockaddr *)&target, sizeof(target)) < 0 &&
+        errno != EINPROGRESS)
+    {
+        close(conn->fd);
+        conn->fd = -1;
+        return -1;
+    }
+    watch(epfd, conn, EPOLL_CTL_ADD, EPOLLOUT | EPOLLIN);
+    return 0;
+}
+
+static void conn_close(conn_t *conn)
+{
+    if (conn->fd >= 0)
+        close(conn->fd);
+    conn->fd = -1;
+}
+
+static void queue_batch(conn_t *conn)
+{
+    int depth = opts.keep_alive ? opts.pipeline : 1;
+    uint64_t now = now_ns();
+    for (int i = 0; i < depth; i++)
+    {
+        const char *url = opts.urls[conn->url_cursor++ % opts.url_count];
+        int n = snprintf(conn->wbuf + conn->wlen, CONN_WBUF_SIZE - conn->wlen,
+                         "GET %s HTTP/1.1\r\n"
+                         "Host: %s:%d\r\n"
+                         "User-Agent: httpserver-loadgen\r\n"
+                         "%s"
+                         "Connection: %s\r\n\r\n",
+                         url, opts.host, opts.port, extra_headers,
+                         opts.keep_alive ? "keep-alive" : "close");
+        conn->wlen += n;
+        conn->sent_at[i] = now;
+    }
+    conn->outstanding = depth;
+    conn->completed = 0;
+}
+
+static void build_extra_headers(int size)
+{
+    size_t len = 0;
+    size_t cookie_min = sizeof("Cookie: a=\r\n") - 1;
+    for (size_t i = 0; i < sizeof(browser_headers) / sizeof(browser_headers[0]); i++)
+    {
+        size_t n = strlen(browser_headers[i]);
+        if (len + n + cookie_min > (size_t)size)
+            break;
+        memcpy(extra_headers + len, browser_headers[i], n);
+        len += n;
+    }
+    if (len + cookie_min > (size_t)size)
+    {
+        extra_headers[len] = '\0';
+        return;
+    }
+
+    len += sprintf(extra_headers + len, "Cookie: a=");
+    for (; len < (size_t)size - 2; len++)
+        extra_headers[len] = "0123456789abcdef"[len % 16];
+    memcpy(extra_headers + len, "\r\n", 3);
+}
+
+static int flush_writes(int epfd, conn_t *conn)
+{
+    while (conn->woff < conn->wlen)
+    {
+        ssize_t n = send(conn->fd, conn->wbuf + conn->woff, conn->wlen - conn->woff,
+                         MSG_NOSIGNAL);
+        if (n < 0)
+        {
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+            {
+                watch(epfd, conn, EPOLL_CTL_MOD, EPOLLIN | EPOLLOUT);
+                return 0;
+            }
+            return -1;
+        }
+        conn->woff += n;
+    }
+    conn->wlen = conn->woff = 0;
+    watch(epfd, conn, EPOLL_CTL_MOD, EPOLLIN);
+    return 0;
+}
+
+/**
+ * Consume complete responses from the read buffer.
+ * @return: 0 to continue, -1 on a malformed response
+ */
+static int parse_responses(thread_ctx_t *ctx, conn_t *conn)
+{
+    size_t pos = 0;
+    while (pos < conn->rlen)
+    {
+        if (conn->in_body)
+        {
+            size_t take = conn->rlen - pos;
+            if (take > conn->body_left)
+                take = conn->body_left;
+            pos += take;
+            conn->body_left -= take;
+        }
+        else
+        {
+            char *start = conn->rbuf + pos;
+            char *end = memmem(start, conn->rlen - pos, "\r\n\r\n", 4);
+            if (!end)
+                break;
+            *end = '\0';
+            int status = 0;
+            if (sscanf(start, "HTTP/1.%*d %d", &status) != 1)
+                return -1;
+            const char *cl = strcasestr(start, "\r\nContent-Length:");
+            conn->body_left = cl ? strtoull(cl + 17, NULL, 10) : 0;
+            conn->server_closes = strcasestr(start, "\r\nConnection: close") != NULL;
+            if (status < 200 || status >= 300)
+                ctx->non_2xx++;
+            conn->in_body = 1;
+            pos = (end - conn->rbuf) + 4;
+        }
+
+        if (conn->in_body && conn->body_left == 0)
+        {
+            conn->in_body = 0;
+            uint64_t latency_us = (now_ns() - conn->sent_at[conn->completed]) / 1000;
+            hist_record(&ctx->hist, latency_us);
+            ctx->requests++;
+            conn->completed++;
+            conn->outstanding--;
+        }
+    }
+    ctx->bytes += pos;
+    memmove(conn->rbuf, conn->rbuf + pos, conn->rlen - pos);
+    conn->rlen -= pos;
+    return 0;
+}
+
+static void restart(int epfd, thread_ctx_t *ctx, conn_t *conn, int failed)
+{
+    if (failed)
+        ctx->errors++;
+    conn_close(conn);
+    if (now_ns() < deadline_ns && conn_open(epfd, conn) < 0)
+        ctx->errors++;
+}
+
+static void on_event(int epfd, thread_ctx_t *ctx, conn_t *conn, unsigned events)
+{
+    if (conn->connecting)
+    {
+        if (!(events & (EPOLLOUT | EPOLLERR | EPOLLHUP)))
+            return;
+        int err = 0;
+        socklen_t len = sizeof(err);
+        getsockopt(conn->fd, SOL_SOCKET, SO_ERROR, &err, &len);
+        if (err != 0 || (events & (EPOLLERR | EPOLLHUP)))
+        {
+            restart(epfd, ctx, conn, 1);
+            return;
+        }
+        conn->connecting = 0;
+        queue_batch(conn);
+    }
+
+    if (conn->wlen > 0 && flush_writes(epfd, conn) < 0)
+    {
+        restart(epfd, ctx, conn, 1);
+        return;
+    }
+
+    if (!(events & (EPOLLIN | EPOLLHUP | EPOLLERR)))
+        return;
+
+    while (1)
+    {
+        ssize_t n = recv(conn->fd, conn->rbuf + conn->rlen, CONN_RBUF_SIZE - conn->rlen, 0);
+        if (n > 0)
+        {
+            conn->rlen += n;
+            if (parse_responses(ctx, conn) < 0)
+            {
+                restart(epfd, ctx, conn, 1);
+                return;
+            }
+            if (conn->outstanding == 0)
+                break;
+            continue;
+        }
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            return;
+        // EOF or error with responses still owed, unless the server announced it
+        restart(epfd, ctx, conn, conn->outstanding > 0 && !conn->server_closes);
+        return;
+    }
+
+    // Batch complete: closed loop, so the next one goes out right away
+    if (!opts.keep_alive || conn->server_closes)
+    {
+        restart(epfd, ctx, conn, 0);
+        return;
+    }
+    if (now_ns() >= deadline_ns)
+        return;
+    queue_batch(conn);
+    if (flush_writes(epfd, conn) < 0)
+        restart(epfd, ctx, conn, 1);
+}
+
+static void *thread_main(void *arg)
+{
+    thread_ctx_t *ctx = arg;
+    int epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (epfd < 0)
+    {
+        perror("epoll_create1");
+        return NULL;
+    }
+
+    for (int i = 0; i < ctx->conn_count; i++)
+    {
+        ctx->conns[i].url_cursor = ctx->id + i;
+        if (conn_open(epfd, &ctx->conns[i]) < 0)
+            ctx->errors++;
+    }
+
+    struct epoll_event events[256];
+    while (now_ns() < deadline_ns)
+    {
+        int ready = epoll_wait(epfd, events, 256, 50);
+        for (int i = 0; i < ready; i++)
+            on_event(epfd, ctx, events[i].data.ptr, events[i].events);
+    }
+
+    for (int i = 0; i < ctx->conn_count; i++)
+        conn_close(&ctx->conns[i]);
+    close(epfd);
+    return NULL;
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+            "  --host ADDR        server IPv4 address (default 127.0.0.1)\n"
+            "  --port N           server port (default 6090)\n"
+            "  --threads N        load generator threads (default 2)\n"
+            "  --connections N    concurrent connections (default 16)\n"
+            "  --duration SEC     measurement time (default 5)\n"
+            "  --mode M           keepalive or close (default keepalive)\n"
+            "  --pipeline N       requests in flight per connection (default 1)\n"
+            "  --urls A,B,...     URL mix (default /,/main.css,/main.js)\n"
+            "  --header-bytes N   add N bytes of browser-like headers (max %d)\n"
+            "  --label NAME       scenario name in the JSON output\n"
+            "  --probe            exit 0 once the server accepts connections\n",
+            prog, MAX_HEADER_BYTES);
+}
+
+static int probe(void)
+{
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    int ok = fd >= 0 && connect(fd, (struct sockaddr *)&target, sizeof(target)) == 0;
+    if (fd >= 0)
+        close(fd);
+    return ok ? 0 : 1;
+}
+
+/**
+ * Read the server's parse-time histogram totals from /metrics.
+ * @return: 0 on success, -1 if the server does not expose them
+ */
+static int scrape_parse_time(double *sum_s, unsigned long long *count)
+{
+    static char buf[METRICS_BUF_SIZE];
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0)
+        return -1;
+    if (connect(fd, (struct sockaddr *)&target, sizeof(target)) < 0)
+    {
+        close(fd);
+        return -1;
+    }
+    int n = snprintf(buf, sizeof(buf),
+                     "GET /metrics HTTP/1.1\r\nHost: %s:%d\r\nConnection: close\r\n\r\n",
+                     opts.host, opts.port);
+    if (send(fd, buf, n, MSG_NOSIGNAL) != n)
+    {
+        close(fd);
+        return -1;
+    }
+    size_t len = 0;
+    ssize_t got;
+    while (len < sizeof(buf) - 1 && (got = recv(fd, buf + len, sizeof(buf) - 1 - len, 0)) > 0)
+        len += got;
+    close(fd);
+    buf[len] = '\0';
+
+    const char *sum = strstr(buf, "\nhttpserver_parse_duration_seconds_sum ");
+    const char *cnt = strstr(buf, "\nhttpserver_parse_duration_seconds_count ");
+    if (!sum || !cnt)
+        return -1;
+    *sum_s = strtod(strchr(sum + 1, ' ') + 1, NULL);
+    *count = strtoull(strchr(cnt + 1, ' ') + 1, NULL, 10);
+    return 0;
+}
+
+static void split_urls(char *list)
+{
+    opts.url_count = 0;
+    for (char *tok = strtok(list, ","); tok && opts.url_count < MAX_URLS; tok = strtok(NULL, ","))
+        opts.urls[opts.url_count++] = tok;
+}
+
+int main(int argc, char **argv)
+{
+    static char default_urls[] = "/,/main.css,/main.js";
+    int probe_only = 0;
+
+    opts.host = "127.0.0.1";
+    opts.port = 6090;
+    opts.threads = 2;
+    opts.connections = 16;
+    opts.duration = 5.0;
+    opts.keep_alive = 1;
+    opts.pipeline = 1;
+    opts.label = NULL;
+    split_urls(default_urls);
+
+    for (int i = 1; i < argc; i++)
+    {
+        const char *arg = argv[i];
+        const char *val = i + 1 < argc ? argv[i + 1] : NULL;
+        if (strcmp(arg, "--probe") == 0)
+        {
+            probe_only = 1;
+            continue;
+        }
+        if (!val)
+        {
+            usage(argv[0]);
+            return 2;
+        }
+        i++;
+        if (strcmp(arg, "--host") == 0)
+            opts.host = val;
+        else if (strcmp(arg, "--port") == 0)
+            opts.port = atoi(val);
+        else if (strcmp(arg, "--threads") == 0)
+            opts.threads = atoi(val);
+        else if (strcmp(arg, "--connections") == 0)
+            opts.connections = atoi(val);
+        else if (strcmp(arg, "--duration") == 0)
+            opts.duration = atof(val);
+        else if (strcmp(arg, "--mode") == 0 && strcmp(val, "keepalive") == 0)
+            opts.keep_alive = 1;
+        else if (strcmp(arg, "--mode") == 0 && strcmp(val, "close") == 0)
+            opts.keep_alive = 0;
+        else if (strcmp(arg, "--pipeline") == 0)
+            opts.pipeline = atoi(val);
+        else if (strcmp(arg, "--urls") == 0)
+            split_urls(argv[i]);
+        else if (strcmp(arg, "--label") == 0)
+            opts.label = val;
+        else if (strcmp(arg, "--header-bytes") == 0)
+            opts.header_bytes = atoi(val);
+        else
+        {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+
+    memset(&target, 0, sizeof(target));
+    target.sin_family = AF_INET;
+    target.sin_port = htons(opts.port);
+    if (inet_pton(AF_INET, opts.host, &target.sin_addr) != 1)
+    {
+        fprintf(stderr, "invalid --host %s\n", opts.host);
+        return 2;
+    }
+    if (probe_only)
+        return probe();
+
+    if (opts.threads < 1 || opts.connections < opts.threads || opts.url_count == 0 ||
+        opts.pipeline < 1 || opts.pipeline > MAX_PIPELINE || opts.duration <= 0 ||
+        opts.header_bytes < 0 || opts.header_bytes > MAX_HEADER_BYTES)
+    {
+        usage(argv[0]);
+        return 2;
+    }
+    build_extra_headers(opts.header_bytes);
+
+    double parse_sum_before = 0, parse_sum_after = 0;
+    unsigned long long parse_count_before = 0, parse_count_after = 0;
+    int have_parse = scrape_parse_time(&parse_sum_before, &parse_count_before) == 0;
+
+    thread_ctx_t *ctxs = calloc(opts.threads, sizeof(*ctxs));
+    conn_t *conns = calloc(opts.connections, sizeof(*conns));
+    if (!ctxs || !conns)
+    {
+        perror("calloc");
+        return 1;
+    }
+
+    uint64_t start = now_ns();
+    deadline_ns = start + (uint64_t)(opts.duration * 1e9);
+
+    int next_conn = 0;
+    for (int t = 0; t < opts.threads; t++)
+    {
+        ctxs[t].id = t;
+        ctxs[t].conn_count = opts.connections / opts.threads +
+                             (t < opts.connections % opts.threads ? 1 : 0);
+        ctxs[t].conns = &conns[next_conn];
+        next_conn += ctxs[t].conn_count;
+        pthread_create(&ctxs[t].thread, NULL, thread_main, &ctxs[t]);
+    }
+
+    histogram_t *total = calloc(1, sizeof(*total));
+    uint64_t requests = 0, non_2xx = 0, errors = 0, bytes = 0;
+    for (int t = 0; t < opts.threads; t++)
+    {
+        pthread_join(ctxs[t].thread, NULL);
+        hist_merge(total, &ctxs[t].hist);
+        requests += ctxs[t].requests;
+        non_2xx += ctxs[t].non_2xx;
+        errors += ctxs[t].errors;
+        bytes += ctxs[t].bytes;
+    }
+    double elapsed = (now_ns() - start) / 1e9;
+
+    // Includes the scrape request itself, which is noise at these counts
+    char parse_ns[32] = "null";
+    if (have_parse && scrape_parse_time(&parse_sum_after, &parse_count_after) == 0 &&
+        parse_count_after > parse_count_before)
+        snprintf(parse_ns, sizeof(parse_ns), "%.1f",
+                 (parse_sum_after - parse_sum_before) * 1e9 /
+                 (parse_count_after - parse_count_before));
+
+    printf("{\"label\": \"%s\", \"mode\": \"%s\", \"threads\": %d, "
+           "\"connections\": %d, \"pipeline\": %d, \"header_bytes\": %d, "
+           "\"duration_s\": %.3f, "
+           "\"requests\": %llu, \"errors\": %llu, \"non_2xx\": %llu, "
+           "\"bytes\": %llu, \"requests_per_sec\": %.1f, "
+           "\"latency_us\": {\"mean\": %.1f, \"p50\": %llu, \"p90\": %llu, "
+           "\"p99\": %llu, \"p999\": %llu, \"max\": %llu}, "
+           "\"parse_ns_per_request\": %s}\n",
+           opts.label ? opts.label : (opts.keep_alive ? "keepalive" : "close"),
+           opts.keep_alive ? "keepalive" : "close",
+           opts.threads, opts.connections, opts.keep_alive ? opts.pipeline : 1,
+           opts.header_bytes, elapsed,
+           (unsigned long long)requests, (unsigned long long)errors,
+           (unsigned long long)non_2xx, (unsigned long long)bytes,
+           requests / elapsed,
+           total->total ? total->sum / total->total : 0.0,
+           (unsigned long long)hist_percentile(total, 50.0),
+           (unsigned long long)hist_percentile(total, 90.0),
+           (unsigned long long)hist_percentile(total, 99.0),
+           (unsigned long long)hist_percentile(total, 99.9),
+           (unsigned long long)total->max, parse_ns);
+
+    free(total);
+    free(conns);
+    free(ctxs);
+    return 0;
+}
@@ -0,0 +1,90 @@
+#!/bin/sh
+# Benchmark suite driven by `make bench`.
+#
+# Starts the server on a loopback port, runs the load generator through a
+# fixed set of scenarios and writes all results to one JSON file. The
+# proxied scenario starts a second instance on PORT+1 that forwards
+# everything to the first one, its stand-in upstream.
+#
+# Usage: bench/run_bench.sh SERVER LOADGEN PORT OUTPUT
+# Environment: BENCH_DURATION, BENCH_THREADS, BENCH_CONNECTIONS,
+#              BENCH_PIPELINE, BENCH_URLS, BENCH_HEADER_BYTES,
+#              BENCH_SERVER_ARGS
+
+set -e
+
+SERVER=$1
+LOADGEN=$2
+PORT=$3
+OUTPUT=$4
+
+DURATION=${BENCH_DURATION:-5}
+THREADS=${BENCH_THREADS:-2}
+CONNECTIONS=${BENCH_CONNECTIONS:-32}
+PIPELINE=${BENCH_PIPELINE:-8}
+URLS=${BENCH_URLS:-/,/main.css,/main.js}
+HEADER_BYTES=${BENCH_HEADER_BYTES:-2048}
+
+if "$LOADGEN" --port "$PORT" --probe; then
+    echo "bench: port $PORT is already in use" >&2
+    exit 1
+fi
+
+PROXY_PORT=$((PORT + 1))
+if "$LOADGEN" --port "$PROXY_PORT" --probe; then
+    echo "bench: port $PROXY_PORT is already in use" >&2
+    exit 1
+fi
+
+wait_for() {
+    tries=0
+    until "$LOADGEN" --port "$1" --probe; do
+        tries=$((tries + 1))
+        if [ $tries -gt 50 ]; then
+            echo "bench: server did not start on port $1" >&2
+            exit 1
+        fi
+        sleep 0.1
+    done
+}
+
+# shellcheck disable=SC2086
+"$SERVER" --port "$PORT" $BENCH_SERVER_ARGS >/dev/null 2>&1 &
+SERVER_PID=$!
+# shellcheck disable=SC2086
+"$SERVER" --port "$PROXY_PORT" --proxy "/=127.0.0.1:$PORT" $BENCH_SERVER_ARGS >/dev/null 2>&1 &
+PROXY_PID=$!
+trap 'kill $SERVER_PID $PROXY_PID 2>/dev/null || true' EXIT
+
+wait_for "$PORT"
+wait_for "$PROXY_PORT"
+
+run() {
+    label=$1
+    shift
+    echo "bench: $label" >&2
+    "$LOADGEN" --port "$PORT" --threads "$THREADS" --duration "$DURATION" \
+        --urls "$URLS" --label "$label" "$@"
+}
+
+{
+    echo "["
+    run keepalive --connections "$CONNECTIONS" --mode keepalive
+    echo ","
+    run pipelined --connections "$CONNECTIONS" --mode keepalive --pipeline "$PIPELINE"
+    echo ","
+    run close --connections "$CONNECTIONS" --mode close
+    echo ","
+    # Same as keepalive with a browser-sized header block: parser cost
+    run large-headers --connections "$CONNECTIONS" --mode keepalive \
+        --header-bytes "$HEADER_BYTES"
+    echo ","
+    # Same as keepalive through the reverse proxy: the cost of the extra hop
+    run proxied --connections "$CONNECTIONS" --mode keepalive --port "$PROXY_PORT"
+    echo "]"
+} > "$OUTPUT"
+
+kill "$SERVER_PID" "$PROXY_PID"
+wait "$SERVER_PID" "$PROXY_PID" 2>/dev/null || true
+
+cat "$OUTPUT"
@@ -0,0 +1,212 @@
+// Generated by tools/mimegen.c from src/http/mime.types; do not edit.
+// 162 extensions, 64 buckets, 512 slots
+
+#define MIME_BUCKET_BITS 6
+#define MIME_SLOT_BITS 9
+
+static const mime_entry_t mime_entries[162] = {
+    { "html", 4, "text/html" },
+    { "htm", 3, "text/html" },
+    { "shtml", 5, "text/html" },
+    { "css", 3, "text/css" },
+    { "txt", 3, "text/plain" },
+    { "text", 4, "text/plain" },
+    { "log", 3, "text/plain" },
+    { "conf", 4, "text/plain" },
+    { "ini", 3, "text/plain" },
+    { "md", 2, "text/plain" },
+    { "markdown", 8, "text/plain" },
+    { "csv", 3, "text/csv" },
+    { "tsv", 3, "text/tab-separated-values" },
+    { "xml", 3, "text/xml" },
+    { "ics", 3, "text/calendar" },
+    { "vcf", 3, "text/vcard" },
+    { "vcard", 5, "text/vcard" },
+    { "vtt", 3, "text/vtt" },
+    { "mml", 3, "text/mathml" },
+    { "htc", 3, "text/x-component" },
+    { "yaml", 4, "text/yaml" },
+    { "yml", 3, "text/yaml" },
+    { "js", 2, "application/javascript" },
+    { "mjs", 3, "application/javascript" },
+    { "cjs", 3, "application/javascript" },
+    { "json", 4, "application/json" },
+    { "map", 3, "application/json" },
+    { "jsonld", 6, "application/ld+json" },
+    { "webmanifest", 11, "application/manifest+json" },
+    { "wasm", 4, "application/wasm" },
+    { "xhtml", 5, "application/xhtml+xml" },
+    { "xht", 3, "application/xhtml+xml" },
+    { "atom", 4, "application/atom+xml" },
+    { "rss", 3, "application/rss+xml" },
+    { "rdf", 3, "application/rdf+xml" },
+    { "xsl", 3, "application/xslt+xml" },
+    { "xslt", 4, "application/xslt+xml" },
+    { "geojson", 7, "application/geo+json" },
+    { "toml", 4, "application/toml" },
+    { "graphql", 7, "application/graphql" },
+    { "gql", 3, "application/graphql" },
+    { "form", 4, "application/x-www-form-urlencoded" },
+    { "png", 3, "image/png" },
+    { "jpg", 3, "image/jpeg" },
+    { "jpeg", 4, "image/jpeg" },
+    { "jpe", 3, "image/jpeg" },
+    { "jfif", 4, "image/jpeg" },
+    { "pjpeg", 5, "image/jpeg" },
+    { "pjp", 3, "image/jpeg" },
+    { "gif", 3, "image/gif" },
+    { "webp", 4, "image/webp" },
+    { "avif", 4, "image/avif" },
+    { "svg", 3, "image/svg+xml" },
+    { "svgz", 4, "image/svg+xml" },
+    { "ico", 3, "image/x-icon" },
+    { "cur", 3, "image/x-icon" },
+    { "bmp", 3, "image/bmp" },
+    { "tif", 3, "image/tiff" },
+    { "tiff", 4, "image/tiff" },
+    { "apng", 4, "image/apng" },
+    { "heic", 4, "image/heic" },
+    { "heif", 4, "image/heif" },
+    { "jxl", 3, "image/jxl" },
+    { "icns", 4, "image/vnd.microsoft.icon" },
+    { "ppm", 3, "image/x-portable-pixmap" },
+    { "woff", 4, "font/woff" },
+    { "woff2", 5, "font/woff2" },
+    { "ttf", 3, "font/ttf" },
+    { "otf", 3, "font/otf" },
+    { "ttc", 3, "font/collection" },
+    { "eot", 3, "application/vnd.ms-fontobject" },
+    { "mp3", 3, "audio/mpeg" },
+    { "mpga", 4, "audio/mpeg" },
+    { "ogg", 3, "audio/ogg" },
+    { "oga", 3, "audio/ogg" },
+    { "opus", 4, "audio/ogg" },
+    { "spx", 3, "audio/ogg" },
+    { "wav", 3, "audio/wav" },
+    { "weba", 4, "audio/webm" },
+    { "aac", 3, "audio/aac" },
+    { "m4a", 3, "audio/mp4" },
+    { "flac", 4, "audio/flac" },
+    { "mid", 3, "audio/midi" },
+    { "midi", 4, "audio/midi" },
+    { "kar", 3, "audio/midi" },
+    { "mka", 3, "audio/x-matroska" },
+    { "3gpp", 4, "audio/3gpp" },
+    { "mp4", 3, "video/mp4" },
+    { "m4v", 3, "video/mp4" },
+    { "mp4v", 4, "video/mp4" },
+    { "mpg4", 4, "video/mp4" },
+    { "webm", 4, "video/webm" },
+    { "ogv", 3, "video/ogg" },
+    { "mov", 3, "video/quicktime" },
+    { "qt", 2, "video/quicktime" },
+    { "avi", 3, "video/x-msvideo" },
+    { "mkv", 3, "video/x-matroska" },
+    { "mpeg", 4, "video/mpeg" },
+    { "mpg", 3, "video/mpeg" },
+    { "mpe", 3, "video/mpeg" },
+    { "m1v", 3, "video/mpeg" },
+    { "m2v", 3, "video/mpeg" },
+    { "ts", 2, "video/mp2t" },
+    { "m2ts", 4, "video/mp2t" },
+    { "3gp", 3, "video/3gpp" },
+    { "flv", 3, "video/x-flv" },
+    { "wmv", 3, "video/x-ms-wmv" },
+    { "m3u8", 4, "application/vnd.apple.mpegurl" },
+    { "mpd", 3, "application/dash+xml" },
+    { "pdf", 3, "application/pdf" },
+    { "rtf", 3, "application/rtf" },
+    { "doc", 3, "application/msword" },
+    { "dot", 3, "application/msword" },
+    { "docx", 4, "application/vnd.openxmlformats-officedocument.wordprocessingml.document" },
+    { "xls", 3, "application/vnd.ms-excel" },
+    { "xlt", 3, "application/vnd.ms-excel" },
+    { "xlsx", 4, "application/vnd.openxmlformats-officedocument.spreadsheetml.sheet" },
+    { "ppt", 3, "application/vnd.ms-powerpoint" },
+    { "pps", 3, "application/vnd.ms-powerpoint" },
+    { "pptx", 4, "application/vnd.openxmlformats-officedocument.presentationml.presentation" },
+    { "odt", 3, "application/vnd.oasis.opendocument.text" },
+    { "ods", 3, "application/vnd.oasis.opendocument.spreadsheet" },
+    { "odp", 3, "application/vnd.oasis.opendocument.presentation" },
+    { "epub", 4, "application/epub+zip" },
+    { "ps", 2, "application/postscript" },
+    { "eps", 3, "application/postscript" },
+    { "ai", 2, "application/postscript" },
+    { "zip", 3, "application/zip" },
+    { "gz", 2, "application/gzip" },
+    { "tgz", 3, "application/gzip" },
+    { "bz2", 3, "application/x-bzip2" },
+    { "xz", 2, "application/x-xz" },
+    { "zst", 3, "application/zstd" },
+    { "tar", 3, "application/x-tar" },
+    { "7z", 2, "application/x-7z-compressed" },
+    { "rar", 3, "application/vnd.rar" },
+    { "jar", 3, "application/java-archive" },
+    { "war", 3, "application/java-archive" },
+    { "ear", 3, "application/java-archive" },
+    { "apk", 3, "application/vnd.android.package-archive" },
+    { "dmg", 3, "application/x-apple-diskimage" },
+    { "iso", 3, "application/x-iso9660-image" },
+    { "deb", 3, "application/vnd.debian.binary-package" },
+    { "rpm", 3, "application/x-rpm" },
+    { "exe", 3, "application/x-msdownload" },
+    { "dll", 3, "application/x-msdownload" },
+    { "msi", 3, "application/x-msdownload" },
+    { "sh", 2, "application/x-sh" },
+    { "swf", 3, "application/x-shockwave-flash" },
+    { "bin", 3, "application/octet-stream" },
+    { "dat", 3, "application/octet-stream" },
+    { "img", 3, "application/octet-stream" },
+    { "cer", 3, "application/pkix-cert" },
+    { "crt", 3, "application/x-x509-ca-cert" },
+    { "der", 3, "application/x-x509-ca-cert" },
+    { "pem", 3, "application/x-x509-ca-cert" },
+    { "p7m", 3, "application/pkcs7-mime" },
+    { "p7c", 3, "application/pkcs7-mime" },
+    { "p12", 3, "application/x-pkcs12" },
+    { "pfx", 3, "application/x-pkcs12" },
+    { "sig", 3, "application/pgp-signature" },
+    { "asc", 3, "application/pgp-signature" },
+};
+
+static const uint16_t mime_displace[1 << MIME_BUCKET_BITS] = {
+    2, 2, 0, 0, 0, 0, 0, 1, 0, 1, 2, 0, 0, 0, 0, 1,
+    0, 0, 0, 0, 3, 1, 3, 0, 1, 0, 0, 0, 2, 0, 2, 1,
+    0, 0, 0, 0, 1, 0, 1, 5, 0, 0, 0, 1, 3, 0, 0, 0,
+    1, 0, 0, 0, 1, 1, 0, 0, 2, 0, 0, 0, 0, 0, 0, 1,
+};
+
+static const uint8_t mime_slots[1 << MIME_SLOT_BITS] = {
+    66, 162, 0, 3, 65, 139, 0, 0, 0, 0, 0, 0, 0, 0, 80, 123,
+    0, 0, 0, 0, 0, 0, 0, 0, 5, 45, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 70, 0, 0, 38, 0, 117, 0, 0, 0, 119, 0, 0,
+    0, 0, 0, 0, 98, 0, 0, 127, 0, 0, 0, 56, 122, 59, 0, 0,
+    0, 0, 24, 75, 0, 78, 0, 0, 105, 31, 0, 0, 0, 1, 0, 0,
+    0, 0, 60, 0, 0, 0, 0, 0, 27, 0, 82, 0, 0, 86, 50, 146,
+    0, 0, 0, 0, 0, 17, 53, 0, 151, 0, 0, 0, 0, 157, 0, 0,
+    0, 0, 0, 12, 0, 0, 101, 0, 0, 54, 0, 0, 0, 145, 0, 113,
+    161, 0, 26, 30, 51, 0, 0, 0, 0, 121, 0, 0, 0, 9, 0, 0,
+    0, 0, 0, 76, 99, 130, 0, 11, 21, 0, 0, 0, 0, 94, 58, 0,
+    0, 92, 0, 0, 96, 0, 29, 128, 63, 0, 0, 0, 0, 0, 0, 140,
+    0, 89, 143, 18, 0, 129, 0, 0, 0, 0, 0, 8, 0, 44, 0, 0,
+    0, 0, 22, 0, 20, 88, 0, 153, 0, 97, 0, 43, 0, 33, 6, 0,
+    0, 0, 0, 0, 0, 0, 0, 73, 15, 57, 107, 0, 41, 0, 0, 0,
+    71, 115, 0, 156, 0, 133, 103, 0, 0, 35, 0, 0, 0, 0, 0, 23,
+    0, 124, 0, 16, 0, 0, 0, 125, 0, 0, 0, 0, 0, 0, 0, 0,
+    39, 0, 0, 7, 46, 0, 0, 61, 28, 0, 0, 0, 102, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 144, 150, 0, 0, 0, 0, 34, 0,
+    0, 48, 0, 0, 114, 0, 0, 0, 126, 0, 0, 0, 0, 0, 0, 0,
+    47, 0, 136, 81, 19, 0, 0, 0, 0, 2, 0, 0, 0, 154, 0, 87,
+    0, 0, 0, 0, 112, 132, 0, 106, 0, 0, 0, 0, 104, 0, 0, 4,
+    36, 0, 0, 93, 109, 0, 91, 0, 37, 0, 0, 134, 0, 152, 0, 13,
+    148, 0, 0, 0, 0, 0, 0, 83, 0, 79, 0, 0, 0, 0, 0, 0,
+    0, 0, 68, 0, 0, 0, 0, 84, 0, 0, 0, 0, 0, 0, 74, 0,
+    0, 0, 0, 108, 10, 0, 0, 0, 118, 142, 0, 0, 0, 0, 64, 69,
+    0, 0, 0, 0, 0, 0, 49, 155, 0, 0, 32, 158, 135, 0, 0, 0,
+    52, 0, 0, 0, 0, 0, 0, 40, 0, 85, 138, 0, 0, 0, 0, 110,
+    95, 90, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 25, 0, 0, 131,
+    0, 67, 0, 0, 160, 0, 0, 0, 0, 111, 0, 0, 141, 0, 159, 100,
+    0, 0, 0, 0, 0, 0, 116, 0, 0, 0, 0, 0, 0, 62, 0, 0,
+    0, 0, 55, 77, 0, 0, 0, 120, 0, 0, 149, 0, 0, 0, 0, 0,
+    0, 0, 0, 42, 0, 0, 147, 0, 0, 14, 0, 72, 0, 0, 137, 0,
+};
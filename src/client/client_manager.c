@@ -11,121 +11,389 @@
  * pool maintenance for optimal server performance.
  * 
  * Features:
- * - Dynamic connection pool management
- * - Automatic timeout cleanup
+ * - Preallocated connection slab with a freelist, indexed by fd
+ * - Timer-wheel keep-alive expiry: O(1) per timed-out connection
  * - Request counting and limits
- * - Real-time connection statistics
+ * - Connection counters for /metrics, per-connection dump with --verbose
  * 
  * @license MIT License
  */
 
 #include "client_manager.h"
+#include "../http/http_handler.h"
+#include "../http/proxy.h"
+#include "../http/h2.h"
+#include "../core/tls.h"
+#include "../core/metrics.h"
+#include "../core/config.h"
+#include "../core/pool.h"
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 #include <sys/socket.h>
+#include <sys/ioctl.h>
 #include <time.h>
 
-client_info_t clients[MAX_CLIENTS];
-int client_count = 0;
+#define FD_TABLE_INITIAL_SIZE 1024
+
+__thread int client_count = 0;
+
+static __thread client_info_t *client_slab;     // server_config.max_clients slots
+static __thread client_info_t *free_clients;    // freelist through next_free
+static __thread client_info_t **fd_table;       // fd -> slot, grown on demand
+static __thread int fd_table_size;
+static __thread timer_wheel_t expiry_wheel;
+
+typedef struct {
+    client_info_t *head;
+    client_info_t *tail;
+    int count;
+} client_list_t;
+
+static __thread client_list_t idle_list;        // oldest idle first
+static __thread client_list_t ready_list;       // deferred, resumed in order
 
 void init_client_manager(void)
 {
-    memset(clients, 0, sizeof(clients));
+    client_slab = calloc(server_config.max_clients, sizeof(*client_slab));
+    fd_table_size = FD_TABLE_INITIAL_SIZE;
+    fd_table = calloc(fd_table_size, sizeof(*fd_table));
+    if (!client_slab || !fd_table)
+    {
+        perror("init_client_manager");
+        exit(1);
+    }
+
+    free_clients = NULL;
+    for (int i = server_config.max_clients - 1; i >= 0; i--)
+    {
+        client_slab[i].fd = -1;
+        client_slab[i].next_free = free_clients;
+        free_clients = &client_slab[i];
+    }
     client_count = 0;
+    memset(&idle_list, 0, sizeof(idle_list));
+    memset(&ready_list, 0, sizeof(ready_list));
+    timer_wheel_init(&expiry_wheel, time(NULL));
 }
 
 client_info_t* find_client(int fd)
 {
-    for (int i = 0; i < client_count; i++)
+    if (fd < 0 || fd >= fd_table_size)
+        return NULL;
+    return fd_table[fd];
+}
+
+static int reserve_fd_slot(int fd)
+{
+    if (fd < fd_table_size)
+        return 0;
+
+    int size = fd_table_size;
+    while (size <= fd)
+        size *= 2;
+    client_info_t **table = realloc(fd_table, size * sizeof(*table));
+    if (!table)
+        return -1;
+    memset(table + fd_table_size, 0, (size - fd_table_size) * sizeof(*table));
+    fd_table = table;
+    fd_table_size = size;
+    return 0;
+}
+
+static client_list_t *queue_list(client_queue_t queue)
+{
+    return queue == CLIENT_QUEUE_IDLE ? &idle_list : &ready_list;
+}
+
+static void queue_unlink(client_info_t *client)
+{
+    if (client->queue == CLIENT_QUEUE_NONE)
+        return;
+    client_list_t *list = queue_list(client->queue);
+    if (client->queue_prev)
+        client->queue_prev->queue_next = client->queue_next;
+    else
+        list->head = client->queue_next;
+    if (client->queue_next)
+        client->queue_next->queue_prev = client->queue_prev;
+    else
+        list->tail = client->queue_prev;
+    list->count--;
+    client->queue_prev = client->queue_next = NULL;
+    client->queue = CLIENT_QUEUE_NONE;
+}
+
+static void queue_push(client_info_t *client, client_queue_t queue)
+{
+    if (client->queue == queue)
+        return; // keep its place
+    queue_unlink(client);
+    client_list_t *list = queue_list(queue);
+    client->queue = queue;
+    client->queue_next = NULL;
+    client->queue_prev = list->tail;
+    if (list->tail)
+        list->tail->queue_next = client;
+    else
+        list->head = client;
+    list->tail = client;
+    list->count++;
+}
+
+void touch_client(client_info_t *client)
+{
+    const runtime_config_t *cfg = config_current();
+    client->last_activity = time(NULL);
+    // Expire once idle for more than the keep-alive timeout; while a
+    // request is forwarded, once its upstream has been silent too long
+    int timeout = client->proxy ? cfg->proxy_timeout : cfg->keep_alive_timeout;
+    timer_wheel_schedule(&expiry_wheel, &client->timer, client->last_activity + timeout + 1);
+}
+
+int client_acquire_buffers(client_info_t *client)
+{
+    queue_unlink(client);
+    if (!client->rbuf)
+        client->rbuf = pool_alloc(server_config.buffer_size);
+    if (!client->req && (client->req = pool_alloc(sizeof(*client->req))) != NULL)
+        http_request_reset(client->req);
+    if (!client->out.chunks)
+    {
+        void *storage = pool_alloc(OUTQ_STORAGE_SIZE);
+        if (storage)
+            outq_attach(&client->out, storage);
+    }
+    // Whatever was attached stays; the next release returns it
+    if (!client->rbuf || !client->req || !client->out.chunks)
     {
-        if (clients[i].fd == fd)
-            return &clients[i];
+        fprintf(stderr, "Out of memory, cannot serve fd=%d\n", client->fd);
+        return -1;
     }
-    return NULL;
+    return 0;
 }
 
-void add_client(int fd)
+static void release_client_buffers(client_info_t *client)
 {
-    if (client_count < MAX_CLIENTS)
+    outq_release(&client->out);
+    pool_free(outq_detach(&client->out), OUTQ_STORAGE_SIZE);
+    pool_free(client->rbuf, server_config.buffer_size);
+    pool_free(client->req, sizeof(*client->req));
+    client->rbuf = NULL;
+    client->req = NULL;
+}
+
+void client_release_idle_buffers(client_info_t *client)
+{
+    // An HTTP/2 stream waiting for a window update is not idle
+    if (client->rlen == 0 && outq_empty(&client->out) && !h2_busy(client))
     {
-        clients[client_count].fd = fd;
-        clients[client_count].last_activity = time(NULL);
-        clients[client_count].request_count = 0;
-        clients[client_count].keep_alive = 1;
-        client_count++;
-        printf("Added client fd=%d, total clients: %d\n", fd, client_count);
+        release_client_buffers(client);
+        queue_push(client, CLIENT_QUEUE_IDLE);
     }
-    else
+}
+
+void client_defer(client_info_t *client)
+{
+    queue_push(client, CLIENT_QUEUE_READY);
+}
+
+int client_deferred_count(void)
+{
+    return ready_list.count;
+}
+
+client_info_t *client_next_deferred(void)
+{
+    client_info_t *client = ready_list.head;
+    if (client)
+        queue_unlink(client);
+    return client;
+}
+
+int client_idle_count(void)
+{
+    return idle_list.count;
+}
+
+int evict_idle_connections(int max, void (*close_connection)(client_info_t *client))
+{
+    time_t now = time(NULL);
+    int evicted = 0;
+    client_info_t *next;
+    for (client_info_t *client = idle_list.head; client && evicted < max; client = next)
     {
-        printf("Max clients reached, cannot add fd=%d\n", fd);
+        next = client->queue_next;
+        // Oldest first: once one is too fresh, so are all the rest
+        if (now - client->last_activity < EVICT_MIN_IDLE)
+            break;
+        // Its next request is already here, about to be served
+        int unread = 0;
+        if (ioctl(client->fd, FIONREAD, &unread) == 0 && unread > 0)
+            continue;
+
+        queue_unlink(client);
+        if (log_verbose)
+            printf("Evicting idle connection fd=%d to admit a new one\n", client->fd);
+        metrics_count_evicted();
+        close_connection(client);
+        evicted++;
     }
+    return evicted;
 }
 
-void remove_client(int fd)
+void close_connections(int all, void (*close_connection)(client_info_t *client))
 {
-    for (int i = 0; i < client_count; i++)
+    time_t now = time(NULL);
+    for (int i = 0; i < server_config.max_clients; i++)
     {
-        if (clients[i].fd == fd)
+        client_info_t *client = &client_slab[i];
+        if (client->fd < 0)
+            continue;
+        if (!all)
         {
-            printf("Removing client fd=%d, requests served: %d\n", fd, clients[i].request_count);
-            clients[i] = clients[client_count - 1];
-            client_count--;
-            printf("Total clients now: %d\n", client_count);
-            break;
+            // Something buffered either way, or a request on the wire
+            int unread = 0;
+            if (client->rlen > 0 || !outq_empty(&client->out) || client->proxy ||
+                h2_busy(client) || (ioctl(client->fd, FIONREAD, &unread) == 0 && unread > 0))
+                continue;
+            // Same grace as eviction: a client that was just answered is
+            // probably sending its next request, which then gets
+            // Connection: close instead of a connection reset
+            if (now - client->last_activity < EVICT_MIN_IDLE)
+                continue;
         }
+        if (log_verbose)
+            printf("Draining: closing connection fd=%d\n", client->fd);
+        close_connection(client);
+    }
+}
+
+int add_client(int fd)
+{
+    if (!free_clients)
+    {
+        if (log_verbose)
+            printf("Max clients reached, cannot add fd=%d\n", fd);
+        return -1;
+    }
+
+    if (reserve_fd_slot(fd) < 0)
+    {
+        fprintf(stderr, "Out of memory, cannot add fd=%d\n", fd);
+        return -1;
     }
+
+    client_info_t *client = free_clients;
+    free_clients = client->next_free;
+    client->next_free = NULL;
+
+    client->fd = fd;
+    client->request_count = 0;
+    client->keep_alive = 1;
+    // Buffers are attached on first use by client_acquire_buffers()
+    client->rbuf = NULL;
+    client->rlen = 0;
+    client->req = NULL;
+    outq_init(&client->out);
+    client->close_after_send = 0;
+    client->status = 0;
+    timer_node_init(&client->timer);
+    if (access_log_enabled)
+        access_log_peer(fd, &client->peer);
+    client->io_state = NULL;
+    client->proxy = NULL;
+    client->nodelay = 0;
+    client->h2 = NULL;
+    client->tls = NULL;
+    client->queue = CLIENT_QUEUE_NONE;
+    client->queue_prev = client->queue_next = NULL;
+    touch_client(client);
+
+    fd_table[fd] = client;
+    client_count++;
+    metrics_count_accepted();
+    if (log_verbose)
+        printf("Added client fd=%d, total clients: %d\n", fd, client_count);
+    return 0;
 }
 
-void cleanup_expired_connections(fd_set *master_set, int *max_fd)
+static void free_client(client_info_t *client)
+{
+    if (client->proxy)
+        proxy_abort(client);
+    timer_wheel_cancel(&expiry_wheel, &client->timer);
+    queue_unlink(client);
+    release_client_buffers(client);
+    if (client->h2)
+        h2_free(client);
+    if (client->tls)
+        tls_free(client);
+    fd_table[client->fd] = NULL;
+    client->fd = -1;
+    client->next_free = free_clients;
+    free_clients = client;
+    client_count--;
+    metrics_connection_closed();
+}
+
+void remove_client(int fd)
+{
+    client_info_t *client = find_client(fd);
+    if (!client)
+        return;
+
+    if (log_verbose)
+        printf("Removing client fd=%d, requests served: %d\n", fd, client->request_count);
+    free_client(client);
+    if (log_verbose)
+        printf("Total clients now: %d\n", client_count);
+}
+
+void cleanup_expired_connections(void (*close_connection)(client_info_t *client))
 {
     time_t current_time = time(NULL);
-    int i = 0;
+    timer_node_t *node;
     
-    while (i < client_count)
+    // Only connections whose deadline has passed are visited
+    while ((node = timer_wheel_pop_expired(&expiry_wheel, current_time)) != NULL)
     {
-        client_info_t *client = &clients[i];
+        client_info_t *client = (client_info_t *)((char *)node - offsetof(client_info_t, timer));
         
-        if (current_time - client->last_activity > KEEP_ALIVE_TIMEOUT)
-        {
+        if (log_verbose)
             printf("Closing expired connection fd=%d (inactive for %ld seconds)\n", 
                    client->fd, current_time - client->last_activity);
-            close(client->fd);
-            FD_CLR(client->fd, master_set);
-            
-            if (client->fd == *max_fd)
-            {
-                *max_fd = 0;
-                for (int j = 0; j < FD_SETSIZE; j++)
-                {
-                    if (FD_ISSET(j, master_set) && j > *max_fd)
-                        *max_fd = j;
-                }
-            }
-            
-            clients[i] = clients[client_count - 1];
-            client_count--;
-        }
-        else
-        {
-            i++;
-        }
+        // The event backend decides how to tear the connection down
+        close_connection(client);
     }
 }
 
+int next_expiry_timeout_ms(void)
+{
+    return timer_wheel_next_timeout_ms(&expiry_wheel, time(NULL));
+}
+
 void print_connection_stats(void)
 {
+    // Counters live in /metrics; the per-connection dump is for debugging
+    if (!log_verbose)
+        return;
+
     time_t current_time = time(NULL);
     printf("=== Connection Statistics ===\n");
-    printf("Active connections: %d/%d\n", client_count, MAX_CLIENTS);
+    printf("Active connections: %d/%d\n", client_count, server_config.max_clients);
     
-    for (int i = 0; i < client_count; i++)
+    for (int i = 0; i < server_config.max_clients; i++)
     {
+        client_info_t *client = &client_slab[i];
+        if (client->fd < 0)
+            continue;
         printf("Client fd=%d: %d requests, inactive for %ld seconds, keep_alive=%s\n",
-               clients[i].fd, 
-               clients[i].request_count,
-               current_time - clients[i].last_activity,
-               clients[i].keep_alive ? "yes" : "no");
+               client->fd, 
+               client->request_count,
+               current_time - client->last_activity,
+               client->keep_alive ? "yes" : "no");
     }
     printf("=============================\n");
 }
@@ -12,8 +12,12 @@
  * 
  * Features:
  * - Keep-alive connection tracking
+ * - O(1) fd-indexed lookup over a preallocated connection slab
  * - Automatic timeout management
  * - Request counting per connection
+ * - Pooled I/O buffers, returned while a keep-alive connection is idle
+ * - Idle queue (oldest first) for shedding keep-alives under pressure, and
+ *   a ready queue for connections that used up their turn with work left
  * - Connection statistics monitoring
  * 
  * @license MIT License
@@ -23,27 +27,98 @@
 #define CLIENT_MANAGER_H
 
 #include <time.h>
-#include <sys/select.h>
+#include <stddef.h>
+#include "../http/http_parser.h"
+#include "../http/output_queue.h"
+#include "../core/timer_wheel.h"
+#include "../core/access_log.h"
 
-#define MAX_CLIENTS 100
-#define KEEP_ALIVE_TIMEOUT 30
-#define MAX_REQUESTS_PER_CONNECTION 100
+// Which waiting queue a connection is on; a connection being served is on none
+typedef enum {
+    CLIENT_QUEUE_NONE = 0,
+    CLIENT_QUEUE_IDLE,     // no request in progress, buffers released
+    CLIENT_QUEUE_READY     // yielded with buffered work, resume next pass
+} client_queue_t;
 
-typedef struct {
-    int fd;
+typedef struct client_info {
+    int fd;                // -1 while the slot is on the freelist
     time_t last_activity;
     int request_count;
     int keep_alive;
+    // rbuf, req and the output queue storage come from the worker's pool
+    // and go back to it while the connection sits idle
+    char *rbuf;            // read buffer (server_config.buffer_size bytes)
+    size_t rlen;           // bytes currently held in rbuf
+    http_request_t *req;   // parser state for the request at rbuf[0]
+    output_queue_t out;    // responses waiting to be written
+    int close_after_send;  // close once the pending output is flushed
+    int status;            // status code of the last response queued
+    timer_node_t timer;    // keep-alive deadline
+    access_peer_t peer;    // filled only while the access log is enabled
+    void *io_state;        // event-backend private per-connection state
+    void *proxy;           // exchange in progress with an upstream (proxy.c)
+    int nodelay;           // TCP_NODELAY set, for relayed responses
+    void *h2;              // HTTP/2 connection state (h2.c), NULL for HTTP/1.x
+    void *tls;             // TLS session (tls.c), NULL for cleartext
+    client_queue_t queue;
+    struct client_info *queue_prev;
+    struct client_info *queue_next;
+    struct client_info *next_free;
 } client_info_t;
 
-extern client_info_t clients[MAX_CLIENTS];
-extern int client_count;
+// Seconds without a request before a keep-alive connection may be evicted
+#define EVICT_MIN_IDLE 1
+
+// Each worker thread owns its own connection table
+extern __thread int client_count;
 
 void init_client_manager(void);
 client_info_t* find_client(int fd);
-void add_client(int fd);
+void touch_client(client_info_t *client);
+int add_client(int fd);
 void remove_client(int fd);
-void cleanup_expired_connections(fd_set *master_set, int *max_fd);
+
+/**
+ * Attach the read buffer, parser state and output queue storage before
+ * the connection reads or answers anything. Also takes the connection off
+ * the idle and ready queues: it is being served now.
+ * @return: 0 on success, -1 when out of memory
+ */
+int client_acquire_buffers(client_info_t *client);
+
+/**
+ * Hand the buffers back to the pool if nothing is buffered in either
+ * direction; an idle connection then holds only its client_info_t and
+ * joins the tail of the idle queue.
+ */
+void client_release_idle_buffers(client_info_t *client);
+
+/**
+ * Queue a connection that stopped at its per-pass budget with work left;
+ * the event loop resumes it after the other ready connections.
+ */
+void client_defer(client_info_t *client);
+int client_deferred_count(void);
+client_info_t *client_next_deferred(void);
+
+/**
+ * Close up to max connections idle for at least EVICT_MIN_IDLE seconds,
+ * longest idle first, to make room for new ones. Connections count as
+ * idle once they have been served; one that has not sent anything yet is
+ * left to its keep-alive deadline.
+ * @return: number of connections handed to close_connection
+ */
+int evict_idle_connections(int max, void (*close_connection)(client_info_t *client));
+int client_idle_count(void);
+
+/**
+ * Close every connection with no request in progress (nor a forwarded
+ * one) and idle for at least EVICT_MIN_IDLE seconds, or with all set
+ * every connection. Used while draining for shutdown.
+ */
+void close_connections(int all, void (*close_connection)(client_info_t *client));
+void cleanup_expired_connections(void (*close_connection)(client_info_t *client));
+int next_expiry_timeout_ms(void);
 void print_connection_stats(void);
 
 #endif // CLIENT_MANAGER_H
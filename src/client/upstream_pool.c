@@ -0,0 +1,250 @@
+/**
+ * @file upstream_pool.c
+ * @brief HTTP Server - Upstream Connection Pool Implementation
+ * @version 1.0.0
+ * @date 2025-06-07
+ * @author David Dev (@DavidDevGt)
+ *
+ * @description
+ * The keep-alive bookkeeping of client_manager.c, turned around: the
+ * worker is the client here. Connections are pooled per worker, so an
+ * exchange and the connection it runs on always belong to one event loop
+ * and need no locking.
+ *
+ * A pooled connection is checked before reuse with a MSG_PEEK recv(): an
+ * upstream that closed it while idle shows up as EOF, and one that sent
+ * anything unasked is not trusted with another request.
+ *
+ * @license MIT License
+ */
+
+#define _GNU_SOURCE  // for SOCK_NONBLOCK and SOCK_CLOEXEC
+
+#include "upstream_pool.h"
+#include "../core/event_loop.h"
+#include "../core/metrics.h"
+#include "../core/pool.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/socket.h>
+#include <netinet/tcp.h>
+
+#define UPSTREAM_FD_TABLE_INITIAL_SIZE 1024
+
+typedef struct {
+    upstream_conn_t *head;          // most recently used
+    upstream_conn_t *tail;          // next to expire
+    int count;
+} upstream_list_t;
+
+static __thread upstream_conn_t **fd_table;     // fd -> connection, grown on demand
+static __thread int fd_table_size;
+static __thread upstream_list_t idle_lists[UPSTREAM_MAX];
+static __thread upstream_list_t dead_list;
+
+static int reserve_fd_slot(int fd)
+{
+    if (fd < fd_table_size)
+        return 0;
+
+    int size = fd_table_size ? fd_table_size : UPSTREAM_FD_TABLE_INITIAL_SIZE;
+    while (size <= fd)
+        size *= 2;
+    upstream_conn_t **table = realloc(fd_table, size * sizeof(*table));
+    if (!table)
+        return -1;
+    memset(table + fd_table_size, 0, (size - fd_table_size) * sizeof(*table));
+    fd_table = table;
+    fd_table_size = size;
+    return 0;
+}
+
+static void list_unlink(upstream_list_t *list, upstream_conn_t *conn)
+{
+    if (conn->prev)
+        conn->prev->next = conn->next;
+    else
+        list->head = conn->next;
+    if (conn->next)
+        conn->next->prev = conn->prev;
+    else
+        list->tail = conn->prev;
+    conn->prev = conn->next = NULL;
+    list->count--;
+}
+
+static void list_push_front(upstream_list_t *list, upstream_conn_t *conn)
+{
+    conn->prev = NULL;
+    conn->next = list->head;
+    if (list->head)
+        list->head->prev = conn;
+    else
+        list->tail = conn;
+    list->head = conn;
+    list->count++;
+}
+
+upstream_conn_t *upstream_find(int fd)
+{
+    if (fd < 0 || fd >= fd_table_size)
+        return NULL;
+    return fd_table[fd];
+}
+
+upstream_conn_t *upstream_connect(int upstream, const struct sockaddr_in *addr)
+{
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+    {
+        perror("socket");
+        return NULL;
+    }
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    // Completes in the background; the first send() finds out how it went
+    if ((connect(fd, (const struct sockaddr *)addr, sizeof(*addr)) < 0 && errno != EINPROGRESS) ||
+        reserve_fd_slot(fd) < 0 || event_loop_watch(fd) < 0)
+    {
+        if (log_verbose)
+            printf("Cannot connect to upstream %d: %s\n", upstream, strerror(errno));
+        close(fd);
+        return NULL;
+    }
+
+    upstream_conn_t *conn = pool_alloc(sizeof(*conn));
+    if (!conn)
+    {
+        close(fd);
+        return NULL;
+    }
+    memset(conn, 0, sizeof(*conn));
+    conn->fd = fd;
+    conn->upstream = upstream;
+    conn->pipe_fds[0] = conn->pipe_fds[1] = -1;
+    fd_table[fd] = conn;
+    if (log_verbose)
+        printf("Connecting to upstream %d on fd=%d\n", upstream, fd);
+    return conn;
+}
+
+/**
+ * Whether a pooled connection can take another request: nothing to read,
+ * and not closed by the upstream.
+ */
+static int still_usable(const upstream_conn_t *conn)
+{
+    char byte;
+    ssize_t n = recv(conn->fd, &byte, 1, MSG_PEEK | MSG_DONTWAIT);
+    return n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+}
+
+upstream_conn_t *upstream_acquire(int upstream, const struct sockaddr_in *addr, int *reused)
+{
+    upstream_list_t *idle = &idle_lists[upstream];
+    upstream_conn_t *conn;
+    while ((conn = idle->head) != NULL)
+    {
+        list_unlink(idle, conn);
+        if (still_usable(conn))
+        {
+            *reused = 1;
+            return conn;
+        }
+        upstream_discard(conn);
+    }
+    *reused = 0;
+    return upstream_connect(upstream, addr);
+}
+
+void upstream_release(upstream_conn_t *conn)
+{
+    upstream_list_t *idle = &idle_lists[conn->upstream];
+    conn->client = NULL;
+    conn->requests++;
+    conn->idle_since = time(NULL);
+    list_push_front(idle, conn);
+    // Keep the most recently used ones; the oldest has the least time left
+    if (idle->count > UPSTREAM_MAX_IDLE)
+    {
+        upstream_conn_t *oldest = idle->tail;
+        list_unlink(idle, oldest);
+        upstream_discard(oldest);
+    }
+}
+
+void upstream_discard(upstream_conn_t *conn)
+{
+    if (conn->dead)
+        return;
+    conn->client = NULL;
+    conn->dead = 1;
+    list_push_front(&dead_list, conn);
+}
+
+void upstream_idle_event(upstream_conn_t *conn)
+{
+    if (conn->dead || still_usable(conn))
+        return;
+    if (log_verbose)
+        printf("Upstream closed idle connection fd=%d after %d requests\n",
+               conn->fd, conn->requests);
+    list_unlink(&idle_lists[conn->upstream], conn);
+    upstream_discard(conn);
+}
+
+static void close_conn(upstream_conn_t *conn)
+{
+    // close() also removes the fd from the epoll interest list
+    fd_table[conn->fd] = NULL;
+    close(conn->fd);
+    if (conn->pipe_fds[0] >= 0)
+    {
+        close(conn->pipe_fds[0]);
+        close(conn->pipe_fds[1]);
+    }
+    pool_free(conn, sizeof(*conn));
+}
+
+void upstream_reap(void)
+{
+    upstream_conn_t *conn;
+    while ((conn = dead_list.head) != NULL)
+    {
+        list_unlink(&dead_list, conn);
+        close_conn(conn);
+    }
+
+    time_t now = time(NULL);
+    for (int i = 0; i < UPSTREAM_MAX; i++)
+    {
+        upstream_list_t *idle = &idle_lists[i];
+        while ((conn = idle->tail) != NULL && now - conn->idle_since >= UPSTREAM_IDLE_TIMEOUT)
+        {
+            list_unlink(idle, conn);
+            close_conn(conn);
+        }
+    }
+}
+
+int upstream_next_expiry_ms(void)
+{
+    time_t now = time(NULL);
+    int timeout = -1;
+    for (int i = 0; i < UPSTREAM_MAX; i++)
+    {
+        upstream_conn_t *oldest = idle_lists[i].tail;
+        if (!oldest)
+            continue;
+        long ms = (oldest->idle_since + UPSTREAM_IDLE_TIMEOUT - now) * 1000;
+        if (ms < 0)
+            ms = 0;
+        if (timeout < 0 || ms < timeout)
+            timeout = (int)ms;
+    }
+    return timeout;
+}
@@ -0,0 +1,91 @@
+/**
+ * @file upstream_pool.h
+ * @brief HTTP Server - Upstream Connection Pool Interface
+ * @version 1.0.0
+ * @date 2025-06-07
+ * @author David Dev (@DavidDevGt)
+ *
+ * @description
+ * Persistent connections to proxy upstreams, kept per worker like the
+ * client table: an fd-indexed lookup, and per upstream an idle list that
+ * is reused most recent first and expired oldest first.
+ *
+ * Upstream sockets sit in the worker's epoll set next to the client
+ * sockets. A connection that is given up is only closed after the current
+ * event batch (upstream_reap()), so an fd number still listed in that
+ * batch is never reused by then.
+ *
+ * @license MIT License
+ */
+
+#ifndef UPSTREAM_POOL_H
+#define UPSTREAM_POOL_H
+
+#include <stddef.h>
+#include <time.h>
+#include <netinet/in.h>
+
+#define UPSTREAM_MAX 16             // configured upstreams (proxy routes)
+#define UPSTREAM_MAX_IDLE 32        // pooled connections per upstream and worker
+#define UPSTREAM_IDLE_TIMEOUT 10    // seconds a pooled connection is kept
+
+struct client_info;
+
+typedef struct upstream_conn {
+    int fd;
+    int upstream;                   // route index
+    int pipe_fds[2];                // splice pipe, created on first use
+    size_t piped;                   // bytes sitting in the pipe
+    int requests;                   // exchanges completed on this connection
+    int dead;                       // given up, closed by upstream_reap()
+    time_t idle_since;
+    struct client_info *client;     // client being answered, NULL while pooled
+    struct upstream_conn *prev;     // idle or dead list
+    struct upstream_conn *next;
+} upstream_conn_t;
+
+/**
+ * A connection to upstream, pooled if one is idle, otherwise a new
+ * non-blocking connect that completes in the background.
+ * @return: the connection, or NULL if no socket could be set up
+ */
+upstream_conn_t *upstream_acquire(int upstream, const struct sockaddr_in *addr, int *reused);
+
+/**
+ * A new connection, bypassing the pool; used to retry a request that a
+ * pooled connection failed before any response byte arrived.
+ * @return: the connection, or NULL if no socket could be set up
+ */
+upstream_conn_t *upstream_connect(int upstream, const struct sockaddr_in *addr);
+
+/**
+ * Return a connection with a finished exchange to its idle list.
+ */
+void upstream_release(upstream_conn_t *conn);
+
+/**
+ * Give a connection up; it is closed after the current event batch.
+ */
+void upstream_discard(upstream_conn_t *conn);
+
+upstream_conn_t *upstream_find(int fd);
+
+/**
+ * Event on a connection nobody is using: the upstream closed it, or sent
+ * something it should not have.
+ */
+void upstream_idle_event(upstream_conn_t *conn);
+
+/**
+ * Close given-up connections and those idle for UPSTREAM_IDLE_TIMEOUT;
+ * run after each event batch.
+ */
+void upstream_reap(void);
+
+/**
+ * Milliseconds until the next pooled connection expires, -1 if none is
+ * pooled; bounds the event loop's sleep.
+ */
+int upstream_next_expiry_ms(void);
+
+#endif // UPSTREAM_POOL_H
@@ -0,0 +1,389 @@
+/**
+ * @file access_log.c
+ * @brief HTTP Server Core - Asynchronous Access Log Implementation
+ * @version 1.0.0
+ * @date 2025-06-07
+ * @author David Dev (@DavidDevGt)
+ *
+ * @description
+ * One single-producer/single-consumer ring per worker. The worker only
+ * copies a record and publishes the new tail with a release store; it
+ * never formats, locks or makes a system call. If the ring is full the
+ * record is dropped and counted, the request is never delayed.
+ *
+ * The writer thread drains every ring, renders JSON lines into a batch
+ * buffer and writes it with one write() call. When the file would grow
+ * past the size limit it is rotated: path -> path.1 -> ... -> path.N.
+ *
+ * Features:
+ * - Lock-free, syscall-free logging on the request path
+ * - Batched writes from a background thread
+ * - Size-based rotation
+ * - Dropped-record accounting
+ *
+ * @license MIT License
+ */
+
+#define _GNU_SOURCE  // for gmtime_r and posix_memalign
+
+#include "access_log.h"
+#include "metrics.h"
+#include "worker.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#define RING_MASK (ACCESS_LOG_RING_SIZE - 1)
+
+typedef struct {
+    uint64_t timestamp_ns;               // CLOCK_REALTIME
+    uint64_t bytes;
+    uint32_t queued_us;                  // parse start to response queued
+    int32_t fd;
+    uint16_t status;
+    uint8_t method_len;
+    uint8_t path_len;
+    access_peer_t peer;
+    char method[ACCESS_LOG_METHOD_MAX];
+    char path[ACCESS_LOG_PATH_MAX];
+} access_record_t;
+
+typedef struct {
+    uint64_t head __attribute__((aligned(64)));  // consumer: next record to write
+    uint64_t tail __attribute__((aligned(64)));  // producer: next free slot
+    uint64_t dropped;                            // producer-owned
+    uint64_t dropped_reported;                   // consumer-owned
+    access_record_t records[ACCESS_LOG_RING_SIZE];
+} access_ring_t;
+
+int access_log_enabled = 0;
+
+static access_ring_t *rings[MAX_WORKERS];
+static int ring_count = 0;
+static __thread access_ring_t *thread_ring;
+
+static char *log_path;
+static size_t log_max_bytes;
+static int log_fd = -1;
+static size_t log_size;
+static char *batch;
+static size_t batch_len;
+static pthread_t writer_thread;
+static int writer_stop = 0;
+
+static int open_log_file(void)
+{
+    log_fd = open(log_path, O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0644);
+    if (log_fd < 0)
+        return -1;
+    struct stat st;
+    log_size = fstat(log_fd, &st) == 0 ? (size_t)st.st_size : 0;
+    return 0;
+}
+
+static void rotate_log_file(void)
+{
+    size_t len = strlen(log_path) + 16;
+    char from[len], to[len];
+
+    close(log_fd);
+    for (int i = ACCESS_LOG_KEEP_FILES - 1; i >= 1; i--)
+    {
+        snprintf(from, len, "%s.%d", log_path, i);
+        snprintf(to, len, "%s.%d", log_path, i + 1);
+        rename(from, to); // missing generations are fine
+    }
+    snprintf(to, len, "%s.1", log_path);
+    rename(log_path, to);
+
+    if (open_log_file() < 0)
+        fprintf(stderr, "access log: cannot reopen %s: %s\n", log_path, strerror(errno));
+}
+
+static void flush_batch(void)
+{
+    if (batch_len == 0)
+        return;
+    if (log_fd >= 0 && log_max_bytes > 0 && log_size > 0 &&
+        log_size + batch_len > log_max_bytes)
+        rotate_log_file();
+
+    size_t off = 0;
+    while (log_fd >= 0 && off < batch_len)
+    {
+        ssize_t n = write(log_fd, batch + off, batch_len - off);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            fprintf(stderr, "access log: write failed: %s\n", strerror(errno));
+            break;
+        }
+        off += n;
+    }
+    log_size += off;
+    batch_len = 0;
+}
+
+/**
+ * Append a JSON string body (without quotes), escaping as needed.
+ */
+static void append_json_string(const char *s, size_t len)
+{
+    for (size_t i = 0; i < len; i++)
+    {
+        unsigned char c = (unsigned char)s[i];
+        if (c == '"' || c == '\\')
+        {
+            batch[batch_len++] = '\\';
+            batch[batch_len++] = c;
+        }
+        else if (c < 0x20 || c == 0x7f)
+        {
+            batch_len += snprintf(batch + batch_len, 7, "\\u%04x", c);
+        }
+        else
+        {
+            batch[batch_len++] = c;
+        }
+    }
+}
+
+static void format_peer(const access_peer_t *peer, char *out, size_t size)
+{
+    char addr[INET6_ADDRSTRLEN];
+    if (peer->family == AF_INET && inet_ntop(AF_INET, peer->addr, addr, sizeof(addr)))
+        snprintf(out, size, "%s:%u", addr, peer->port);
+    else if (peer->family == AF_INET6 && inet_ntop(AF_INET6, peer->addr, addr, sizeof(addr)))
+        snprintf(out, size, "[%s]:%u", addr, peer->port);
+    else
+        snprintf(out, size, "-");
+}
+
+static void format_record(const access_record_t *rec)
+{
+    // Worst case: every path/method byte escaped to six characters
+    size_t worst = 256 + 6 * (ACCESS_LOG_PATH_MAX + ACCESS_LOG_METHOD_MAX);
+    if (batch_len + worst > ACCESS_LOG_BATCH_SIZE)
+        flush_batch();
+
+    time_t secs = (time_t)(rec->timestamp_ns / 1000000000ull);
+    unsigned millis = (unsigned)(rec->timestamp_ns / 1000000ull % 1000);
+    struct tm tm;
+    gmtime_r(&secs, &tm);
+
+    char peer[INET6_ADDRSTRLEN + 8];
+    format_peer(&rec->peer, peer, sizeof(peer));
+
+    batch_len += snprintf(batch + batch_len, ACCESS_LOG_BATCH_SIZE - batch_len,
+                          "{\"time\":\"%04d-%02d-%02dT%02d:%02d:%02d.%03uZ\","
+                          "\"peer\":\"%s\",\"fd\":%d,\"method\":\"",
+                          tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday,
+                          tm.tm_hour, tm.tm_min, tm.tm_sec, millis, peer, rec->fd);
+    append_json_string(rec->method, rec->method_len);
+    memcpy(batch + batch_len, "\",\"path\":\"", 10);
+    batch_len += 10;
+    append_json_string(rec->path, rec->path_len);
+    batch_len += snprintf(batch + batch_len, ACCESS_LOG_BATCH_SIZE - batch_len,
+                          "\",\"status\":%u,\"bytes\":%llu,\"queued_us\":%u}\n",
+                          rec->status, (unsigned long long)rec->bytes, rec->queued_us);
+}
+
+/**
+ * Move everything currently in the rings into the batch buffer.
+ * @return: number of records consumed
+ */
+static size_t drain_rings(void)
+{
+    size_t drained = 0;
+    int count = __atomic_load_n(&ring_count, __ATOMIC_ACQUIRE);
+    if (count > MAX_WORKERS)
+        count = MAX_WORKERS;
+
+    for (int w = 0; w < count; w++)
+    {
+        access_ring_t *ring = __atomic_load_n(&rings[w], __ATOMIC_ACQUIRE);
+        if (!ring)
+            continue;
+
+        uint64_t head = ring->head;
+        uint64_t tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+        for (; head != tail; head++)
+            format_record(&ring->records[head & RING_MASK]);
+        drained += tail - ring->head;
+        __atomic_store_n(&ring->head, head, __ATOMIC_RELEASE);
+
+        uint64_t dropped = __atomic_load_n(&ring->dropped, __ATOMIC_RELAXED);
+        if (dropped != ring->dropped_reported)
+        {
+            if (batch_len + 128 > ACCESS_LOG_BATCH_SIZE)
+                flush_batch();
+            batch_len += snprintf(batch + batch_len, ACCESS_LOG_BATCH_SIZE - batch_len,
+                                  "{\"dropped\":%llu,\"worker\":%d}\n",
+                                  (unsigned long long)(dropped - ring->dropped_reported), w);
+            ring->dropped_reported = dropped;
+        }
+    }
+    return drained;
+}
+
+static void *writer_main(void *arg)
+{
+    (void)arg;
+    // Workers never wake the writer (that would put a system call on the
+    // request path), so it naps between passes. A ring holds far more
+    // records than a worker produces in one nap.
+    struct timespec nap = { 0, ACCESS_LOG_POLL_MS * 1000000L };
+    int held = 0;                        // passes the batch has waited
+    while (!__atomic_load_n(&writer_stop, __ATOMIC_ACQUIRE))
+    {
+        // Keep batching while records are flowing, write when it goes
+        // quiet, fills up or has waited long enough
+        if (drain_rings() == 0 || batch_len >= ACCESS_LOG_BATCH_SIZE / 2 ||
+            ++held >= ACCESS_LOG_MAX_DELAY_MS / ACCESS_LOG_POLL_MS)
+        {
+            flush_batch();
+            held = 0;
+        }
+        nanosleep(&nap, NULL);
+    }
+    drain_rings();
+    flush_batch();
+    return NULL;
+}
+
+int access_log_open(const char *path, size_t max_bytes)
+{
+    log_path = strdup(path);
+    log_max_bytes = max_bytes;
+    batch = malloc(ACCESS_LOG_BATCH_SIZE);
+    if (!log_path || !batch)
+        return -1;
+    if (open_log_file() < 0)
+        return -1;
+    if (pthread_create(&writer_thread, NULL, writer_main, NULL) != 0)
+    {
+        close(log_fd);
+        log_fd = -1;
+        return -1;
+    }
+    access_log_enabled = 1;
+    return 0;
+}
+
+void access_log_init_thread(void)
+{
+    if (!access_log_enabled)
+        return;
+
+    access_ring_t *ring;
+    if (posix_memalign((void **)&ring, 64, sizeof(*ring)) != 0)
+    {
+        perror("access_log_init_thread");
+        exit(1);
+    }
+    memset(ring, 0, sizeof(*ring));
+
+    int slot = __atomic_fetch_add(&ring_count, 1, __ATOMIC_RELAXED);
+    if (slot < MAX_WORKERS)
+    {
+        __atomic_store_n(&rings[slot], ring, __ATOMIC_RELEASE);
+        thread_ring = ring;
+    }
+    else
+    {
+        free(ring);
+    }
+}
+
+void access_log_peer(int fd, access_peer_t *peer)
+{
+    struct sockaddr_storage addr;
+    socklen_t len = sizeof(addr);
+    memset(peer, 0, sizeof(*peer));
+    if (getpeername(fd, (struct sockaddr *)&addr, &len) < 0)
+        return;
+
+    if (addr.ss_family == AF_INET)
+    {
+        const struct sockaddr_in *in = (const struct sockaddr_in *)&addr;
+        peer->family = AF_INET;
+        peer->port = ntohs(in->sin_port);
+        memcpy(peer->addr, &in->sin_addr, 4);
+    }
+    else if (addr.ss_family == AF_INET6)
+    {
+        const struct sockaddr_in6 *in6 = (const struct sockaddr_in6 *)&addr;
+        peer->family = AF_INET6;
+        peer->port = ntohs(in6->sin6_port);
+        memcpy(peer->addr, &in6->sin6_addr, 16);
+    }
+}
+
+static size_t copy_slice(char *dst, size_t size, const http_slice_t *slice)
+{
+    size_t len = slice->len < size ? slice->len : size;
+    memcpy(dst, slice->ptr, len);
+    return len;
+}
+
+void access_log_record(const access_peer_t *peer, int fd, const http_request_t *req,
+                       int status, size_t bytes, uint64_t start_ns)
+{
+    access_ring_t *ring = thread_ring;
+    if (!ring)
+        return;
+
+    uint64_t tail = ring->tail;
+    if (tail - __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) == ACCESS_LOG_RING_SIZE)
+    {
+        __atomic_store_n(&ring->dropped, ring->dropped + 1, __ATOMIC_RELAXED);
+        return;
+    }
+
+    access_record_t *rec = &ring->records[tail & RING_MASK];
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    rec->timestamp_ns = (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+    rec->queued_us = (uint32_t)((metrics_now_ns() - start_ns) / 1000);
+    rec->bytes = bytes;
+    rec->fd = fd;
+    rec->status = (uint16_t)status;
+    rec->peer = *peer;
+    if (req && req->method.ptr)
+    {
+        rec->method_len = (uint8_t)copy_slice(rec->method, ACCESS_LOG_METHOD_MAX, &req->method);
+        rec->path_len = (uint8_t)copy_slice(rec->path, ACCESS_LOG_PATH_MAX, &req->path);
+    }
+    else
+    {
+        // Unparseable request: nothing trustworthy to copy
+        rec->method[0] = '-';
+        rec->method_len = 1;
+        rec->path[0] = '-';
+        rec->path_len = 1;
+    }
+
+    __atomic_store_n(&ring->tail, tail + 1, __ATOMIC_RELEASE);
+}
+
+void access_log_close(void)
+{
+    if (!access_log_enabled)
+        return;
+    __atomic_store_n(&writer_stop, 1, __ATOMIC_RELEASE);
+    pthread_join(writer_thread, NULL);
+    if (log_fd >= 0)
+        close(log_fd);
+    log_fd = -1;
+    access_log_enabled = 0;
+}
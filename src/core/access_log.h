@@ -0,0 +1,50 @@
+/**
+ * @file access_log.h
+ * @brief HTTP Server Core - Asynchronous Access Log Interface
+ * @version 1.0.0
+ * @date 2025-06-07
+ * @author David Dev (@DavidDevGt)
+ *
+ * @description
+ * Structured access log kept off the request path. Workers copy a small
+ * fixed-size record into their own single-producer ring; a background
+ * thread formats the records as JSON lines and writes them to the log
+ * file in large batches, rotating it by size.
+ *
+ * @license MIT License
+ */
+
+#ifndef ACCESS_LOG_H
+#define ACCESS_LOG_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "../http/http_parser.h"
+
+#define ACCESS_LOG_RING_SIZE 4096        // records per worker, power of two
+#define ACCESS_LOG_METHOD_MAX 8
+#define ACCESS_LOG_PATH_MAX 128          // longer paths are truncated
+#define ACCESS_LOG_BATCH_SIZE (256 * 1024)
+#define ACCESS_LOG_DEFAULT_MAX_BYTES (64 * 1024 * 1024)
+#define ACCESS_LOG_KEEP_FILES 5          // rotated files: path.1 .. path.5
+#define ACCESS_LOG_POLL_MS 5             // writer nap between passes
+#define ACCESS_LOG_MAX_DELAY_MS 1000     // longest a record waits in the batch
+
+// Peer address, kept compact so it can live in every connection
+typedef struct {
+    uint16_t family;                     // AF_INET, AF_INET6 or 0 if unknown
+    uint16_t port;                       // host byte order
+    uint8_t addr[16];
+} access_peer_t;
+
+// Nonzero once access_log_open() succeeded
+extern int access_log_enabled;
+
+int access_log_open(const char *path, size_t max_bytes);
+void access_log_init_thread(void);
+void access_log_peer(int fd, access_peer_t *peer);
+void access_log_record(const access_peer_t *peer, int fd, const http_request_t *req,
+                       int status, size_t bytes, uint64_t start_ns);
+void access_log_close(void);
+
+#endif // ACCESS_LOG_H
@@ -0,0 +1,563 @@
+/**
+ * @file config.c
+ * @brief HTTP Server Core - Runtime Configuration Implementation
+ * @version 1.0.0
+ * @date 2025-06-07
+ * @author David Dev (@DavidDevGt)
+ *
+ * @description
+ * One option table serves both the config file ("name = value" lines,
+ * '#' comments) and the command line ("--name value"), so every setting
+ * has the same name and validation in both places.
+ *
+ * Reloadable settings live in an immutable snapshot. A reload builds a
+ * new snapshot from the file plus the original command line and publishes
+ * it with a single pointer store; workers never see a half-applied
+ * configuration. Old snapshots are kept, since a worker may still be
+ * reading one; each reload costs a few KB.
+ *
+ * @license MIT License
+ */
+
+#define _GNU_SOURCE  // for realpath and strdup
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include "config.h"
+#include "event_loop.h"
+#include "metrics.h"
+#include "access_log.h"
+#include "lifecycle.h"
+#include "../http/file_cache.h"
+#include "../http/conditional.h"
+#include "../http/proxy.h"
+#include "../http/bundle.h"
+
+typedef struct {
+    const char *name;
+    int takes_value;          // 0: a flag on the command line, yes/no in the file
+    int reloadable;
+    int (*apply)(const char *value, runtime_config_t *rt);
+} config_option_t;
+
+server_config_t server_config = {
+    .port = CONFIG_DEFAULT_PORT,
+    .backlog = CONFIG_DEFAULT_BACKLOG,
+    .workers = 1,
+    .max_clients = CONFIG_DEFAULT_MAX_CLIENTS,
+    .buffer_size = CONFIG_DEFAULT_BUFFER_SIZE,
+    .open_file_cache = CONFIG_DEFAULT_OPEN_FILE_CACHE,
+    .defer_accept = CONFIG_DEFAULT_DEFER_ACCEPT,
+    .drain_timeout = CONFIG_DEFAULT_DRAIN_TIMEOUT,
+    .access_log_max = ACCESS_LOG_DEFAULT_MAX_BYTES,
+    .bundle_preload = BUNDLE_PRELOAD_POPULATE
+};
+
+static runtime_config_t *current;
+static volatile sig_atomic_t reload_requested = 0;
+static int saved_argc;
+static char **saved_argv;
+
+static int parse_number(const char *arg, long min, long max, long *out)
+{
+    char *end;
+    long n = strtol(arg, &end, 10);
+    if (*arg == '\0' || *end != '\0' || n < min || n > max)
+        return -1;
+    *out = n;
+    return 0;
+}
+
+static int parse_bool(const char *arg, int *out)
+{
+    if (strcmp(arg, "yes") == 0 || strcmp(arg, "on") == 0 ||
+        strcmp(arg, "true") == 0 || strcmp(arg, "1") == 0)
+        *out = 1;
+    else if (strcmp(arg, "no") == 0 || strcmp(arg, "off") == 0 ||
+             strcmp(arg, "false") == 0 || strcmp(arg, "0") == 0)
+        *out = 0;
+    else
+        return -1;
+    return 0;
+}
+
+static int set_port(const char *value, runtime_config_t *rt)
+{
+    (void)rt;
+    long n;
+    if (parse_number(value, 1, 65535, &n) < 0)
+        return -1;
+    server_config.port = (int)n;
+    return 0;
+}
+
+static int set_backlog(const char *value, runtime_config_t *rt)
+{
+    (void)rt;
+    long n;
+    if (parse_number(value, 1, 65535, &n) < 0)
+        return -1;
+    server_config.backlog = (int)n;
+    return 0;
+}
+
+static int set_workers(const char *value, runtime_config_t *rt)
+{
+    (void)rt;
+    long n;
+    if (parse_number(value, 0, 65535, &n) < 0)
+        return -1;
+    server_config.workers = (int)n;
+    return 0;
+}
+
+static int set_max_clients(const char *value, runtime_config_t *rt)
+{
+    (void)rt;
+    long n;
+    if (parse_number(value, 1, 1000000, &n) < 0)
+        return -1;
+    server_config.max_clients = (int)n;
+    return 0;
+}
+
+static int set_buffer_size(const char *value, runtime_config_t *rt)
+{
+    (void)rt;
+    long n;
+    if (parse_number(value, CONFIG_MIN_BUFFER_SIZE, CONFIG_MAX_BUFFER_SIZE, &n) < 0)
+        return -1;
+    server_config.buffer_size = (size_t)n;
+    return 0;
+}
+
+static int set_open_file_cache(const char *value, runtime_config_t *rt)
+{
+    (void)rt;
+    long n;
+    if (parse_number(value, 0, 1000000, &n) < 0)
+        return -1;
+    server_config.open_file_cache = (int)n;
+    return 0;
+}
+
+static int set_defer_accept(const char *value, runtime_config_t *rt)
+{
+    (void)rt;
+    long n;
+    if (parse_number(value, 0, 3600, &n) < 0)
+        return -1;
+    server_config.defer_accept = (int)n;
+    return 0;
+}
+
+static int set_drain_timeout(const char *value, runtime_config_t *rt)
+{
+    (void)rt;
+    long n;
+    if (parse_number(value, 0, 3600, &n) < 0)
+        return -1;
+    server_config.drain_timeout = (int)n;
+    return 0;
+}
+
+static int set_tls_port(const char *value, runtime_config_t *rt)
+{
+    (void)rt;
+    long n;
+    if (parse_number(value, 0, 65535, &n) < 0)
+        return -1;
+    server_config.tls_port = (int)n;
+    return 0;
+}
+
+static int set_tls_cert(const char *value, runtime_config_t *rt)
+{
+    (void)rt;
+    char *path = strdup(value);
+    if (!path)
+        return -1;
+    server_config.tls_cert = path;
+    return 0;
+}
+
+static int set_tls_key(const char *value, runtime_config_t *rt)
+{
+    (void)rt;
+    char *path = strdup(value);
+    if (!path)
+        return -1;
+    server_config.tls_key = path;
+    return 0;
+}
+
+static int set_bundle(const char *value, runtime_config_t *rt)
+{
+    (void)rt;
+    char *path = strdup(value);
+    if (!path)
+        return -1;
+    server_config.bundle_path = path;
+    return 0;
+}
+
+static int set_bundle_preload(const char *value, runtime_config_t *rt)
+{
+    (void)rt;
+    if (strcmp(value, "lazy") == 0)
+        server_config.bundle_preload = BUNDLE_PRELOAD_LAZY;
+    else if (strcmp(value, "populate") == 0)
+        server_config.bundle_preload = BUNDLE_PRELOAD_POPULATE;
+    else if (strcmp(value, "lock") == 0)
+        server_config.bundle_preload = BUNDLE_PRELOAD_LOCK;
+    else
+        return -1;
+    return 0;
+}
+
+static int set_cache_mb(const char *value, runtime_config_t *rt)
+{
+    (void)rt;
+    long n;
+    if (parse_number(value, 0, 1024 * 1024, &n) < 0)
+        return -1;
+    file_cache_set_budget((size_t)n * 1024 * 1024);
+    return 0;
+}
+
+static int set_backend(const char *value, runtime_config_t *rt)
+{
+    (void)rt;
+    return set_event_backend(value);
+}
+
+static int set_access_log(const char *value, runtime_config_t *rt)
+{
+    (void)rt;
+    char *path = strdup(value);
+    if (!path)
+        return -1;
+    server_config.access_log_path = path;
+    return 0;
+}
+
+static int set_access_log_max_mb(const char *value, runtime_config_t *rt)
+{
+    (void)rt;
+    long n;
+    if (parse_number(value, 0, 1024 * 1024, &n) < 0)
+        return -1;
+    server_config.access_log_max = (size_t)n * 1024 * 1024;
+    return 0;
+}
+
+static int set_verbose(const char *value, runtime_config_t *rt)
+{
+    (void)rt;
+    return parse_bool(value, &log_verbose);
+}
+
+static int set_keep_alive_timeout(const char *value, runtime_config_t *rt)
+{
+    long n;
+    if (parse_number(value, 1, 24 * 3600, &n) < 0)
+        return -1;
+    rt->keep_alive_timeout = (int)n;
+    return 0;
+}
+
+static int set_proxy_timeout(const char *value, runtime_config_t *rt)
+{
+    long n;
+    if (parse_number(value, 1, 24 * 3600, &n) < 0)
+        return -1;
+    rt->proxy_timeout = (int)n;
+    return 0;
+}
+
+static int set_max_requests(const char *value, runtime_config_t *rt)
+{
+    long n;
+    if (parse_number(value, 1, 1000000, &n) < 0)
+        return -1;
+    rt->max_requests = (int)n;
+    return 0;
+}
+
+static int set_open_file_valid(const char *value, runtime_config_t *rt)
+{
+    long n;
+    if (parse_number(value, 0, 24 * 3600, &n) < 0)
+        return -1;
+    rt->open_file_valid = (int)n;
+    return 0;
+}
+
+static int set_root(const char *value, runtime_config_t *rt)
+{
+    if (value[0] == '\0' || strlen(value) >= sizeof(rt->root))
+        return -1;
+    strcpy(rt->root, value);
+    return 0;
+}
+
+static int set_cache_control(const char *value, runtime_config_t *rt)
+{
+    (void)rt;
+    return cache_control_add_rule(value);
+}
+
+static int set_proxy(const char *value, runtime_config_t *rt)
+{
+    (void)rt;
+    return proxy_add_route(value);
+}
+
+static const config_option_t options[] = {
+    { "port",               1, 0, set_port },
+    { "backlog",            1, 0, set_backlog },
+    { "workers",            1, 0, set_workers },
+    { "max-clients",        1, 0, set_max_clients },
+    { "buffer-size",        1, 0, set_buffer_size },
+    { "cache-mb",           1, 0, set_cache_mb },
+    { "open-file-cache",    1, 0, set_open_file_cache },
+    { "defer-accept",       1, 0, set_defer_accept },
+    { "drain-timeout",      1, 0, set_drain_timeout },
+    { "backend",            1, 0, set_backend },
+    { "proxy",              1, 0, set_proxy },
+    { "tls-port",           1, 0, set_tls_port },
+    { "tls-cert",           1, 0, set_tls_cert },
+    { "tls-key",            1, 0, set_tls_key },
+    { "bundle",             1, 0, set_bundle },
+    { "bundle-preload",     1, 0, set_bundle_preload },
+    { "access-log",         1, 0, set_access_log },
+    { "access-log-max-mb",  1, 0, set_access_log_max_mb },
+    { "verbose",            0, 0, set_verbose },
+    { "keep-alive-timeout", 1, 1, set_keep_alive_timeout },
+    { "proxy-timeout",      1, 1, set_proxy_timeout },
+    { "max-requests",       1, 1, set_max_requests },
+    { "open-file-cache-valid", 1, 1, set_open_file_valid },
+    { "root",               1, 1, set_root },
+    { "cache-control",      1, 1, set_cache_control },
+};
+
+static const config_option_t *find_option(const char *name)
+{
+    for (size_t i = 0; i < sizeof(options) / sizeof(options[0]); i++)
+    {
+        if (strcmp(options[i].name, name) == 0)
+            return &options[i];
+    }
+    return NULL;
+}
+
+static int apply_option(const config_option_t *opt, const char *value,
+                        runtime_config_t *rt, int reloading)
+{
+    // Structural settings size sockets and tables; they need a restart
+    if (reloading && !opt->reloadable)
+        return 0;
+    return opt->apply(value, rt);
+}
+
+static char *trim(char *s)
+{
+    while (*s == ' ' || *s == '\t')
+        s++;
+    char *end = s + strlen(s);
+    while (end > s && (end[-1] == ' ' || end[-1] == '\t' || end[-1] == '\n' || end[-1] == '\r'))
+        end--;
+    *end = '\0';
+    return s;
+}
+
+/**
+ * Apply a config file.
+ * @return: 0 on success, -1 on the first bad line (reported on stderr)
+ */
+static int load_file(const char *path, runtime_config_t *rt, int reloading)
+{
+    FILE *f = fopen(path, "r");
+    if (!f)
+    {
+        perror(path);
+        return -1;
+    }
+
+    char line[CONFIG_MAX_LINE];
+    int line_no = 0;
+    int rc = 0;
+    while (fgets(line, sizeof(line), f))
+    {
+        line_no++;
+        char *text = trim(line);
+        if (*text == '\0' || *text == '#')
+            continue;
+
+        char *eq = strchr(text, '=');
+        if (!eq)
+        {
+            fprintf(stderr, "%s:%d: expected name = value\n", path, line_no);
+            rc = -1;
+            break;
+        }
+        *eq = '\0';
+        char *name = trim(text);
+        char *value = trim(eq + 1);
+
+        const config_option_t *opt = find_option(name);
+        if (!opt)
+        {
+            fprintf(stderr, "%s:%d: unknown setting '%s'\n", path, line_no, name);
+            rc = -1;
+            break;
+        }
+        if (apply_option(opt, value, rt, reloading) < 0)
+        {
+            fprintf(stderr, "%s:%d: invalid value for %s: %s\n", path, line_no, name, value);
+            rc = -1;
+            break;
+        }
+    }
+    fclose(f);
+    return rc;
+}
+
+/**
+ * Apply command-line options; they override the file.
+ * @return: 0 on success, -1 on an unknown option or invalid value
+ */
+static int apply_args(int argc, char **argv, runtime_config_t *rt, int reloading)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        const char *name = argv[i];
+        if (strcmp(name, "-w") == 0)
+            name = "--workers";
+        else if (strcmp(name, "-v") == 0)
+            name = "--verbose";
+        if (strncmp(name, "--", 2) != 0)
+            return -1;
+        name += 2;
+
+        if (strcmp(name, "config") == 0)
+        {
+            if (++i >= argc)
+                return -1;
+            continue; // read before everything else by config_load()
+        }
+
+        const config_option_t *opt = find_option(name);
+        if (!opt || (opt->takes_value && i + 1 >= argc))
+            return -1;
+        const char *value = opt->takes_value ? argv[++i] : "yes";
+        if (apply_option(opt, value, rt, reloading) < 0)
+        {
+            fprintf(stderr, "Invalid value for --%s: %s\n", name, value);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static runtime_config_t *new_snapshot(void)
+{
+    runtime_config_t *rt = calloc(1, sizeof(*rt));
+    if (!rt)
+        return NULL;
+    rt->keep_alive_timeout = CONFIG_DEFAULT_KEEP_ALIVE_TIMEOUT;
+    rt->proxy_timeout = CONFIG_DEFAULT_PROXY_TIMEOUT;
+    rt->max_requests = CONFIG_DEFAULT_MAX_REQUESTS;
+    rt->open_file_valid = CONFIG_DEFAULT_OPEN_FILE_VALID;
+    strcpy(rt->root, CONFIG_DEFAULT_ROOT);
+    return rt;
+}
+
+/**
+ * Fill in and validate a snapshot from the file and the command line.
+ * @return: 0 on success, -1 on error (reported on stderr)
+ */
+static int build_snapshot(runtime_config_t *rt, int reloading)
+{
+    if (server_config.config_path &&
+        load_file(server_config.config_path, rt, reloading) < 0)
+        return -1;
+    if (apply_args(saved_argc, saved_argv, rt, reloading) < 0)
+        return -1;
+
+    // Resolved once here instead of on every uncached request
+    char resolved[PATH_MAX];
+    if (!realpath(rt->root, resolved))
+    {
+        perror(rt->root);
+        return -1;
+    }
+    strcpy(rt->root, resolved);
+    return 0;
+}
+
+static void on_sighup(int sig)
+{
+    (void)sig;
+    reload_requested = 1;
+    lifecycle_wake(); // workers may be asleep until their next deadline
+}
+
+int config_load(int argc, char **argv)
+{
+    saved_argc = argc;
+    saved_argv = argv;
+
+    // The file is applied first so the command line can override it
+    for (int i = 1; i + 1 < argc; i++)
+    {
+        if (strcmp(argv[i], "--config") == 0)
+            server_config.config_path = argv[i + 1];
+    }
+
+    runtime_config_t *rt = new_snapshot();
+    if (!rt)
+        return -1;
+    cache_control_begin();
+    if (build_snapshot(rt, 0) < 0)
+    {
+        cache_control_discard();
+        free(rt);
+        return -1;
+    }
+    cache_control_commit();
+    __atomic_store_n(&current, rt, __ATOMIC_RELEASE);
+
+    signal(SIGHUP, on_sighup);
+    return 0;
+}
+
+const runtime_config_t *config_current(void)
+{
+    return __atomic_load_n(&current, __ATOMIC_ACQUIRE);
+}
+
+void config_reload_if_requested(void)
+{
+    // Every worker polls the flag; the exchange lets exactly one reload
+    if (!reload_requested || !__atomic_exchange_n(&reload_requested, 0, __ATOMIC_ACQ_REL))
+        return;
+
+    runtime_config_t *rt = new_snapshot();
+    if (!rt)
+        return;
+    cache_control_begin();
+    if (build_snapshot(rt, 1) < 0)
+    {
+        fprintf(stderr, "Configuration reload failed, keeping the current settings\n");
+        cache_control_discard();
+        free(rt);
+        return;
+    }
+    rt->generation = config_current()->generation + 1;
+    cache_control_commit();
+    __atomic_store_n(&current, rt, __ATOMIC_RELEASE);
+    printf("Configuration reloaded (generation %u)\n", rt->generation);
+}
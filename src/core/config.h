@@ -0,0 +1,89 @@
+/**
+ * @file config.h
+ * @brief HTTP Server Core - Runtime Configuration Interface
+ * @version 1.0.0
+ * @date 2025-06-07
+ * @author David Dev (@DavidDevGt)
+ *
+ * @description
+ * Settings come from built-in defaults, then an optional config file
+ * (--config PATH), then command-line options, which win. Structural
+ * settings (sockets, table and buffer sizes) are fixed at startup;
+ * the rest is reread from the file and reapplied on SIGHUP.
+ *
+ * @license MIT License
+ */
+
+#ifndef CONFIG_H
+#define CONFIG_H
+
+#include <stddef.h>
+#include <limits.h>
+
+#define CONFIG_DEFAULT_PORT 6090
+#define CONFIG_DEFAULT_BACKLOG 511
+#define CONFIG_DEFAULT_MAX_CLIENTS 100
+#define CONFIG_DEFAULT_KEEP_ALIVE_TIMEOUT 30
+#define CONFIG_DEFAULT_PROXY_TIMEOUT 60      // seconds an upstream may stay silent
+#define CONFIG_DEFAULT_MAX_REQUESTS 100
+#define CONFIG_DEFAULT_BUFFER_SIZE 4096
+#define CONFIG_DEFAULT_ROOT "./www"
+#define CONFIG_DEFAULT_OPEN_FILE_CACHE 256   // entries per worker, 0 = off
+#define CONFIG_DEFAULT_OPEN_FILE_VALID 5     // seconds between revalidations
+#define CONFIG_DEFAULT_DEFER_ACCEPT 5        // seconds a connection may stay silent
+#define CONFIG_DEFAULT_DRAIN_TIMEOUT 30      // seconds to finish responses on SIGTERM
+#define CONFIG_MIN_BUFFER_SIZE 1024
+#define CONFIG_MAX_BUFFER_SIZE (1024 * 1024)
+#define CONFIG_MAX_LINE 1024
+
+// Fixed for the life of the process
+typedef struct {
+    int port;
+    int backlog;
+    int workers;              // 0 = one per core
+    int max_clients;          // per worker
+    size_t buffer_size;       // per-connection read buffer
+    int open_file_cache;      // open-file cache entries per worker
+    int defer_accept;         // TCP_DEFER_ACCEPT seconds, 0 = off
+    int drain_timeout;        // seconds a drain waits before closing everything
+    const char *access_log_path;
+    size_t access_log_max;
+    const char *config_path;
+    int tls_port;             // HTTPS listener, 0 = off
+    const char *tls_cert;     // PEM certificate chain
+    const char *tls_key;      // PEM private key
+    const char *bundle_path;  // packed document root, NULL = serve from --root
+    int bundle_preload;       // bundle_preload_t
+} server_config_t;
+
+// Reapplied on SIGHUP; take a snapshot with config_current()
+typedef struct {
+    int keep_alive_timeout;
+    int proxy_timeout;        // seconds an exchange may wait on its upstream
+    int max_requests;
+    int open_file_valid;      // seconds an open-file cache entry is trusted
+    char root[PATH_MAX];      // document root, already resolved
+    unsigned generation;      // bumped by every reload
+} runtime_config_t;
+
+extern server_config_t server_config;
+
+/**
+ * Load defaults, the config file and the command line.
+ * @return: 0 on success, -1 on an unknown option or invalid value
+ */
+int config_load(int argc, char **argv);
+
+/**
+ * Current reloadable settings. Snapshots are never freed, so a pointer
+ * stays valid for as long as the caller holds it.
+ */
+const runtime_config_t *config_current(void);
+
+/**
+ * Apply a pending SIGHUP reload; called by every event loop iteration.
+ * Only one thread does the work, the others pick up the new snapshot.
+ */
+void config_reload_if_requested(void);
+
+#endif // CONFIG_H
@@ -6,113 +6,420 @@
  * @author David Dev (@DavidDevGt)
  * 
  * @description
- * Main event loop implementation using select() for I/O multiplexing.
+ * Main event loop implementation using an epoll reactor for I/O multiplexing.
  * Manages connection lifecycle, handles new connections, processes client
  * requests, and performs periodic connection cleanup.
  * 
  * Features:
- * - Select-based I/O multiplexing
- * - Automatic connection timeout management
+ * - Epoll-based I/O multiplexing (edge-triggered listen socket)
+ * - Deadline-driven sleeps from the keep-alive timer wheel
+ * - Admission control: at capacity new connections are left in the kernel
+ *   backlog instead of being accepted and refused, and the longest idle
+ *   keep-alive connections are closed to make room for them
+ * - Fair scheduling: a connection that uses up its per-pass budget is
+ *   resumed after everyone else who was ready
+ * - A second, TLS listener whose connections start with a handshake
+ * - Graceful drain on SIGTERM: stop accepting, finish responses in
+ *   progress, close idle keep-alives, return once no connection is left
  * - Connection statistics monitoring
  * - Graceful connection handling
  * 
  * @license MIT License
  */
 
+#define _GNU_SOURCE  // for accept4
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <errno.h>
 #include <sys/socket.h>
-#include <sys/select.h>
+#include <sys/epoll.h>
 #include <time.h>
 #include "event_loop.h"
+#include "server.h"
+#include "uring_loop.h"
+#include "metrics.h"
+#include "config.h"
+#include "lifecycle.h"
+#include "tls.h"
 #include "../client/client_manager.h"
+#include "../client/upstream_pool.h"
 #include "../http/http_handler.h"
+#include "../http/proxy.h"
+
+static event_backend_t event_backend = BACKEND_EPOLL;
+static __thread int accept_paused;
+static __thread int loop_epoll_fd = -1;
+
+int set_event_backend(const char *name)
+{
+    if (strcmp(name, "epoll") == 0)
+        event_backend = BACKEND_EPOLL;
+    else if (strcmp(name, "io_uring") == 0)
+        event_backend = BACKEND_IO_URING;
+    else
+        return -1;
+    return 0;
+}
+
+void reject_connection(int client_fd)
+{
+    metrics_count_rejected();
+    if (log_verbose)
+        printf("Max clients reached, rejecting connection fd=%d\n", client_fd);
+    const char *response = "HTTP/1.1 503 Service Unavailable\r\n"
+                         "Content-Length: 26\r\n"
+                         "Connection: close\r\n\r\n"
+                         "<h1>Server Overloaded</h1>";
+    send(client_fd, response, strlen(response), MSG_NOSIGNAL);
+    close(client_fd);
+}
 
-void handle_new_connection(int listen_fd, fd_set *master_set, int *max_fd)
+int loop_timeout_ms(time_t last_stats_print)
+{
+    // Connections with deferred work must not wait for the next event
+    if (client_deferred_count() > 0)
+        return 0;
+
+    // Sleep until the next keep-alive deadline or stats report
+    int timeout = next_expiry_timeout_ms();
+    int stats_ms = (int)(last_stats_print + STATS_INTERVAL - time(NULL)) * 1000;
+    if (stats_ms < 0)
+        stats_ms = 0;
+    if (timeout < 0 || stats_ms < timeout)
+        timeout = stats_ms;
+    // Draining: look for newly idle connections and the deadline every second
+    if (lifecycle_draining() && timeout > 1000)
+        timeout = 1000;
+    return timeout;
+}
+
+static void close_client(client_info_t *client)
+{
+    // close() also removes the fd from the epoll interest list
+    int fd = client->fd;
+    close(fd);
+    remove_client(fd);
+}
+
+int admission_timeout_ms(int timeout)
+{
+    // Idle connections too fresh to evict now may qualify within a second
+    if (client_idle_count() > 0 && (timeout < 0 || timeout > EVICT_MIN_IDLE * 1000))
+        return EVICT_MIN_IDLE * 1000;
+    return timeout;
+}
+
+int drain_connections(void (*close_connection)(client_info_t *client))
+{
+    static __thread time_t deadline;
+    time_t now = time(NULL);
+    if (deadline == 0)
+        deadline = now + server_config.drain_timeout;
+
+    int all = now >= deadline;
+    static __thread int timed_out;
+    if (all && !timed_out && client_count > 0)
+    {
+        timed_out = 1;
+        printf("Drain timeout, closing %d connections\n", client_count);
+    }
+    close_connections(all, close_connection);
+    return client_count == 0;
+}
+
+/**
+ * Number of idle connections to shed for the ones waiting to be accepted.
+ */
+int eviction_quota(int listen_fd)
+{
+    int waiting = pending_connections(listen_fd);
+    if (waiting < 0)
+        waiting = 1;
+    return waiting < EVICT_BATCH ? waiting : EVICT_BATCH;
+}
+
+/**
+ * Runs after dispatch while accepting is paused: shed idle keep-alives
+ * for the connections that are waiting if the table is still full, and
+ * drain the accept queue again once there is room.
+ */
+static void admit_connections(int listen_fd, int tls_listen_fd, int epoll_fd)
 {
-    int client_fd = accept(listen_fd, NULL, NULL);
-    if (client_fd >= 0)
+    if (client_count >= server_config.max_clients)
     {
-        if (client_count >= MAX_CLIENTS)
+        int quota = eviction_quota(listen_fd);
+        if (tls_listen_fd >= 0)
+            quota += eviction_quota(tls_listen_fd);
+        evict_idle_connections(quota, close_client);
+    }
+    if (client_count < server_config.max_clients)
+    {
+        accept_paused = 0;
+        handle_new_connection(listen_fd, epoll_fd, 0);
+        if (tls_listen_fd >= 0)
+            handle_new_connection(tls_listen_fd, epoll_fd, 1);
+    }
+}
+
+void handle_new_connection(int listen_fd, int epoll_fd, int tls)
+{
+    // The listen socket is edge-triggered, so drain the accept queue
+    // completely; otherwise pending connections would wait for the next SYN.
+    while (1)
+    {
+        if (client_count >= server_config.max_clients)
+        {
+            // Leave the rest in the kernel backlog rather than accept and
+            // refuse them; admit_connections() picks up from here
+            if (!accept_paused)
+            {
+                if (log_verbose)
+                    printf("Max clients reached, pausing accept\n");
+                accept_paused = 1;
+                metrics_count_accept_paused();
+            }
+            return;
+        }
+
+        int client_fd = accept4(listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (client_fd < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK)
+                perror("accept");
+            return;
+        }
+
+        if (add_client(client_fd) < 0)
+        {
+            close(client_fd);
+            continue;
+        }
+        if (tls && tls_accept(find_client(client_fd)) < 0)
         {
-            printf("Max clients reached, rejecting connection fd=%d\n", client_fd);
-            const char *response = "HTTP/1.1 503 Service Unavailable\r\n"
-                                 "Content-Length: 26\r\n"
-                                 "Connection: close\r\n\r\n"
-                                 "<h1>Server Overloaded</h1>";
-            send(client_fd, response, strlen(response), 0);
             close(client_fd);
+            remove_client(client_fd);
+            continue;
         }
-        else
+
+        // handle_client drains the socket to EAGAIN, so edge-triggered
+        // notifications are enough for client sockets too. EPOLLOUT resumes
+        // responses that filled the socket buffer.
+        struct epoll_event ev = {
+            .events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET,
+            .data.fd = client_fd
+        };
+        if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, client_fd, &ev) < 0)
         {
-            FD_SET(client_fd, master_set);
-            if (client_fd > *max_fd)
-                *max_fd = client_fd;
-            add_client(client_fd);
+            perror("epoll_ctl");
+            close(client_fd);
+            remove_client(client_fd);
         }
     }
 }
 
-void handle_existing_client(int fd, fd_set *master_set)
+int event_loop_watch(int fd)
 {
-    if (handle_client(fd) < 0)
+    struct epoll_event ev = {
+        .events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET,
+        .data.fd = fd
+    };
+    return epoll_ctl(loop_epoll_fd, EPOLL_CTL_ADD, fd, &ev);
+}
+
+void handle_existing_client(int fd, int epoll_fd)
+{
+    (void)epoll_fd; // close() drops the fd from the interest list
+    upstream_conn_t *upstream = upstream_find(fd);
+    if (upstream)
+    {
+        if (!upstream->client)
+        {
+            upstream_idle_event(upstream);
+            return;
+        }
+        // The exchange is driven from the client it answers
+        fd = upstream->client->fd;
+    }
+    else if (!find_client(fd))
+    {
+        return; // closed earlier in this batch, from its upstream's event
+    }
+    int result = handle_client(fd);
+    if (result < 0)
     {
         close(fd);
-        FD_CLR(fd, master_set);
         remove_client(fd);
     }
+    else if (result == HANDLE_YIELD)
+    {
+        metrics_count_yield();
+        client_defer(find_client(fd));
+    }
+}
+
+/**
+ * Give the connections deferred by earlier passes their next turn. Only
+ * the first count are resumed; anything deferred again waits for the
+ * next pass.
+ */
+static void resume_deferred_clients(int count, int epoll_fd)
+{
+    client_info_t *client;
+    while (count-- > 0 && (client = client_next_deferred()) != NULL)
+        handle_existing_client(client->fd, epoll_fd);
+}
+
+/**
+ * Stop accepting for good. The socket may be shared with a new process
+ * after an upgrade, and close() only drops an epoll registration once the
+ * last reference to the socket is gone, so remove it explicitly.
+ */
+static void stop_listening(int listen_fd, int epoll_fd)
+{
+    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, listen_fd, NULL);
+    close(listen_fd);
+    accept_paused = 0;
+}
+
+static void watch_listener(int listen_fd, int epoll_fd)
+{
+    struct epoll_event ev = {
+        .events = EPOLLIN | EPOLLET | EPOLLEXCLUSIVE,
+        .data.fd = listen_fd
+    };
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, listen_fd, &ev) < 0)
+    {
+        perror("epoll_ctl");
+        exit(1);
+    }
 }
 
-void run_server_loop(int listen_fd)
+static void run_epoll_loop(int listen_fd, int tls_listen_fd)
 {
-    fd_set master_set, read_set;
-    FD_ZERO(&master_set);
-    FD_SET(listen_fd, &master_set);
+    int epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_fd < 0)
+    {
+        perror("epoll_create1");
+        exit(1);
+    }
+    loop_epoll_fd = epoll_fd;
+
+    watch_listener(listen_fd, epoll_fd);
+    if (tls_listen_fd >= 0)
+        watch_listener(tls_listen_fd, epoll_fd);
 
-    int max_fd = listen_fd;
-    struct timeval timeout;
+    int wake_fd = lifecycle_register_loop();
+    struct epoll_event wake_ev = {
+        .events = EPOLLIN,
+        .data.fd = wake_fd
+    };
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, wake_fd, &wake_ev) < 0)
+    {
+        perror("epoll_ctl");
+        exit(1);
+    }
+
+    struct epoll_event events[MAX_EVENTS];
     time_t last_stats_print = time(NULL);
     
     while (1)
     {
-        read_set = master_set;
-        
-        timeout.tv_sec = 5;
-        timeout.tv_usec = 0;
-        
-        int ready = select(max_fd + 1, &read_set, NULL, NULL, &timeout);
+        config_reload_if_requested();
+        lifecycle_poll();
+        if (lifecycle_draining())
+        {
+            if (listen_fd >= 0)
+            {
+                stop_listening(listen_fd, epoll_fd);
+                listen_fd = -1;
+            }
+            if (tls_listen_fd >= 0)
+            {
+                stop_listening(tls_listen_fd, epoll_fd);
+                tls_listen_fd = -1;
+            }
+            if (drain_connections(close_client))
+                break;
+        }
+
+        int timeout = loop_timeout_ms(last_stats_print);
+        if (accept_paused)
+            timeout = admission_timeout_ms(timeout);
+        int upstream_timeout = upstream_next_expiry_ms();
+        if (upstream_timeout >= 0 && (timeout < 0 || upstream_timeout < timeout))
+            timeout = upstream_timeout;
+        int ready = epoll_wait(epoll_fd, events, MAX_EVENTS, timeout);
         if (ready < 0)
         {
-            perror("select");
+            if (errno == EINTR)
+                continue;
+            perror("epoll_wait");
             exit(1);
         }
         
-        cleanup_expired_connections(&master_set, &max_fd);
-        
-        time_t current_time = time(NULL);
-        if (current_time - last_stats_print >= 30)
+        // Deferred before this pass; dispatch below may defer more
+        int deferred = client_deferred_count();
+        for (int i = 0; i < ready; ++i)
         {
-            print_connection_stats();
-            last_stats_print = current_time;
-        }
-
-        for (int fd = 0; fd <= max_fd && ready > 0; ++fd)
-        {
-            if (!FD_ISSET(fd, &read_set))
-                continue;
-                
-            ready--;
+            int fd = events[i].data.fd;
             
             if (fd == listen_fd)
             {
-                handle_new_connection(listen_fd, &master_set, &max_fd);
+                handle_new_connection(listen_fd, epoll_fd, 0);
+            }
+            else if (fd == tls_listen_fd)
+            {
+                handle_new_connection(tls_listen_fd, epoll_fd, 1);
+            }
+            else if (fd == wake_fd)
+            {
+                lifecycle_clear_wake(wake_fd); // the flags are checked at the top
             }
             else
             {
-                handle_existing_client(fd, &master_set);
+                handle_existing_client(fd, epoll_fd);
             }
         }
+        resume_deferred_clients(deferred, epoll_fd);
+
+        // Expire and evict idle connections after dispatch so no fd in
+        // events[] can be closed (and reused) before its handler runs.
+        cleanup_expired_connections(close_client);
+        upstream_reap();
+        if (accept_paused)
+            admit_connections(listen_fd, tls_listen_fd, epoll_fd);
+        
+        time_t current_time = time(NULL);
+        if (current_time - last_stats_print >= STATS_INTERVAL)
+        {
+            print_connection_stats();
+            last_stats_print = current_time;
+        }
+    }
+    close(epoll_fd);
+}
+
+void run_server_loop(int listen_fd, int tls_listen_fd)
+{
+    // Proxied exchanges are relayed with splice() driven by epoll readiness,
+    // and TLS sessions read and write through OpenSSL on the socket itself
+    static int epoll_notice;
+    if (event_backend == BACKEND_IO_URING && (proxy_route_count() > 0 || tls_listen_fd >= 0))
+    {
+        if (!__atomic_exchange_n(&epoll_notice, 1, __ATOMIC_RELAXED))
+            printf("%s configured, using the epoll backend\n",
+                   proxy_route_count() > 0 ? "Proxy routes" : "TLS");
+    }
+    else if (event_backend == BACKEND_IO_URING)
+    {
+        if (run_uring_loop(listen_fd) == 0)
+            return;
+        fprintf(stderr, "io_uring unavailable, falling back to epoll\n");
     }
+    run_epoll_loop(listen_fd, tls_listen_fd);
 }
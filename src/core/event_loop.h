@@ -7,8 +7,8 @@
  * 
  * @description
  * Event loop and I/O multiplexing interface for the HTTP server.
- * Handles connection management using select() system call for efficient
- * concurrent connection processing.
+ * Handles connection management using an epoll reactor so that each
+ * wakeup costs O(ready) instead of O(max_fd), without the FD_SETSIZE cap.
  * 
  * @license MIT License
  */
@@ -16,11 +16,53 @@
 #ifndef EVENT_LOOP_H
 #define EVENT_LOOP_H
 
-#include <sys/select.h>
+#include <sys/epoll.h>
 #include <time.h>
 
-void run_server_loop(int listen_fd);
-void handle_new_connection(int listen_fd, fd_set *master_set, int *max_fd);
-void handle_existing_client(int fd, fd_set *master_set);
+#define MAX_EVENTS 256
+#define STATS_INTERVAL 30  // seconds between connection reports
+#define EVICT_BATCH 8      // idle connections closed per pass while at capacity
+
+struct client_info;
+
+typedef enum {
+    BACKEND_EPOLL,
+    BACKEND_IO_URING
+} event_backend_t;
+
+int set_event_backend(const char *name);
+/**
+ * Serve the calling worker's listeners until drained; tls_listen_fd is
+ * -1 without HTTPS.
+ */
+void run_server_loop(int listen_fd, int tls_listen_fd);
+/**
+ * Answer 503 and close. Only the io_uring backend needs it, for a
+ * connection its multishot accept delivered after accepting was paused.
+ */
+void reject_connection(int client_fd);
+int loop_timeout_ms(time_t last_stats_print);
+/**
+ * While accepting is paused, shorten the loop timeout so waiting
+ * connections are reconsidered once idle ones become old enough to evict.
+ */
+int admission_timeout_ms(int timeout);
+int eviction_quota(int listen_fd);
+/**
+ * One drain step, run at the top of every pass once SIGTERM arrived:
+ * closes the connections with nothing in progress, and everything once
+ * drain-timeout has passed.
+ * @return: 1 once the worker has no connections left
+ */
+int drain_connections(void (*close_connection)(struct client_info *client));
+/**
+ * Add a socket the worker opened itself (an upstream connection) to the
+ * calling thread's epoll set, edge-triggered for reading and writing.
+ * @return: 0 on success, -1 on error
+ */
+int event_loop_watch(int fd);
+// tls: connections on listen_fd start with a TLS handshake
+void handle_new_connection(int listen_fd, int epoll_fd, int tls);
+void handle_existing_client(int fd, int epoll_fd);
 
 #endif // EVENT_LOOP_H
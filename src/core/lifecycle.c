@@ -0,0 +1,352 @@
+/**
+ * @file lifecycle.c
+ * @brief HTTP Server Core - Shutdown and Binary Upgrade Implementation
+ * @version 1.0.0
+ * @date 2025-06-07
+ * @author David Dev (@DavidDevGt)
+ *
+ * @description
+ * Signal handlers only set flags and write to the per-loop wake eventfds;
+ * the event loops do the work from lifecycle_poll().
+ *
+ * An upgrade forks and execs the binary at the path it was started from,
+ * so a build installed over it is what runs. The listen sockets are
+ * inherited across execve() and named in HTTPSERVER_LISTEN_FDS. Both
+ * processes accept from the same sockets until the old one drains, so no
+ * connection is refused and none queued is lost. If the new binary fails
+ * to start, the old one reaps it and keeps serving.
+ *
+ * @license MIT License
+ */
+
+#define _GNU_SOURCE  // for environ
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <limits.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <netinet/in.h>
+#include "lifecycle.h"
+#include "config.h"
+
+extern char **environ;
+
+static volatile sig_atomic_t drain_requested = 0;
+static volatile sig_atomic_t upgrade_requested = 0;
+static volatile sig_atomic_t child_exited = 0;
+static int drain_announced = 0;
+
+static int wake_fds[LIFECYCLE_MAX_LOOPS];
+static int wake_count = 0;
+static pthread_mutex_t lifecycle_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static int listeners[LIFECYCLE_MAX_LISTENERS];
+static int listener_count = 0;
+static int inherited[LIFECYCLE_MAX_LISTENERS];      // -1 once taken
+static int inherited_port[LIFECYCLE_MAX_LISTENERS];
+static int inherited_count = 0;
+static pid_t parent_pid = 0;    // process that handed the listeners over
+
+static char **saved_argv;
+static char exe_path[PATH_MAX];
+static pid_t upgrade_pid = 0;   // new binary started by SIGUSR2, not yet reaped
+
+void lifecycle_wake(void)
+{
+    int saved_errno = errno;
+    uint64_t one = 1;
+    int count = __atomic_load_n(&wake_count, __ATOMIC_ACQUIRE);
+    for (int i = 0; i < count; i++)
+    {
+        if (write(wake_fds[i], &one, sizeof(one)) < 0)
+            continue; // counter saturated: the loop is awake anyway
+    }
+    errno = saved_errno;
+}
+
+static void on_sigterm(int sig)
+{
+    (void)sig;
+    drain_requested = 1;
+    lifecycle_wake();
+}
+
+static void on_sigusr2(int sig)
+{
+    (void)sig;
+    upgrade_requested = 1;
+    lifecycle_wake();
+}
+
+static void on_sigchld(int sig)
+{
+    (void)sig;
+    child_exited = 1;
+    lifecycle_wake();
+}
+
+void lifecycle_init(char **argv)
+{
+    saved_argv = argv;
+    ssize_t len = readlink("/proc/self/exe", exe_path, sizeof(exe_path) - 1);
+    if (len < 0)
+    {
+        perror("readlink(/proc/self/exe)");
+        exit(1);
+    }
+    exe_path[len] = '\0';
+
+    signal(SIGTERM, on_sigterm);
+    signal(SIGUSR2, on_sigusr2);
+    signal(SIGCHLD, on_sigchld);
+}
+
+static int listens_on(int fd, int port)
+{
+    struct sockaddr_in addr;
+    socklen_t addr_len = sizeof(addr);
+    int accepting = 0;
+    socklen_t opt_len = sizeof(accepting);
+    return getsockname(fd, (struct sockaddr *)&addr, &addr_len) == 0 &&
+           addr.sin_family == AF_INET && ntohs(addr.sin_port) == port &&
+           getsockopt(fd, SOL_SOCKET, SO_ACCEPTCONN, &accepting, &opt_len) == 0 &&
+           accepting;
+}
+
+int lifecycle_inherit_listeners(int port, int tls_port)
+{
+    const char *fds = getenv(LIFECYCLE_LISTEN_FDS_ENV);
+    const char *parent = getenv(LIFECYCLE_PARENT_PID_ENV);
+    if (parent)
+        parent_pid = (pid_t)atoi(parent);
+
+    int usable = fds != NULL;
+    int main_count = 0, tls_count = 0;
+    while (fds && *fds && inherited_count < LIFECYCLE_MAX_LISTENERS)
+    {
+        char *end;
+        long fd = strtol(fds, &end, 10);
+        if (end == fds || fd < 0 || fd > INT32_MAX)
+        {
+            usable = 0;
+            break;
+        }
+        if (listens_on((int)fd, port))
+        {
+            inherited_port[inherited_count] = port;
+            inherited[inherited_count++] = (int)fd;
+            main_count++;
+        }
+        else if (tls_port && listens_on((int)fd, tls_port))
+        {
+            inherited_port[inherited_count] = tls_port;
+            inherited[inherited_count++] = (int)fd;
+            tls_count++;
+        }
+        else
+            usable = 0;
+        fds = *end == ',' ? end + 1 : end;
+    }
+
+    // Children started later must not see them
+    unsetenv(LIFECYCLE_LISTEN_FDS_ENV);
+    unsetenv(LIFECYCLE_PARENT_PID_ENV);
+
+    // One listener per worker on each port, or none handed over at all
+    if (tls_port && tls_count != main_count)
+        usable = 0;
+    if (!usable || main_count == 0)
+    {
+        // Only close what was verified to be a listener we were handed
+        if (inherited_count > 0)
+            fprintf(stderr, "Inherited listeners do not match port %d, binding new ones\n", port);
+        for (int i = 0; i < inherited_count; i++)
+            close(inherited[i]);
+        inherited_count = 0;
+        return 0;
+    }
+
+    for (int i = 0; i < inherited_count; i++)
+        fcntl(inherited[i], F_SETFD, FD_CLOEXEC);
+    return main_count;
+}
+
+int lifecycle_take_listener(int port)
+{
+    for (int i = 0; i < inherited_count; i++)
+    {
+        if (inherited[i] >= 0 && inherited_port[i] == port)
+        {
+            int fd = inherited[i];
+            inherited[i] = -1;
+            return fd;
+        }
+    }
+    return -1;
+}
+
+void lifecycle_add_listener(int fd)
+{
+    if (listener_count < LIFECYCLE_MAX_LISTENERS)
+        listeners[listener_count++] = fd;
+}
+
+void lifecycle_ready(void)
+{
+    if (inherited_count == 0 || parent_pid <= 0)
+        return;
+    // Only the process that started us; the pid may be stale otherwise
+    if (getppid() != parent_pid)
+        return;
+    printf("Took over %d listeners from pid %d, asking it to drain\n",
+           inherited_count, (int)parent_pid);
+    kill(parent_pid, SIGTERM);
+}
+
+int lifecycle_register_loop(void)
+{
+    int fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (fd < 0)
+    {
+        perror("eventfd");
+        exit(1);
+    }
+    pthread_mutex_lock(&lifecycle_lock);
+    if (wake_count >= LIFECYCLE_MAX_LOOPS)
+    {
+        fprintf(stderr, "Too many event loops\n");
+        exit(1);
+    }
+    wake_fds[wake_count] = fd;
+    // Publish after the slot is written; the handlers read without a lock
+    __atomic_store_n(&wake_count, wake_count + 1, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&lifecycle_lock);
+    return fd;
+}
+
+void lifecycle_clear_wake(int wake_fd)
+{
+    uint64_t value;
+    if (read(wake_fd, &value, sizeof(value)) < 0 && errno != EAGAIN)
+        perror("read(eventfd)");
+}
+
+int lifecycle_draining(void)
+{
+    return drain_requested;
+}
+
+/**
+ * Fork and exec the binary with the listeners inherited. The child's
+ * environment is built first: between fork() and execve() a threaded
+ * process may only make async-signal-safe calls.
+ */
+static void start_upgrade(void)
+{
+    if (upgrade_pid > 0)
+    {
+        fprintf(stderr, "Upgrade already running as pid %d\n", (int)upgrade_pid);
+        return;
+    }
+    if (listener_count == 0)
+        return;
+
+    static char fds_var[LIFECYCLE_MAX_LISTENERS * 12 + sizeof(LIFECYCLE_LISTEN_FDS_ENV) + 1];
+    static char parent_var[32 + sizeof(LIFECYCLE_PARENT_PID_ENV)];
+    int len = snprintf(fds_var, sizeof(fds_var), "%s=", LIFECYCLE_LISTEN_FDS_ENV);
+    for (int i = 0; i < listener_count; i++)
+        len += snprintf(fds_var + len, sizeof(fds_var) - len, i ? ",%d" : "%d", listeners[i]);
+    snprintf(parent_var, sizeof(parent_var), "%s=%d", LIFECYCLE_PARENT_PID_ENV, (int)getpid());
+
+    size_t env_count = 0;
+    while (environ[env_count])
+        env_count++;
+    char **envp = malloc((env_count + 3) * sizeof(*envp));
+    if (!envp)
+    {
+        fprintf(stderr, "Out of memory, cannot start the new binary\n");
+        return;
+    }
+    size_t n = 0;
+    for (size_t i = 0; i < env_count; i++)
+    {
+        if (strncmp(environ[i], LIFECYCLE_LISTEN_FDS_ENV "=", sizeof(LIFECYCLE_LISTEN_FDS_ENV)) != 0 &&
+            strncmp(environ[i], LIFECYCLE_PARENT_PID_ENV "=", sizeof(LIFECYCLE_PARENT_PID_ENV)) != 0)
+            envp[n++] = environ[i];
+    }
+    envp[n++] = fds_var;
+    envp[n++] = parent_var;
+    envp[n] = NULL;
+
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid == 0)
+    {
+        for (int i = 0; i < listener_count; i++)
+            fcntl(listeners[i], F_SETFD, 0);
+        execve(exe_path, saved_argv, envp);
+        _exit(127);
+    }
+    free(envp);
+    if (pid < 0)
+    {
+        perror("fork");
+        return;
+    }
+    upgrade_pid = pid;
+    printf("Starting %s as pid %d with %d listeners\n", exe_path, (int)pid, listener_count);
+}
+
+static void reap_children(void)
+{
+    int status;
+    pid_t pid;
+    while ((pid = waitpid(-1, &status, WNOHANG)) > 0)
+    {
+        if (pid != upgrade_pid)
+            continue;
+        upgrade_pid = 0;
+        if (WIFEXITED(status))
+            fprintf(stderr, "New binary (pid %d) exited with status %d, still serving\n",
+                    (int)pid, WEXITSTATUS(status));
+        else
+            fprintf(stderr, "New binary (pid %d) killed by signal %d, still serving\n",
+                    (int)pid, WIFSIGNALED(status) ? WTERMSIG(status) : 0);
+    }
+}
+
+void lifecycle_poll(void)
+{
+    if (!upgrade_requested && !child_exited && (!drain_requested || drain_announced))
+        return;
+    // Whoever holds the lock does the work; the flags stay set for later
+    if (pthread_mutex_trylock(&lifecycle_lock) != 0)
+        return;
+
+    if (child_exited)
+    {
+        child_exited = 0;
+        reap_children();
+    }
+    if (upgrade_requested)
+    {
+        upgrade_requested = 0;
+        if (!drain_requested)
+            start_upgrade();
+    }
+    if (drain_requested && !drain_announced)
+    {
+        drain_announced = 1;
+        printf("Draining connections (up to %d seconds)\n", server_config.drain_timeout);
+    }
+    pthread_mutex_unlock(&lifecycle_lock);
+}
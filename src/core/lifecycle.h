@@ -0,0 +1,79 @@
+/**
+ * @file lifecycle.h
+ * @brief HTTP Server Core - Shutdown and Binary Upgrade Interface
+ * @version 1.0.0
+ * @date 2025-06-07
+ * @author David Dev (@DavidDevGt)
+ *
+ * @description
+ * Process lifecycle signals. SIGTERM drains: workers stop accepting,
+ * finish the responses in progress, close idle keep-alive connections and
+ * exit once empty (or after drain-timeout seconds). SIGUSR2 starts the
+ * binary again with the listen sockets inherited, so the new process
+ * serves from the same kernel accept queues; once it is up it sends the
+ * old process SIGTERM.
+ *
+ * @license MIT License
+ */
+
+#ifndef LIFECYCLE_H
+#define LIFECYCLE_H
+
+#define LIFECYCLE_MAX_LISTENERS 256
+#define LIFECYCLE_MAX_LOOPS 256
+#define LIFECYCLE_LISTEN_FDS_ENV "HTTPSERVER_LISTEN_FDS"   // "3,4,5"
+#define LIFECYCLE_PARENT_PID_ENV "HTTPSERVER_PARENT_PID"
+
+/**
+ * Install the SIGTERM, SIGUSR2 and SIGCHLD handlers and remember how to
+ * start this binary again.
+ */
+void lifecycle_init(char **argv);
+
+/**
+ * Pick up listen sockets handed over by a previous process. They are
+ * ignored (and closed) unless each listens on port or tls_port (0 = none),
+ * with as many on one as on the other.
+ * @return: number of inherited listeners on port; the server must run
+ *          that many workers
+ */
+int lifecycle_inherit_listeners(int port, int tls_port);
+
+/**
+ * Next inherited listener on port, or -1 once they are all taken.
+ */
+int lifecycle_take_listener(int port);
+
+/**
+ * Record a listener so an upgrade can pass it on. Startup only.
+ */
+void lifecycle_add_listener(int fd);
+
+/**
+ * Listeners are set up: tell the process we took them from to drain.
+ */
+void lifecycle_ready(void);
+
+/**
+ * Eventfd that becomes readable whenever a lifecycle or reload signal
+ * arrives, so every event loop wakes up, not just the thread the signal
+ * was delivered to. Never closed: a signal may write to it at any time.
+ */
+int lifecycle_register_loop(void);
+void lifecycle_clear_wake(int wake_fd);
+
+/**
+ * Wake every registered event loop. Async-signal-safe.
+ */
+void lifecycle_wake(void);
+
+/**
+ * Handle pending lifecycle work (start an upgrade, reap a failed one);
+ * called by every event loop iteration, only one thread does the work.
+ */
+void lifecycle_poll(void);
+
+// Nonzero once SIGTERM arrived
+int lifecycle_draining(void);
+
+#endif // LIFECYCLE_H
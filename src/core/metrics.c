@@ -0,0 +1,347 @@
+/**
+ * @file metrics.c
+ * @brief HTTP Server Core - Lock-free Metrics Implementation
+ * @version 1.0.0
+ * @date 2025-06-07
+ * @author David Dev (@DavidDevGt)
+ *
+ * @description
+ * Each worker registers one metrics block on startup. The owning thread is
+ * the only writer, so an update is a plain load/add/store (relaxed atomics,
+ * no lock prefix); scrapes from any thread read the blocks with relaxed
+ * loads and may see a worker a few increments behind, which is fine for
+ * monitoring.
+ *
+ * Features:
+ * - Requests by status code, bytes sent, accepts, rejects, active connections
+ * - Keep-alive reuse counter (requests on an already used connection)
+ * - Parse and send time histograms
+ * - Prometheus text exposition
+ *
+ * @license MIT License
+ */
+
+#define _GNU_SOURCE  // for open_memstream
+
+#include "metrics.h"
+#include "worker.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define METRICS_STATUS_SLOTS (METRICS_STATUS_MAX - METRICS_STATUS_MIN + 1)
+
+// Single-writer update and cross-thread read of one counter
+#define METRIC_ADD(field, n) __atomic_store_n(&(field), (field) + (n), __ATOMIC_RELAXED)
+#define METRIC_LOAD(field) __atomic_load_n(&(field), __ATOMIC_RELAXED)
+
+typedef struct {
+    uint64_t buckets[METRICS_HIST_BUCKETS + 1];  // per bucket, last one is +Inf
+    uint64_t count;
+    uint64_t sum_ns;
+} metrics_histogram_t;
+
+typedef struct {
+    uint64_t bytes_sent;
+    uint64_t connections_accepted;
+    uint64_t connections_rejected;
+    uint64_t connections_closed;
+    uint64_t connections_evicted;
+    uint64_t accept_pauses;
+    uint64_t yields;
+    uint64_t keepalive_reused;
+    uint64_t upstream_requests;
+    uint64_t upstream_reused;
+    uint64_t h2_connections;
+    uint64_t h2_streams;
+    uint64_t tls_handshakes;
+    uint64_t tls_resumed;
+    uint64_t tls_ktls;
+    uint64_t tls_failed;
+    metrics_histogram_t parse_time;
+    metrics_histogram_t send_time;
+    uint64_t requests[METRICS_STATUS_SLOTS];
+} __attribute__((aligned(64))) worker_metrics_t;
+
+// Upper bounds in nanoseconds
+static const uint64_t bucket_bounds_ns[METRICS_HIST_BUCKETS] = {
+    500, 1000, 2500, 5000, 10000, 25000, 50000, 100000,
+    250000, 500000, 1000000, 2500000, 10000000, 100000000
+};
+
+int log_verbose = 0;
+
+static worker_metrics_t *registry[MAX_WORKERS];
+static int registry_count = 0;
+
+// Threads that never registered (none today) write here rather than crash
+static worker_metrics_t unregistered_metrics;
+static __thread worker_metrics_t *thread_metrics = &unregistered_metrics;
+
+void metrics_init_thread(void)
+{
+    worker_metrics_t *block;
+    if (posix_memalign((void **)&block, 64, sizeof(*block)) != 0)
+    {
+        perror("metrics_init_thread");
+        exit(1);
+    }
+    memset(block, 0, sizeof(*block));
+
+    int slot = __atomic_fetch_add(&registry_count, 1, __ATOMIC_RELAXED);
+    if (slot < MAX_WORKERS)
+        __atomic_store_n(&registry[slot], block, __ATOMIC_RELEASE);
+    thread_metrics = block;
+}
+
+uint64_t metrics_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+void metrics_count_request(int status, int reused_connection)
+{
+    worker_metrics_t *m = thread_metrics;
+    if (status >= METRICS_STATUS_MIN && status <= METRICS_STATUS_MAX)
+        METRIC_ADD(m->requests[status - METRICS_STATUS_MIN], 1);
+    if (reused_connection)
+        METRIC_ADD(m->keepalive_reused, 1);
+}
+
+void metrics_count_bytes_sent(size_t bytes)
+{
+    METRIC_ADD(thread_metrics->bytes_sent, bytes);
+}
+
+void metrics_count_accepted(void)
+{
+    METRIC_ADD(thread_metrics->connections_accepted, 1);
+}
+
+void metrics_count_rejected(void)
+{
+    METRIC_ADD(thread_metrics->connections_rejected, 1);
+}
+
+void metrics_count_evicted(void)
+{
+    METRIC_ADD(thread_metrics->connections_evicted, 1);
+}
+
+void metrics_count_accept_paused(void)
+{
+    METRIC_ADD(thread_metrics->accept_pauses, 1);
+}
+
+void metrics_count_yield(void)
+{
+    METRIC_ADD(thread_metrics->yields, 1);
+}
+
+void metrics_connection_closed(void)
+{
+    METRIC_ADD(thread_metrics->connections_closed, 1);
+}
+
+void metrics_count_upstream(int reused_connection)
+{
+    worker_metrics_t *m = thread_metrics;
+    METRIC_ADD(m->upstream_requests, 1);
+    if (reused_connection)
+        METRIC_ADD(m->upstream_reused, 1);
+}
+
+void metrics_count_h2_connection(void)
+{
+    METRIC_ADD(thread_metrics->h2_connections, 1);
+}
+
+void metrics_count_h2_stream(void)
+{
+    METRIC_ADD(thread_metrics->h2_streams, 1);
+}
+
+void metrics_count_tls_handshake(int resumed, int ktls)
+{
+    METRIC_ADD(thread_metrics->tls_handshakes, 1);
+    if (resumed)
+        METRIC_ADD(thread_metrics->tls_resumed, 1);
+    if (ktls)
+        METRIC_ADD(thread_metrics->tls_ktls, 1);
+}
+
+void metrics_count_tls_failed(void)
+{
+    METRIC_ADD(thread_metrics->tls_failed, 1);
+}
+
+static void observe(metrics_histogram_t *hist, uint64_t ns)
+{
+    int i = 0;
+    while (i < METRICS_HIST_BUCKETS && ns > bucket_bounds_ns[i])
+        i++;
+    METRIC_ADD(hist->buckets[i], 1);
+    METRIC_ADD(hist->count, 1);
+    METRIC_ADD(hist->sum_ns, ns);
+}
+
+void metrics_observe_parse(uint64_t ns)
+{
+    observe(&thread_metrics->parse_time, ns);
+}
+
+void metrics_observe_send(uint64_t ns)
+{
+    observe(&thread_metrics->send_time, ns);
+}
+
+static void sum_histogram(metrics_histogram_t *dst, metrics_histogram_t *src)
+{
+    for (int i = 0; i <= METRICS_HIST_BUCKETS; i++)
+        dst->buckets[i] += METRIC_LOAD(src->buckets[i]);
+    dst->count += METRIC_LOAD(src->count);
+    dst->sum_ns += METRIC_LOAD(src->sum_ns);
+}
+
+static void write_histogram(FILE *out, const char *name, const char *help,
+                            const metrics_histogram_t *hist)
+{
+    fprintf(out, "# HELP %s %s\n# TYPE %s histogram\n", name, help, name);
+    uint64_t cumulative = 0;
+    for (int i = 0; i < METRICS_HIST_BUCKETS; i++)
+    {
+        cumulative += hist->buckets[i];
+        fprintf(out, "%s_bucket{le=\"%g\"} %llu\n", name,
+                bucket_bounds_ns[i] / 1e9, (unsigned long long)cumulative);
+    }
+    cumulative += hist->buckets[METRICS_HIST_BUCKETS];
+    fprintf(out, "%s_bucket{le=\"+Inf\"} %llu\n", name, (unsigned long long)cumulative);
+    fprintf(out, "%s_sum %.9f\n", name, hist->sum_ns / 1e9);
+    fprintf(out, "%s_count %llu\n", name, (unsigned long long)hist->count);
+}
+
+static void write_counter(FILE *out, const char *name, const char *type,
+                          const char *help, unsigned long long value)
+{
+    fprintf(out, "# HELP %s %s\n# TYPE %s %s\n%s %llu\n", name, help, name, type, name, value);
+}
+
+char *metrics_render(size_t *len)
+{
+    // Aggregate into a heap block: the per-status table is too big for the stack
+    worker_metrics_t *total = calloc(1, sizeof(*total));
+    if (!total)
+        return NULL;
+
+    int workers = __atomic_load_n(&registry_count, __ATOMIC_RELAXED);
+    if (workers > MAX_WORKERS)
+        workers = MAX_WORKERS;
+    for (int w = 0; w < workers; w++)
+    {
+        worker_metrics_t *m = __atomic_load_n(&registry[w], __ATOMIC_ACQUIRE);
+        if (!m)
+            continue;
+        total->bytes_sent += METRIC_LOAD(m->bytes_sent);
+        total->connections_accepted += METRIC_LOAD(m->connections_accepted);
+        total->connections_rejected += METRIC_LOAD(m->connections_rejected);
+        total->connections_closed += METRIC_LOAD(m->connections_closed);
+        total->connections_evicted += METRIC_LOAD(m->connections_evicted);
+        total->accept_pauses += METRIC_LOAD(m->accept_pauses);
+        total->yields += METRIC_LOAD(m->yields);
+        total->keepalive_reused += METRIC_LOAD(m->keepalive_reused);
+        total->upstream_requests += METRIC_LOAD(m->upstream_requests);
+        total->upstream_reused += METRIC_LOAD(m->upstream_reused);
+        total->h2_connections += METRIC_LOAD(m->h2_connections);
+        total->h2_streams += METRIC_LOAD(m->h2_streams);
+        total->tls_handshakes += METRIC_LOAD(m->tls_handshakes);
+        total->tls_resumed += METRIC_LOAD(m->tls_resumed);
+        total->tls_ktls += METRIC_LOAD(m->tls_ktls);
+        total->tls_failed += METRIC_LOAD(m->tls_failed);
+        sum_histogram(&total->parse_time, &m->parse_time);
+        sum_histogram(&total->send_time, &m->send_time);
+        for (int s = 0; s < METRICS_STATUS_SLOTS; s++)
+            total->requests[s] += METRIC_LOAD(m->requests[s]);
+    }
+
+    char *text = NULL;
+    FILE *out = open_memstream(&text, len);
+    if (!out)
+    {
+        free(total);
+        return NULL;
+    }
+
+    uint64_t requests = 0;
+    fprintf(out, "# HELP httpserver_requests_total Requests answered, by status code.\n"
+                 "# TYPE httpserver_requests_total counter\n");
+    for (int s = 0; s < METRICS_STATUS_SLOTS; s++)
+    {
+        if (total->requests[s] == 0)
+            continue;
+        requests += total->requests[s];
+        fprintf(out, "httpserver_requests_total{code=\"%d\"} %llu\n",
+                s + METRICS_STATUS_MIN, (unsigned long long)total->requests[s]);
+    }
+
+    write_counter(out, "httpserver_sent_bytes_total", "counter",
+                  "Response bytes written to sockets.", total->bytes_sent);
+    write_counter(out, "httpserver_connections_accepted_total", "counter",
+                  "Connections accepted.", total->connections_accepted);
+    write_counter(out, "httpserver_connections_rejected_total", "counter",
+                  "Connections answered 503: accepted by io_uring before a paused accept took effect.",
+                  total->connections_rejected);
+    write_counter(out, "httpserver_connections_evicted_total", "counter",
+                  "Idle keep-alive connections closed to admit new ones.",
+                  total->connections_evicted);
+    write_counter(out, "httpserver_accept_pauses_total", "counter",
+                  "Times a worker stopped accepting because its table was full.",
+                  total->accept_pauses);
+    write_counter(out, "httpserver_connection_yields_total", "counter",
+                  "Times a connection used up its per-pass budget with work left.",
+                  total->yields);
+    write_counter(out, "httpserver_connections_active", "gauge",
+                  "Open client connections.",
+                  total->connections_accepted - total->connections_closed);
+    write_counter(out, "httpserver_keepalive_reused_requests_total", "counter",
+                  "Requests served on a connection that had already served one.",
+                  total->keepalive_reused);
+    fprintf(out, "# HELP httpserver_keepalive_reuse_ratio Share of requests on reused connections.\n"
+                 "# TYPE httpserver_keepalive_reuse_ratio gauge\n"
+                 "httpserver_keepalive_reuse_ratio %.4f\n",
+            requests ? (double)total->keepalive_reused / requests : 0.0);
+    write_counter(out, "httpserver_upstream_requests_total", "counter",
+                  "Requests forwarded to proxy upstreams.", total->upstream_requests);
+    write_counter(out, "httpserver_upstream_reused_requests_total", "counter",
+                  "Forwarded requests sent on a pooled upstream connection.",
+                  total->upstream_reused);
+    write_counter(out, "httpserver_h2_connections_total", "counter",
+                  "Connections switched to HTTP/2.", total->h2_connections);
+    write_counter(out, "httpserver_h2_streams_total", "counter",
+                  "Requests answered on HTTP/2 streams.", total->h2_streams);
+    write_counter(out, "httpserver_tls_handshakes_total", "counter",
+                  "Completed TLS handshakes.", total->tls_handshakes);
+    write_counter(out, "httpserver_tls_resumed_total", "counter",
+                  "TLS handshakes that resumed a session from a ticket.", total->tls_resumed);
+    write_counter(out, "httpserver_tls_ktls_total", "counter",
+                  "TLS connections whose record encryption runs in the kernel.",
+                  total->tls_ktls);
+    write_counter(out, "httpserver_tls_failed_total", "counter",
+                  "TLS handshakes that failed.", total->tls_failed);
+    write_histogram(out, "httpserver_parse_duration_seconds",
+                    "Time to parse a complete request head.", &total->parse_time);
+    write_histogram(out, "httpserver_send_duration_seconds",
+                    "Time spent writing queued responses to the socket.", &total->send_time);
+    write_counter(out, "httpserver_workers", "gauge", "Worker event loops.",
+                  (unsigned long long)workers);
+
+    free(total);
+    if (fclose(out) != 0)
+    {
+        free(text);
+        return NULL;
+    }
+    return text;
+}
@@ -0,0 +1,56 @@
+/**
+ * @file metrics.h
+ * @brief HTTP Server Core - Lock-free Metrics Interface
+ * @version 1.0.0
+ * @date 2025-06-07
+ * @author David Dev (@DavidDevGt)
+ *
+ * @description
+ * Per-worker counters and latency histograms. Every worker thread writes
+ * only its own cache-line aligned block, so the hot path takes no locks
+ * and shares no cache lines; a scrape sums the blocks with relaxed loads
+ * and renders them in the Prometheus text format.
+ *
+ * @license MIT License
+ */
+
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define METRICS_PATH "/metrics"
+#define METRICS_STATUS_MIN 100
+#define METRICS_STATUS_MAX 599
+#define METRICS_HIST_BUCKETS 14  // finite upper bounds, +Inf comes on top
+
+// Set by --verbose: per-request and per-connection lines on stdout
+extern int log_verbose;
+
+void metrics_init_thread(void);
+uint64_t metrics_now_ns(void);
+
+void metrics_count_request(int status, int reused_connection);
+void metrics_count_bytes_sent(size_t bytes);
+void metrics_count_accepted(void);
+void metrics_count_rejected(void);
+void metrics_count_evicted(void);
+void metrics_count_accept_paused(void);
+void metrics_count_yield(void);
+void metrics_connection_closed(void);
+void metrics_count_upstream(int reused_connection);
+void metrics_count_h2_connection(void);
+void metrics_count_h2_stream(void);
+void metrics_count_tls_handshake(int resumed, int ktls);
+void metrics_count_tls_failed(void);
+void metrics_observe_parse(uint64_t ns);
+void metrics_observe_send(uint64_t ns);
+
+/**
+ * Render all workers' metrics in Prometheus text format.
+ * @return: malloc'd text (caller frees) and its length, or NULL
+ */
+char *metrics_render(size_t *len);
+
+#endif // METRICS_H
@@ -0,0 +1,38 @@
+/**
+ * @file pool.h
+ * @brief HTTP Server Core - Slab Buffer Pool Interface
+ * @version 1.0.0
+ * @date 2025-06-07
+ * @author David Dev (@DavidDevGt)
+ *
+ * @description
+ * Per-thread, size-classed pool for connection buffers and request state.
+ * Objects are carved from slabs and recycled through per-class freelists,
+ * so once a worker has seen its peak load, serving allocates nothing.
+ *
+ * @license MIT License
+ */
+
+#ifndef POOL_H
+#define POOL_H
+
+#include <stddef.h>
+
+#define POOL_MIN_SHIFT 6            // smallest class: 64 bytes
+#define POOL_MAX_SHIFT 20           // largest class: 1 MB, bigger goes to malloc()
+#define POOL_CLASSES (POOL_MAX_SHIFT - POOL_MIN_SHIFT + 1)
+#define POOL_SLAB_SIZE (64 * 1024)  // carved into objects of one class
+
+/**
+ * Take an object of at least `size` bytes from the calling thread's pool.
+ * @return: the object (contents undefined), NULL when out of memory
+ */
+void *pool_alloc(size_t size);
+
+/**
+ * Give an object back; `size` must be the size it was allocated with and
+ * the caller must be the thread that allocated it. NULL is ignored.
+ */
+void pool_free(void *ptr, size_t size);
+
+#endif // POOL_H
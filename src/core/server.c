@@ -12,19 +12,32 @@
  * @license MIT License
  */
 
+#define _GNU_SOURCE  // for SOCK_NONBLOCK and SOCK_CLOEXEC
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <arpa/inet.h>
 #include <unistd.h>
 #include <string.h>
 #include "server.h"
+#include "config.h"
+#include "lifecycle.h"
 #include "../client/client_manager.h"
+#include "../http/http_parser.h"
+#include "../http/proxy.h"
+#include "../http/bundle.h"
 
-int create_listen_socket(int port)
+/**
+ * New socket bound to port; exits on failure, as at startup nothing can
+ * be served without it.
+ */
+static int bind_listen_socket(int port, int reuse_port)
 {
-    int sockfd = socket(AF_INET, SOCK_STREAM, 0);
+    // Non-blocking so the edge-triggered accept loop can drain until EAGAIN
+    int sockfd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
     if (sockfd < 0)
     {
         perror("socket");
@@ -34,6 +47,13 @@ int create_listen_socket(int port)
     int opt = 1;
     setsockopt(sockfd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
 
+    // Lets every worker bind its own listener; the kernel balances accepts
+    if (reuse_port && setsockopt(sockfd, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt)) < 0)
+    {
+        perror("setsockopt(SO_REUSEPORT)");
+        exit(1);
+    }
+
     struct sockaddr_in addr =
         {
             .sin_family = AF_INET,
@@ -46,20 +66,64 @@ int create_listen_socket(int port)
         perror("bind");
         exit(1);
     }
+    return sockfd;
+}
+
+int create_listen_socket(int port, int reuse_port)
+{
+    // After a binary upgrade the previous process's sockets are reused, so
+    // connections already queued on them are served rather than dropped
+    int sockfd = lifecycle_take_listener(port);
+    if (sockfd < 0)
+        sockfd = bind_listen_socket(port, reuse_port);
 
-    if (listen(sockfd, BACKLOG) < 0)
+    // Wake us only once a request has arrived, so a connection that has
+    // sent nothing yet waits in the kernel instead of taking a slot
+    if (server_config.defer_accept > 0 &&
+        setsockopt(sockfd, IPPROTO_TCP, TCP_DEFER_ACCEPT, &server_config.defer_accept,
+                   sizeof(server_config.defer_accept)) < 0)
+        perror("setsockopt(TCP_DEFER_ACCEPT)");
+
+    // On an inherited socket this only resizes the backlog
+    if (listen(sockfd, server_config.backlog) < 0)
     {
         perror("listen");
         exit(1);
     }
 
+    lifecycle_add_listener(sockfd);
     return sockfd;
 }
 
-void print_server_info(void)
+int pending_connections(int listen_fd)
+{
+    // For a listening socket tcpi_unacked is the accept queue length
+    struct tcp_info info;
+    socklen_t len = sizeof(info);
+    if (getsockopt(listen_fd, IPPROTO_TCP, TCP_INFO, &info, &len) < 0)
+        return -1;
+    return (int)info.tcpi_unacked;
+}
+
+void print_server_info(int port, int workers)
 {
-    printf("HTTP Server started on port %d with keep-alive support\n", PORT);
-    printf("Keep-alive timeout: %d seconds\n", KEEP_ALIVE_TIMEOUT);
-    printf("Max requests per connection: %d\n", MAX_REQUESTS_PER_CONNECTION);
-    printf("Max concurrent clients: %d\n", MAX_CLIENTS);
+    printf("HTTP Server started on port %d with keep-alive support\n", port);
+    printf("Worker threads: %d\n", workers);
+    const runtime_config_t *cfg = config_current();
+    if (bundle_loaded())
+        printf("Document root: bundle %s, %u files, %zu bytes mapped\n",
+               server_config.bundle_path, bundle_entry_count(), bundle_size());
+    else
+        printf("Document root: %s\n", cfg->root);
+    printf("Keep-alive timeout: %d seconds\n", cfg->keep_alive_timeout);
+    printf("Max requests per connection: %d\n", cfg->max_requests);
+    printf("Max concurrent clients: %d per worker\n", server_config.max_clients);
+    printf("Listen backlog: %d, read buffer: %zu bytes\n",
+           server_config.backlog, server_config.buffer_size);
+    printf("Header scanner: %s\n", http_parser_scanner());
+    if (server_config.tls_port)
+        printf("HTTPS on port %d, certificate %s\n", server_config.tls_port,
+               server_config.tls_cert);
+    proxy_print_routes();
+    printf("Process id: %d (SIGTERM drains, SIGUSR2 starts a new binary)\n", (int)getpid());
 }
@@ -15,13 +15,15 @@
 #ifndef SERVER_H
 #define SERVER_H
 
-#include <sys/select.h>
 #include <time.h>
 
-#define PORT 6090
-#define BACKLOG 10
+int create_listen_socket(int port, int reuse_port);
 
-int create_listen_socket(int port);
-void print_server_info(void);
+/**
+ * Connections waiting in the listen socket's accept queue.
+ * @return: queue length, or -1 if the kernel does not say
+ */
+int pending_connections(int listen_fd);
+void print_server_info(int port, int workers);
 
 #endif // SERVER_H
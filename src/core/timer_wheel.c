@@ -0,0 +1,106 @@
+/**
+ * @file timer_wheel.c
+ * @brief HTTP Server Core - Timer Wheel Implementation
+ * @version 1.0.0
+ * @date 2025-06-07
+ * @author David Dev (@DavidDevGt)
+ * 
+ * @description
+ * Each slot is a circular doubly linked list. Expiry walks the slots from
+ * the last processed tick up to now, so the cost per loop iteration is the
+ * number of elapsed ticks plus the number of expired timers.
+ * 
+ * @license MIT License
+ */
+
+#include "timer_wheel.h"
+
+void timer_wheel_init(timer_wheel_t *wheel, time_t now)
+{
+    for (int i = 0; i < TIMER_WHEEL_SLOTS; i++)
+    {
+        wheel->slots[i].prev = &wheel->slots[i];
+        wheel->slots[i].next = &wheel->slots[i];
+    }
+    wheel->current = now;
+    wheel->count = 0;
+}
+
+void timer_node_init(timer_node_t *node)
+{
+    node->prev = node->next = NULL;
+    node->expires = 0;
+}
+
+int timer_node_armed(const timer_node_t *node)
+{
+    return node->next != NULL;
+}
+
+static timer_node_t *slot_for(timer_wheel_t *wheel, time_t tick)
+{
+    return &wheel->slots[(unsigned long)tick % TIMER_WHEEL_SLOTS];
+}
+
+void timer_wheel_cancel(timer_wheel_t *wheel, timer_node_t *node)
+{
+    if (!timer_node_armed(node))
+        return;
+    node->prev->next = node->next;
+    node->next->prev = node->prev;
+    node->prev = node->next = NULL;
+    wheel->count--;
+}
+
+void timer_wheel_schedule(timer_wheel_t *wheel, timer_node_t *node, time_t expires)
+{
+    timer_wheel_cancel(wheel, node);
+
+    // Already overdue timers land in the slot about to be processed
+    timer_node_t *slot = slot_for(wheel, expires < wheel->current ? wheel->current : expires);
+    node->expires = expires;
+    node->prev = slot->prev;
+    node->next = slot;
+    slot->prev->next = node;
+    slot->prev = node;
+    wheel->count++;
+}
+
+timer_node_t *timer_wheel_pop_expired(timer_wheel_t *wheel, time_t now)
+{
+    while (wheel->count > 0 && wheel->current <= now)
+    {
+        timer_node_t *slot = slot_for(wheel, wheel->current);
+        for (timer_node_t *node = slot->next; node != slot; node = node->next)
+        {
+            if (node->expires <= now)
+            {
+                timer_wheel_cancel(wheel, node);
+                return node;
+            }
+        }
+        if (wheel->current == now)
+            break; // timers for this tick may still be added
+        wheel->current++;
+    }
+    if (wheel->count == 0)
+        wheel->current = now;
+    return NULL;
+}
+
+int timer_wheel_next_timeout_ms(const timer_wheel_t *wheel, time_t now)
+{
+    if (wheel->count == 0)
+        return -1;
+
+    // The first occupied slot bounds the next deadline from below; a slot
+    // holding only later-round timers just causes an early, empty wakeup.
+    for (int i = 0; i < TIMER_WHEEL_SLOTS; i++)
+    {
+        time_t tick = wheel->current + i;
+        const timer_node_t *slot = &wheel->slots[(unsigned long)tick % TIMER_WHEEL_SLOTS];
+        if (slot->next != slot)
+            return tick <= now ? 0 : (int)(tick - now) * 1000;
+    }
+    return TIMER_WHEEL_SLOTS * 1000;
+}
@@ -0,0 +1,45 @@
+/**
+ * @file timer_wheel.h
+ * @brief HTTP Server Core - Timer Wheel Interface
+ * @version 1.0.0
+ * @date 2025-06-07
+ * @author David Dev (@DavidDevGt)
+ * 
+ * @description
+ * Hashed timing wheel with one-second ticks for connection deadlines.
+ * Timers are intrusive nodes, so arming, re-arming and cancelling are O(1)
+ * pointer updates. Deadlines further out than the wheel span simply stay in
+ * their slot for more rounds.
+ * 
+ * @license MIT License
+ */
+
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+#include <stddef.h>
+#include <time.h>
+
+#define TIMER_WHEEL_SLOTS 64
+
+typedef struct timer_node {
+    struct timer_node *prev;
+    struct timer_node *next;
+    time_t expires;
+} timer_node_t;
+
+typedef struct {
+    timer_node_t slots[TIMER_WHEEL_SLOTS];  // list sentinels
+    time_t current;                         // next tick to expire
+    size_t count;
+} timer_wheel_t;
+
+void timer_wheel_init(timer_wheel_t *wheel, time_t now);
+void timer_node_init(timer_node_t *node);
+int timer_node_armed(const timer_node_t *node);
+void timer_wheel_schedule(timer_wheel_t *wheel, timer_node_t *node, time_t expires);
+void timer_wheel_cancel(timer_wheel_t *wheel, timer_node_t *node);
+timer_node_t *timer_wheel_pop_expired(timer_wheel_t *wheel, time_t now);
+int timer_wheel_next_timeout_ms(const timer_wheel_t *wheel, time_t now);
+
+#endif // TIMER_WHEEL_H
@@ -0,0 +1,252 @@
+/**
+ * @file tls.c
+ * @brief HTTP Server Core - TLS Termination Implementation
+ * @version 1.0.0
+ * @date 2025-06-07
+ * @author David Dev (@DavidDevGt)
+ *
+ * @description
+ * One SSL_CTX serves all workers; each connection gets its own SSL on the
+ * client socket. SSL_OP_ENABLE_KTLS makes OpenSSL install the session
+ * keys in the kernel once the handshake is done, separately per
+ * direction, and only where the kernel has the tls module and the cipher
+ * is one it implements; whatever it managed is read back from the socket
+ * BIO and decides how responses are written.
+ *
+ * Reads always go through SSL_read(), which is a plain recv() when the
+ * kernel decrypts. Partial writes are enabled, so a socket that fills up
+ * mid-record behaves like any other short write.
+ *
+ * No close_notify is sent: the socket is closed before the session is
+ * freed, and every response is delimited by its own framing.
+ *
+ * @license MIT License
+ */
+
+#include "tls.h"
+#include "config.h"
+#include "metrics.h"
+#include "pool.h"
+#include "../http/output_queue.h"
+#include <stdio.h>
+#include <errno.h>
+#include <limits.h>
+#include <openssl/ssl.h>
+#include <openssl/err.h>
+
+#ifdef OPENSSL_NO_KTLS
+#define BIO_get_ktls_send(b) 0
+#define BIO_get_ktls_recv(b) 0
+#endif
+
+typedef struct {
+    SSL *ssl;
+    int established;
+    int kernel_tx;     // the kernel encrypts: write plaintext to the socket
+    int kernel_rx;     // the kernel decrypts
+} tls_conn_t;
+
+static SSL_CTX *tls_ctx = NULL;
+
+// ALPN protocol list in wire format, in order of preference
+static const unsigned char alpn_protocols[] = "\x02h2\x08http/1.1";
+
+static int select_alpn(SSL *ssl, const unsigned char **out, unsigned char *out_len,
+                       const unsigned char *in, unsigned int in_len, void *arg)
+{
+    (void)ssl;
+    (void)arg;
+    // Our preference wins; a client offering neither gets no ALPN at all
+    if (SSL_select_next_proto((unsigned char **)out, out_len, alpn_protocols,
+                              sizeof(alpn_protocols) - 1, in, in_len) != OPENSSL_NPN_NEGOTIATED)
+        return SSL_TLSEXT_ERR_NOACK;
+    return SSL_TLSEXT_ERR_OK;
+}
+
+int tls_init(void)
+{
+    const char *cert = server_config.tls_cert;
+    const char *key = server_config.tls_key;
+    if (!cert || !key)
+    {
+        fprintf(stderr, "--tls-port needs --tls-cert and --tls-key\n");
+        return -1;
+    }
+
+    tls_ctx = SSL_CTX_new(TLS_server_method());
+    if (!tls_ctx)
+    {
+        ERR_print_errors_fp(stderr);
+        return -1;
+    }
+    SSL_CTX_set_min_proto_version(tls_ctx, TLS1_2_VERSION);
+
+    // A peer that closes without close_notify reads as a plain EOF
+    uint64_t options = SSL_OP_NO_RENEGOTIATION | SSL_OP_IGNORE_UNEXPECTED_EOF;
+#ifdef SSL_OP_ENABLE_KTLS
+    options |= SSL_OP_ENABLE_KTLS;
+#endif
+    SSL_CTX_set_options(tls_ctx, options);
+
+    // The output queue retries a blocked write from a fresh copy of the same
+    // bytes, possibly followed by more
+    SSL_CTX_set_mode(tls_ctx, SSL_MODE_ENABLE_PARTIAL_WRITE |
+                              SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER |
+                              SSL_MODE_RELEASE_BUFFERS);
+
+    // Resumption from stateless tickets only: the ticket key is shared by
+    // every worker and there is no session cache to lock
+    SSL_CTX_set_session_cache_mode(tls_ctx, SSL_SESS_CACHE_OFF);
+    SSL_CTX_set_timeout(tls_ctx, TLS_SESSION_LIFETIME);
+
+    SSL_CTX_set_alpn_select_cb(tls_ctx, select_alpn, NULL);
+
+    if (SSL_CTX_use_certificate_chain_file(tls_ctx, cert) != 1 ||
+        SSL_CTX_use_PrivateKey_file(tls_ctx, key, SSL_FILETYPE_PEM) != 1 ||
+        SSL_CTX_check_private_key(tls_ctx) != 1)
+    {
+        fprintf(stderr, "Cannot load TLS certificate %s and key %s\n", cert, key);
+        ERR_print_errors_fp(stderr);
+        SSL_CTX_free(tls_ctx);
+        tls_ctx = NULL;
+        return -1;
+    }
+    return 0;
+}
+
+int tls_accept(client_info_t *client)
+{
+    tls_conn_t *tls = pool_alloc(sizeof(*tls));
+    if (!tls)
+        return -1;
+    tls->ssl = SSL_new(tls_ctx);
+    if (!tls->ssl || SSL_set_fd(tls->ssl, client->fd) != 1)
+    {
+        SSL_free(tls->ssl);
+        pool_free(tls, sizeof(*tls));
+        return -1;
+    }
+    SSL_set_accept_state(tls->ssl);
+    tls->established = 0;
+    tls->kernel_tx = 0;
+    tls->kernel_rx = 0;
+    client->tls = tls;
+    return 0;
+}
+
+int tls_handshake(client_info_t *client)
+{
+    tls_conn_t *tls = client->tls;
+    ERR_clear_error();
+    int rc = SSL_do_handshake(tls->ssl);
+    if (rc != 1)
+    {
+        int err = SSL_get_error(tls->ssl, rc);
+        if (err == SSL_ERROR_WANT_READ || err == SSL_ERROR_WANT_WRITE)
+            return 0;
+        if (log_verbose)
+        {
+            unsigned long reason = ERR_peek_error();
+            printf("TLS handshake failed on fd=%d: %s\n", client->fd,
+                   reason ? ERR_reason_error_string(reason) : "connection closed");
+        }
+        metrics_count_tls_failed();
+        return -1;
+    }
+
+    tls->established = 1;
+    tls->kernel_tx = BIO_get_ktls_send(SSL_get_wbio(tls->ssl));
+    tls->kernel_rx = BIO_get_ktls_recv(SSL_get_rbio(tls->ssl));
+    int resumed = SSL_session_reused(tls->ssl);
+    metrics_count_tls_handshake(resumed, tls->kernel_tx);
+
+    if (log_verbose)
+    {
+        const unsigned char *alpn = NULL;
+        unsigned int alpn_len = 0;
+        SSL_get0_alpn_selected(tls->ssl, &alpn, &alpn_len);
+        printf("TLS fd=%d: %s %s%s, ALPN %.*s, kTLS send %s, receive %s\n", client->fd,
+               SSL_get_version(tls->ssl), SSL_get_cipher_name(tls->ssl),
+               resumed ? " (resumed)" : "",
+               alpn_len ? (int)alpn_len : 4, alpn_len ? (const char *)alpn : "none",
+               tls->kernel_tx ? "on" : "off", tls->kernel_rx ? "on" : "off");
+    }
+    return 1;
+}
+
+int tls_established(const client_info_t *client)
+{
+    const tls_conn_t *tls = client->tls;
+    return tls->established;
+}
+
+/**
+ * errno for an SSL_read() or SSL_write() that did not transfer anything.
+ * @return: 0 for a clean close, -1 otherwise
+ */
+static int map_ssl_error(SSL *ssl, int rc)
+{
+    switch (SSL_get_error(ssl, rc))
+    {
+    case SSL_ERROR_WANT_READ:
+    case SSL_ERROR_WANT_WRITE:
+        errno = EAGAIN;
+        return -1;
+    case SSL_ERROR_ZERO_RETURN:
+        return 0;
+    case SSL_ERROR_SYSCALL:
+        if (errno == 0)
+            errno = ECONNRESET;
+        return -1;
+    default:
+        errno = EPROTO;
+        return -1;
+    }
+}
+
+ssize_t tls_recv(client_info_t *client, void *buf, size_t len)
+{
+    tls_conn_t *tls = client->tls;
+    ERR_clear_error();
+    errno = 0;
+    int n = SSL_read(tls->ssl, buf, len > INT_MAX ? INT_MAX : (int)len);
+    if (n > 0)
+        return n;
+    return map_ssl_error(tls->ssl, n);
+}
+
+static ssize_t ssl_write(void *ctx, const void *data, size_t len)
+{
+    SSL *ssl = ctx;
+    ERR_clear_error();
+    errno = 0;
+    int n = SSL_write(ssl, data, len > INT_MAX ? INT_MAX : (int)len);
+    if (n > 0)
+        return n;
+    // The peer closing mid-response is an error for a writer
+    if (map_ssl_error(ssl, n) == 0)
+        errno = EPIPE;
+    return -1;
+}
+
+int tls_flush(client_info_t *client, size_t *budget)
+{
+    tls_conn_t *tls = client->tls;
+    if (tls->kernel_tx)
+        return outq_flush(&client->out, client->fd, budget);
+    return outq_flush_copy(&client->out, ssl_write, tls->ssl, budget);
+}
+
+int tls_kernel_io(const client_info_t *client)
+{
+    const tls_conn_t *tls = client->tls;
+    return tls->kernel_tx && tls->kernel_rx;
+}
+
+void tls_free(client_info_t *client)
+{
+    tls_conn_t *tls = client->tls;
+    SSL_free(tls->ssl);
+    pool_free(tls, sizeof(*tls));
+    client->tls = NULL;
+}
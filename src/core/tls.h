@@ -0,0 +1,77 @@
+/**
+ * @file tls.h
+ * @brief HTTP Server Core - TLS Termination Interface
+ * @version 1.0.0
+ * @date 2025-06-07
+ * @author David Dev (@DavidDevGt)
+ *
+ * @description
+ * HTTPS on a second listener (--tls-port), terminated with OpenSSL. After
+ * the handshake the record layer is handed to the kernel (kTLS) when both
+ * the kernel and the negotiated cipher support it: responses then go out
+ * through the same sendmsg()/sendfile() path as cleartext, and static
+ * files stay zero-copy. Otherwise records are encrypted in user space,
+ * copied out of the output queue 16 KB at a time.
+ *
+ * Sessions resume from stateless tickets, so no cache is shared between
+ * workers. ALPN offers h2 and http/1.1.
+ *
+ * @license MIT License
+ */
+
+#ifndef TLS_H
+#define TLS_H
+
+#include <stddef.h>
+#include <sys/types.h>
+#include "../client/client_manager.h"
+
+#define TLS_SESSION_LIFETIME 7200   // seconds a session ticket stays valid
+
+/**
+ * Create the server context from server_config.tls_cert and tls_key.
+ * Call once at startup, before any worker runs.
+ * @return: 0 on success, -1 (reasons on stderr) if they cannot be loaded
+ */
+int tls_init(void);
+
+/**
+ * Start a server-side session on a newly accepted connection; the
+ * handshake is driven by tls_handshake().
+ * @return: 0 on success, -1 when out of memory
+ */
+int tls_accept(client_info_t *client);
+
+/**
+ * Continue the handshake with whatever the socket allows.
+ * @return: 1 once established, 0 if it waits for the socket, -1 on failure
+ */
+int tls_handshake(client_info_t *client);
+
+int tls_established(const client_info_t *client);
+
+/**
+ * recv() counterpart: decrypted bytes into buf.
+ * @return: bytes read, 0 once the peer closed, -1 with errno set
+ *          (EAGAIN when the socket has nothing more for now)
+ */
+ssize_t tls_recv(client_info_t *client, void *buf, size_t len);
+
+/**
+ * outq_flush() counterpart for the client's output queue.
+ * @return: as outq_flush()
+ */
+int tls_flush(client_info_t *client, size_t *budget);
+
+/**
+ * Whether the kernel handles records in both directions, so the socket
+ * carries plaintext to splice() from and to.
+ */
+int tls_kernel_io(const client_info_t *client);
+
+/**
+ * The connection is closing; releases the session.
+ */
+void tls_free(client_info_t *client);
+
+#endif // TLS_H
@@ -0,0 +1,842 @@
+/**
+ * @file uring_loop.c
+ * @brief HTTP Server Core - io_uring Event Loop Implementation
+ * @version 1.0.0
+ * @date 2025-06-07
+ * @author David Dev (@DavidDevGt)
+ *
+ * @description
+ * io_uring backend built directly on the kernel ABI (no liburing). Each
+ * worker thread owns one ring:
+ *
+ * - one multishot accept on the listen socket
+ * - one multishot recv per connection, filling buffers from a provided
+ *   buffer ring; data is copied into the connection's read buffer and the
+ *   ring buffer is recycled at once
+ * - response memory chunks go out with IORING_OP_SENDMSG
+ * - file bodies go out as a linked IORING_OP_READ + IORING_OP_SEND pair
+ *   through a per-connection staging buffer
+ *
+ * All submissions for a loop iteration are flushed by the single
+ * io_uring_enter() that also waits for completions.
+ *
+ * On SIGTERM the accept is cancelled for good and the listener closed;
+ * the loop returns once the remaining connections are finished.
+ *
+ * At capacity the multishot accept is cancelled, so new connections wait
+ * in the kernel backlog, and the longest idle keep-alives are shut down to
+ * make room; accept is re-armed once a slot is free.
+ *
+ * A connection is never closed while it has operations in flight: teardown
+ * shuts the socket down, waits for the outstanding completions, and only
+ * then closes the fd. So a completion can never refer to a reused fd.
+ *
+ * @license MIT License
+ */
+
+#define _GNU_SOURCE  // for MSG_MORE and SOCK_NONBLOCK
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#include "uring_loop.h"
+#include "event_loop.h"
+#include "metrics.h"
+#include "config.h"
+#include "pool.h"
+#include "lifecycle.h"
+#include "../client/client_manager.h"
+#include "../http/http_handler.h"
+
+enum {
+    OP_ACCEPT = 1,
+    OP_RECV,
+    OP_SEND,
+    OP_FILE_READ,
+    OP_FILE_SEND,
+    OP_CANCEL,
+    OP_LISTEN_POLL,
+    OP_WAKE
+};
+
+typedef struct {
+    int fd;
+    unsigned *sq_head;
+    unsigned *sq_tail;
+    unsigned *sq_mask;
+    unsigned sq_entries;
+    unsigned sqe_tail;        // local tail, published on enter
+    struct io_uring_sqe *sqes;
+    unsigned *cq_head;
+    unsigned *cq_tail;
+    unsigned *cq_mask;
+    struct io_uring_cqe *cqes;
+    struct io_uring_buf_ring *buf_ring;
+    char *buf_base;
+    unsigned short buf_tail;
+} uring_t;
+
+typedef struct {
+    unsigned short bid;
+    unsigned short off;
+    unsigned short len;
+} pending_recv_t;
+
+typedef struct {
+    int inflight;             // submitted operations not yet completed
+    int send_busy;            // a send (or file read+send pair) is in flight
+    int closing;
+    int peer_closed;
+    int evicted;              // closing to admit a new connection
+    struct iovec iov[OUTQ_MAX_IOV];
+    struct msghdr msg;
+    char *staging;            // file body staging buffer, lazily allocated
+    size_t staged;            // bytes read into staging for the current pair
+    size_t staged_sent;
+    uint64_t send_started;    // submit time of the send in flight (metrics)
+    pending_recv_t pending[URING_MAX_PENDING_RECV]; // data not yet in rbuf
+    int pending_count;
+} uring_conn_t;
+
+static __thread uring_t ring;
+static __thread int accept_armed;       // multishot accept in flight
+static __thread int accept_paused;      // table full, accept cancelled
+static __thread int listen_poll_armed;  // watching for arrivals while paused
+static __thread int evictions_pending;  // evicted connections not yet closed
+static __thread int accept_stopped;     // draining, the listener is closed
+
+static uint64_t make_user_data(int fd, int op)
+{
+    return ((uint64_t)(unsigned)fd << 8) | (unsigned)op;
+}
+
+static int uring_enter(unsigned wait_nr, int timeout_ms)
+{
+    __atomic_store_n(ring.sq_tail, ring.sqe_tail, __ATOMIC_RELEASE);
+    unsigned to_submit = ring.sqe_tail - __atomic_load_n(ring.sq_head, __ATOMIC_ACQUIRE);
+
+    unsigned flags = 0;
+    struct __kernel_timespec ts;
+    struct io_uring_getevents_arg arg;
+    memset(&arg, 0, sizeof(arg));
+
+    if (wait_nr > 0)
+    {
+        flags |= IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG;
+        if (timeout_ms >= 0)
+        {
+            ts.tv_sec = timeout_ms / 1000;
+            ts.tv_nsec = (long long)(timeout_ms % 1000) * 1000000;
+            arg.ts = (uint64_t)(uintptr_t)&ts;
+        }
+        return (int)syscall(__NR_io_uring_enter, ring.fd, to_submit, wait_nr,
+                            flags, &arg, sizeof(arg));
+    }
+    return (int)syscall(__NR_io_uring_enter, ring.fd, to_submit, 0, 0, NULL, 0);
+}
+
+static unsigned sq_space(void)
+{
+    return ring.sq_entries - (ring.sqe_tail - __atomic_load_n(ring.sq_head, __ATOMIC_ACQUIRE));
+}
+
+/**
+ * Reserve room for `count` consecutive SQEs, submitting queued ones first
+ * if the ring is full. Linked pairs must not be split across a submit.
+ */
+static int reserve_sqes(unsigned count)
+{
+    if (sq_space() >= count)
+        return 0;
+    uring_enter(0, 0);
+    return sq_space() >= count ? 0 : -1;
+}
+
+static struct io_uring_sqe *next_sqe(void)
+{
+    struct io_uring_sqe *sqe = &ring.sqes[ring.sqe_tail & *ring.sq_mask];
+    memset(sqe, 0, sizeof(*sqe));
+    ring.sqe_tail++;
+    return sqe;
+}
+
+static void recycle_buffer(unsigned short bid)
+{
+    struct io_uring_buf *buf = &ring.buf_ring->bufs[ring.buf_tail & (URING_RECV_BUF_COUNT - 1)];
+    buf->addr = (uint64_t)(uintptr_t)(ring.buf_base + (size_t)bid * URING_RECV_BUF_SIZE);
+    buf->len = URING_RECV_BUF_SIZE;
+    buf->bid = bid;
+    ring.buf_tail++;
+    __atomic_store_n(&ring.buf_ring->tail, ring.buf_tail, __ATOMIC_RELEASE);
+}
+
+static int uring_init(void)
+{
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+
+    ring.fd = (int)syscall(__NR_io_uring_setup, URING_ENTRIES, &params);
+    if (ring.fd < 0)
+        return -1;
+
+    if (!(params.features & IORING_FEAT_SINGLE_MMAP) ||
+        !(params.features & IORING_FEAT_EXT_ARG))
+    {
+        close(ring.fd);
+        return -1;
+    }
+
+    size_t sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    size_t cq_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    size_t ring_size = sq_size > cq_size ? sq_size : cq_size;
+
+    char *rings = mmap(NULL, ring_size, PROT_READ | PROT_WRITE,
+                       MAP_SHARED | MAP_POPULATE, ring.fd, IORING_OFF_SQ_RING);
+    struct io_uring_sqe *sqes = mmap(NULL, params.sq_entries * sizeof(struct io_uring_sqe),
+                                     PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                                     ring.fd, IORING_OFF_SQES);
+    if (rings == MAP_FAILED || sqes == MAP_FAILED)
+    {
+        close(ring.fd);
+        return -1;
+    }
+
+    ring.sq_head = (unsigned *)(rings + params.sq_off.head);
+    ring.sq_tail = (unsigned *)(rings + params.sq_off.tail);
+    ring.sq_mask = (unsigned *)(rings + params.sq_off.ring_mask);
+    ring.sq_entries = params.sq_entries;
+    ring.sqe_tail = *ring.sq_tail;
+    ring.sqes = sqes;
+    ring.cq_head = (unsigned *)(rings + params.cq_off.head);
+    ring.cq_tail = (unsigned *)(rings + params.cq_off.tail);
+    ring.cq_mask = (unsigned *)(rings + params.cq_off.ring_mask);
+    ring.cqes = (struct io_uring_cqe *)(rings + params.cq_off.cqes);
+
+    // SQ index array is the identity mapping
+    unsigned *sq_array = (unsigned *)(rings + params.sq_off.array);
+    for (unsigned i = 0; i < params.sq_entries; i++)
+        sq_array[i] = i;
+
+    // Provided buffer ring for multishot receives
+    size_t buf_ring_size = URING_RECV_BUF_COUNT * sizeof(struct io_uring_buf);
+    ring.buf_ring = mmap(NULL, buf_ring_size, PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    ring.buf_base = malloc((size_t)URING_RECV_BUF_COUNT * URING_RECV_BUF_SIZE);
+    if (ring.buf_ring == MAP_FAILED || !ring.buf_base)
+    {
+        close(ring.fd);
+        return -1;
+    }
+
+    struct io_uring_buf_reg reg;
+    memset(&reg, 0, sizeof(reg));
+    reg.ring_addr = (uint64_t)(uintptr_t)ring.buf_ring;
+    reg.ring_entries = URING_RECV_BUF_COUNT;
+    reg.bgid = URING_RECV_BUF_GROUP;
+    if (syscall(__NR_io_uring_register, ring.fd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0)
+    {
+        close(ring.fd);
+        return -1;
+    }
+
+    ring.buf_tail = 0;
+    for (unsigned short bid = 0; bid < URING_RECV_BUF_COUNT; bid++)
+        recycle_buffer(bid);
+    return 0;
+}
+
+static int arm_accept(int listen_fd)
+{
+    if (reserve_sqes(1) < 0)
+        return -1;
+    struct io_uring_sqe *sqe = next_sqe();
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = listen_fd;
+    sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+    sqe->accept_flags = SOCK_NONBLOCK | SOCK_CLOEXEC;
+    sqe->user_data = make_user_data(listen_fd, OP_ACCEPT);
+    accept_armed = 1;
+    return 0;
+}
+
+static int cancel_listen_op(int listen_fd, int op)
+{
+    if (reserve_sqes(1) < 0)
+        return -1;
+    struct io_uring_sqe *sqe = next_sqe();
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->fd = -1;
+    sqe->addr = make_user_data(listen_fd, op);
+    sqe->user_data = make_user_data(listen_fd, OP_CANCEL);
+    return 0;
+}
+
+static void pause_accept(int listen_fd)
+{
+    if (cancel_listen_op(listen_fd, OP_ACCEPT) < 0)
+        return; // try again after the next accept
+    accept_paused = 1;
+    metrics_count_accept_paused();
+    if (log_verbose)
+        printf("Max clients reached, pausing accept\n");
+}
+
+static int arm_recv(client_info_t *client)
+{
+    uring_conn_t *conn = client->io_state;
+    if (reserve_sqes(1) < 0)
+        return -1;
+    struct io_uring_sqe *sqe = next_sqe();
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = client->fd;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = URING_RECV_BUF_GROUP;
+    sqe->user_data = make_user_data(client->fd, OP_RECV);
+    conn->inflight++;
+    return 0;
+}
+
+static void maybe_finish_close(client_info_t *client)
+{
+    uring_conn_t *conn = client->io_state;
+    if (!conn->closing || conn->inflight > 0)
+        return;
+
+    if (conn->evicted)
+        evictions_pending--;
+    for (int i = 0; i < conn->pending_count; i++)
+        recycle_buffer(conn->pending[i].bid);
+    pool_free(conn->staging, URING_FILE_CHUNK);
+    pool_free(conn, sizeof(*conn));
+    client->io_state = NULL;
+
+    int fd = client->fd;
+    close(fd);
+    remove_client(fd);
+}
+
+/**
+ * Start tearing a connection down. The connection is only freed by
+ * maybe_finish_close() once its last operation has completed, so callers
+ * may keep using it after this returns.
+ */
+static void begin_close(client_info_t *client)
+{
+    uring_conn_t *conn = client->io_state;
+    if (!conn->closing)
+    {
+        conn->closing = 1;
+        // Completes the multishot recv and fails any send still in flight
+        shutdown(client->fd, SHUT_RDWR);
+    }
+}
+
+static void expire_connection(client_info_t *client)
+{
+    begin_close(client);
+    maybe_finish_close(client);
+}
+
+static void evict_connection(client_info_t *client)
+{
+    ((uring_conn_t *)client->io_state)->evicted = 1;
+    evictions_pending++;
+    expire_connection(client);
+}
+
+static void arm_listen_poll(int listen_fd)
+{
+    if (reserve_sqes(1) < 0)
+        return;
+    struct io_uring_sqe *sqe = next_sqe();
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = listen_fd;
+    sqe->poll32_events = POLLIN;
+    sqe->user_data = make_user_data(listen_fd, OP_LISTEN_POLL);
+    listen_poll_armed = 1;
+}
+
+/**
+ * Stop accepting for good. The cancelled requests hold their own
+ * reference to the socket, so the fd can be closed right away; their
+ * completions are ignored from now on.
+ */
+static void stop_accepting(int listen_fd)
+{
+    if (accept_armed)
+        cancel_listen_op(listen_fd, OP_ACCEPT);
+    if (listen_poll_armed)
+        cancel_listen_op(listen_fd, OP_LISTEN_POLL);
+    close(listen_fd);
+    accept_stopped = 1;
+    accept_paused = 0;
+}
+
+static void arm_wake(int wake_fd)
+{
+    if (reserve_sqes(1) < 0)
+        return; // signals are then noticed on the next timeout
+    struct io_uring_sqe *sqe = next_sqe();
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = wake_fd;
+    sqe->poll32_events = POLLIN;
+    sqe->user_data = make_user_data(wake_fd, OP_WAKE);
+}
+
+/**
+ * Runs after each batch of completions while accepting is paused. Slots
+ * only free up once an evicted connection's last completion arrives, so
+ * those already on their way out are counted as gone.
+ */
+static void admit_connections(int listen_fd)
+{
+    int waiting = eviction_quota(listen_fd);
+    if (client_count - evictions_pending >= server_config.max_clients)
+    {
+        int quota = waiting - evictions_pending;
+        if (quota > 0)
+            evict_idle_connections(quota, evict_connection);
+    }
+    if (client_count < server_config.max_clients)
+    {
+        accept_paused = 0;
+        // Still armed if the cancel has not landed yet; the accept
+        // completion then re-arms it
+        if (!accept_armed && arm_accept(listen_fd) < 0)
+        {
+            fprintf(stderr, "io_uring: cannot re-arm accept\n");
+            exit(1);
+        }
+        return;
+    }
+
+    // Nobody is waiting yet: get woken by the next arrival while there
+    // are idle connections that could make room for it. Arrivals already
+    // waiting are retried on the admission_timeout_ms() tick instead.
+    if (waiting == 0 && client_idle_count() > 0 && !listen_poll_armed)
+        arm_listen_poll(listen_fd);
+}
+
+/**
+ * Move buffered receive data into the connection's read buffer, in order,
+ * handing ring buffers back as soon as they are fully copied.
+ */
+static void drain_pending(client_info_t *client)
+{
+    uring_conn_t *conn = client->io_state;
+    while (conn->pending_count > 0 && client->rlen < server_config.buffer_size)
+    {
+        pending_recv_t *p = &conn->pending[0];
+        size_t room = server_config.buffer_size - client->rlen;
+        size_t n = p->len < room ? p->len : room;
+        memcpy(client->rbuf + client->rlen,
+               ring.buf_base + (size_t)p->bid * URING_RECV_BUF_SIZE + p->off, n);
+        client->rlen += n;
+        p->off += n;
+        p->len -= n;
+        if (p->len > 0)
+            break;
+        recycle_buffer(p->bid);
+        conn->pending_count--;
+        memmove(&conn->pending[0], &conn->pending[1],
+                conn->pending_count * sizeof(conn->pending[0]));
+    }
+}
+
+static int stash_recv(client_info_t *client, unsigned short bid, int len)
+{
+    uring_conn_t *conn = client->io_state;
+    if (conn->pending_count == URING_MAX_PENDING_RECV)
+    {
+        recycle_buffer(bid);
+        return -1; // peer keeps sending while we cannot answer
+    }
+    if (client_acquire_buffers(client) < 0)
+    {
+        recycle_buffer(bid);
+        return -1;
+    }
+    pending_recv_t *p = &conn->pending[conn->pending_count++];
+    p->bid = bid;
+    p->off = 0;
+    p->len = (unsigned short)len;
+    drain_pending(client);
+    return 0;
+}
+
+/**
+ * Submit the next piece of output if nothing is in flight.
+ */
+static void start_send(client_info_t *client)
+{
+    uring_conn_t *conn = client->io_state;
+    if (conn->send_busy || conn->closing)
+        return;
+
+    out_chunk_t *chunk;
+    while ((chunk = outq_front(&client->out)) != NULL)
+    {
+        if (chunk->type == OUT_MEM)
+        {
+            int file_follows;
+            int iovcnt = outq_gather(&client->out, conn->iov, OUTQ_MAX_IOV, &file_follows);
+            memset(&conn->msg, 0, sizeof(conn->msg));
+            conn->msg.msg_iov = conn->iov;
+            conn->msg.msg_iovlen = iovcnt;
+
+            if (reserve_sqes(1) < 0)
+                break;
+            struct io_uring_sqe *sqe = next_sqe();
+            sqe->opcode = IORING_OP_SENDMSG;
+            sqe->fd = client->fd;
+            sqe->addr = (uint64_t)(uintptr_t)&conn->msg;
+            sqe->len = 1;
+            sqe->msg_flags = MSG_NOSIGNAL | (file_follows ? MSG_MORE : 0);
+            sqe->user_data = make_user_data(client->fd, OP_SEND);
+            conn->inflight++;
+            conn->send_busy = 1;
+            conn->send_started = metrics_now_ns();
+            return;
+        }
+
+        if (chunk->remaining == 0)
+        {
+            outq_consume_file(&client->out, 0);
+            continue;
+        }
+
+        if (!conn->staging && !(conn->staging = pool_alloc(URING_FILE_CHUNK)))
+            break;
+        if (reserve_sqes(2) < 0)
+            break;
+
+        size_t n = chunk->remaining < URING_FILE_CHUNK ? chunk->remaining : URING_FILE_CHUNK;
+
+        // A short read fails the link, so the send is cancelled rather
+        // than transmitting stale staging bytes
+        struct io_uring_sqe *sqe = next_sqe();
+        sqe->opcode = IORING_OP_READ;
+        sqe->fd = chunk->file_fd;
+        sqe->addr = (uint64_t)(uintptr_t)conn->staging;
+        sqe->len = (unsigned)n;
+        sqe->off = (uint64_t)chunk->offset;
+        sqe->flags = IOSQE_IO_LINK;
+        sqe->user_data = make_user_data(client->fd, OP_FILE_READ);
+
+        sqe = next_sqe();
+        sqe->opcode = IORING_OP_SEND;
+        sqe->fd = client->fd;
+        sqe->addr = (uint64_t)(uintptr_t)conn->staging;
+        sqe->len = (unsigned)n;
+        sqe->msg_flags = MSG_NOSIGNAL;
+        sqe->user_data = make_user_data(client->fd, OP_FILE_SEND);
+
+        conn->staged = n;
+        conn->staged_sent = 0;
+        conn->inflight += 2;
+        conn->send_busy = 1;
+        conn->send_started = metrics_now_ns();
+        return;
+    }
+
+    if (chunk)
+        begin_close(client); // out of SQEs or memory
+}
+
+/**
+ * Parse and answer buffered requests, and start writing the responses.
+ * Called after every completion that may have made progress possible.
+ */
+static void drive(client_info_t *client)
+{
+    uring_conn_t *conn = client->io_state;
+    if (!conn->closing && client_acquire_buffers(client) < 0)
+        begin_close(client);
+
+    while (!conn->closing)
+    {
+        // Each send completion is a turn, so the budget is per loop pass
+        int requests_left = FAIR_MAX_REQUESTS;
+        drain_pending(client);
+        int stalled = http_process_input(client, &requests_left);
+        start_send(client);
+        if (conn->closing || conn->send_busy)
+            return; // the send completion calls back in here
+
+        // Output fully written
+        if (client->close_after_send || conn->peer_closed)
+        {
+            begin_close(client);
+            return;
+        }
+        if (!stalled && !(conn->pending_count > 0 && client->rlen < server_config.buffer_size))
+        {
+            // Waiting for the next request: give the buffers back
+            if (client->rlen == 0 && conn->pending_count == 0)
+            {
+                pool_free(conn->staging, URING_FILE_CHUNK);
+                conn->staging = NULL;
+                client_release_idle_buffers(client);
+            }
+            return;
+        }
+    }
+}
+
+static void on_accept(int listen_fd, int client_fd)
+{
+    if (client_count >= server_config.max_clients)
+    {
+        // Accepted before the cancel took effect
+        reject_connection(client_fd);
+        return;
+    }
+    if (add_client(client_fd) < 0)
+    {
+        close(client_fd);
+        return;
+    }
+
+    client_info_t *client = find_client(client_fd);
+    client->io_state = pool_alloc(sizeof(uring_conn_t));
+    if (client->io_state)
+        memset(client->io_state, 0, sizeof(uring_conn_t));
+    if (!client->io_state || arm_recv(client) < 0)
+    {
+        pool_free(client->io_state, sizeof(uring_conn_t));
+        client->io_state = NULL;
+        close(client_fd);
+        remove_client(client_fd);
+        return;
+    }
+
+    if (client_count >= server_config.max_clients && !accept_paused && !accept_stopped)
+        pause_accept(listen_fd);
+}
+
+static void on_recv(client_info_t *client, const struct io_uring_cqe *cqe)
+{
+    uring_conn_t *conn = client->io_state;
+    int more = cqe->flags & IORING_CQE_F_MORE;
+    if (!more)
+    {
+        conn->inflight--;
+    }
+
+    if (cqe->flags & IORING_CQE_F_BUFFER)
+    {
+        unsigned short bid = cqe->flags >> IORING_CQE_BUFFER_SHIFT;
+        if (cqe->res <= 0 || conn->closing)
+            recycle_buffer(bid);
+        else if (stash_recv(client, bid, cqe->res) < 0)
+        {
+            begin_close(client);
+            return;
+        }
+    }
+
+    if (cqe->res == 0)
+        conn->peer_closed = 1;
+    else if (cqe->res < 0 && cqe->res != -ENOBUFS)
+    {
+        begin_close(client);
+        return;
+    }
+
+    if (conn->closing)
+        return;
+
+    touch_client(client);
+    // Re-arm after the kernel ended the multishot (e.g. buffers ran out)
+    if (!more && !conn->peer_closed && arm_recv(client) < 0)
+    {
+        begin_close(client);
+        return;
+    }
+    drive(client);
+}
+
+static void on_send(client_info_t *client, int res)
+{
+    uring_conn_t *conn = client->io_state;
+    conn->inflight--;
+    conn->send_busy = 0;
+    if (conn->closing || res < 0)
+    {
+        begin_close(client);
+        return;
+    }
+    touch_client(client);
+    metrics_observe_send(metrics_now_ns() - conn->send_started);
+    outq_consume_mem(&client->out, res);
+    drive(client);
+}
+
+static void on_file_send(client_info_t *client, int res)
+{
+    uring_conn_t *conn = client->io_state;
+    conn->inflight--;
+    if (conn->closing || res <= 0)
+    {
+        // -ECANCELED here means the linked file read failed or came up short
+        conn->send_busy = 0;
+        begin_close(client);
+        return;
+    }
+    touch_client(client);
+
+    conn->staged_sent += res;
+    if (conn->staged_sent < conn->staged)
+    {
+        // Short send: push out the rest of the staged bytes
+        if (reserve_sqes(1) < 0)
+        {
+            conn->send_busy = 0;
+            begin_close(client);
+            return;
+        }
+        struct io_uring_sqe *sqe = next_sqe();
+        sqe->opcode = IORING_OP_SEND;
+        sqe->fd = client->fd;
+        sqe->addr = (uint64_t)(uintptr_t)(conn->staging + conn->staged_sent);
+        sqe->len = (unsigned)(conn->staged - conn->staged_sent);
+        sqe->msg_flags = MSG_NOSIGNAL;
+        sqe->user_data = make_user_data(client->fd, OP_FILE_SEND);
+        conn->inflight++;
+        return;
+    }
+
+    conn->send_busy = 0;
+    metrics_observe_send(metrics_now_ns() - conn->send_started);
+    outq_consume_file(&client->out, conn->staged);
+    drive(client);
+}
+
+static void handle_cqe(int listen_fd, const struct io_uring_cqe *cqe)
+{
+    int fd = (int)(cqe->user_data >> 8);
+    int op = (int)(cqe->user_data & 0xff);
+
+    if (op == OP_ACCEPT)
+    {
+        if (cqe->res >= 0)
+            on_accept(listen_fd, cqe->res);
+        else if (cqe->res != -EAGAIN && cqe->res != -EINTR && cqe->res != -ECANCELED)
+            fprintf(stderr, "accept: %s\n", strerror(-cqe->res));
+        if (!(cqe->flags & IORING_CQE_F_MORE))
+        {
+            accept_armed = 0;
+            if (!accept_paused && !accept_stopped && arm_accept(listen_fd) < 0)
+            {
+                fprintf(stderr, "io_uring: cannot re-arm accept\n");
+                exit(1);
+            }
+        }
+        return;
+    }
+    if (op == OP_CANCEL)
+        return; // the accept completion reports the outcome
+    if (op == OP_LISTEN_POLL)
+    {
+        listen_poll_armed = 0; // admit_connections() runs after this batch
+        return;
+    }
+    if (op == OP_WAKE)
+    {
+        // The flags are checked at the top of the loop
+        lifecycle_clear_wake(fd);
+        arm_wake(fd);
+        return;
+    }
+
+    // The fd stays open until every operation on it has completed, so the
+    // lookup always finds the connection the operation was issued for
+    client_info_t *client = find_client(fd);
+    if (!client || !client->io_state)
+        return;
+
+    switch (op)
+    {
+    case OP_RECV:
+        on_recv(client, cqe);
+        break;
+    case OP_SEND:
+        on_send(client, cqe->res);
+        break;
+    case OP_FILE_READ:
+        // Success is reported by the linked send; failure cancels it
+        ((uring_conn_t *)client->io_state)->inflight--;
+        break;
+    case OP_FILE_SEND:
+        on_file_send(client, cqe->res);
+        break;
+    }
+
+    maybe_finish_close(client);
+}
+
+int run_uring_loop(int listen_fd)
+{
+    if (uring_init() < 0 || arm_accept(listen_fd) < 0)
+        return -1;
+
+    printf("Event backend: io_uring (multishot accept/recv, provided buffers)\n");
+    arm_wake(lifecycle_register_loop());
+    time_t last_stats_print = time(NULL);
+
+    while (1)
+    {
+        config_reload_if_requested();
+        lifecycle_poll();
+        if (lifecycle_draining() && !accept_stopped)
+            stop_accepting(listen_fd);
+
+        int timeout = loop_timeout_ms(last_stats_print);
+        if (accept_paused)
+            timeout = admission_timeout_ms(timeout);
+        int ret = uring_enter(1, timeout);
+        if (ret < 0 && errno != ETIME && errno != EINTR && errno != EBUSY && errno != EAGAIN)
+        {
+            perror("io_uring_enter");
+            exit(1);
+        }
+
+        unsigned head = *ring.cq_head;
+        unsigned tail = __atomic_load_n(ring.cq_tail, __ATOMIC_ACQUIRE);
+        while (head != tail)
+        {
+            struct io_uring_cqe cqe = ring.cqes[head & *ring.cq_mask];
+            head++;
+            // Free the CQ slot before handling; handlers may submit more
+            __atomic_store_n(ring.cq_head, head, __ATOMIC_RELEASE);
+            handle_cqe(listen_fd, &cqe);
+            if (head == tail)
+                tail = __atomic_load_n(ring.cq_tail, __ATOMIC_ACQUIRE);
+        }
+
+        cleanup_expired_connections(expire_connection);
+        if (accept_paused)
+            admit_connections(listen_fd);
+        // After the completions: a request already received counts as
+        // in progress even if the kernel consumed it from the socket
+        if (accept_stopped && drain_connections(expire_connection))
+            return 0;
+
+        time_t current_time = time(NULL);
+        if (current_time - last_stats_print >= STATS_INTERVAL)
+        {
+            print_connection_stats();
+            last_stats_print = current_time;
+        }
+    }
+}
@@ -0,0 +1,33 @@
+/**
+ * @file uring_loop.h
+ * @brief HTTP Server Core - io_uring Event Loop Interface
+ * @version 1.0.0
+ * @date 2025-06-07
+ * @author David Dev (@DavidDevGt)
+ * 
+ * @description
+ * Optional io_uring event backend, selected at startup with
+ * --backend io_uring. It drives the same client manager and HTTP handler
+ * as the epoll loop, but accepts, receives and sends through the ring.
+ * 
+ * @license MIT License
+ */
+
+#ifndef URING_LOOP_H
+#define URING_LOOP_H
+
+#define URING_ENTRIES 1024
+#define URING_RECV_BUF_COUNT 256  // power of two
+#define URING_RECV_BUF_SIZE 4096
+#define URING_RECV_BUF_GROUP 0
+#define URING_FILE_CHUNK (64 * 1024)
+#define URING_MAX_PENDING_RECV 8
+
+/**
+ * Run the io_uring loop on this thread.
+ * @return: -1 if io_uring (or a required feature) is unavailable;
+ *          otherwise it does not return
+ */
+int run_uring_loop(int listen_fd);
+
+#endif // URING_LOOP_H
@@ -0,0 +1,34 @@
+/**
+ * @file worker.h
+ * @brief HTTP Server Core - Worker Thread Interface
+ * @version 1.0.0
+ * @date 2025-06-07
+ * @author David Dev (@DavidDevGt)
+ * 
+ * @description
+ * Multi-core worker model. Each worker thread is pinned to a core and owns
+ * a SO_REUSEPORT listen socket, an event loop and a client table, so the
+ * kernel spreads accepts across workers and no locks are shared.
+ * 
+ * @license MIT License
+ */
+
+#ifndef WORKER_H
+#define WORKER_H
+
+#include <pthread.h>
+
+#define MAX_WORKERS 256
+
+typedef struct {
+    int id;
+    int cpu;
+    int listen_fd;
+    int tls_listen_fd;     // -1 without HTTPS
+    pthread_t thread;
+} worker_t;
+
+int resolve_worker_count(int requested);
+void run_workers(int count, int port, int tls_port);
+
+#endif // WORKER_H
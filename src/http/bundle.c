@@ -0,0 +1,182 @@
+/**
+ * @file bundle.c
+ * @brief HTTP Server - Packed Asset Bundle Implementation
+ * @version 1.0.0
+ * @date 2025-06-07
+ * @author David Dev (@DavidDevGt)
+ *
+ * @description
+ * The mapping is shared by all workers and never unmapped, so slices of it
+ * go on output queues without references. Every offset is checked once in
+ * bundle_open(); lookups trust the file afterwards.
+ *
+ * The packer writes a new bundle next to the old one and renames it into
+ * place, so a running server keeps reading the file it mapped. Truncating
+ * a mapped bundle in place would crash it (SIGBUS), as with any mmap.
+ *
+ * @license MIT License
+ */
+
+#define _GNU_SOURCE  // for MAP_POPULATE
+
+#include "bundle.h"
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// Written once by bundle_open(), before any worker starts
+static const char *base;
+static size_t mapped_size;
+static const bundle_header_t *header;
+static const uint32_t *slots;
+static const bundle_entry_t *entries;
+
+static int range_ok(uint64_t offset, uint64_t len, size_t size)
+{
+    return offset <= size && len <= size - offset;
+}
+
+static int string_ok(uint64_t offset, size_t size)
+{
+    return offset < size && memchr(base + offset, '\0', size - offset) != NULL;
+}
+
+/**
+ * Check every offset the server will follow.
+ * @return: 0 if the layout is sound, -1 otherwise
+ */
+static int validate(size_t size)
+{
+    if (memcmp(header->magic, BUNDLE_MAGIC, sizeof(header->magic)) != 0 ||
+        header->version != BUNDLE_VERSION || header->size != size)
+        return -1;
+
+    uint32_t slot_count = header->slot_count;
+    uint32_t count = header->entry_count;
+    if (slot_count == 0 || (slot_count & (slot_count - 1)) != 0 ||
+        count >= slot_count ||
+        header->slots % sizeof(uint32_t) != 0 ||
+        !range_ok(header->slots, (uint64_t)slot_count * sizeof(uint32_t), size) ||
+        header->entries % sizeof(uint64_t) != 0 ||
+        !range_ok(header->entries, (uint64_t)count * sizeof(bundle_entry_t), size))
+        return -1;
+
+    for (uint32_t i = 0; i < slot_count; i++)
+    {
+        if (slots[i] > count)
+            return -1;
+    }
+    for (uint32_t i = 0; i < count; i++)
+    {
+        const bundle_entry_t *e = &entries[i];
+        if (!string_ok(e->path, size) || strlen(base + e->path) != e->path_len ||
+            !string_ok(e->mime, size) || !string_ok(e->last_modified, size))
+            return -1;
+        for (int c = 0; c < ENCODING_COUNT; c++)
+        {
+            const bundle_variant_t *v = &e->variants[c];
+            if (v->head_len == 0 && c != ENCODING_IDENTITY)
+                continue;
+            if (v->head_len == 0 || !range_ok(v->head, v->head_len, size) ||
+                !range_ok(v->body, v->size, size) || !string_ok(v->etag, size))
+                return -1;
+        }
+    }
+    return 0;
+}
+
+int bundle_open(const char *path, bundle_preload_t preload)
+{
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        perror(path);
+        return -1;
+    }
+    struct stat st;
+    if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(bundle_header_t))
+    {
+        fprintf(stderr, "%s: truncated or unreadable bundle\n", path);
+        close(fd);
+        return -1;
+    }
+
+    int flags = MAP_PRIVATE;
+    if (preload != BUNDLE_PRELOAD_LAZY)
+        flags |= MAP_POPULATE;
+    void *map = mmap(NULL, st.st_size, PROT_READ, flags, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+    {
+        perror("mmap bundle");
+        return -1;
+    }
+
+    base = map;
+    mapped_size = st.st_size;
+    header = map;
+    slots = (const uint32_t *)(base + header->slots);
+    entries = (const bundle_entry_t *)(base + header->entries);
+    if (validate(mapped_size) < 0)
+    {
+        fprintf(stderr, "%s: not a bundle this server can read (rebuild with make bundle)\n", path);
+        munmap(map, st.st_size);
+        base = NULL;
+        header = NULL;
+        return -1;
+    }
+
+    // Readahead for the lazy case: the whole file is about to be served
+    if (preload == BUNDLE_PRELOAD_LAZY)
+        madvise(map, st.st_size, MADV_WILLNEED);
+    if (preload == BUNDLE_PRELOAD_LOCK && mlock(map, st.st_size) < 0)
+        perror("mlock bundle (continuing unlocked; check RLIMIT_MEMLOCK)");
+    return 0;
+}
+
+int bundle_loaded(void)
+{
+    return base != NULL;
+}
+
+const bundle_entry_t *bundle_lookup(const char *url_path)
+{
+    size_t len = strlen(url_path);
+    uint64_t hash = fnv1a(url_path, len);
+    uint32_t mask = header->slot_count - 1;
+    for (uint32_t i = (uint32_t)hash & mask;; i = (i + 1) & mask)
+    {
+        uint32_t index = slots[i];
+        if (index == 0)
+            return NULL;
+        const bundle_entry_t *entry = &entries[index - 1];
+        if (entry->path_hash == hash && entry->path_len == len &&
+            memcmp(base + entry->path, url_path, len) == 0)
+            return entry;
+    }
+}
+
+const char *bundle_at(uint64_t offset)
+{
+    return base + offset;
+}
+
+const bundle_variant_t *bundle_variant(const bundle_entry_t *entry,
+                                       content_encoding_t encoding)
+{
+    const bundle_variant_t *variant = &entry->variants[encoding];
+    return variant->head_len ? variant : NULL;
+}
+
+uint32_t bundle_entry_count(void)
+{
+    return header ? header->entry_count : 0;
+}
+
+size_t bundle_size(void)
+{
+    return mapped_size;
+}
@@ -0,0 +1,114 @@
+/**
+ * @file bundle.h
+ * @brief HTTP Server - Packed Asset Bundle Interface
+ * @version 1.0.0
+ * @date 2025-06-07
+ * @author David Dev (@DavidDevGt)
+ *
+ * @description
+ * A bundle is the document root packed into one file by tools/bundlegen.c
+ * (`make bundle`): every file with its MIME type, validators, gzip and br
+ * variants and the fixed part of its response head, behind an
+ * open-addressing table keyed by URL path. With --bundle the server maps
+ * it read-only at startup and answers static requests from the mapping:
+ * one hash probe, then the head and body go out as slices of the mapping,
+ * with no realpath(), open() or stat() and nothing compressed at run time.
+ *
+ * The bundle replaces the document root: paths it does not hold are 404s.
+ * It is fixed for the life of the process; deploy a new one by restarting
+ * or with a SIGUSR2 binary upgrade. Cache-Control, Connection and
+ * Keep-Alive stay out of the stored heads since they follow the reloadable
+ * settings; they are appended per response.
+ *
+ * The layout below is shared with the packer. Integers are in host byte
+ * order: a bundle is built for the machine that serves it.
+ *
+ * @license MIT License
+ */
+
+#ifndef BUNDLE_H
+#define BUNDLE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "compress.h"
+#include "fnv.h"
+
+#define BUNDLE_MAGIC "HTBUNDL1"
+#define BUNDLE_VERSION 1
+#define BUNDLE_ALIGN 64                     // start of every body
+
+typedef enum {
+    BUNDLE_PRELOAD_LAZY,        // fault pages in on first use
+    BUNDLE_PRELOAD_POPULATE,    // MAP_POPULATE: read everything at startup
+    BUNDLE_PRELOAD_LOCK         // populate and mlock() against eviction
+} bundle_preload_t;
+
+// Offsets are from the start of the file; strings are NUL-terminated
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t entry_count;
+    uint32_t slot_count;        // power of two, at least twice entry_count
+    uint32_t reserved;
+    uint64_t size;              // whole file
+    uint64_t slots;             // uint32_t[slot_count]: entry index + 1, 0 = empty
+    uint64_t entries;           // bundle_entry_t[entry_count]
+} bundle_header_t;
+
+typedef struct {
+    uint64_t body;
+    uint64_t size;              // 0 with head_len 0: coding not worth it
+    uint64_t etag;
+    uint64_t head;              // "HTTP/1.1 200 OK" up to Last-Modified
+    uint32_t head_len;
+    uint32_t reserved;
+} bundle_variant_t;
+
+typedef struct {
+    uint64_t path_hash;         // fnv1a() of the URL path
+    uint64_t path;              // URL path, "/index.html"
+    uint64_t mime;
+    uint64_t last_modified;
+    int64_t mtime;
+    uint32_t path_len;
+    uint32_t reserved;
+    bundle_variant_t variants[ENCODING_COUNT];
+} bundle_entry_t;
+
+/**
+ * Map and check the bundle. Startup only, before any worker runs.
+ * @return: 0 on success, -1 on error (reported on stderr)
+ */
+int bundle_open(const char *path, bundle_preload_t preload);
+
+/**
+ * Whether a bundle is serving; static files then never touch the disk.
+ */
+int bundle_loaded(void);
+
+/**
+ * Entry for a URL path.
+ * @return: the entry, or NULL if the bundle has no such file
+ */
+const bundle_entry_t *bundle_lookup(const char *url_path);
+
+/**
+ * Address of a string or body in the mapping.
+ */
+const char *bundle_at(uint64_t offset);
+
+/**
+ * Variant for a coding, or NULL if the packer left it out. Identity is
+ * always present.
+ */
+const bundle_variant_t *bundle_variant(const bundle_entry_t *entry,
+                                       content_encoding_t encoding);
+
+/**
+ * Files and bytes in the bundle, for the startup banner.
+ */
+uint32_t bundle_entry_count(void);
+size_t bundle_size(void);
+
+#endif // BUNDLE_H
@@ -0,0 +1,220 @@
+/**
+ * @file compress.c
+ * @brief HTTP Server - Content Encoding Implementation
+ * @version 1.0.0
+ * @date 2025-06-07
+ * @author David Dev (@DavidDevGt)
+ *
+ * @description
+ * gzip (zlib, gzip wrapper) and brotli one-shot compression plus the
+ * Accept-Encoding parser used to pick a coding per request.
+ *
+ * Features:
+ * - q-values honoured, including q=0 exclusions and the "*" wildcard
+ * - Only text-like MIME types are considered compressible
+ *
+ * @license MIT License
+ */
+
+#include "compress.h"
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>  // for strncasecmp
+#include <zlib.h>
+#include <brotli/encode.h>
+
+const char *encoding_name(content_encoding_t encoding)
+{
+    switch (encoding)
+    {
+    case ENCODING_GZIP:
+        return "gzip";
+    case ENCODING_BR:
+        return "br";
+    default:
+        return NULL;
+    }
+}
+
+const char *encoding_suffix(content_encoding_t encoding)
+{
+    switch (encoding)
+    {
+    case ENCODING_GZIP:
+        return ".gz";
+    case ENCODING_BR:
+        return ".br";
+    default:
+        return "";
+    }
+}
+
+static int has_suffix(const char *str, const char *suffix)
+{
+    size_t len = strlen(str), suffix_len = strlen(suffix);
+    return len >= suffix_len && strcmp(str + len - suffix_len, suffix) == 0;
+}
+
+int mime_is_compressible(const char *mime)
+{
+    // Structured syntax suffixes (RFC 6839): svg+xml, manifest+json, ...
+    return strncmp(mime, "text/", 5) == 0 ||
+           strcmp(mime, "application/javascript") == 0 ||
+           strcmp(mime, "application/json") == 0 ||
+           strcmp(mime, "application/wasm") == 0 ||
+           strcmp(mime, "application/vnd.ms-fontobject") == 0 ||
+           strcmp(mime, "font/ttf") == 0 ||
+           strcmp(mime, "font/otf") == 0 ||
+           strcmp(mime, "image/x-icon") == 0 ||
+           has_suffix(mime, "+xml") || has_suffix(mime, "+json");
+}
+
+static int token_is(const char *token, size_t len, const char *name)
+{
+    return strlen(name) == len && strncasecmp(token, name, len) == 0;
+}
+
+/**
+ * A q parameter of 0 (q=0, q=0.0, q=0.000) rules a coding out.
+ */
+static int q_is_zero(const char *params, size_t len)
+{
+    const char *end = params + len;
+    const char *p = params;
+    while (p < end)
+    {
+        while (p < end && (*p == ';' || *p == ' ' || *p == '\t'))
+            p++;
+        if (end - p >= 2 && (p[0] == 'q' || p[0] == 'Q') && p[1] == '=')
+        {
+            p += 2;
+            if (p >= end || *p != '0')
+                return 0;
+            for (p++; p < end && *p != ';'; p++)
+            {
+                if (*p != '.' && *p != '0' && *p != ' ' && *p != '\t')
+                    return 0;
+            }
+            return 1;
+        }
+        while (p < end && *p != ';')
+            p++;
+    }
+    return 0;
+}
+
+unsigned accepted_encodings(const http_request_t *req)
+{
+    unsigned accepted = 1u << ENCODING_IDENTITY;
+    const http_slice_t *header = http_get_header(req, HTTP_HDR_ACCEPT_ENCODING);
+    if (!header)
+        return accepted;
+
+    // -1 = not mentioned, 0 = refused, 1 = accepted
+    int explicit_state[ENCODING_COUNT] = { -1, -1, -1 };
+    int wildcard = -1;
+
+    const char *p = header->ptr;
+    const char *end = header->ptr + header->len;
+    while (p < end)
+    {
+        while (p < end && (*p == ',' || *p == ' ' || *p == '\t'))
+            p++;
+        const char *token = p;
+        while (p < end && *p != ',' && *p != ';' && *p != ' ' && *p != '\t')
+            p++;
+        size_t token_len = p - token;
+        const char *params = p;
+        while (p < end && *p != ',')
+            p++;
+        if (token_len == 0)
+            continue;
+
+        int state = q_is_zero(params, p - params) ? 0 : 1;
+        if (token_is(token, token_len, "gzip") || token_is(token, token_len, "x-gzip"))
+            explicit_state[ENCODING_GZIP] = state;
+        else if (token_is(token, token_len, "br"))
+            explicit_state[ENCODING_BR] = state;
+        else if (token_is(token, token_len, "*"))
+            wildcard = state;
+    }
+
+    for (int e = ENCODING_GZIP; e < ENCODING_COUNT; e++)
+    {
+        if (explicit_state[e] == 1 || (explicit_state[e] == -1 && wildcard == 1))
+            accepted |= 1u << e;
+    }
+    return accepted;
+}
+
+static int compress_gzip(const char *in, size_t len, char **out, size_t *out_len)
+{
+    z_stream zs;
+    memset(&zs, 0, sizeof(zs));
+    // windowBits 15 + 16 selects the gzip wrapper
+    if (deflateInit2(&zs, COMPRESS_GZIP_LEVEL, Z_DEFLATED, 15 + 16, 9,
+                     Z_DEFAULT_STRATEGY) != Z_OK)
+        return -1;
+
+    size_t bound = deflateBound(&zs, len);
+    char *buf = malloc(bound);
+    if (!buf)
+    {
+        deflateEnd(&zs);
+        return -1;
+    }
+
+    zs.next_in = (Bytef *)in;
+    zs.avail_in = (uInt)len;
+    zs.next_out = (Bytef *)buf;
+    zs.avail_out = (uInt)bound;
+    int rc = deflate(&zs, Z_FINISH);
+    size_t produced = zs.total_out;
+    deflateEnd(&zs);
+    if (rc != Z_STREAM_END)
+    {
+        free(buf);
+        return -1;
+    }
+
+    *out = buf;
+    *out_len = produced;
+    return 0;
+}
+
+static int compress_brotli(const char *in, size_t len, char **out, size_t *out_len)
+{
+    size_t bound = BrotliEncoderMaxCompressedSize(len);
+    if (bound == 0)
+        return -1;
+    char *buf = malloc(bound);
+    if (!buf)
+        return -1;
+
+    size_t produced = bound;
+    if (!BrotliEncoderCompress(COMPRESS_BROTLI_QUALITY, BROTLI_DEFAULT_WINDOW,
+                               BROTLI_MODE_TEXT, len, (const uint8_t *)in,
+                               &produced, (uint8_t *)buf))
+    {
+        free(buf);
+        return -1;
+    }
+
+    *out = buf;
+    *out_len = produced;
+    return 0;
+}
+
+int compress_buffer(content_encoding_t encoding, const char *in, size_t len,
+                    char **out, size_t *out_len)
+{
+    switch (encoding)
+    {
+    case ENCODING_GZIP:
+        return compress_gzip(in, len, out, out_len);
+    case ENCODING_BR:
+        return compress_brotli(in, len, out, out_len);
+    default:
+        return -1;
+    }
+}
@@ -0,0 +1,51 @@
+/**
+ * @file compress.h
+ * @brief HTTP Server - Content Encoding Interface
+ * @version 1.0.0
+ * @date 2025-06-07
+ * @author David Dev (@DavidDevGt)
+ *
+ * @description
+ * Content codings the server can produce (gzip via zlib, br via brotli),
+ * Accept-Encoding negotiation, and one-shot compression of a buffer.
+ * Compression is only ever run once per cached file and coding; the
+ * results live in the file cache.
+ *
+ * @license MIT License
+ */
+
+#ifndef COMPRESS_H
+#define COMPRESS_H
+
+#include <stddef.h>
+#include "http_parser.h"
+
+#define COMPRESS_MIN_SIZE 256      // smaller bodies are not worth a coding
+#define COMPRESS_GZIP_LEVEL 9
+#define COMPRESS_BROTLI_QUALITY 9
+
+typedef enum {
+    ENCODING_IDENTITY,
+    ENCODING_GZIP,
+    ENCODING_BR,
+    ENCODING_COUNT
+} content_encoding_t;
+
+const char *encoding_name(content_encoding_t encoding);
+const char *encoding_suffix(content_encoding_t encoding);
+int mime_is_compressible(const char *mime);
+
+/**
+ * Parse Accept-Encoding.
+ * @return: bitmask of acceptable codings, (1 << ENCODING_*)
+ */
+unsigned accepted_encodings(const http_request_t *req);
+
+/**
+ * Compress a buffer in one go.
+ * @return: 0 with a malloc'd result in *out, -1 on failure
+ */
+int compress_buffer(content_encoding_t encoding, const char *in, size_t len,
+                    char **out, size_t *out_len);
+
+#endif // COMPRESS_H
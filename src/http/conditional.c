@@ -0,0 +1,215 @@
+/**
+ * @file conditional.c
+ * @brief HTTP Server - Cache Validators and Conditional Requests Implementation
+ * @version 1.0.0
+ * @date 2025-06-07
+ * @author David Dev (@DavidDevGt)
+ *
+ * @description
+ * Validators are computed from data serve_file() already has from fstat():
+ * the ETag combines inode, size and mtime (plus the content coding, since a
+ * compressed body is a different representation), Last-Modified is the
+ * mtime. Both end up in the prebuilt heads of cached files.
+ *
+ * Features:
+ * - Strong ETags, weak comparison for If-None-Match (RFC 9110 13.1.2)
+ * - If-Modified-Since ignored when If-None-Match is present
+ * - If-Range with a strong ETag or an exact date
+ * - IMF-fixdate formatting and parsing
+ * - Cache-Control by longest URL prefix, set with --cache-control
+ *
+ * Rules are collected into a staging table and published in one step, so
+ * a SIGHUP reload swaps the whole set. Published tables are never freed:
+ * cached entries keep pointers to their values.
+ *
+ * @license MIT License
+ */
+
+#define _GNU_SOURCE  // for strptime, timegm and strdup
+
+#include "conditional.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+    char *prefix;
+    size_t prefix_len;
+    char *value;
+} cache_control_rule_t;
+
+typedef struct {
+    cache_control_rule_t rules[CACHE_CONTROL_MAX_RULES];
+    int count;
+} cache_control_table_t;
+
+static cache_control_table_t *staging;
+static cache_control_table_t *active;  // NULL until the first commit
+
+void format_etag(char *buf, size_t size, const struct stat *st, content_encoding_t encoding)
+{
+    const char *coding = encoding_name(encoding);
+    snprintf(buf, size, "\"%llx-%llx-%llx%s%s\"",
+             (unsigned long long)st->st_ino,
+             (unsigned long long)st->st_size,
+             (unsigned long long)st->st_mtime,
+             coding ? "-" : "", coding ? coding : "");
+}
+
+void format_http_date(char *buf, size_t size, time_t t)
+{
+    struct tm tm;
+    gmtime_r(&t, &tm);
+    strftime(buf, size, "%a, %d %b %Y %H:%M:%S GMT", &tm);
+}
+
+static int parse_http_date(const char *text, time_t *out)
+{
+    struct tm tm;
+    memset(&tm, 0, sizeof(tm));
+    const char *end = strptime(text, "%a, %d %b %Y %H:%M:%S GMT", &tm);
+    if (!end || *end != '\0')
+        return -1;
+    *out = timegm(&tm);
+    return 0;
+}
+
+/**
+ * Match one ETag against an If-None-Match list. Weak comparison: a W/
+ * prefix on either side is ignored.
+ */
+static int etag_list_matches(const http_slice_t *list, const char *etag)
+{
+    size_t etag_len = strlen(etag);
+    const char *p = list->ptr;
+    const char *end = list->ptr + list->len;
+
+    while (p < end)
+    {
+        while (p < end && (*p == ',' || *p == ' ' || *p == '\t'))
+            p++;
+        if (p < end && *p == '*')
+            return 1;
+        if (end - p >= 2 && p[0] == 'W' && p[1] == '/')
+            p += 2;
+
+        const char *tag = p;
+        if (p < end && *p == '"')
+        {
+            p++;
+            while (p < end && *p != '"')
+                p++;
+            if (p < end)
+                p++; // closing quote
+        }
+        size_t tag_len = p - tag;
+        if (tag_len == etag_len && memcmp(tag, etag, etag_len) == 0)
+            return 1;
+
+        while (p < end && *p != ',')
+            p++;
+    }
+    return 0;
+}
+
+int request_not_modified(const http_request_t *req, const char *etag, time_t mtime)
+{
+    const http_slice_t *if_none_match = http_get_header(req, HTTP_HDR_IF_NONE_MATCH);
+    if (if_none_match)
+        return etag_list_matches(if_none_match, etag);
+
+    const http_slice_t *if_modified_since = http_get_header(req, HTTP_HDR_IF_MODIFIED_SINCE);
+    if (!if_modified_since || if_modified_since->len >= HTTP_DATE_MAX)
+        return 0;
+
+    char text[HTTP_DATE_MAX];
+    memcpy(text, if_modified_since->ptr, if_modified_since->len);
+    text[if_modified_since->len] = '\0';
+
+    time_t since;
+    if (parse_http_date(text, &since) < 0)
+        return 0;
+    return mtime <= since;
+}
+
+int if_range_matches(const http_request_t *req, const char *etag, time_t mtime)
+{
+    const http_slice_t *if_range = http_get_header(req, HTTP_HDR_IF_RANGE);
+    if (!if_range)
+        return 1;
+
+    if (if_range->len > 0 && if_range->ptr[0] == '"')
+        return if_range->len == strlen(etag) && memcmp(if_range->ptr, etag, if_range->len) == 0;
+    if (if_range->len >= HTTP_DATE_MAX || (if_range->len > 1 && if_range->ptr[0] == 'W'))
+        return 0; // weak validators never qualify
+
+    char text[HTTP_DATE_MAX];
+    memcpy(text, if_range->ptr, if_range->len);
+    text[if_range->len] = '\0';
+
+    time_t date;
+    return parse_http_date(text, &date) == 0 && date == mtime;
+}
+
+int cache_control_add_rule(const char *spec)
+{
+    const char *eq = strchr(spec, '=');
+    if (!eq || eq == spec || spec[0] != '/' || eq[1] == '\0' ||
+        strlen(eq + 1) > CACHE_CONTROL_MAX_VALUE)
+        return -1;
+    if (!staging || staging->count == CACHE_CONTROL_MAX_RULES)
+        return -1;
+
+    cache_control_rule_t *rule = &staging->rules[staging->count];
+    rule->prefix_len = eq - spec;
+    rule->prefix = strndup(spec, rule->prefix_len);
+    rule->value = strdup(eq + 1);
+    if (!rule->prefix || !rule->value)
+    {
+        free(rule->prefix);
+        free(rule->value);
+        return -1;
+    }
+    staging->count++;
+    return 0;
+}
+
+void cache_control_begin(void)
+{
+    cache_control_discard();
+    staging = calloc(1, sizeof(*staging));
+}
+
+void cache_control_commit(void)
+{
+    if (staging)
+        __atomic_store_n(&active, staging, __ATOMIC_RELEASE);
+    staging = NULL;
+}
+
+void cache_control_discard(void)
+{
+    if (!staging)
+        return;
+    for (int i = 0; i < staging->count; i++)
+    {
+        free(staging->rules[i].prefix);
+        free(staging->rules[i].value);
+    }
+    free(staging);
+    staging = NULL;
+}
+
+const char *cache_control_for(const char *url_path)
+{
+    const cache_control_table_t *table = __atomic_load_n(&active, __ATOMIC_ACQUIRE);
+    const cache_control_rule_t *best = NULL;
+    for (int i = 0; table && i < table->count; i++)
+    {
+        const cache_control_rule_t *rule = &table->rules[i];
+        if (strncmp(url_path, rule->prefix, rule->prefix_len) == 0 &&
+            (!best || rule->prefix_len > best->prefix_len))
+            best = rule;
+    }
+    return best ? best->value : CACHE_CONTROL_DEFAULT;
+}
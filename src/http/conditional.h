@@ -0,0 +1,58 @@
+/**
+ * @file conditional.h
+ * @brief HTTP Server - Cache Validators and Conditional Requests Interface
+ * @version 1.0.0
+ * @date 2025-06-07
+ * @author David Dev (@DavidDevGt)
+ *
+ * @description
+ * ETag and Last-Modified validators derived from a file's stat data,
+ * If-None-Match / If-Modified-Since evaluation, and Cache-Control values
+ * chosen by longest matching URL path prefix.
+ *
+ * @license MIT License
+ */
+
+#ifndef CONDITIONAL_H
+#define CONDITIONAL_H
+
+#include <stddef.h>
+#include <time.h>
+#include <sys/stat.h>
+#include "http_parser.h"
+#include "compress.h"
+
+#define ETAG_MAX 64
+#define HTTP_DATE_MAX 32
+#define CACHE_CONTROL_MAX_RULES 32
+#define CACHE_CONTROL_MAX_VALUE 256
+#define CACHE_CONTROL_DEFAULT "no-cache"  // always revalidate, 304 when unchanged
+
+void format_etag(char *buf, size_t size, const struct stat *st, content_encoding_t encoding);
+void format_http_date(char *buf, size_t size, time_t t);
+
+/**
+ * Evaluate If-None-Match, then (only without it) If-Modified-Since.
+ * @return: 1 if the client's copy is current and a 304 should be sent
+ */
+int request_not_modified(const http_request_t *req, const char *etag, time_t mtime);
+
+/**
+ * Evaluate If-Range: a strong ETag must match exactly, a date must equal
+ * the modification time. Without the header ranges always apply.
+ * @return: 1 if the Range header should be honoured
+ */
+int if_range_matches(const http_request_t *req, const char *etag, time_t mtime);
+
+/**
+ * Add a Cache-Control rule to the table started by cache_control_begin();
+ * it takes effect with cache_control_commit(). The longest prefix wins.
+ * @return: 0 on success, -1 if the table is full or the spec is malformed
+ */
+int cache_control_add_rule(const char *spec);  // "PREFIX=VALUE"
+void cache_control_begin(void);
+void cache_control_commit(void);
+void cache_control_discard(void);
+const char *cache_control_for(const char *url_path);
+
+#endif // CONDITIONAL_H
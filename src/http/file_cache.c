@@ -0,0 +1,391 @@
+/**
+ * @file file_cache.c
+ * @brief HTTP Server - Static Asset Cache Implementation
+ * @version 1.0.0
+ * @date 2025-06-07
+ * @author David Dev (@DavidDevGt)
+ * 
+ * @description
+ * Per-worker hash table of cached static files with an LRU list for
+ * eviction. Entries are reference counted: a response that is still being
+ * written keeps its entry alive even if the entry is evicted or found stale
+ * in the meantime.
+ * 
+ * Compressed variants are filled in lazily and charged to the budget when
+ * they are created; a variant that turns out no smaller than the original
+ * is remembered as unavailable so the work is never repeated.
+ * 
+ * Large bodies are mmap'd instead of copied. If such a file is truncated
+ * while mapped, touching the lost pages raises SIGBUS; the mtime/size check
+ * narrows that window to FILE_CACHE_VALIDATE_INTERVAL.
+ * 
+ * @license MIT License
+ */
+
+#define _GNU_SOURCE  // for strdup
+
+#include "file_cache.h"
+#include "http_handler.h"
+#include "fnv.h"
+#include "../core/config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+static size_t cache_budget = FILE_CACHE_DEFAULT_BUDGET;
+
+static __thread file_cache_entry_t *buckets[FILE_CACHE_BUCKETS];
+static __thread lru_list_t lru;
+static __thread size_t cache_used;
+
+void file_cache_set_budget(size_t bytes)
+{
+    cache_budget = bytes;
+}
+
+static unsigned int hash_path(const char *path)
+{
+    return fnv1a_str(path) % FILE_CACHE_BUCKETS;
+}
+
+/**
+ * Least recently used entry, the next to evict; NULL when empty.
+ */
+static file_cache_entry_t *lru_oldest(void)
+{
+    return lru.tail ? LRU_ENTRY(lru.tail, file_cache_entry_t, lru) : NULL;
+}
+
+static void free_variant(file_variant_t *variant)
+{
+    if (variant->body)
+    {
+        if (variant->body_mapped)
+            munmap(variant->body, variant->size);
+        else
+            free(variant->body);
+    }
+    free(variant->head[0]);
+    free(variant->head[1]);
+    // The ETag stays; load_precompressed() resets a sibling's itself
+    variant->state = VARIANT_UNTRIED;
+    variant->body = NULL;
+    variant->size = 0;
+    variant->body_mapped = 0;
+    variant->head[0] = variant->head[1] = NULL;
+    variant->head_len[0] = variant->head_len[1] = 0;
+}
+
+static void free_entry(file_cache_entry_t *entry)
+{
+    for (int e = 0; e < ENCODING_COUNT; e++)
+        free_variant(&entry->variants[e]);
+    free(entry->url_path);
+    free(entry->resolved_path);
+    free(entry);
+}
+
+/**
+ * Remove an entry from the table and LRU list and drop the cache's own
+ * reference. Responses still holding it keep the memory alive.
+ */
+static void detach_entry(file_cache_entry_t *entry)
+{
+    file_cache_entry_t **link = &buckets[hash_path(entry->url_path)];
+    while (*link && *link != entry)
+        link = &(*link)->hash_next;
+    if (*link)
+        *link = entry->hash_next;
+    lru_unlink(&lru, &entry->lru);
+    cache_used -= entry->cost;
+    entry->detached = 1;
+    file_cache_release(entry);
+}
+
+/**
+ * Whether main.js.gz / main.js.br is still what load_precompressed() saw,
+ * including still missing.
+ */
+static int siblings_unchanged(const file_cache_entry_t *entry)
+{
+    for (int e = ENCODING_GZIP; e < ENCODING_COUNT; e++)
+    {
+        const file_variant_t *variant = &entry->variants[e];
+        char path[1024];
+        int n = snprintf(path, sizeof(path), "%s%s", entry->resolved_path, encoding_suffix(e));
+        if (n < 0 || (size_t)n >= sizeof(path))
+            continue;
+        struct stat st;
+        if (stat(path, &st) < 0)
+        {
+            if (variant->sibling_inode != 0)
+                return 0;
+            continue;
+        }
+        if (st.st_ino != variant->sibling_inode ||
+            st.st_mtime != variant->sibling_mtime ||
+            st.st_size != variant->sibling_size)
+            return 0;
+    }
+    return 1;
+}
+
+static int is_fresh(file_cache_entry_t *entry, time_t now)
+{
+    if (entry->generation != config_current()->generation)
+        return 0;
+    if (now - entry->validated_at < FILE_CACHE_VALIDATE_INTERVAL)
+        return 1;
+
+    struct stat st;
+    if (stat(entry->resolved_path, &st) < 0 ||
+        st.st_mtime != entry->mtime ||
+        st.st_size != entry->size ||
+        st.st_ino != entry->inode ||
+        !siblings_unchanged(entry))
+        return 0;
+
+    entry->validated_at = now;
+    return 1;
+}
+
+file_cache_entry_t *file_cache_lookup(const char *url_path)
+{
+    file_cache_entry_t *entry = buckets[hash_path(url_path)];
+    while (entry && strcmp(entry->url_path, url_path) != 0)
+        entry = entry->hash_next;
+    if (!entry)
+        return NULL;
+
+    if (!is_fresh(entry, time(NULL)))
+    {
+        detach_entry(entry);
+        return NULL;
+    }
+
+    lru_unlink(&lru, &entry->lru);
+    lru_push_front(&lru, &entry->lru);
+    entry->refcount++;
+    return entry;
+}
+
+static int load_body(file_variant_t *variant, int file_fd, size_t size)
+{
+    variant->size = size;
+    if (size == 0)
+        return 0;
+
+    if (size >= FILE_CACHE_MMAP_THRESHOLD)
+    {
+        void *map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, file_fd, 0);
+        if (map == MAP_FAILED)
+            return -1;
+        variant->body = map;
+        variant->body_mapped = 1;
+        return 0;
+    }
+
+    variant->body = malloc(size);
+    if (!variant->body)
+        return -1;
+
+    size_t done = 0;
+    while (done < size)
+    {
+        ssize_t n = pread(file_fd, variant->body + done, size - done, done);
+        if (n <= 0)
+            return -1;
+        done += n;
+    }
+    return 0;
+}
+
+static int build_heads(file_cache_entry_t *entry, content_encoding_t encoding)
+{
+    file_variant_t *variant = &entry->variants[encoding];
+    file_head_t info = {
+        .content_length = variant->size,
+        .mime = entry->mime,
+        .encoding = encoding_name(encoding),
+        .etag = variant->etag,
+        .last_modified = entry->last_modified,
+        .cache_control = entry->cache_control
+    };
+    char head[FILE_HEAD_MAX];
+    for (int keep_alive = 0; keep_alive <= 1; keep_alive++)
+    {
+        int len = format_file_head(head, sizeof(head), &info, keep_alive);
+        if (len < 0)
+            return -1;
+        variant->head[keep_alive] = malloc(len);
+        if (!variant->head[keep_alive])
+            return -1;
+        memcpy(variant->head[keep_alive], head, len);
+        variant->head_len[keep_alive] = len;
+    }
+    return 0;
+}
+
+static size_t variant_cost(const file_variant_t *variant)
+{
+    return variant->size + variant->head_len[0] + variant->head_len[1];
+}
+
+int file_open_precompressed(const char *resolved_path, content_encoding_t encoding,
+                            const struct stat *original, struct stat *st)
+{
+    char path[1024];
+    int n = snprintf(path, sizeof(path), "%s%s", resolved_path, encoding_suffix(encoding));
+    if (n < 0 || (size_t)n >= sizeof(path))
+        return -1;
+
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return -1;
+
+    // A sibling older than the file it was made from is stale
+    if (fstat(fd, st) < 0 || !S_ISREG(st->st_mode) || st->st_mtime < original->st_mtime)
+    {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/**
+ * Pick up main.js.gz / main.js.br next to the file, if present and fresh.
+ */
+static void load_precompressed(file_cache_entry_t *entry, const struct stat *original)
+{
+    for (int e = ENCODING_GZIP; e < ENCODING_COUNT; e++)
+    {
+        file_variant_t *variant = &entry->variants[e];
+        struct stat st;
+        st.st_ino = 0;
+        int fd = file_open_precompressed(entry->resolved_path, e, original, &st);
+        // Remembered even when stale or unusable, so a change shows up
+        variant->sibling_inode = st.st_ino;
+        variant->sibling_mtime = st.st_ino ? st.st_mtime : 0;
+        variant->sibling_size = st.st_ino ? st.st_size : 0;
+        if (fd < 0)
+            continue;
+
+        // Validated by its own stat: regenerating the sibling changes the
+        // ETag even when the file it was made from did not change
+        format_etag(variant->etag, ETAG_MAX, &st, e);
+        if (st.st_size <= FILE_CACHE_MAX_ENTRY_SIZE &&
+            load_body(variant, fd, st.st_size) == 0 && build_heads(entry, e) == 0)
+        {
+            variant->state = VARIANT_READY;
+        }
+        else
+        {
+            free_variant(variant);
+            format_etag(variant->etag, ETAG_MAX, original, e); // compressed on demand
+        }
+        close(fd);
+    }
+}
+
+file_cache_entry_t *file_cache_insert(const char *url_path, const char *resolved_path,
+                                      int file_fd, const struct stat *st, const char *mime)
+{
+    if (st->st_size > FILE_CACHE_MAX_ENTRY_SIZE || (size_t)st->st_size > cache_budget)
+        return NULL;
+
+    file_cache_entry_t *entry = calloc(1, sizeof(*entry));
+    if (!entry)
+        return NULL;
+
+    entry->url_path = strdup(url_path);
+    entry->resolved_path = strdup(resolved_path);
+    entry->mtime = st->st_mtime;
+    entry->size = st->st_size;
+    entry->inode = st->st_ino;
+    entry->mime = mime;
+    // Generation first: a reload in between then only makes the entry stale
+    entry->generation = config_current()->generation;
+    entry->cache_control = cache_control_for(url_path);
+    format_http_date(entry->last_modified, sizeof(entry->last_modified), st->st_mtime);
+    for (int e = 0; e < ENCODING_COUNT; e++)
+        format_etag(entry->variants[e].etag, ETAG_MAX, st, e);
+    entry->validated_at = time(NULL);
+    entry->refcount = 1;
+
+    file_variant_t *identity = &entry->variants[ENCODING_IDENTITY];
+    if (!entry->url_path || !entry->resolved_path ||
+        load_body(identity, file_fd, st->st_size) < 0 ||
+        build_heads(entry, ENCODING_IDENTITY) < 0)
+    {
+        free_entry(entry);
+        return NULL;
+    }
+    identity->state = VARIANT_READY;
+    load_precompressed(entry, st);
+
+    entry->cost = sizeof(*entry);
+    for (int e = 0; e < ENCODING_COUNT; e++)
+        entry->cost += variant_cost(&entry->variants[e]);
+
+    // Make room, least recently used first
+    while (lru.tail && cache_used + entry->cost > cache_budget)
+        detach_entry(lru_oldest());
+
+    unsigned int bucket = hash_path(url_path);
+    entry->hash_next = buckets[bucket];
+    buckets[bucket] = entry;
+    lru_push_front(&lru, &entry->lru);
+    cache_used += entry->cost;
+
+    entry->refcount++; // reference handed to the caller
+    return entry;
+}
+
+file_variant_t *file_cache_variant(file_cache_entry_t *entry, content_encoding_t encoding)
+{
+    file_variant_t *variant = &entry->variants[encoding];
+    if (variant->state != VARIANT_UNTRIED)
+        return variant->state == VARIANT_READY ? variant : NULL;
+
+    // First request for this coding: compress once, keep the result
+    file_variant_t *identity = &entry->variants[ENCODING_IDENTITY];
+    variant->state = VARIANT_NONE;
+    if (!mime_is_compressible(entry->mime) || identity->size < COMPRESS_MIN_SIZE)
+        return NULL;
+    if (compress_buffer(encoding, identity->body, identity->size,
+                        &variant->body, &variant->size) < 0 ||
+        variant->size >= identity->size ||
+        build_heads(entry, encoding) < 0)
+    {
+        free_variant(variant);
+        variant->state = VARIANT_NONE;
+        return NULL;
+    }
+    variant->state = VARIANT_READY;
+
+    size_t cost = variant_cost(variant);
+    entry->cost += cost;
+    if (!entry->detached)
+    {
+        cache_used += cost;
+        // Make room, but never evict the entry being served
+        while (lru.tail && lru.tail != &entry->lru && cache_used > cache_budget)
+            detach_entry(lru_oldest());
+    }
+    return variant;
+}
+
+void file_cache_retain(file_cache_entry_t *entry)
+{
+    entry->refcount++;
+}
+
+void file_cache_release(file_cache_entry_t *entry)
+{
+    if (--entry->refcount == 0 && entry->detached)
+        free_entry(entry);
+}
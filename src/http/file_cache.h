@@ -0,0 +1,96 @@
+/**
+ * @file file_cache.h
+ * @brief HTTP Server - Static Asset Cache Interface
+ * @version 1.0.0
+ * @date 2025-06-07
+ * @author David Dev (@DavidDevGt)
+ * 
+ * @description
+ * In-memory cache of static files keyed by URL path. Each entry keeps the
+ * resolved path, stat data, MIME type, ready-made response heads and the
+ * body (heap copy, or an mmap'd region for larger files), so a hot request
+ * becomes a single writev() without touching the filesystem.
+ * 
+ * Every entry holds one variant per content coding. gzip/br variants come
+ * from precompressed siblings (main.js.br, main.js.gz) when present and
+ * at least as new as the file; otherwise they are compressed on first
+ * request. Variants live inside the entry and are dropped together with
+ * it; revalidation also checks each sibling's mtime/size/inode (or its
+ * absence), so redeploying only main.js.br takes effect as well.
+ * 
+ * Entries are revalidated against the file's mtime/size/inode at most once
+ * per FILE_CACHE_VALIDATE_INTERVAL seconds and evicted in LRU order once
+ * the memory budget is exceeded. Each worker thread owns its own cache.
+ * A configuration reload makes every entry stale, since the prebuilt heads
+ * carry Cache-Control and keep-alive settings.
+ * 
+ * @license MIT License
+ */
+
+#ifndef FILE_CACHE_H
+#define FILE_CACHE_H
+
+#include <stddef.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include "compress.h"
+#include "conditional.h"
+#include "lru.h"
+
+#define FILE_CACHE_DEFAULT_BUDGET (16 * 1024 * 1024)
+#define FILE_CACHE_MAX_ENTRY_SIZE (1024 * 1024)
+#define FILE_CACHE_MMAP_THRESHOLD (64 * 1024)
+#define FILE_CACHE_VALIDATE_INTERVAL 1
+#define FILE_CACHE_BUCKETS 256
+
+typedef enum {
+    VARIANT_UNTRIED,          // compressed on first request
+    VARIANT_READY,
+    VARIANT_NONE              // unavailable or not smaller than the original
+} variant_state_t;
+
+typedef struct {
+    variant_state_t state;
+    char *body;
+    size_t size;
+    int body_mapped;          // body is an mmap'd region, not heap
+    char etag[ETAG_MAX];      // differs per coding
+    char *head[2];            // response head, indexed by keep_alive
+    size_t head_len[2];
+    // Precompressed sibling as last seen, used or not; inode 0 = none
+    time_t sibling_mtime;
+    off_t sibling_size;
+    ino_t sibling_inode;
+} file_variant_t;
+
+typedef struct file_cache_entry {
+    char *url_path;
+    char *resolved_path;
+    time_t mtime;
+    off_t size;
+    ino_t inode;
+    const char *mime;
+    const char *cache_control;
+    char last_modified[HTTP_DATE_MAX];
+    file_variant_t variants[ENCODING_COUNT];  // indexed by content_encoding_t
+    time_t validated_at;
+    unsigned generation;      // configuration the heads were built with
+    size_t cost;              // bytes charged against the budget
+    int refcount;             // cache's own reference plus in-flight sends
+    int detached;             // evicted/stale, freed at refcount 0
+    struct file_cache_entry *hash_next;
+    lru_link_t lru;
+} file_cache_entry_t;
+
+void file_cache_set_budget(size_t bytes);
+file_cache_entry_t *file_cache_lookup(const char *url_path);
+file_cache_entry_t *file_cache_insert(const char *url_path, const char *resolved_path,
+                                      int file_fd, const struct stat *st, const char *mime);
+file_variant_t *file_cache_variant(file_cache_entry_t *entry, content_encoding_t encoding);
+void file_cache_retain(file_cache_entry_t *entry);
+void file_cache_release(file_cache_entry_t *entry);
+int file_open_precompressed(const char *resolved_path, content_encoding_t encoding,
+                            const struct stat *original, struct stat *st);
+
+#endif // FILE_CACHE_H
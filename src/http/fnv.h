@@ -0,0 +1,49 @@
+/**
+ * @file fnv.h
+ * @brief HTTP Server - FNV-1a Hashing
+ * @version 1.0.0
+ * @date 2025-06-07
+ * @author David Dev (@DavidDevGt)
+ *
+ * @description
+ * The one string hash of the server: 64-bit FNV-1a, for the route table,
+ * the MIME table, the file caches and bundles. It consumes one byte at a
+ * time, so callers that fold case or want every prefix hash can drive
+ * fnv1a_step() themselves. The build-time generators use the same
+ * functions, so tables made at build time match lookups at run time.
+ *
+ * @license MIT License
+ */
+
+#ifndef FNV_H
+#define FNV_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define FNV_OFFSET 0xcbf29ce484222325ULL
+#define FNV_PRIME 0x100000001b3ULL
+
+static inline uint64_t fnv1a_step(uint64_t hash, unsigned char c)
+{
+    return (hash ^ c) * FNV_PRIME;
+}
+
+static inline uint64_t fnv1a(const void *data, size_t len)
+{
+    const unsigned char *p = data;
+    uint64_t hash = FNV_OFFSET;
+    for (size_t i = 0; i < len; i++)
+        hash = fnv1a_step(hash, p[i]);
+    return hash;
+}
+
+static inline uint64_t fnv1a_str(const char *str)
+{
+    uint64_t hash = FNV_OFFSET;
+    while (*str)
+        hash = fnv1a_step(hash, (unsigned char)*str++);
+    return hash;
+}
+
+#endif // FNV_H
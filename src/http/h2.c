@@ -0,0 +1,1298 @@
+/**
+ * @file h2.c
+ * @brief HTTP Server - HTTP/2 Connection Implementation
+ * @version 1.0.0
+ * @date 2025-06-07
+ * @author David Dev (@DavidDevGt)
+ *
+ * @description
+ * A stream is answered as soon as its HEADERS arrive. The HTTP/1.1
+ * response that process_request() writes is caught in a per-worker
+ * capture queue: its head becomes an HPACK-encoded HEADERS frame right
+ * away, its body chunks move to the stream with their references. DATA
+ * frames are then cut from those chunks in turn, one frame per stream and
+ * round, as far as the connection and stream windows allow. Cached bodies
+ * and open files go out by reference as before, a frame header in the
+ * arena followed by a slice of the body, so sendfile() still does the
+ * copying for large files.
+ *
+ * A slice that is not the last of its chunk borrows the memory; the last
+ * one carries the chunk's reference, and the queue sends them in order.
+ * A stream reset while borrowed slices are still queued is kept on a
+ * closing list until the output queue has drained.
+ *
+ * Request bodies are not read: DATA frames are skipped as they arrive
+ * and their bytes handed straight back to the connection window. A
+ * request that has one gets 400, as over HTTP/1.1.
+ *
+ * Server push, priorities and trailers are not supported; PRIORITY
+ * frames are ignored. Proxy routes answer RST_STREAM(HTTP_1_1_REQUIRED),
+ * so clients retry them over HTTP/1.1, where the relay works.
+ *
+ * @license MIT License
+ */
+
+#define _GNU_SOURCE  // for memmem
+
+#include "h2.h"
+#include "hpack.h"
+#include "http_handler.h"
+#include "output_queue.h"
+#include "../core/access_log.h"
+#include "../core/config.h"
+#include "../core/lifecycle.h"
+#include "../core/metrics.h"
+#include "../core/pool.h"
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+#define H2_PREFACE "PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n"
+#define H2_PREFACE_LEN (sizeof(H2_PREFACE) - 1)
+#define FRAME_HEADER_LEN 9
+#define DEFAULT_WINDOW 65535
+#define MAX_WINDOW 0x7fffffff
+#define INLINE_FRAME_MAX 1024       // body bytes per frame copied into the arena
+#define UPGRADE_SETTINGS_MAX 64     // decoded HTTP2-Settings bytes
+
+// Frame types
+#define FRAME_DATA 0x0
+#define FRAME_HEADERS 0x1
+#define FRAME_PRIORITY 0x2
+#define FRAME_RST_STREAM 0x3
+#define FRAME_SETTINGS 0x4
+#define FRAME_PUSH_PROMISE 0x5
+#define FRAME_PING 0x6
+#define FRAME_GOAWAY 0x7
+#define FRAME_WINDOW_UPDATE 0x8
+#define FRAME_CONTINUATION 0x9
+
+// Frame flags
+#define FLAG_END_STREAM 0x1
+#define FLAG_ACK 0x1
+#define FLAG_END_HEADERS 0x4
+#define FLAG_PADDED 0x8
+#define FLAG_PRIORITY 0x20
+
+// Error codes
+#define ERR_NO_ERROR 0x0
+#define ERR_PROTOCOL 0x1
+#define ERR_INTERNAL 0x2
+#define ERR_FLOW_CONTROL 0x3
+#define ERR_FRAME_SIZE 0x6
+#define ERR_REFUSED_STREAM 0x7
+#define ERR_COMPRESSION 0x9
+#define ERR_ENHANCE_YOUR_CALM 0xb
+#define ERR_HTTP_1_1_REQUIRED 0xd
+
+// Settings
+#define SETTINGS_HEADER_TABLE_SIZE 0x1
+#define SETTINGS_ENABLE_PUSH 0x2
+#define SETTINGS_MAX_CONCURRENT_STREAMS 0x3
+#define SETTINGS_INITIAL_WINDOW_SIZE 0x4
+#define SETTINGS_MAX_FRAME_SIZE 0x5
+#define SETTINGS_MAX_HEADER_LIST_SIZE 0x6
+
+typedef enum {
+    PHASE_PREFACE,              // waiting for the client preface
+    PHASE_SETTINGS,             // its first frame must be SETTINGS
+    PHASE_OPEN
+} h2_phase_t;
+
+typedef struct h2_stream {
+    uint32_t id;
+    int64_t window;             // send window; a SETTINGS change can make it negative
+    int rst_after;              // the client is still sending a body: reset once answered
+    int done;                   // END_STREAM queued
+    int count;                  // body chunks
+    int next;                   // first chunk not completely framed yet
+    size_t alloc_size;
+    struct h2_stream *next_closing;
+    out_chunk_t chunks[];       // then the body bytes copied out of the capture arena
+} h2_stream_t;
+
+typedef struct {
+    h2_phase_t phase;
+    uint32_t last_stream_id;    // highest stream the client opened
+    int64_t send_window;        // connection level
+    uint32_t peer_initial_window;
+    uint32_t peer_max_frame;
+    int size_update_pending;    // encoder table resized; say so in the next block
+    size_t discard;             // payload bytes of a skipped frame still to come
+    int goaway_sent;
+    int peer_goaway;
+    int stream_count;
+    int next_turn;              // round-robin position in streams[]
+    h2_stream_t *streams[H2_MAX_STREAMS];  // streams with response data left
+    h2_stream_t *closing;       // reset streams the output queue may borrow from
+    hpack_table_t decoder;
+    hpack_table_t encoder;
+} h2_conn_t;
+
+// process_request() writes its HTTP/1.1 response here to be turned into
+// frames; one per worker, as every stream is answered on the spot
+static __thread output_queue_t capture;
+static __thread char header_scratch[H2_HEADER_LIST_MAX];
+
+static void put_u32(uint8_t *p, uint32_t v)
+{
+    p[0] = (uint8_t)(v >> 24);
+    p[1] = (uint8_t)(v >> 16);
+    p[2] = (uint8_t)(v >> 8);
+    p[3] = (uint8_t)v;
+}
+
+static uint32_t get_u32(const uint8_t *p)
+{
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+static size_t frame_length(const uint8_t *frame)
+{
+    return ((size_t)frame[0] << 16) | ((size_t)frame[1] << 8) | frame[2];
+}
+
+static void frame_header(uint8_t *h, size_t len, uint8_t type, uint8_t flags, uint32_t id)
+{
+    h[0] = (uint8_t)(len >> 16);
+    h[1] = (uint8_t)(len >> 8);
+    h[2] = (uint8_t)len;
+    h[3] = type;
+    h[4] = flags;
+    put_u32(h + 5, id);
+}
+
+static int name_is(const char *name, size_t len, const char *str)
+{
+    return strlen(str) == len && memcmp(name, str, len) == 0;
+}
+
+/**
+ * Header fields that describe the HTTP/1.1 connection; HTTP/2 has none.
+ */
+static int connection_specific(const char *name, size_t len)
+{
+    return name_is(name, len, "connection") || name_is(name, len, "keep-alive") ||
+           name_is(name, len, "proxy-connection") || name_is(name, len, "transfer-encoding") ||
+           name_is(name, len, "upgrade");
+}
+
+/**
+ * Queue a small frame, payload copied into the arena.
+ */
+static int queue_frame(client_info_t *client, uint8_t type, uint8_t flags, uint32_t id,
+                       const void *payload, size_t len)
+{
+    uint8_t frame[FRAME_HEADER_LEN + 32];
+    frame_header(frame, len, type, flags, id);
+    if (len)
+        memcpy(frame + FRAME_HEADER_LEN, payload, len);
+    if (outq_write(&client->out, frame, FRAME_HEADER_LEN + len) < 0)
+    {
+        // Not even room for a control frame: the peer is not reading
+        client->close_after_send = 1;
+        return -1;
+    }
+    return 0;
+}
+
+static void send_rst(client_info_t *client, uint32_t id, uint32_t code)
+{
+    uint8_t payload[4];
+    put_u32(payload, code);
+    queue_frame(client, FRAME_RST_STREAM, 0, id, payload, sizeof(payload));
+}
+
+static void send_goaway(client_info_t *client, h2_conn_t *h2, uint32_t code)
+{
+    uint8_t payload[8];
+    put_u32(payload, h2->last_stream_id);
+    put_u32(payload + 4, code);
+    queue_frame(client, FRAME_GOAWAY, 0, 0, payload, sizeof(payload));
+    h2->goaway_sent = 1;
+}
+
+static void send_settings(client_info_t *client)
+{
+    uint8_t payload[12];
+    payload[0] = 0;
+    payload[1] = SETTINGS_MAX_CONCURRENT_STREAMS;
+    put_u32(payload + 2, H2_MAX_STREAMS);
+    payload[6] = 0;
+    payload[7] = SETTINGS_MAX_HEADER_LIST_SIZE;
+    put_u32(payload + 8, H2_HEADER_LIST_MAX);
+    queue_frame(client, FRAME_SETTINGS, 0, 0, payload, sizeof(payload));
+}
+
+/**
+ * Shutting down, or max-requests reached: the streams already open
+ * finish, new ones are not taken.
+ */
+static int should_go_away(const client_info_t *client)
+{
+    return lifecycle_draining() || client->request_count >= config_current()->max_requests;
+}
+
+/**
+ * Tell the peer why the connection ends and close it once that is sent.
+ */
+static void connection_error(client_info_t *client, h2_conn_t *h2, uint32_t code,
+                             const char *what)
+{
+    if (log_verbose)
+        printf("HTTP/2 error on fd=%d: %s (code %u)\n", client->fd, what, code);
+    send_goaway(client, h2, code);
+    client->close_after_send = 1;
+}
+
+static void free_stream(h2_stream_t *stream)
+{
+    for (int i = stream->next; i < stream->count; i++)
+        outq_chunk_release(&stream->chunks[i]);
+    pool_free(stream, stream->alloc_size);
+}
+
+static void release_closing(h2_conn_t *h2)
+{
+    while (h2->closing)
+    {
+        h2_stream_t *stream = h2->closing;
+        h2->closing = stream->next_closing;
+        free_stream(stream);
+    }
+}
+
+static int find_stream(const h2_conn_t *h2, uint32_t id)
+{
+    for (int i = 0; i < h2->stream_count; i++)
+    {
+        if (h2->streams[i]->id == id)
+            return i;
+    }
+    return -1;
+}
+
+static void remove_stream(h2_conn_t *h2, int index)
+{
+    h2->stream_count--;
+    memmove(&h2->streams[index], &h2->streams[index + 1],
+            (h2->stream_count - index) * sizeof(h2->streams[0]));
+}
+
+/**
+ * Stop sending a stream's body. Frames already queued may borrow from
+ * its chunks, so those are only released once the queue has drained.
+ */
+static void abort_stream(client_info_t *client, h2_conn_t *h2, int index)
+{
+    h2_stream_t *stream = h2->streams[index];
+    remove_stream(h2, index);
+    if (outq_empty(&client->out))
+    {
+        free_stream(stream);
+        return;
+    }
+    stream->next_closing = h2->closing;
+    h2->closing = stream;
+}
+
+static int capture_ready(void)
+{
+    if (capture.chunks)
+        return 0;
+    void *storage = pool_alloc(OUTQ_STORAGE_SIZE);
+    if (!storage)
+        return -1;
+    outq_init(&capture);
+    outq_attach(&capture, storage);
+    return 0;
+}
+
+static int in_capture_arena(const out_chunk_t *chunk)
+{
+    return chunk->type == OUT_MEM && chunk->data >= capture.arena &&
+           chunk->data < capture.arena + OUTQ_ARENA_SIZE;
+}
+
+static int in_stream(const h2_stream_t *stream, const out_chunk_t *chunk)
+{
+    const char *start = (const char *)stream;
+    return chunk->type == OUT_MEM && chunk->data >= start &&
+           chunk->data < start + stream->alloc_size;
+}
+
+/**
+ * Encode an HTTP/1.1 response head as an HPACK header block.
+ * @return: block length, or -1 if it does not fit
+ */
+static int encode_head(h2_conn_t *h2, const char *head, size_t len, uint8_t *dst, size_t room)
+{
+    if (len < 12 || memcmp(head, "HTTP/1.", 7) != 0)
+        return -1;
+
+    size_t n = 0;
+    int m;
+    if (h2->size_update_pending)
+    {
+        if ((m = hpack_encode_size_update(dst, room, h2->encoder.max_size)) < 0)
+            return -1;
+        n += m;
+        h2->size_update_pending = 0;
+    }
+    if ((m = hpack_encode_header(&h2->encoder, dst + n, room - n, ":status", 7,
+                                 head + 9, 3, 0)) < 0)
+        return -1;
+    n += m;
+
+    const char *end = head + len;
+    const char *line = (const char *)memchr(head, '\n', len) + 1;
+    while (line < end)
+    {
+        const char *eol = memchr(line, '\n', end - line);
+        if (!eol)
+            return -1;
+        size_t line_len = eol - line;
+        if (line_len > 0 && line[line_len - 1] == '\r')
+            line_len--;
+        if (line_len == 0)
+            break; // the blank line that ends the head
+
+        const char *colon = memchr(line, ':', line_len);
+        char name[64];
+        size_t name_len = colon ? (size_t)(colon - line) : sizeof(name);
+        if (name_len >= sizeof(name))
+            return -1;
+        for (size_t i = 0; i < name_len; i++)
+            name[i] = (char)tolower((unsigned char)line[i]);
+        const char *value = colon + 1;
+        while (value < line + line_len && *value == ' ')
+            value++;
+
+        if (!connection_specific(name, name_len))
+        {
+            // A Content-Range differs with every response: not worth a slot
+            int index = !name_is(name, name_len, "content-range");
+            if ((m = hpack_encode_header(&h2->encoder, dst + n, room - n, name, name_len,
+                                         value, line + line_len - value, index)) < 0)
+                return -1;
+            n += m;
+        }
+        line = eol + 1;
+    }
+    return (int)n;
+}
+
+/**
+ * Move the body out of the capture queue into a new stream: the rest of
+ * the head chunk, then every chunk after it, with their references. Bytes
+ * in the capture arena are copied, as the arena serves the next stream.
+ * @return: the stream, or NULL when out of memory (capture left as is)
+ */
+static h2_stream_t *adopt_body(h2_conn_t *h2, uint32_t id, const out_chunk_t *head,
+                               size_t head_len)
+{
+    size_t rest = head->len - head_len;
+    int count = capture.count + (rest > 0);
+    size_t copied = rest;
+    for (int i = 0; i < capture.count; i++)
+    {
+        const out_chunk_t *chunk = &capture.chunks[(capture.head + i) % OUTQ_MAX_CHUNKS];
+        if (in_capture_arena(chunk))
+            copied += chunk->len;
+    }
+
+    size_t size = sizeof(h2_stream_t) + count * sizeof(out_chunk_t) + copied;
+    h2_stream_t *stream = pool_alloc(size);
+    if (!stream)
+        return NULL;
+    stream->id = id;
+    stream->window = h2->peer_initial_window;
+    stream->rst_after = 0;
+    stream->done = 0;
+    stream->next = 0;
+    stream->alloc_size = size;
+    stream->next_closing = NULL;
+
+    char *bytes = (char *)&stream->chunks[count];
+    int n = 0;
+    if (rest > 0)
+    {
+        out_chunk_t *chunk = &stream->chunks[n++];
+        memset(chunk, 0, sizeof(*chunk));
+        chunk->type = OUT_MEM;
+        chunk->file_fd = -1;
+        memcpy(bytes, head->data + head_len, rest);
+        chunk->data = bytes;
+        chunk->len = rest;
+        bytes += rest;
+    }
+    out_chunk_t chunk;
+    while (outq_pop(&capture, &chunk) == 0)
+    {
+        if (in_capture_arena(&chunk))
+        {
+            memcpy(bytes, chunk.data, chunk.len);
+            chunk.data = bytes;
+            bytes += chunk.len;
+        }
+        stream->chunks[n++] = chunk;
+    }
+    stream->count = n;
+    return stream;
+}
+
+/**
+ * Turn the captured response into a HEADERS frame and, if it has a body,
+ * a stream for write_data() to frame.
+ * @return: 0 on success, -1 if nothing was queued (capture left as is)
+ */
+static int queue_response(client_info_t *client, h2_conn_t *h2, uint32_t id, int rst_after)
+{
+    // Every response head is queued as one piece of memory
+    out_chunk_t *first = outq_front(&capture);
+    if (!first || first->type != OUT_MEM)
+        return -1;
+    const char *end = memmem(first->data, first->len, "\r\n\r\n", 4);
+    if (!end)
+        return -1;
+    size_t head_len = end + 4 - first->data;
+    size_t body_len = capture.total_queued - head_len;
+
+    out_chunk_t head;
+    outq_pop(&capture, &head);
+    h2_stream_t *stream = NULL;
+    if (body_len > 0 && !(stream = adopt_body(h2, id, &head, head_len)))
+    {
+        outq_chunk_release(&head);
+        return -1;
+    }
+
+    // Encoding updates the encoder's table: from here on the frame must go
+    // out, or the peer's decoder falls out of step
+    uint8_t frame[FRAME_HEADER_LEN + FILE_HEAD_MAX];
+    int block = encode_head(h2, head.data, head_len, frame + FRAME_HEADER_LEN, FILE_HEAD_MAX);
+    outq_chunk_release(&head);
+    frame_header(frame, block, FRAME_HEADERS,
+                 FLAG_END_HEADERS | (stream ? 0 : FLAG_END_STREAM), id);
+    if (block < 0 || outq_write(&client->out, frame, FRAME_HEADER_LEN + block) < 0)
+    {
+        if (stream)
+            free_stream(stream);
+        connection_error(client, h2, ERR_INTERNAL, "response head does not fit");
+        return 0;
+    }
+
+    if (!stream)
+    {
+        if (rst_after)
+            send_rst(client, id, ERR_NO_ERROR);
+        return 0;
+    }
+    stream->rst_after = rst_after;
+    h2->streams[h2->stream_count++] = stream;
+    return 0;
+}
+
+/**
+ * Answer a request on a new stream the way an HTTP/1.x request is
+ * answered, then queue the result as frames.
+ */
+static void answer_stream(client_info_t *client, h2_conn_t *h2, uint32_t id,
+                          const http_request_t *req, const route_t *route,
+                          int end_stream, uint64_t start_ns)
+{
+    int reused = client->request_count > 0;
+    int close_after_send = client->close_after_send;
+    output_queue_t saved = client->out;
+    capture.total_queued = 0;
+    client->out = capture;
+    client->close_after_send = 0;
+
+    // Request bodies are not read; as over HTTP/1.1, one gets a 400
+    if (!end_stream)
+        send_400(client, 0);
+    else
+        process_request(client, req, route);
+
+    capture = client->out;
+    client->out = saved;
+    int broken = client->close_after_send;
+    client->close_after_send = close_after_send;
+
+    metrics_count_request(client->status, reused);
+    metrics_count_h2_stream();
+    if (access_log_enabled)
+        access_log_record(&client->peer, client->fd, req, client->status,
+                          capture.total_queued, start_ns);
+
+    // broken: the response could not be queued in full
+    if (broken || queue_response(client, h2, id, !end_stream) < 0)
+    {
+        outq_release(&capture);
+        send_rst(client, id, ERR_INTERNAL);
+    }
+}
+
+/**
+ * Queue the next frame of a stream's body.
+ * @return: 1 if a frame was queued, 0 if a flow-control window is closed,
+ *          -1 if the output queue has no room for it
+ */
+static int write_data_frame(client_info_t *client, h2_conn_t *h2, h2_stream_t *stream)
+{
+    output_queue_t *q = &client->out;
+    uint8_t header[FRAME_HEADER_LEN];
+    size_t rst_room = stream->rst_after ? FRAME_HEADER_LEN + 4 : 0;
+
+    // Empty pieces (a zero-length range, say) need no frame of their own
+    while (stream->next < stream->count)
+    {
+        out_chunk_t *chunk = &stream->chunks[stream->next];
+        if ((chunk->type == OUT_MEM ? chunk->len : chunk->remaining) > 0)
+            break;
+        outq_chunk_release(chunk);
+        stream->next++;
+    }
+    if (stream->next == stream->count)
+    {
+        if (outq_free_chunks(q) < 2 || outq_arena_free(q) < FRAME_HEADER_LEN + rst_room)
+            return -1;
+        frame_header(header, 0, FRAME_DATA, FLAG_END_STREAM, stream->id);
+        outq_write(q, header, sizeof(header));
+        stream->done = 1;
+        if (stream->rst_after)
+            send_rst(client, stream->id, ERR_NO_ERROR);
+        return 1;
+    }
+
+    out_chunk_t *chunk = &stream->chunks[stream->next];
+    int copy = in_stream(stream, chunk);
+    size_t left = chunk->type == OUT_MEM ? chunk->len : chunk->remaining;
+    int64_t allowed = h2->peer_max_frame < H2_FRAME_MAX ? h2->peer_max_frame : H2_FRAME_MAX;
+    if (copy && allowed > INLINE_FRAME_MAX)
+        allowed = INLINE_FRAME_MAX;
+    if (h2->send_window < allowed)
+        allowed = h2->send_window;
+    if (stream->window < allowed)
+        allowed = stream->window;
+    if (allowed <= 0)
+        return 0;
+
+    size_t n = left < (size_t)allowed ? left : (size_t)allowed;
+    int last_piece = n == left;
+    int end_stream = last_piece && stream->next == stream->count - 1;
+    size_t arena = FRAME_HEADER_LEN + (copy ? n : 0) + (end_stream ? rst_room : 0);
+    if (outq_free_chunks(q) < 3 || outq_arena_free(q) < arena)
+        return -1;
+
+    frame_header(header, n, FRAME_DATA, end_stream ? FLAG_END_STREAM : 0, stream->id);
+    outq_write(q, header, sizeof(header));
+    if (copy)
+    {
+        outq_write(q, chunk->data, n);
+    }
+    else if (chunk->type == OUT_MEM)
+    {
+        // The last piece takes the chunk's reference along; the earlier
+        // ones borrow and are sent before it
+        if (!last_piece)
+            outq_push_mem(q, chunk->data, n, NULL);
+        else if (chunk->owned)
+            outq_push_owned(q, chunk->data, n, chunk->owned);
+        else
+            outq_push_mem(q, chunk->data, n, chunk->entry);
+    }
+    else
+    {
+        // File chunks all come from the open-file cache; every piece holds
+        // its own reference, the last one the chunk's
+        if (!last_piece)
+            open_file_retain(chunk->file);
+        outq_push_open_file(q, chunk->file, chunk->offset, n);
+    }
+
+    if (chunk->type == OUT_MEM)
+    {
+        chunk->data += n;
+        chunk->len -= n;
+    }
+    else
+    {
+        chunk->offset += n;
+        chunk->remaining -= n;
+    }
+    if (last_piece)
+        stream->next++;
+    h2->send_window -= n;
+    stream->window -= n;
+    if (end_stream)
+    {
+        stream->done = 1;
+        if (stream->rst_after)
+            send_rst(client, stream->id, ERR_NO_ERROR);
+    }
+    return 1;
+}
+
+/**
+ * Frame response data, one frame per stream in turn, until every stream
+ * is done or blocked by flow control, or the output queue is full.
+ * @return: 1 if it stopped because the output queue is full, 0 otherwise
+ */
+static int write_data(client_info_t *client, h2_conn_t *h2)
+{
+    int blocked = 0; // streams in a row that could not send
+    while (h2->stream_count > 0 && blocked < h2->stream_count)
+    {
+        if (h2->next_turn >= h2->stream_count)
+            h2->next_turn = 0;
+        h2_stream_t *stream = h2->streams[h2->next_turn];
+        int framed = write_data_frame(client, h2, stream);
+        if (framed < 0)
+            return 1;
+        if (framed == 0)
+        {
+            blocked++;
+            h2->next_turn++;
+            continue;
+        }
+        blocked = 0;
+        if (stream->done)
+        {
+            // Everything it had is queued, references included
+            remove_stream(h2, h2->next_turn);
+            pool_free(stream, stream->alloc_size);
+        }
+        else
+        {
+            h2->next_turn++;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Apply one setting from a SETTINGS frame or HTTP2-Settings.
+ * @return: 0, or the error code for a connection error
+ */
+static uint32_t apply_setting(h2_conn_t *h2, uint16_t id, uint32_t value)
+{
+    switch (id)
+    {
+    case SETTINGS_HEADER_TABLE_SIZE:
+    {
+        size_t size = value < HPACK_TABLE_SIZE ? value : HPACK_TABLE_SIZE;
+        if (size != h2->encoder.max_size)
+        {
+            hpack_table_resize(&h2->encoder, size);
+            h2->size_update_pending = 1;
+        }
+        break;
+    }
+    case SETTINGS_ENABLE_PUSH:
+        if (value > 1)
+            return ERR_PROTOCOL;
+        break;
+    case SETTINGS_INITIAL_WINDOW_SIZE:
+        if (value > MAX_WINDOW)
+            return ERR_FLOW_CONTROL;
+        // Applies to the streams already open as well
+        for (int i = 0; i < h2->stream_count; i++)
+            h2->streams[i]->window += (int64_t)value - h2->peer_initial_window;
+        h2->peer_initial_window = value;
+        break;
+    case SETTINGS_MAX_FRAME_SIZE:
+        if (value < 16384 || value > 16777215)
+            return ERR_PROTOCOL;
+        h2->peer_max_frame = value;
+        break;
+    default:
+        break; // unknown settings are ignored
+    }
+    return 0;
+}
+
+static uint32_t apply_settings(h2_conn_t *h2, const uint8_t *payload, size_t len)
+{
+    for (size_t i = 0; i + 6 <= len; i += 6)
+    {
+        uint32_t code = apply_setting(h2, (uint16_t)((payload[i] << 8) | payload[i + 1]),
+                                      get_u32(payload + i + 2));
+        if (code)
+            return code;
+    }
+    return 0;
+}
+
+static void on_settings(client_info_t *client, h2_conn_t *h2, uint8_t flags, uint32_t id,
+                        const uint8_t *payload, size_t len)
+{
+    if (id != 0)
+    {
+        connection_error(client, h2, ERR_PROTOCOL, "SETTINGS on a stream");
+        return;
+    }
+    if (flags & FLAG_ACK)
+    {
+        if (len != 0)
+            connection_error(client, h2, ERR_FRAME_SIZE, "SETTINGS ack with payload");
+        return;
+    }
+    if (len % 6 != 0)
+    {
+        connection_error(client, h2, ERR_FRAME_SIZE, "SETTINGS length");
+        return;
+    }
+    uint32_t code = apply_settings(h2, payload, len);
+    if (code)
+    {
+        connection_error(client, h2, code, "SETTINGS value");
+        return;
+    }
+    queue_frame(client, FRAME_SETTINGS, FLAG_ACK, 0, NULL, 0);
+    h2->phase = PHASE_OPEN;
+}
+
+static void on_window_update(client_info_t *client, h2_conn_t *h2, uint32_t id,
+                             const uint8_t *payload, size_t len)
+{
+    if (len != 4)
+    {
+        connection_error(client, h2, ERR_FRAME_SIZE, "WINDOW_UPDATE length");
+        return;
+    }
+    uint32_t increment = get_u32(payload) & MAX_WINDOW;
+    if (id == 0)
+    {
+        h2->send_window += increment;
+        if (increment == 0 || h2->send_window > MAX_WINDOW)
+            connection_error(client, h2, increment ? ERR_FLOW_CONTROL : ERR_PROTOCOL,
+                             "connection window");
+        return;
+    }
+
+    int index = find_stream(h2, id);
+    if (index < 0)
+        return; // already answered in full
+    h2_stream_t *stream = h2->streams[index];
+    stream->window += increment;
+    if (increment == 0 || stream->window > MAX_WINDOW)
+    {
+        send_rst(client, id, increment ? ERR_FLOW_CONTROL : ERR_PROTOCOL);
+        abort_stream(client, h2, index);
+    }
+}
+
+/**
+ * Frames whose payload is read in full and needs no answer beyond a
+ * control frame.
+ */
+static void on_control_frame(client_info_t *client, h2_conn_t *h2, uint8_t type, uint8_t flags,
+                             uint32_t id, const uint8_t *payload, size_t len)
+{
+    switch (type)
+    {
+    case FRAME_SETTINGS:
+        on_settings(client, h2, flags, id, payload, len);
+        break;
+    case FRAME_PING:
+        if (len != 8)
+            connection_error(client, h2, ERR_FRAME_SIZE, "PING length");
+        else if (id != 0)
+            connection_error(client, h2, ERR_PROTOCOL, "PING on a stream");
+        else if (!(flags & FLAG_ACK))
+            queue_frame(client, FRAME_PING, FLAG_ACK, 0, payload, len);
+        break;
+    case FRAME_RST_STREAM:
+        if (len != 4)
+            connection_error(client, h2, ERR_FRAME_SIZE, "RST_STREAM length");
+        else if (id == 0)
+            connection_error(client, h2, ERR_PROTOCOL, "RST_STREAM on stream 0");
+        else
+        {
+            int index = find_stream(h2, id);
+            if (index >= 0)
+                abort_stream(client, h2, index);
+        }
+        break;
+    case FRAME_WINDOW_UPDATE:
+        on_window_update(client, h2, id, payload, len);
+        break;
+    case FRAME_PUSH_PROMISE:
+        connection_error(client, h2, ERR_PROTOCOL, "PUSH_PROMISE from a client");
+        break;
+    case FRAME_CONTINUATION:
+        connection_error(client, h2, ERR_PROTOCOL, "CONTINUATION without HEADERS");
+        break;
+    default:
+        break; // PRIORITY: the deprecated scheme is not implemented
+    }
+}
+
+static void on_data(client_info_t *client, h2_conn_t *h2, uint8_t flags, uint32_t id,
+                    size_t len)
+{
+    if (id == 0)
+    {
+        connection_error(client, h2, ERR_PROTOCOL, "DATA on stream 0");
+        return;
+    }
+    // The body is dropped unread, so its bytes go straight back to the
+    // connection window; the stream is reset once answered
+    if (len > 0)
+    {
+        uint8_t payload[4];
+        put_u32(payload, (uint32_t)len);
+        queue_frame(client, FRAME_WINDOW_UPDATE, 0, 0, payload, sizeof(payload));
+    }
+    int index = find_stream(h2, id);
+    if (index >= 0 && (flags & FLAG_END_STREAM))
+        h2->streams[index]->rst_after = 0;
+}
+
+typedef struct {
+    http_request_t *req;
+    int have_method;
+    int have_path;
+    int regular_seen;           // pseudo-header fields must come first
+    int malformed;
+} request_fields_t;
+
+static int collect_field(void *ctx, const char *name, size_t name_len,
+                         const char *value, size_t value_len)
+{
+    request_fields_t *fields = ctx;
+    http_request_t *req = fields->req;
+
+    if (name_len > 0 && name[0] == ':')
+    {
+        if (fields->regular_seen)
+            fields->malformed = 1;
+        else if (name_is(name, name_len, ":method"))
+        {
+            req->method.ptr = value;
+            req->method.len = value_len;
+            fields->have_method = 1;
+        }
+        else if (name_is(name, name_len, ":path"))
+        {
+            req->path.ptr = value;
+            req->path.len = value_len;
+            fields->have_path = 1;
+        }
+        else if (name_is(name, name_len, ":authority"))
+        {
+            // Stands in for Host, which HTTP/1.1 requests must carry
+            if (http_request_add_header(req, "host", 4, value, value_len) < 0)
+                fields->malformed = 1;
+        }
+        else if (!name_is(name, name_len, ":scheme"))
+            fields->malformed = 1;
+        return 0;
+    }
+
+    fields->regular_seen = 1;
+    for (size_t i = 0; i < name_len; i++)
+    {
+        if (isupper((unsigned char)name[i]))
+            fields->malformed = 1;
+    }
+    if (connection_specific(name, name_len) ||
+        http_request_add_header(req, name, name_len, value, value_len) < 0)
+        fields->malformed = 1;
+    return 0;
+}
+
+/**
+ * Handle a HEADERS frame at rbuf[pos] together with its CONTINUATION
+ * frames, which must all be buffered.
+ * @return: bytes consumed, 0 if the block is incomplete or on error
+ */
+static size_t on_headers(client_info_t *client, h2_conn_t *h2, size_t pos)
+{
+    uint8_t *buf = (uint8_t *)client->rbuf;
+    uint8_t *frame = buf + pos;
+    size_t len = frame_length(frame);
+    uint8_t flags = frame[4];
+    uint32_t id = get_u32(frame + 5) & MAX_WINDOW;
+
+    // Find the end of the block before touching anything
+    size_t end = pos + FRAME_HEADER_LEN + len;
+    int end_headers = flags & FLAG_END_HEADERS;
+    while (end <= client->rlen && !end_headers)
+    {
+        if (client->rlen - end < FRAME_HEADER_LEN)
+        {
+            end = client->rlen + 1;
+            break;
+        }
+        const uint8_t *next = buf + end;
+        if (next[3] != FRAME_CONTINUATION || (get_u32(next + 5) & MAX_WINDOW) != id ||
+            frame_length(next) > H2_FRAME_MAX)
+        {
+            connection_error(client, h2, ERR_PROTOCOL, "header block interrupted");
+            return 0;
+        }
+        end_headers = next[4] & FLAG_END_HEADERS;
+        end += FRAME_HEADER_LEN + frame_length(next);
+    }
+    if (end > client->rlen)
+    {
+        // Header blocks have to fit the read buffer, as request heads do
+        if (pos == 0 && client->rlen == server_config.buffer_size)
+            connection_error(client, h2, ERR_ENHANCE_YOUR_CALM, "header block too large");
+        return 0;
+    }
+
+    if (id == 0 || !(id & 1))
+    {
+        connection_error(client, h2, ERR_PROTOCOL, "HEADERS on a server stream id");
+        return 0;
+    }
+
+    // Padding and the priority fields surround the first fragment
+    uint8_t *block = frame + FRAME_HEADER_LEN;
+    size_t pad = 0;
+    if (flags & FLAG_PADDED)
+    {
+        if (len < 1)
+        {
+            connection_error(client, h2, ERR_PROTOCOL, "HEADERS padding");
+            return 0;
+        }
+        pad = *block++;
+        len--;
+    }
+    if (flags & FLAG_PRIORITY)
+    {
+        if (len < 5)
+        {
+            connection_error(client, h2, ERR_PROTOCOL, "HEADERS priority");
+            return 0;
+        }
+        block += 5;
+        len -= 5;
+    }
+    if (pad > len)
+    {
+        connection_error(client, h2, ERR_PROTOCOL, "HEADERS padding");
+        return 0;
+    }
+    size_t block_len = len - pad;
+
+    // Continuation fragments are moved up over their own frame headers
+    for (size_t next = (size_t)(block - buf) + len + pad; next < end; )
+    {
+        size_t fragment = frame_length(buf + next);
+        memmove(block + block_len, buf + next + FRAME_HEADER_LEN, fragment);
+        block_len += fragment;
+        next += FRAME_HEADER_LEN + fragment;
+    }
+
+    uint64_t parse_start = metrics_now_ns();
+    http_request_t *req = client->req;
+    http_request_reset(req);
+    req->http_version = 20;
+    request_fields_t fields = { .req = req };
+    int rc = hpack_decode(&h2->decoder, block, block_len, header_scratch,
+                          sizeof(header_scratch), collect_field, &fields);
+    if (rc != HPACK_OK)
+    {
+        connection_error(client, h2, rc == HPACK_TOO_LARGE ? ERR_ENHANCE_YOUR_CALM : ERR_COMPRESSION,
+                         "header block");
+        return 0;
+    }
+    metrics_observe_parse(metrics_now_ns() - parse_start);
+
+    // Trailers, or streams opened after GOAWAY: decoded only to keep the
+    // table in step
+    size_t consumed = end - pos;
+    if (!h2->goaway_sent && should_go_away(client))
+        send_goaway(client, h2, ERR_NO_ERROR);
+    if (id <= h2->last_stream_id || h2->goaway_sent)
+        return consumed;
+    h2->last_stream_id = id;
+
+    if (fields.malformed || !fields.have_method || !fields.have_path)
+        send_rst(client, id, ERR_PROTOCOL);
+    else if (h2->stream_count == H2_MAX_STREAMS)
+        send_rst(client, id, ERR_REFUSED_STREAM);
+    else
+    {
+        const route_t *route = route_match(req);
+        if (route->handler == ROUTE_PROXY)
+            send_rst(client, id, ERR_HTTP_1_1_REQUIRED);
+        else
+            answer_stream(client, h2, id, req, route, flags & FLAG_END_STREAM, parse_start);
+    }
+    return consumed;
+}
+
+static h2_conn_t *h2_conn_new(client_info_t *client)
+{
+    if (capture_ready() < 0)
+        return NULL;
+    h2_conn_t *h2 = pool_alloc(sizeof(*h2));
+    if (!h2)
+        return NULL;
+    h2->phase = PHASE_PREFACE;
+    h2->last_stream_id = 0;
+    h2->send_window = DEFAULT_WINDOW;
+    h2->peer_initial_window = DEFAULT_WINDOW;
+    h2->peer_max_frame = 16384;
+    h2->size_update_pending = 0;
+    h2->discard = 0;
+    h2->goaway_sent = 0;
+    h2->peer_goaway = 0;
+    h2->stream_count = 0;
+    h2->next_turn = 0;
+    h2->closing = NULL;
+    hpack_table_init(&h2->decoder, HPACK_TABLE_SIZE);
+    hpack_table_init(&h2->encoder, HPACK_TABLE_SIZE);
+
+    // Frames of many streams are interleaved in small writes; Nagle would
+    // hold them back waiting for acknowledgements
+    if (!client->nodelay)
+    {
+        int one = 1;
+        setsockopt(client->fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        client->nodelay = 1;
+    }
+    metrics_count_h2_connection();
+    return h2;
+}
+
+int h2_preface_check(const char *buf, size_t len)
+{
+    size_t n = len < H2_PREFACE_LEN ? len : H2_PREFACE_LEN;
+    if (memcmp(buf, H2_PREFACE, n) != 0)
+        return 0;
+    return n == H2_PREFACE_LEN ? 1 : -1;
+}
+
+int h2_start(client_info_t *client)
+{
+    h2_conn_t *h2 = h2_conn_new(client);
+    if (!h2)
+        return -1;
+    client->h2 = h2;
+    if (log_verbose)
+        printf("Client fd=%d speaks HTTP/2 (prior knowledge)\n", client->fd);
+    send_settings(client);
+    return 0;
+}
+
+/**
+ * Decode base64url (padding optional, as HTTP2-Settings omits it).
+ * @return: decoded length, or -1 on a bad character or overflow
+ */
+static int decode_base64url(const char *src, size_t len, uint8_t *dst, size_t room)
+{
+    uint32_t bits = 0;
+    int count = 0;
+    size_t n = 0;
+    for (size_t i = 0; i < len && src[i] != '='; i++)
+    {
+        char c = src[i];
+        int v;
+        if (c >= 'A' && c <= 'Z')
+            v = c - 'A';
+        else if (c >= 'a' && c <= 'z')
+            v = c - 'a' + 26;
+        else if (c >= '0' && c <= '9')
+            v = c - '0' + 52;
+        else if (c == '-' || c == '+')
+            v = 62;
+        else if (c == '_' || c == '/')
+            v = 63;
+        else
+            return -1;
+        bits = (bits << 6) | (uint32_t)v;
+        count += 6;
+        if (count >= 8)
+        {
+            count -= 8;
+            if (n == room)
+                return -1;
+            dst[n++] = (uint8_t)(bits >> count);
+        }
+    }
+    return (int)n;
+}
+
+int h2_try_upgrade(client_info_t *client, const http_request_t *req, const route_t *route,
+                   uint64_t start_ns)
+{
+    // Only bodiless GETs: a body would have to arrive as HTTP/1.1 first
+    const http_slice_t *upgrade = http_find_header(req, "Upgrade");
+    const http_slice_t *settings = http_find_header(req, "HTTP2-Settings");
+    const http_slice_t *content_length = http_get_header(req, HTTP_HDR_CONTENT_LENGTH);
+    if (!upgrade || !settings || !http_slice_case_equals(upgrade, "h2c") ||
+        req->http_version < 11 || !http_slice_equals(&req->method, "GET") ||
+        (content_length && !http_slice_equals(content_length, "0")) || lifecycle_draining())
+        return 0;
+
+    uint8_t payload[UPGRADE_SETTINGS_MAX];
+    int len = decode_base64url(settings->ptr, settings->len, payload, sizeof(payload));
+    if (len < 0 || len % 6 != 0)
+        return 0;
+    h2_conn_t *h2 = h2_conn_new(client);
+    if (!h2)
+        return 0;
+    if (apply_settings(h2, payload, len) != 0)
+    {
+        pool_free(h2, sizeof(*h2));
+        return 0;
+    }
+
+    client->h2 = h2;
+    if (log_verbose)
+        printf("Client fd=%d upgraded to HTTP/2 (h2c)\n", client->fd);
+    outq_printf(&client->out,
+                "HTTP/1.1 101 Switching Protocols\r\n"
+                "Connection: Upgrade\r\n"
+                "Upgrade: h2c\r\n\r\n");
+    send_settings(client);
+
+    // The request itself is stream 1, half-closed by the client
+    h2->last_stream_id = 1;
+    answer_stream(client, h2, 1, req, route, 1, start_ns);
+    return 1;
+}
+
+int h2_process_input(client_info_t *client, int *budget)
+{
+    h2_conn_t *h2 = client->h2;
+    const uint8_t *buf = (const uint8_t *)client->rbuf;
+    size_t pos = 0;
+    int stalled = 0;
+
+    if (h2->closing && outq_empty(&client->out))
+        release_closing(h2);
+
+    if (h2->phase == PHASE_PREFACE && client->rlen > 0)
+    {
+        int preface = h2_preface_check(client->rbuf, client->rlen);
+        if (preface == 0)
+            connection_error(client, h2, ERR_PROTOCOL, "bad client preface");
+        else if (preface == 1)
+        {
+            pos = H2_PREFACE_LEN;
+            h2->phase = PHASE_SETTINGS;
+        }
+    }
+
+    while (h2->phase != PHASE_PREFACE && !client->close_after_send)
+    {
+        size_t avail = client->rlen - pos;
+        if (h2->discard > 0)
+        {
+            size_t n = avail < h2->discard ? avail : h2->discard;
+            pos += n;
+            h2->discard -= n;
+            if (h2->discard > 0)
+                break;
+            continue;
+        }
+        if (avail < FRAME_HEADER_LEN)
+            break;
+        if (!outq_has_room(&client->out))
+        {
+            stalled = 1;
+            break;
+        }
+
+        const uint8_t *frame = buf + pos;
+        size_t len = frame_length(frame);
+        uint8_t type = frame[3];
+        uint8_t flags = frame[4];
+        uint32_t id = get_u32(frame + 5) & MAX_WINDOW;
+        if (len > H2_FRAME_MAX)
+        {
+            connection_error(client, h2, ERR_FRAME_SIZE, "frame too large");
+            break;
+        }
+        if (h2->phase == PHASE_SETTINGS && (type != FRAME_SETTINGS || (flags & FLAG_ACK)))
+        {
+            connection_error(client, h2, ERR_PROTOCOL, "preface without SETTINGS");
+            break;
+        }
+
+        // Payloads nobody reads are skipped as they arrive, so a frame
+        // larger than the read buffer does not hold anything up
+        if (type == FRAME_DATA || type == FRAME_GOAWAY || type > FRAME_CONTINUATION)
+        {
+            if (type == FRAME_DATA)
+                on_data(client, h2, flags, id, len);
+            else if (type == FRAME_GOAWAY)
+                h2->peer_goaway = 1;
+            pos += FRAME_HEADER_LEN;
+            h2->discard = len;
+            continue;
+        }
+
+        if (type == FRAME_HEADERS)
+        {
+            if (*budget == 0)
+            {
+                stalled = 1;
+                break;
+            }
+            size_t used = on_headers(client, h2, pos);
+            if (!used)
+                break;
+            pos += used;
+            (*budget)--;
+            continue;
+        }
+
+        if (avail - FRAME_HEADER_LEN < len)
+        {
+            if (pos == 0 && client->rlen == server_config.buffer_size)
+                connection_error(client, h2, ERR_ENHANCE_YOUR_CALM, "frame larger than the read buffer");
+            break;
+        }
+        on_control_frame(client, h2, type, flags, id, frame + FRAME_HEADER_LEN, len);
+        pos += FRAME_HEADER_LEN + len;
+    }
+
+    if (pos > 0)
+    {
+        client->rlen -= pos;
+        memmove(client->rbuf, client->rbuf + pos, client->rlen);
+    }
+    if (client->close_after_send)
+        return 0;
+
+    if (!h2->goaway_sent && should_go_away(client))
+        send_goaway(client, h2, ERR_NO_ERROR);
+
+    // After an upgrade, stream 1 waits for the client preface: until then
+    // the client is still reading HTTP/1.1
+    if (h2->phase == PHASE_OPEN && write_data(client, h2))
+        stalled = 1;
+    if ((h2->goaway_sent || h2->peer_goaway) && h2->stream_count == 0)
+        client->close_after_send = 1;
+    return stalled;
+}
+
+int h2_busy(const client_info_t *client)
+{
+    const h2_conn_t *h2 = client->h2;
+    return h2 && h2->stream_count > 0;
+}
+
+void h2_free(client_info_t *client)
+{
+    h2_conn_t *h2 = client->h2;
+    if (!h2)
+        return;
+    for (int i = 0; i < h2->stream_count; i++)
+        free_stream(h2->streams[i]);
+    release_closing(h2);
+    pool_free(h2, sizeof(*h2));
+    client->h2 = NULL;
+}
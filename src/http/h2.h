@@ -0,0 +1,80 @@
+/**
+ * @file h2.h
+ * @brief HTTP Server - HTTP/2 Connection Interface
+ * @version 1.0.0
+ * @date 2025-06-07
+ * @author David Dev (@DavidDevGt)
+ *
+ * @description
+ * Cleartext HTTP/2 (RFC 9113): with prior knowledge, when a connection
+ * opens with the client preface, or through "Upgrade: h2c" on an HTTP/1.1
+ * request. Requests on any number of streams share one connection; each
+ * is answered by the same code as an HTTP/1.x request (process_request()
+ * and serve_file()), and the response is sent as HEADERS and DATA frames
+ * under per-stream and connection flow control.
+ *
+ * Like the HTTP/1.x path, everything here only reads the client's read
+ * buffer and appends to its output queue, so any event backend drives it.
+ *
+ * @license MIT License
+ */
+
+#ifndef H2_H
+#define H2_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "http_parser.h"
+#include "router.h"
+#include "../client/client_manager.h"
+
+#define H2_MAX_STREAMS 64           // SETTINGS_MAX_CONCURRENT_STREAMS
+#define H2_HEADER_LIST_MAX 16384    // SETTINGS_MAX_HEADER_LIST_SIZE, decoded
+#define H2_FRAME_MAX 16384          // largest frame accepted, and DATA frame sent
+
+/**
+ * Whether the bytes at the start of a connection are the HTTP/2 client
+ * preface.
+ * @return: 1 if they are, 0 if not, -1 if too few bytes arrived to tell
+ */
+int h2_preface_check(const char *buf, size_t len);
+
+/**
+ * Switch a connection to HTTP/2 with prior knowledge; the preface is
+ * still at rbuf[0] and is consumed by h2_process_input().
+ * @return: 0 on success, -1 when out of memory
+ */
+int h2_start(client_info_t *client);
+
+/**
+ * Take up "Upgrade: h2c" on a parsed HTTP/1.1 request: answer 101, switch
+ * the connection, and answer the request itself (bound for route) as
+ * stream 1.
+ * @return: 1 if the connection switched, 0 if the request does not ask
+ *          for it (or cannot have it) and is answered over HTTP/1.1
+ */
+int h2_try_upgrade(client_info_t *client, const http_request_t *req, const route_t *route,
+                   uint64_t start_ns);
+
+/**
+ * Counterpart of http_process_input() for an HTTP/2 connection: handle
+ * the complete frames in the read buffer, then frame as much response
+ * data as the flow-control windows allow. Each new stream takes one unit
+ * of *budget.
+ * @return: 1 if it stopped early because the output queue is full or the
+ *          budget is spent, 0 otherwise
+ */
+int h2_process_input(client_info_t *client, int *budget);
+
+/**
+ * Whether any stream still has response data to send.
+ */
+int h2_busy(const client_info_t *client);
+
+/**
+ * The connection is closing; drops all stream state. Call once its output
+ * queue has been released.
+ */
+void h2_free(client_info_t *client);
+
+#endif // H2_H
@@ -0,0 +1,547 @@
+/**
+ * @file hpack.c
+ * @brief HTTP Server - HPACK Header Compression Implementation
+ * @version 1.0.0
+ * @date 2025-06-07
+ * @author David Dev (@DavidDevGt)
+ *
+ * @description
+ * The Huffman code is canonical, so the code lengths alone define it.
+ * hpack_init() turns them into a decoding tree and then into a table that
+ * consumes four bits per step: at most one symbol ends within any four
+ * bits, as no code is shorter than five.
+ *
+ * Decoded strings are written to a caller-provided scratch buffer. Names
+ * and values from the dynamic table are copied there too, since a later
+ * field of the same block may evict the entry they came from.
+ *
+ * @license MIT License
+ */
+
+#include "hpack.h"
+#include <string.h>
+
+static const struct {
+    const char *name;
+    const char *value;
+} static_table[HPACK_STATIC_ENTRIES] = {
+    { ":authority", "" },
+    { ":method", "GET" },
+    { ":method", "POST" },
+    { ":path", "/" },
+    { ":path", "/index.html" },
+    { ":scheme", "http" },
+    { ":scheme", "https" },
+    { ":status", "200" },
+    { ":status", "204" },
+    { ":status", "206" },
+    { ":status", "304" },
+    { ":status", "400" },
+    { ":status", "404" },
+    { ":status", "500" },
+    { "accept-charset", "" },
+    { "accept-encoding", "gzip, deflate" },
+    { "accept-language", "" },
+    { "accept-ranges", "" },
+    { "accept", "" },
+    { "access-control-allow-origin", "" },
+    { "age", "" },
+    { "allow", "" },
+    { "authorization", "" },
+    { "cache-control", "" },
+    { "content-disposition", "" },
+    { "content-encoding", "" },
+    { "content-language", "" },
+    { "content-length", "" },
+    { "content-location", "" },
+    { "content-range", "" },
+    { "content-type", "" },
+    { "cookie", "" },
+    { "date", "" },
+    { "etag", "" },
+    { "expect", "" },
+    { "expires", "" },
+    { "from", "" },
+    { "host", "" },
+    { "if-match", "" },
+    { "if-modified-since", "" },
+    { "if-none-match", "" },
+    { "if-range", "" },
+    { "if-unmodified-since", "" },
+    { "last-modified", "" },
+    { "link", "" },
+    { "location", "" },
+    { "max-forwards", "" },
+    { "proxy-authenticate", "" },
+    { "proxy-authorization", "" },
+    { "range", "" },
+    { "referer", "" },
+    { "refresh", "" },
+    { "retry-after", "" },
+    { "server", "" },
+    { "set-cookie", "" },
+    { "strict-transport-security", "" },
+    { "transfer-encoding", "" },
+    { "user-agent", "" },
+    { "vary", "" },
+    { "via", "" },
+    { "www-authenticate", "" }
+};
+
+// Code lengths of symbols 0-255 and EOS (RFC 7541 Appendix B)
+static const uint8_t huffman_lengths[257] = {
+    13, 23, 28, 28, 28, 28, 28, 28, 28, 24, 30, 28, 28, 30, 28, 28,
+    28, 28, 28, 28, 28, 28, 30, 28, 28, 28, 28, 28, 28, 28, 28, 28,
+     6, 10, 10, 12, 13,  6,  8, 11, 10, 10,  8, 11,  8,  6,  6,  6,
+     5,  5,  5,  6,  6,  6,  6,  6,  6,  6,  7,  8, 15,  6, 12, 10,
+    13,  6,  7,  7,  7,  7,  7,  7,  7,  7,  7,  7,  7,  7,  7,  7,
+     7,  7,  7,  7,  7,  7,  7,  7,  8,  7,  8, 13, 19, 13, 14,  6,
+    15,  5,  6,  5,  6,  5,  6,  6,  6,  5,  7,  7,  6,  6,  6,  5,
+     6,  7,  6,  5,  5,  6,  7,  7,  7,  7,  7, 15, 11, 14, 13, 28,
+    20, 22, 20, 20, 22, 22, 22, 23, 22, 23, 23, 23, 23, 23, 24, 23,
+    24, 24, 22, 23, 24, 23, 23, 23, 23, 21, 22, 23, 22, 23, 23, 24,
+    22, 21, 20, 22, 22, 23, 23, 21, 23, 22, 22, 24, 21, 22, 23, 23,
+    21, 21, 22, 21, 23, 22, 23, 23, 20, 22, 22, 22, 23, 22, 22, 23,
+    26, 26, 20, 19, 22, 23, 22, 25, 26, 26, 26, 27, 27, 26, 24, 25,
+    19, 21, 26, 27, 27, 26, 27, 24, 21, 21, 26, 26, 28, 27, 27, 27,
+    20, 24, 20, 21, 22, 21, 21, 23, 22, 22, 25, 25, 24, 24, 26, 23,
+    26, 27, 26, 26, 27, 27, 27, 27, 27, 28, 27, 27, 27, 27, 27, 26,
+    30
+};
+
+#define HUFF_NODES 256      // internal nodes of the code tree, root is 0
+#define HUFF_EMIT 1         // a symbol ends within this step
+#define HUFF_ACCEPT 2       // the string may end here: what is left is padding
+#define HUFF_FAIL 4         // EOS, which must never appear inside a string
+
+typedef struct {
+    uint8_t next;           // node after the four bits
+    uint8_t flags;
+    uint8_t symbol;         // with HUFF_EMIT
+} huff_step_t;
+
+// Written once by hpack_init(), before any worker starts
+static huff_step_t huff_steps[HUFF_NODES][16];
+
+void hpack_init(void)
+{
+    // > 0 internal node, < 0 leaf -(symbol + 1); the root is nobody's child
+    static int16_t child[HUFF_NODES][2];
+    static uint8_t depth[HUFF_NODES];
+    static uint8_t all_ones[HUFF_NODES];
+    memset(child, 0, sizeof(child));
+    all_ones[0] = 1;
+    depth[0] = 0;
+
+    // Canonical: codes of one length count up in symbol order, and the
+    // next length continues from there shifted left by one
+    int nodes = 1;
+    uint32_t code = 0;
+    for (int len = 1; len <= 30; len++)
+    {
+        for (int symbol = 0; symbol < 257; symbol++)
+        {
+            if (huffman_lengths[symbol] != len)
+                continue;
+            int node = 0;
+            for (int bit = len - 1; bit > 0; bit--)
+            {
+                int b = (code >> bit) & 1;
+                if (!child[node][b])
+                {
+                    child[node][b] = (int16_t)nodes;
+                    depth[nodes] = depth[node] + 1;
+                    all_ones[nodes] = all_ones[node] && b;
+                    nodes++;
+                }
+                node = child[node][b];
+            }
+            child[node][code & 1] = (int16_t)-(symbol + 1);
+            code++;
+        }
+        code <<= 1;
+    }
+
+    for (int node = 0; node < HUFF_NODES; node++)
+    {
+        for (int nibble = 0; nibble < 16; nibble++)
+        {
+            huff_step_t *step = &huff_steps[node][nibble];
+            int cur = node;
+            step->flags = 0;
+            for (int bit = 3; bit >= 0; bit--)
+            {
+                int next = child[cur][(nibble >> bit) & 1];
+                if (next >= 0)
+                {
+                    cur = next;
+                    continue;
+                }
+                if (next == -257)
+                {
+                    step->flags |= HUFF_FAIL;
+                    break;
+                }
+                step->flags |= HUFF_EMIT;
+                step->symbol = (uint8_t)(-next - 1);
+                cur = 0;
+            }
+            step->next = (uint8_t)cur;
+            // Padding is the most significant bits of EOS: ones, under a byte
+            if (cur == 0 || (all_ones[cur] && depth[cur] < 8))
+                step->flags |= HUFF_ACCEPT;
+        }
+    }
+}
+
+/**
+ * @return: HPACK_OK with the length in *out_len, or an HPACK_* error
+ */
+static int huffman_decode(const uint8_t *src, size_t len, char *dst, size_t room,
+                          size_t *out_len)
+{
+    uint8_t node = 0;
+    uint8_t flags = HUFF_ACCEPT;
+    size_t n = 0;
+    for (size_t i = 0; i < len; i++)
+    {
+        uint8_t nibbles[2] = { src[i] >> 4, src[i] & 0x0f };
+        for (int j = 0; j < 2; j++)
+        {
+            const huff_step_t *step = &huff_steps[node][nibbles[j]];
+            if (step->flags & HUFF_FAIL)
+                return HPACK_ERROR;
+            if (step->flags & HUFF_EMIT)
+            {
+                if (n == room)
+                    return HPACK_TOO_LARGE;
+                dst[n++] = (char)step->symbol;
+            }
+            node = step->next;
+            flags = step->flags;
+        }
+    }
+    if (!(flags & HUFF_ACCEPT))
+        return HPACK_ERROR;
+    *out_len = n;
+    return HPACK_OK;
+}
+
+/**
+ * Read an integer with an N-bit prefix; *p must be before end.
+ * @return: 0 on success, -1 if truncated or implausibly large
+ */
+static int decode_int(const uint8_t **p, const uint8_t *end, int prefix_bits, uint32_t *out)
+{
+    uint32_t max = (1u << prefix_bits) - 1;
+    uint32_t value = *(*p)++ & max;
+    if (value < max)
+    {
+        *out = value;
+        return 0;
+    }
+    for (int shift = 0; *p < end; shift += 7)
+    {
+        // Nothing in a header block comes near 2^28
+        if (shift > 21)
+            return -1;
+        uint8_t b = *(*p)++;
+        value += (uint32_t)(b & 0x7f) << shift;
+        if (!(b & 0x80))
+        {
+            *out = value;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+static int encode_int(uint8_t *dst, size_t room, uint8_t first, int prefix_bits, uint32_t value)
+{
+    uint32_t max = (1u << prefix_bits) - 1;
+    size_t n = 0;
+    if (room == 0)
+        return -1;
+    if (value < max)
+    {
+        dst[0] = first | (uint8_t)value;
+        return 1;
+    }
+    dst[n++] = first | (uint8_t)max;
+    value -= max;
+    while (value >= 0x80)
+    {
+        if (n == room)
+            return -1;
+        dst[n++] = (uint8_t)((value & 0x7f) | 0x80);
+        value >>= 7;
+    }
+    if (n == room)
+        return -1;
+    dst[n++] = (uint8_t)value;
+    return (int)n;
+}
+
+static int encode_string(uint8_t *dst, size_t room, const char *str, size_t len)
+{
+    int n = encode_int(dst, room, 0x00, 7, (uint32_t)len);
+    if (n < 0 || (size_t)n + len > room)
+        return -1;
+    memcpy(dst + n, str, len);
+    return n + (int)len;
+}
+
+/**
+ * Read a string literal into dst.
+ * @return: HPACK_OK with the length in *out_len, or an HPACK_* error
+ */
+static int decode_string(const uint8_t **p, const uint8_t *end, char *dst, size_t room,
+                         size_t *out_len)
+{
+    if (*p == end)
+        return HPACK_ERROR;
+    int huffman = **p & 0x80;
+    uint32_t len;
+    if (decode_int(p, end, 7, &len) < 0 || len > (size_t)(end - *p))
+        return HPACK_ERROR;
+    if (huffman)
+    {
+        int rc = huffman_decode(*p, len, dst, room, out_len);
+        if (rc != HPACK_OK)
+            return rc;
+    }
+    else
+    {
+        if (len > room)
+            return HPACK_TOO_LARGE;
+        memcpy(dst, *p, len);
+        *out_len = len;
+    }
+    *p += len;
+    return HPACK_OK;
+}
+
+void hpack_table_init(hpack_table_t *table, size_t max_size)
+{
+    table->count = 0;
+    table->used = 0;
+    table->size = 0;
+    table->max_size = max_size;
+}
+
+static void evict_oldest(hpack_table_t *table)
+{
+    size_t len = table->name_len[0] + table->value_len[0];
+    memmove(table->data, table->data + len, table->used - len);
+    table->used -= len;
+    table->size -= len + HPACK_ENTRY_OVERHEAD;
+    table->count--;
+    for (int i = 0; i < table->count; i++)
+    {
+        table->offset[i] = (uint16_t)(table->offset[i + 1] - len);
+        table->name_len[i] = table->name_len[i + 1];
+        table->value_len[i] = table->value_len[i + 1];
+    }
+}
+
+void hpack_table_resize(hpack_table_t *table, size_t max_size)
+{
+    table->max_size = max_size;
+    while (table->count > 0 && table->size > max_size)
+        evict_oldest(table);
+}
+
+static void table_insert(hpack_table_t *table, const char *name, size_t name_len,
+                         const char *value, size_t value_len)
+{
+    size_t entry = name_len + value_len + HPACK_ENTRY_OVERHEAD;
+    while (table->count > 0 && table->size + entry > table->max_size)
+        evict_oldest(table);
+    // An entry larger than the whole table just empties it
+    if (entry > table->max_size)
+        return;
+
+    int i = table->count++;
+    table->offset[i] = (uint16_t)table->used;
+    table->name_len[i] = (uint16_t)name_len;
+    table->value_len[i] = (uint16_t)value_len;
+    memcpy(table->data + table->used, name, name_len);
+    memcpy(table->data + table->used + name_len, value, value_len);
+    table->used += name_len + value_len;
+    table->size += entry;
+}
+
+/**
+ * Entry at an HPACK index: 1-61 static, then the dynamic table newest first.
+ * @return: 1 for a dynamic entry, 0 for a static one, -1 for a bad index
+ */
+static int lookup(const hpack_table_t *table, uint32_t index,
+                  const char **name, size_t *name_len, const char **value, size_t *value_len)
+{
+    if (index == 0)
+        return -1;
+    if (index <= HPACK_STATIC_ENTRIES)
+    {
+        *name = static_table[index - 1].name;
+        *name_len = strlen(*name);
+        *value = static_table[index - 1].value;
+        *value_len = strlen(*value);
+        return 0;
+    }
+    index -= HPACK_STATIC_ENTRIES + 1;
+    if (index >= (uint32_t)table->count)
+        return -1;
+    int i = table->count - 1 - (int)index;
+    *name = table->data + table->offset[i];
+    *name_len = table->name_len[i];
+    *value = *name + *name_len;
+    *value_len = table->value_len[i];
+    return 1;
+}
+
+static int copy_to_scratch(char *scratch, size_t scratch_size, size_t *used,
+                           const char **str, size_t len)
+{
+    if (len > scratch_size - *used)
+        return HPACK_TOO_LARGE;
+    memcpy(scratch + *used, *str, len);
+    *str = scratch + *used;
+    *used += len;
+    return HPACK_OK;
+}
+
+int hpack_decode(hpack_table_t *table, const uint8_t *block, size_t len,
+                 char *scratch, size_t scratch_size, hpack_header_fn fn, void *ctx)
+{
+    const uint8_t *p = block;
+    const uint8_t *end = block + len;
+    size_t used = 0;
+    int fields = 0;
+
+    while (p < end)
+    {
+        uint8_t first = *p;
+        const char *name, *value;
+        size_t name_len, value_len;
+        int rc;
+
+        if ((first & 0xe0) == 0x20)
+        {
+            // Dynamic table size update: only ahead of the first field
+            uint32_t size;
+            if (fields > 0 || decode_int(&p, end, 5, &size) < 0 || size > HPACK_TABLE_SIZE)
+                return HPACK_ERROR;
+            hpack_table_resize(table, size);
+            continue;
+        }
+
+        if (first & 0x80)
+        {
+            // Indexed field
+            uint32_t index;
+            if (decode_int(&p, end, 7, &index) < 0)
+                return HPACK_ERROR;
+            int dynamic = lookup(table, index, &name, &name_len, &value, &value_len);
+            if (dynamic < 0)
+                return HPACK_ERROR;
+            if (dynamic &&
+                ((rc = copy_to_scratch(scratch, scratch_size, &used, &name, name_len)) != HPACK_OK ||
+                 (rc = copy_to_scratch(scratch, scratch_size, &used, &value, value_len)) != HPACK_OK))
+                return rc;
+        }
+        else
+        {
+            // Literal, with incremental indexing (01), without (0000) or
+            // never indexed (0001); the last two are the same to a decoder
+            int indexing = (first & 0x40) != 0;
+            uint32_t index;
+            if (decode_int(&p, end, indexing ? 6 : 4, &index) < 0)
+                return HPACK_ERROR;
+            if (index)
+            {
+                const char *unused;
+                size_t unused_len;
+                int dynamic = lookup(table, index, &name, &name_len, &unused, &unused_len);
+                if (dynamic < 0)
+                    return HPACK_ERROR;
+                if (dynamic &&
+                    (rc = copy_to_scratch(scratch, scratch_size, &used, &name, name_len)) != HPACK_OK)
+                    return rc;
+            }
+            else
+            {
+                if ((rc = decode_string(&p, end, scratch + used, scratch_size - used,
+                                        &name_len)) != HPACK_OK)
+                    return rc;
+                name = scratch + used;
+                used += name_len;
+            }
+            if ((rc = decode_string(&p, end, scratch + used, scratch_size - used,
+                                    &value_len)) != HPACK_OK)
+                return rc;
+            value = scratch + used;
+            used += value_len;
+            if (indexing)
+                table_insert(table, name, name_len, value, value_len);
+        }
+
+        fields++;
+        if (fn(ctx, name, name_len, value, value_len) < 0)
+            return HPACK_ERROR;
+    }
+    return HPACK_OK;
+}
+
+int hpack_encode_header(hpack_table_t *table, uint8_t *dst, size_t room,
+                        const char *name, size_t name_len,
+                        const char *value, size_t value_len, int index)
+{
+    uint32_t name_index = 0;
+    for (int i = 0; i < HPACK_STATIC_ENTRIES; i++)
+    {
+        const char *entry = static_table[i].name;
+        if (strlen(entry) != name_len || memcmp(entry, name, name_len) != 0)
+            continue;
+        if (strlen(static_table[i].value) == value_len &&
+            memcmp(static_table[i].value, value, value_len) == 0)
+            return encode_int(dst, room, 0x80, 7, i + 1);
+        if (!name_index)
+            name_index = i + 1;
+    }
+    // Newest first, which is also the lowest index
+    for (int i = table->count - 1; i >= 0; i--)
+    {
+        const char *entry = table->data + table->offset[i];
+        if (table->name_len[i] != name_len || memcmp(entry, name, name_len) != 0)
+            continue;
+        uint32_t dynamic_index = HPACK_STATIC_ENTRIES + table->count - i;
+        if (table->value_len[i] == value_len &&
+            memcmp(entry + name_len, value, value_len) == 0)
+            return encode_int(dst, room, 0x80, 7, dynamic_index);
+        if (!name_index)
+            name_index = dynamic_index;
+    }
+
+    int n = index ? encode_int(dst, room, 0x40, 6, name_index)
+                  : encode_int(dst, room, 0x00, 4, name_index);
+    if (n < 0)
+        return -1;
+    int m;
+    if (!name_index)
+    {
+        if ((m = encode_string(dst + n, room - n, name, name_len)) < 0)
+            return -1;
+        n += m;
+    }
+    if ((m = encode_string(dst + n, room - n, value, value_len)) < 0)
+        return -1;
+    n += m;
+    if (index)
+        table_insert(table, name, name_len, value, value_len);
+    return n;
+}
+
+int hpack_encode_size_update(uint8_t *dst, size_t room, size_t size)
+{
+    return encode_int(dst, room, 0x20, 5, (uint32_t)size);
+}
@@ -0,0 +1,96 @@
+/**
+ * @file hpack.h
+ * @brief HTTP Server - HPACK Header Compression Interface
+ * @version 1.0.0
+ * @date 2025-06-07
+ * @author David Dev (@DavidDevGt)
+ *
+ * @description
+ * HPACK (RFC 7541) for the HTTP/2 connections in h2.c: integer and string
+ * primitives, the static table, and one dynamic table per direction.
+ * Request header blocks are decoded, Huffman-coded strings included;
+ * response headers are encoded with the static and dynamic tables but
+ * written as raw strings, which keeps encoding a plain copy.
+ *
+ * @license MIT License
+ */
+
+#ifndef HPACK_H
+#define HPACK_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define HPACK_TABLE_SIZE 4096                   // SETTINGS_HEADER_TABLE_SIZE, both ways
+#define HPACK_ENTRY_OVERHEAD 32                 // RFC 7541 4.1
+#define HPACK_MAX_ENTRIES (HPACK_TABLE_SIZE / HPACK_ENTRY_OVERHEAD)
+#define HPACK_STATIC_ENTRIES 61
+
+// Return codes of hpack_decode()
+#define HPACK_OK 0
+#define HPACK_ERROR -1                          // malformed block: COMPRESSION_ERROR
+#define HPACK_TOO_LARGE -2                      // decoded list exceeds the scratch buffer
+
+/**
+ * Dynamic table: name and value bytes of all entries packed oldest first,
+ * so evicting is a memmove of what is left. Only the connection that owns
+ * it touches it.
+ */
+typedef struct {
+    char data[HPACK_TABLE_SIZE];
+    uint16_t offset[HPACK_MAX_ENTRIES];         // entry start in data, oldest first
+    uint16_t name_len[HPACK_MAX_ENTRIES];
+    uint16_t value_len[HPACK_MAX_ENTRIES];
+    int count;
+    size_t used;                                // bytes of data in use
+    size_t size;                                // RFC size: lengths plus 32 per entry
+    size_t max_size;
+} hpack_table_t;
+
+/**
+ * Called once per decoded header field; name and value point into the
+ * scratch buffer and stay valid until the buffer is reused.
+ * @return: 0 to go on, -1 to stop decoding with HPACK_ERROR
+ */
+typedef int (*hpack_header_fn)(void *ctx, const char *name, size_t name_len,
+                               const char *value, size_t value_len);
+
+/**
+ * Build the Huffman decoding table; call once at startup.
+ */
+void hpack_init(void);
+
+void hpack_table_init(hpack_table_t *table, size_t max_size);
+
+/**
+ * Change the table's maximum size, evicting entries that no longer fit.
+ */
+void hpack_table_resize(hpack_table_t *table, size_t max_size);
+
+/**
+ * Decode a complete header block, updating the decoder's dynamic table.
+ * Size updates above HPACK_TABLE_SIZE are rejected. Decoding stops at the
+ * first error; the table is then out of step with the peer and the
+ * connection has to go.
+ * @return: HPACK_OK, HPACK_ERROR or HPACK_TOO_LARGE
+ */
+int hpack_decode(hpack_table_t *table, const uint8_t *block, size_t len,
+                 char *scratch, size_t scratch_size, hpack_header_fn fn, void *ctx);
+
+/**
+ * Encode one header field (name in lower case). An exact match in either
+ * table becomes an index; otherwise a literal that reuses a matching name,
+ * added to the encoder's dynamic table when `index` is set.
+ * @return: bytes written, or -1 if `room` is too small
+ */
+int hpack_encode_header(hpack_table_t *table, uint8_t *dst, size_t room,
+                        const char *name, size_t name_len,
+                        const char *value, size_t value_len, int index);
+
+/**
+ * Encode a dynamic table size update; it must open a header block.
+ * @return: bytes written, or -1 if `room` is too small
+ */
+int hpack_encode_size_update(uint8_t *dst, size_t room, size_t size);
+
+#endif // HPACK_H
@@ -12,18 +12,45 @@
  * 
  * Features:
  * - HTTP/1.1 and HTTP/1.0 protocol support
+ * - Buffered, non-blocking reads with an incremental request parser
  * - Keep-alive connection management
  * - Secure file serving with realpath() protection
+ * - Zero-copy sendfile() bodies with resumable non-blocking writes
+ * - In-memory asset cache: hot files go out without copies
+ * - Packed, memory-mapped document root with --bundle (bundle.c)
+ * - gzip/br content negotiation: precompressed siblings or cached variants
+ * - ETag/Last-Modified validators, 304 Not Modified, Cache-Control rules
+ * - Range/If-Range: 206 single ranges and multipart/byteranges, 416
+ * - HTTP/1.1 pipelining with batched response writes
  * - MIME type detection and content serving
  * - Proper error response handling (400, 404)
+ * - Prometheus metrics at /metrics (loopback clients only)
+ * - Reverse proxy routes ahead of the document root (proxy.c)
+ * - Cleartext HTTP/2 by prior knowledge or Upgrade: h2c (h2.c)
  * - Request counting and connection limits
  * 
  * @license MIT License
  */
 
-#define _GNU_SOURCE  // for dprintf and realpath
+#define _GNU_SOURCE  // for realpath
 
 #include "http_handler.h"
+#include "http_parser.h"
+#include "file_cache.h"
+#include "compress.h"
+#include "conditional.h"
+#include "range.h"
+#include "open_file_cache.h"
+#include "output_queue.h"
+#include "proxy.h"
+#include "h2.h"
+#include "router.h"
+#include "bundle.h"
+#include "../core/metrics.h"
+#include "../core/access_log.h"
+#include "../core/config.h"
+#include "../core/lifecycle.h"
+#include "../core/tls.h"
 #include "../client/client_manager.h"
 #include <stdio.h>
 #include <stdlib.h>
@@ -34,243 +61,908 @@
 #include <errno.h>
 #include <sys/socket.h>
 #include <sys/stat.h>
+#include <netinet/in.h>
 #include <time.h>
 
-#define WWW_ROOT "./www"
-
-int read_line(int fd, char *buf, int max)
+int parse_connection_header(const http_request_t *req)
 {
-    int i = 0, n;
-    char c;
-    while (i < max - 1)
-    {
-        n = recv(fd, &c, 1, 0); // read one byte
-        if (n <= 0)
-            return n;
-        if (c == '\r')
+    // Look for close or keep-alive among the tokens of every Connection
+    // header; close wins
+    int keep_alive = 0;
+    for (int i = 0; i < req->header_count; i++)
+    {
+        const http_header_t *h = &req->headers[i];
+        if (!http_slice_case_equals(&h->name, "Connection"))
             continue;
-        if (c == '\n')
-            break;
-        buf[i++] = c; // save byte
+        if (http_has_token(&h->value, "close", 5))
+            return 0;
+        keep_alive |= http_has_token(&h->value, "keep-alive", 10);
     }
-    buf[i] = '\0';
-    return i; // return number of bytes read
+    if (keep_alive)
+        return 1;
+    
+    // Default behavior based on HTTP version
+    // HTTP/1.1 defaults to keep-alive, HTTP/1.0 defaults to close
+    return (req->http_version >= 11) ? 1 : 0;
 }
 
-int parse_http_version(const char *request_line)
+/**
+ * /metrics is for local scrapers only; everyone else gets a 404.
+ */
+static int is_loopback_peer(int fd)
 {
-    // Check if it's HTTP/1.1 or HTTP/1.0
-    if (strstr(request_line, "HTTP/1.1"))
-        return 11;
-    else if (strstr(request_line, "HTTP/1.0"))
-        return 10;
-    return 11; // Default to HTTP/1.1
+    struct sockaddr_storage addr;
+    socklen_t len = sizeof(addr);
+    if (getpeername(fd, (struct sockaddr *)&addr, &len) < 0)
+        return 0;
+    if (addr.ss_family == AF_INET)
+    {
+        const struct sockaddr_in *in = (const struct sockaddr_in *)&addr;
+        return (ntohl(in->sin_addr.s_addr) >> 24) == 127;
+    }
+    if (addr.ss_family == AF_INET6)
+    {
+        const struct sockaddr_in6 *in6 = (const struct sockaddr_in6 *)&addr;
+        return IN6_IS_ADDR_LOOPBACK(&in6->sin6_addr);
+    }
+    return 0;
 }
 
-int parse_connection_header(const char *headers, int http_version)
+int http_keep_alive(client_info_t *client, const http_request_t *req)
 {
-    // Look for Connection: keep-alive or Connection: close
-    const char *connection = strstr(headers, "Connection:");
-    if (!connection)
+    // Parse connection header based on HTTP version
+    int keep_alive = parse_connection_header(req);
+    
+    // Check if we should close due to request limit
+    int max_requests = config_current()->max_requests;
+    client->request_count++;
+    if (client->request_count >= max_requests)
     {
-        // Default behavior based on HTTP version
-        // HTTP/1.1 defaults to keep-alive, HTTP/1.0 defaults to close
-        return (http_version >= 11) ? 1 : 0;
+        if (log_verbose)
+            printf("Client fd=%d reached max requests (%d), closing connection\n", 
+                   client->fd, max_requests);
+        keep_alive = 0;
     }
+    // Shutting down: finish this response, then let the client reconnect
+    if (lifecycle_draining())
+        keep_alive = 0;
+    
+    client->keep_alive = keep_alive;
+    return keep_alive;
+}
+
+int process_request(client_info_t *client, const http_request_t *req, const route_t *route)
+{
+    int fd = client->fd;
     
-    // Move past "Connection:"
-    connection += 11;
+    uint64_t body_len = 0;
+    int has_length = http_content_length(req, &body_len);
+    int has_body = has_length < 0 || body_len > 0 || http_find_header(req, "Transfer-Encoding");
+    if (!route_allows(route, req))
+    {
+        if (log_verbose)
+            printf("Method %.*s not allowed for %.*s from fd=%d\n",
+                   (int)req->method.len, req->method.ptr,
+                   (int)req->path.len, req->path.ptr, fd);
+        // A body we do not read would be parsed as the next request
+        int keep_alive = http_keep_alive(client, req) && !has_body;
+        char allow[96];
+        route_allow_header(route, allow, sizeof(allow));
+        send_405(client, allow, keep_alive);
+        return keep_alive;
+    }
+
+    // HTTP/1.1 requires Host (RFC 7230 5.4); a GET body would be parsed
+    // as the next request, so refuse anything but an empty one, and any
+    // framing (repeated lengths, Transfer-Encoding) we do not read
+    if ((req->http_version >= 11 && !http_get_header(req, HTTP_HDR_HOST)) || has_body)
+    {
+        if (log_verbose)
+            printf("Missing Host or unexpected body from fd=%d\n", fd);
+        send_400(client, 0);
+        return 0;
+    }
+
+    char path[256];
+    if (req->path.len >= sizeof(path))
+    {
+        if (log_verbose)
+            printf("Request path too long from fd=%d\n", fd);
+        send_400(client, 0);
+        return 0;
+    }
+    memcpy(path, req->path.ptr, req->path.len);
+    path[req->path.len] = '\0';
     
-    // Skip whitespace
-    while (*connection == ' ' || *connection == '\t')
-        connection++;
+    int keep_alive = http_keep_alive(client, req);
     
-    // Check for keep-alive
-    if (strncasecmp(connection, "keep-alive", 10) == 0)
-        return 1;
+    if (log_verbose)
+        printf("Serving %s to fd=%d (request #%d, keep_alive=%s)\n", 
+               path, fd, client->request_count, keep_alive ? "yes" : "no");
     
-    // Check for close
-    if (strncasecmp(connection, "close", 5) == 0)
-        return 0;
+    if (route->handler == ROUTE_METRICS && is_loopback_peer(fd))
+        send_metrics(client, keep_alive);
+    else
+        serve_file(client, req, path, keep_alive); // serve file or 404
     
-    // Default behavior based on HTTP version
-    return (http_version >= 11) ? 1 : 0;
+    return keep_alive;
+}
+
+/**
+ * Pull everything the kernel has for this socket into the read buffer.
+ * @return: 1 if the buffer filled up before EAGAIN, 0 once drained,
+ *          -1 on error or when the peer has closed its side
+ */
+static int fill_read_buffer(client_info_t *client)
+{
+    while (client->rlen < server_config.buffer_size)
+    {
+        size_t room = server_config.buffer_size - client->rlen;
+        ssize_t n = client->tls
+            ? tls_recv(client, client->rbuf + client->rlen, room)
+            : recv(client->fd, client->rbuf + client->rlen, room, MSG_DONTWAIT);
+        if (n > 0)
+        {
+            client->rlen += n;
+            continue;
+        }
+        if (n == 0)
+        {
+            if (log_verbose)
+                printf("Client fd=%d disconnected\n", client->fd);
+            return -1;
+        }
+        if (errno == EINTR)
+            continue;
+        if (errno == EAGAIN || errno == EWOULDBLOCK)
+            return 0;
+        if (log_verbose)
+            printf("Error reading from client fd=%d: %s\n", client->fd, strerror(errno));
+        return -1;
+    }
+    return 1;
+}
+
+int http_process_input(client_info_t *client, int *budget)
+{
+    if (client->h2)
+        return h2_process_input(client, budget);
+
+    // A connection that opens with the client preface speaks HTTP/2 from
+    // the first byte
+    if (client->request_count == 0 && client->rlen > 0)
+    {
+        int preface = h2_preface_check(client->rbuf, client->rlen);
+        if (preface < 0)
+            return 0; // need more data
+        if (preface > 0)
+        {
+            if (h2_start(client) < 0)
+            {
+                client->close_after_send = 1;
+                return 0;
+            }
+            return h2_process_input(client, budget);
+        }
+    }
+
+    while (client->rlen > 0 && !client->close_after_send)
+    {
+        if (!outq_has_room(&client->out) || *budget == 0)
+            return 1;
+        
+        int reused = client->request_count > 0;
+        size_t queued_before = client->out.total_queued;
+        uint64_t parse_start = metrics_now_ns();
+        int consumed = http_parse_request(client->req, client->rbuf, client->rlen);
+        if (consumed == HTTP_PARSE_ERROR)
+        {
+            if (log_verbose)
+                printf("Invalid HTTP request from fd=%d\n", client->fd);
+            send_400(client, 0);
+            metrics_count_request(client->status, reused);
+            if (access_log_enabled)
+                access_log_record(&client->peer, client->fd, NULL, client->status,
+                                  client->out.total_queued - queued_before, parse_start);
+            client->close_after_send = 1;
+            return 0;
+        }
+        if (consumed == HTTP_PARSE_AGAIN)
+        {
+            if (client->rlen == server_config.buffer_size)
+            {
+                if (log_verbose)
+                    printf("Request head too large from fd=%d\n", client->fd);
+                send_400(client, 0);
+                metrics_count_request(client->status, reused);
+                if (access_log_enabled)
+                    access_log_record(&client->peer, client->fd, NULL, client->status,
+                                      client->out.total_queued - queued_before, parse_start);
+                client->close_after_send = 1;
+            }
+            return 0; // need more data
+        }
+        metrics_observe_parse(metrics_now_ns() - parse_start);
+        
+        size_t taken = consumed;
+        const route_t *route = route_match(client->req);
+        if (route->handler != ROUTE_PROXY && h2_try_upgrade(client, client->req, route, parse_start))
+        {
+            // Answered as stream 1; what follows is the HTTP/2 preface
+            (*budget)--;
+            client->rlen -= taken;
+            memmove(client->rbuf, client->rbuf + taken, client->rlen);
+            http_request_reset(client->req);
+            return h2_process_input(client, budget);
+        }
+        int keep_alive = route->handler == ROUTE_PROXY
+            ? proxy_begin(client, client->req, &taken, route->arg, parse_start)
+            : process_request(client, client->req, route);
+        (*budget)--;
+        // A forwarded request is counted and logged once its response is done
+        if (!client->proxy)
+        {
+            metrics_count_request(client->status, reused);
+            if (access_log_enabled)
+                access_log_record(&client->peer, client->fd, client->req, client->status,
+                                  client->out.total_queued - queued_before, parse_start);
+        }
+        
+        // Drop the answered request and rewind the parser for the next one
+        client->rlen -= taken;
+        memmove(client->rbuf, client->rbuf + taken, client->rlen);
+        http_request_reset(client->req);
+        
+        if (!keep_alive)
+            client->close_after_send = 1;
+        if (client->proxy)
+            return 1; // later requests wait for its response
+    }
+    return 0;
+}
+
+/**
+ * Flush the output queue, timing the socket writes for the send histogram.
+ * @return: same as outq_flush()
+ */
+static int timed_flush(client_info_t *client, size_t *budget)
+{
+    if (outq_empty(&client->out))
+        return 1;
+    uint64_t start = metrics_now_ns();
+    int flushed = client->tls
+        ? tls_flush(client, budget)
+        : outq_flush(&client->out, client->fd, budget);
+    metrics_observe_send(metrics_now_ns() - start);
+    return flushed;
 }
 
 int handle_client(int fd)
 {
-    char line[BUF_SIZE];
-    char headers[BUF_SIZE] = "";
-    
     client_info_t *client = find_client(fd);
     if (!client) 
     {
-        printf("Warning: Client fd=%d not found in client list\n", fd);
+        fprintf(stderr, "Warning: Client fd=%d not found in client list\n", fd);
         return -1;
     }
     
-    // Update last activity
-    client->last_activity = time(NULL);
+    // Update last activity and push back the keep-alive deadline
+    touch_client(client);
+    if (client->tls && !tls_established(client))
+    {
+        int shaken = tls_handshake(client);
+        if (shaken <= 0)
+            return shaken; // wait for the socket, or close
+    }
+    if (client_acquire_buffers(client) < 0)
+        return -1;
     
-    int read_result = read_line(fd, line, sizeof(line));
-    if (read_result <= 0)
+    int requests_left = FAIR_MAX_REQUESTS;
+    size_t bytes_left = FAIR_MAX_BYTES;
+    int status = 0;
+    int stalled = 0;
+    int have_read = 0;
+
+    // Finish the responses in flight before looking at further requests, so
+    // a slow reader applies backpressure instead of growing the queue.
+    while (1)
     {
-        if (read_result == 0)
-            printf("Client fd=%d disconnected\n", fd);
-        else
-            printf("Error reading from client fd=%d: %s\n", fd, strerror(errno));
+        int flushed = timed_flush(client, &bytes_left);
+        if (flushed < 0)
+            return -1;
+        if (flushed == 0)
+            return 0; // socket full, wait for EPOLLOUT
+        if (flushed == 2)
+            return HANDLE_YIELD;
+
+        // A forwarded request owns the connection until its response is out
+        if (client->proxy)
+        {
+            int relayed = proxy_relay(client, &bytes_left);
+            if (relayed < 0)
+                return -1;
+            if (relayed == 0)
+                return 0; // woken by the client or the upstream socket
+            if (relayed == 2)
+                return HANDLE_YIELD;
+            have_read = 0; // done: the next request may be waiting
+            continue;
+        }
+
+        if (client->close_after_send || (have_read && status < 0))
+            return -1; // Return -1 to close connection
+        if (have_read)
+        {
+            if (requests_left == 0 && (stalled || status > 0))
+                return HANDLE_YIELD; // more requests buffered or still unread
+            if (status == 0 && !stalled)
+            {
+                client_release_idle_buffers(client);
+                return 0; // 0 to keep alive
+            }
+        }
+
+        // The socket is edge-triggered: keep reading until the kernel buffer
+        // is drained. All pipelined requests found along the way are answered
+        // and their responses flushed together, up to this pass's budget.
+        status = fill_read_buffer(client);
+        stalled = http_process_input(client, &requests_left);
+        have_read = 1;
+    }
+}
+
+// The lines after the file's own headers; they follow the reloadable
+// settings, so bundles store everything before them
+#define FILE_HEAD_TAIL "Cache-Control: %s\r\n" \
+                       "Vary: Accept-Encoding\r\n" \
+                       "Connection: %s\r\n" \
+                       "Keep-Alive: timeout=%d, max=%d\r\n\r\n"
+
+int format_file_head(char *buf, size_t size, const file_head_t *info, int keep_alive)
+{
+    const char *connection_header = keep_alive ? "keep-alive" : "close";
+    const char *encoding = info->encoding;
+    const char *content_range = info->content_range;
+    const runtime_config_t *cfg = config_current();
+    int n = snprintf(buf, size,
+                     "HTTP/1.1 %s\r\n"
+                     "Content-Length: %zu\r\n"
+                     "Content-Type: %s\r\n"
+                     "%s%s%s"
+                     "%s%s%s"
+                     "Accept-Ranges: bytes\r\n"
+                     "ETag: %s\r\n"
+                     "Last-Modified: %s\r\n"
+                     FILE_HEAD_TAIL,
+                     info->partial ? "206 Partial Content" : "200 OK",
+                     info->content_length, info->mime,
+                     encoding ? "Content-Encoding: " : "",
+                     encoding ? encoding : "",
+                     encoding ? "\r\n" : "",
+                     content_range ? "Content-Range: " : "",
+                     content_range ? content_range : "",
+                     content_range ? "\r\n" : "",
+                     info->etag, info->last_modified, info->cache_control,
+                     connection_header, 
+                     cfg->keep_alive_timeout, cfg->max_requests);
+    if (n < 0 || (size_t)n >= size)
         return -1;
+    return n;
+}
+
+/**
+ * Where a 206 takes its bytes from: a cached body, a bundle body or an
+ * open file. Every slice holds its own reference on the entry or file;
+ * bundle slices need none, the mapping is never released.
+ */
+typedef struct {
+    const char *mem;
+    file_cache_entry_t *entry;
+    open_file_t *file;
+} range_source_t;
+
+static void release_range_source(range_source_t *src)
+{
+    if (src->entry)
+        file_cache_release(src->entry);
+    if (src->file)
+        open_file_release(src->file);
+}
+
+/**
+ * Queue the body bytes of one range. The first slice takes over the
+ * caller's reference, later ones get their own.
+ * @return: 0 on success, -1 if the connection must be closed
+ */
+static int push_range_body(client_info_t *client, range_source_t *src,
+                           const byte_range_t *range, int first)
+{
+    size_t len = range->end - range->start + 1;
+    int rc;
+    if (!src->entry && !src->file)
+        return outq_push_mem(&client->out, src->mem + range->start, len, NULL);
+    if (src->entry)
+    {
+        if (!first)
+            file_cache_retain(src->entry);
+        rc = outq_push_mem(&client->out, src->mem + range->start, len, src->entry);
+        if (rc < 0 && !first)
+            file_cache_release(src->entry);
+        return rc;
     }
-        
-    // parse HTTP request line
-    char method[16], path[256];
-    if (sscanf(line, "%15s %255s", method, path) != 2)
+
+    if (!first)
+        open_file_retain(src->file);
+    rc = outq_push_open_file(&client->out, src->file, range->start, len);
+    if (rc < 0 && !first)
+        open_file_release(src->file);
+    return rc;
+}
+
+/**
+ * Answer with 206: a single range inline, several as multipart/byteranges.
+ * Takes over the source's reference or descriptor once it returns 0.
+ * @return: 0 when queued, -1 if the queue has no room for that many parts
+ *          (nothing was consumed; the caller answers 200 instead)
+ */
+static int queue_ranges(client_info_t *client, const file_head_t *base, off_t size,
+                        const byte_range_t *ranges, int count, range_source_t *src,
+                        int keep_alive)
+{
+    // Head, then a part header and a body per range, then the trailer
+    if (outq_free_chunks(&client->out) < 2 * count + 2)
+        return -1;
+
+    file_head_t info = *base;
+    info.partial = 1;
+    client->status = 206;
+
+    char head[FILE_HEAD_MAX];
+    if (count == 1)
     {
-        printf("Invalid HTTP request line from fd=%d: %s\n", fd, line);
-        send_400(fd, 0);
+        char content_range[96];
+        snprintf(content_range, sizeof(content_range), "bytes %lld-%lld/%lld",
+                 (long long)ranges[0].start, (long long)ranges[0].end, (long long)size);
+        info.content_range = content_range;
+        info.content_length = ranges[0].end - ranges[0].start + 1;
+
+        int len = format_file_head(head, sizeof(head), &info, keep_alive);
+        if (len < 0 || outq_printf(&client->out, "%s", head) < 0 ||
+            push_range_body(client, src, &ranges[0], 1) < 0)
+        {
+            release_range_source(src);
+            client->close_after_send = 1;
+        }
+        return 0;
+    }
+
+    // All part headers and the trailer share one heap block, owned by the
+    // trailer chunk, which is retired last
+    size_t part_cap = 160 + strlen(base->mime);
+    char *parts = malloc(count * part_cap + 64);
+    if (!parts)
         return -1;
+
+    size_t part_off[RANGE_MAX + 1];
+    size_t part_len[RANGE_MAX + 1];
+    size_t used = 0;
+    size_t total = 0;
+    for (int i = 0; i < count; i++)
+    {
+        int n = snprintf(parts + used, part_cap,
+                         "%s--" RANGE_BOUNDARY "\r\n"
+                         "Content-Type: %s\r\n"
+                         "Content-Range: bytes %lld-%lld/%lld\r\n\r\n",
+                         i == 0 ? "" : "\r\n", base->mime,
+                         (long long)ranges[i].start, (long long)ranges[i].end,
+                         (long long)size);
+        part_off[i] = used;
+        part_len[i] = n;
+        used += n;
+        total += n + (ranges[i].end - ranges[i].start + 1);
     }
-    
-    if (strcmp(method, "GET") != 0)
+    int n = snprintf(parts + used, 64, "\r\n--" RANGE_BOUNDARY "--\r\n");
+    part_off[count] = used;
+    part_len[count] = n;
+    total += n;
+
+    info.mime = "multipart/byteranges; boundary=" RANGE_BOUNDARY;
+    info.content_length = total;
+    int len = format_file_head(head, sizeof(head), &info, keep_alive);
+    if (len < 0 || outq_printf(&client->out, "%s", head) < 0)
     {
-        // only GET method is supported
-        printf("Unsupported method %s from fd=%d\n", method, fd);
-        send_400(fd, 0);
-        return -1;
+        free(parts);
+        release_range_source(src);
+        client->close_after_send = 1;
+        return 0;
     }
-    
-    // Parse HTTP version from request line
-    int http_version = parse_http_version(line);
-    
-    // Read headers
-    int header_len = 0;
-    while (read_line(fd, line, sizeof(line)) > 0 && line[0] != '\0')
+
+    for (int i = 0; i < count; i++)
     {
-        // Accumulate headers for parsing
-        int line_len = strlen(line);
-        if (header_len + line_len + 3 < (int)sizeof(headers)) // +3 for \r\n and null terminator
+        outq_push_mem(&client->out, parts + part_off[i], part_len[i], NULL);
+        if (push_range_body(client, src, &ranges[i], i == 0) < 0)
         {
-            strcat(headers, line);
-            strcat(headers, "\r\n");
-            header_len += line_len + 2;
+            // The head promised more bytes than will come: end the connection
+            if (i == 0)
+                release_range_source(src);
+            client->close_after_send = 1;
+            break;
         }
     }
-    
-    // Parse connection header based on HTTP version
-    int keep_alive = parse_connection_header(headers, http_version);
-    
-    // Check if we should close due to request limit
-    client->request_count++;
-    if (client->request_count >= MAX_REQUESTS_PER_CONNECTION)
+    outq_push_owned(&client->out, parts + part_off[count], part_len[count], parts);
+    return 0;
+}
+
+/**
+ * Honour Range/If-Range for a body of `size` bytes.
+ * @return: 1 if a 206 or 416 was queued (source consumed), 0 to send 200
+ */
+static int try_ranges(client_info_t *client, const http_request_t *req,
+                      const file_head_t *info, off_t size, time_t mtime,
+                      range_source_t *src, int keep_alive)
+{
+    if (!http_get_header(req, HTTP_HDR_RANGE) || !if_range_matches(req, info->etag, mtime))
+        return 0;
+
+    byte_range_t ranges[RANGE_MAX];
+    int count = parse_range(req, size, ranges, RANGE_MAX);
+    if (count == RANGE_UNSATISFIABLE)
     {
-        printf("Client fd=%d reached max requests (%d), closing connection\n", 
-               fd, MAX_REQUESTS_PER_CONNECTION);
-        keep_alive = 0;
+        send_416(client, size, keep_alive);
+        release_range_source(src);
+        return 1;
     }
-    
-    client->keep_alive = keep_alive;
-    
-    printf("Serving %s to fd=%d (request #%d, keep_alive=%s)\n", 
-           path, fd, client->request_count, keep_alive ? "yes" : "no");
-    
-    serve_file(fd, path, keep_alive); // serve file or 404
-    
-    return keep_alive ? 0 : -1; // Return -1 to close connection, 0 to keep alive
+    if (count == RANGE_NONE)
+        return 0;
+    return queue_ranges(client, info, size, ranges, count, src, keep_alive) == 0;
 }
 
-const char *get_mime(const char *path)
+/**
+ * Queue a cached response: prebuilt head plus body, no copies. The body
+ * chunk carries the reference on the entry, so both stay valid until the
+ * body is sent. The best coding the client accepts wins; br is preferred
+ * over gzip, identity is always available.
+ */
+static void queue_cached_file(client_info_t *client, const http_request_t *req,
+                              file_cache_entry_t *entry, unsigned accepted, int keep_alive)
 {
-    const char *ext = strrchr(path, '.');
-    if (!ext)
-        return "application/octet-stream";
-    if (strcmp(ext, ".html") == 0)
-        return "text/html";
-    if (strcmp(ext, ".css") == 0)
-        return "text/css";
-    if (strcmp(ext, ".js") == 0)
-        return "application/javascript";
-    if (strcmp(ext, ".png") == 0)
-        return "image/png";
-    if (strcmp(ext, ".jpg") == 0)
-        return "image/jpeg";
-    return "application/octet-stream";
+    file_variant_t *variant = NULL;
+    if (accepted & (1u << ENCODING_BR))
+        variant = file_cache_variant(entry, ENCODING_BR);
+    if (!variant && (accepted & (1u << ENCODING_GZIP)))
+        variant = file_cache_variant(entry, ENCODING_GZIP);
+    if (!variant)
+        variant = &entry->variants[ENCODING_IDENTITY];
+
+    if (request_not_modified(req, variant->etag, entry->mtime))
+    {
+        send_304(client, variant->etag, entry->last_modified, entry->cache_control, keep_alive);
+        file_cache_release(entry);
+        return;
+    }
+
+    file_head_t info = {
+        .mime = entry->mime,
+        .encoding = encoding_name(ENCODING_IDENTITY),
+        .etag = variant->etag,
+        .last_modified = entry->last_modified,
+        .cache_control = entry->cache_control
+    };
+    range_source_t src = { variant->body, entry, NULL };
+    if (variant == &entry->variants[ENCODING_IDENTITY] &&
+        try_ranges(client, req, &info, variant->size, entry->mtime, &src, keep_alive))
+        return;
+
+    client->status = 200;
+    outq_push_mem(&client->out, variant->head[keep_alive], variant->head_len[keep_alive], NULL);
+    outq_push_mem(&client->out, variant->body, variant->size, entry);
 }
 
-void serve_file(int fd, const char *url_path, int keep_alive)
+/**
+ * Queue a response from the bundle: its stored head plus the lines that
+ * depend on the reloadable settings, then the body straight from the
+ * mapping. Codings are picked as for cached files.
+ */
+static void queue_bundle_file(client_info_t *client, const http_request_t *req,
+                              const bundle_entry_t *entry, unsigned accepted, int keep_alive)
 {
-    char requested_path[512];
-    snprintf(requested_path, sizeof(requested_path), "%s%s",
-             WWW_ROOT, strcmp(url_path, "/") == 0 ? "/index.html" : url_path);
+    const bundle_variant_t *identity = bundle_variant(entry, ENCODING_IDENTITY);
+    const bundle_variant_t *variant = NULL;
+    if (accepted & (1u << ENCODING_BR))
+        variant = bundle_variant(entry, ENCODING_BR);
+    if (!variant && (accepted & (1u << ENCODING_GZIP)))
+        variant = bundle_variant(entry, ENCODING_GZIP);
+    if (!variant)
+        variant = identity;
 
-    char resolved_path[512];
-    char www_root_resolved[512];
-    
-    // Get absolute path for both the requested file and www root
-    if (!realpath(requested_path, resolved_path) || !realpath(WWW_ROOT, www_root_resolved))
+    const char *etag = bundle_at(variant->etag);
+    const char *last_modified = bundle_at(entry->last_modified);
+    const char *cache_control = cache_control_for(bundle_at(entry->path));
+    if (request_not_modified(req, etag, entry->mtime))
     {
-        send_404(fd, keep_alive);
+        send_304(client, etag, last_modified, cache_control, keep_alive);
         return;
     }
-    
-    // Check if the resolved path is within www root directory
-    if (strncmp(resolved_path, www_root_resolved, strlen(www_root_resolved)) != 0)
+
+    file_head_t info = {
+        .mime = bundle_at(entry->mime),
+        .etag = etag,
+        .last_modified = last_modified,
+        .cache_control = cache_control
+    };
+    range_source_t src = { bundle_at(variant->body), NULL, NULL };
+    if (variant == identity &&
+        try_ranges(client, req, &info, variant->size, entry->mtime, &src, keep_alive))
+        return;
+
+    // The head stays one piece of memory, as h2.c expects: the stored part
+    // is copied next to the tail rather than queued by reference
+    const runtime_config_t *cfg = config_current();
+    client->status = 200;
+    if (outq_printf(&client->out, "%.*s" FILE_HEAD_TAIL,
+                    (int)variant->head_len, bundle_at(variant->head), cache_control,
+                    keep_alive ? "keep-alive" : "close",
+                    cfg->keep_alive_timeout, cfg->max_requests) < 0)
+        return;
+    outq_push_mem(&client->out, bundle_at(variant->body), variant->size, NULL);
+}
+
+/**
+ * For files too large to cache: find a precompressed sibling the client
+ * accepts that is at least as new as the original.
+ * @return: the referenced sibling with its coding in *encoding, or NULL
+ */
+static open_file_t *open_best_sibling(const char *url_path, unsigned accepted,
+                                      const struct stat *original,
+                                      content_encoding_t *encoding)
+{
+    static const content_encoding_t preference[] = { ENCODING_BR, ENCODING_GZIP };
+    for (size_t i = 0; i < sizeof(preference) / sizeof(preference[0]); i++)
     {
-        send_404(fd, keep_alive);
+        if (!(accepted & (1u << preference[i])))
+            continue;
+        char sibling_path[PATH_MAX];
+        int n = snprintf(sibling_path, sizeof(sibling_path), "%s%s",
+                         url_path, encoding_suffix(preference[i]));
+        if (n < 0 || (size_t)n >= sizeof(sibling_path))
+            continue;
+
+        // Missing siblings are cached as negative entries too
+        open_file_t *sibling = open_file_get(sibling_path);
+        if (!sibling)
+            continue;
+        if (sibling->st.st_mtime < original->st_mtime)
+        {
+            open_file_release(sibling);
+            continue;
+        }
+        *encoding = preference[i];
+        return sibling;
+    }
+    return NULL;
+}
+
+void serve_file(client_info_t *client, const http_request_t *req,
+                const char *url_path, int keep_alive)
+{
+    unsigned accepted = accepted_encodings(req);
+    // Range offsets refer to the identity bytes, so no coding for ranges
+    if (http_get_header(req, HTTP_HDR_RANGE))
+        accepted = 1u << ENCODING_IDENTITY;
+    if (strcmp(url_path, "/") == 0)
+        url_path = "/index.html";
+
+    // Packed root: one probe, no filesystem at all
+    if (bundle_loaded())
+    {
+        const bundle_entry_t *packed = bundle_lookup(url_path);
+        if (packed)
+            queue_bundle_file(client, req, packed, accepted, keep_alive);
+        else
+            send_404(client, keep_alive);
+        return;
+    }
+
+    // Hot path: no realpath/open/fstat at all
+    file_cache_entry_t *entry = file_cache_lookup(url_path);
+    if (entry)
+    {
+        queue_cached_file(client, req, entry, accepted, keep_alive);
         return;
     }
 
-    int file_fd = open(resolved_path, O_RDONLY);
-    if (file_fd < 0)
+    // Resolved, opened and stat'ed at most once per revalidation interval
+    open_file_t *file = open_file_get(url_path);
+    if (!file)
     {
-        send_404(fd, keep_alive);
+        send_404(client, keep_alive);
         return;
     }
 
-    struct stat st;
-    fstat(file_fd, &st);
-    const char *mime = get_mime(resolved_path);
+    entry = file_cache_insert(url_path, file->resolved_path, file->fd, &file->st, file->mime);
+    if (entry)
+    {
+        open_file_release(file);
+        queue_cached_file(client, req, entry, accepted, keep_alive);
+        return;
+    }
 
+    // Too large for the cache: stream it from the page cache instead.
+    // Last-Modified describes the original file, whichever coding is sent;
+    // a precompressed sibling's ETag comes from its own stat.
+    struct stat st = file->st;
+    const char *mime = file->mime;
+    content_encoding_t encoding = ENCODING_IDENTITY;
+    open_file_t *sibling = open_best_sibling(url_path, accepted, &st, &encoding);
+    if (sibling)
+    {
+        open_file_release(file);
+        file = sibling;
+    }
+    char etag[ETAG_MAX];
+    char last_modified[HTTP_DATE_MAX];
+    format_etag(etag, sizeof(etag), &file->st, encoding);
+    format_http_date(last_modified, sizeof(last_modified), st.st_mtime);
+    const char *cache_control = cache_control_for(url_path);
+
+    if (request_not_modified(req, etag, st.st_mtime))
+    {
+        open_file_release(file);
+        send_304(client, etag, last_modified, cache_control, keep_alive);
+        return;
+    }
+
+    file_head_t info = {
+        .content_length = file->st.st_size,
+        .mime = mime,
+        .encoding = encoding_name(encoding),
+        .etag = etag,
+        .last_modified = last_modified,
+        .cache_control = cache_control
+    };
+    range_source_t src = { NULL, NULL, file };
+    if (encoding == ENCODING_IDENTITY &&
+        try_ranges(client, req, &info, st.st_size, st.st_mtime, &src, keep_alive))
+        return;
+
+    char head[FILE_HEAD_MAX];
+    int len = format_file_head(head, sizeof(head), &info, keep_alive);
+    if (len < 0 || outq_printf(&client->out, "%s", head) < 0)
+    {
+        open_file_release(file);
+        return;
+    }
+
+    // The body is sent by outq_flush(), possibly across several writable
+    // events for large files
+    client->status = 200;
+    if (outq_push_open_file(&client->out, file, 0, file->st.st_size) < 0)
+    {
+        open_file_release(file);
+        client->close_after_send = 1;
+    }
+}
+
+void send_304(client_info_t *client, const char *etag, const char *last_modified,
+              const char *cache_control, int keep_alive)
+{
+    const char *connection_header = keep_alive ? "keep-alive" : "close";
+    client->status = 304;
+    outq_printf(&client->out,
+                "HTTP/1.1 304 Not Modified\r\n"
+                "ETag: %s\r\n"
+                "Last-Modified: %s\r\n"
+                "Cache-Control: %s\r\n"
+                "Vary: Accept-Encoding\r\n"
+                "Connection: %s\r\n\r\n",
+                etag, last_modified, cache_control, connection_header);
+}
+
+void send_416(client_info_t *client, off_t size, int keep_alive)
+{
     const char *connection_header = keep_alive ? "keep-alive" : "close";
-    dprintf(fd,
-            "HTTP/1.1 200 OK\r\n"
-            "Content-Length: %zu\r\n"
-            "Content-Type: %s\r\n"
-            "Connection: %s\r\n"
-            "Keep-Alive: timeout=%d, max=%d\r\n\r\n",
-            (size_t)st.st_size, mime, connection_header, 
-            KEEP_ALIVE_TIMEOUT, MAX_REQUESTS_PER_CONNECTION);
-
-    ssize_t r;
-    char buf[BUF_SIZE];
-    while ((r = read(file_fd, buf, sizeof(buf))) > 0)
-    {
-        send(fd, buf, r, 0);
-    }
-    close(file_fd);
+    client->status = 416;
+    outq_printf(&client->out,
+                "HTTP/1.1 416 Range Not Satisfiable\r\n"
+                "Content-Range: bytes */%lld\r\n"
+                "Content-Length: 0\r\n"
+                "Connection: %s\r\n\r\n",
+                (long long)size, connection_header);
 }
 
-void send_404(int fd, int keep_alive)
+void send_404(client_info_t *client, int keep_alive)
 {
     const char *body = "<h1>404 Not Found</h1>";
     const char *connection_header = keep_alive ? "keep-alive" : "close";
-    dprintf(fd,
-            "HTTP/1.1 404 Not Found\r\n"
-            "Content-Length: %zu\r\n"
-            "Content-Type: text/html\r\n"
-            "Connection: %s\r\n\r\n"
-            "%s",
-            strlen(body), connection_header, body);
+    client->status = 404;
+    outq_printf(&client->out,
+                 "HTTP/1.1 404 Not Found\r\n"
+                 "Content-Length: %zu\r\n"
+                 "Content-Type: text/html\r\n"
+                 "Connection: %s\r\n\r\n"
+                 "%s",
+                 strlen(body), connection_header, body);
 }
 
-void send_400(int fd, int keep_alive)
+void send_400(client_info_t *client, int keep_alive)
 {
     const char *body = "<h1>400 Bad Request</h1>";
     const char *connection_header = keep_alive ? "keep-alive" : "close";
-    dprintf(fd,
-            "HTTP/1.1 400 Bad Request\r\n"
-            "Content-Length: %zu\r\n"
-            "Content-Type: text/html\r\n"
-            "Connection: %s\r\n\r\n"
-            "%s",
-            strlen(body), connection_header, body);
+    client->status = 400;
+    outq_printf(&client->out,
+                 "HTTP/1.1 400 Bad Request\r\n"
+                 "Content-Length: %zu\r\n"
+                 "Content-Type: text/html\r\n"
+                 "Connection: %s\r\n\r\n"
+                 "%s",
+                 strlen(body), connection_header, body);
+}
+
+void send_405(client_info_t *client, const char *allow, int keep_alive)
+{
+    const char *body = "<h1>405 Method Not Allowed</h1>";
+    const char *connection_header = keep_alive ? "keep-alive" : "close";
+    client->status = 405;
+    outq_printf(&client->out,
+                 "HTTP/1.1 405 Method Not Allowed\r\n"
+                 "Allow: %s\r\n"
+                 "Content-Length: %zu\r\n"
+                 "Content-Type: text/html\r\n"
+                 "Connection: %s\r\n\r\n"
+                 "%s",
+                 allow, strlen(body), connection_header, body);
+}
+
+void send_411(client_info_t *client, int keep_alive)
+{
+    const char *body = "<h1>411 Length Required</h1>";
+    const char *connection_header = keep_alive ? "keep-alive" : "close";
+    client->status = 411;
+    outq_printf(&client->out,
+                 "HTTP/1.1 411 Length Required\r\n"
+                 "Content-Length: %zu\r\n"
+                 "Content-Type: text/html\r\n"
+                 "Connection: %s\r\n\r\n"
+                 "%s",
+                 strlen(body), connection_header, body);
+}
+
+void send_502(client_info_t *client, int keep_alive)
+{
+    const char *body = "<h1>502 Bad Gateway</h1>";
+    const char *connection_header = keep_alive ? "keep-alive" : "close";
+    client->status = 502;
+    outq_printf(&client->out,
+                 "HTTP/1.1 502 Bad Gateway\r\n"
+                 "Content-Length: %zu\r\n"
+                 "Content-Type: text/html\r\n"
+                 "Connection: %s\r\n\r\n"
+                 "%s",
+                 strlen(body), connection_header, body);
+}
+
+void send_metrics(client_info_t *client, int keep_alive)
+{
+    size_t len;
+    char *body = metrics_render(&len);
+    if (!body)
+    {
+        send_404(client, keep_alive);
+        return;
+    }
+
+    const char *connection_header = keep_alive ? "keep-alive" : "close";
+    client->status = 200;
+    if (outq_printf(&client->out,
+                    "HTTP/1.1 200 OK\r\n"
+                    "Content-Length: %zu\r\n"
+                    "Content-Type: text/plain; version=0.0.4\r\n"
+                    "Cache-Control: no-store\r\n"
+                    "Connection: %s\r\n\r\n",
+                    len, connection_header) < 0)
+    {
+        free(body);
+        return;
+    }
+    outq_push_owned(&client->out, body, len, body);
 }
@@ -23,15 +23,74 @@
 #ifndef HTTP_HANDLER_H
 #define HTTP_HANDLER_H
 
-#define BUF_SIZE 4096
+#include <stddef.h>
+#include "http_parser.h"
+#include "router.h"
+#include "../client/client_manager.h"
 
-int read_line(int fd, char *buf, int max);
+#define FILE_HEAD_MAX 1024
+
+// What one connection may do per event loop pass before the others get
+// their turn; handle_client() returns HANDLE_YIELD when it stops there
+#define FAIR_MAX_REQUESTS 16
+#define FAIR_MAX_BYTES (256 * 1024)
+#define HANDLE_YIELD 1
+
+// Everything that goes into a file response head besides the status line
+typedef struct {
+    size_t content_length;
+    const char *mime;
+    const char *encoding;       // Content-Encoding, NULL for identity
+    const char *etag;
+    const char *last_modified;
+    const char *cache_control;
+    int partial;                // 206 Partial Content instead of 200 OK
+    const char *content_range;  // single-range 206 only
+} file_head_t;
+
+/**
+ * Read, answer and flush whatever the connection has ready, within the
+ * FAIR_MAX_* budgets.
+ * @return: 0 to wait for the next event, HANDLE_YIELD to be resumed on
+ *          the next loop pass, -1 to close the connection
+ */
 int handle_client(int fd);
-const char *get_mime(const char *path);
-void serve_file(int fd, const char *url_path, int keep_alive);
-void send_404(int fd, int keep_alive);
-void send_400(int fd, int keep_alive);
-int parse_http_version(const char *request_line);
-int parse_connection_header(const char *headers, int http_version);
+
+/**
+ * Answer the complete requests sitting in the client's read buffer, in
+ * order, queueing the responses on its output queue; each one takes one
+ * unit of *budget. Performs no socket I/O, so any event backend can
+ * drive it.
+ * @return: 1 if it stopped early because the output queue is full or the
+ *          budget is spent, 0 once no complete request is left
+ */
+int http_process_input(client_info_t *client, int *budget);
+
+/**
+ * Answer one fully parsed request; the HTTP/2 streams of h2.c go through
+ * here as well.
+ * @return: 1 to keep the connection open, 0 to close it
+ */
+int process_request(client_info_t *client, const http_request_t *req, const route_t *route);
+int format_file_head(char *buf, size_t size, const file_head_t *info, int keep_alive);
+void serve_file(client_info_t *client, const http_request_t *req,
+                const char *url_path, int keep_alive);
+void send_404(client_info_t *client, int keep_alive);
+void send_416(client_info_t *client, off_t size, int keep_alive);
+void send_400(client_info_t *client, int keep_alive);
+void send_405(client_info_t *client, const char *allow, int keep_alive);
+void send_411(client_info_t *client, int keep_alive);
+void send_502(client_info_t *client, int keep_alive);
+void send_304(client_info_t *client, const char *etag, const char *last_modified,
+              const char *cache_control, int keep_alive);
+void send_metrics(client_info_t *client, int keep_alive);
+int parse_connection_header(const http_request_t *req);
+
+/**
+ * Count a request on the connection and decide whether it stays open
+ * afterwards: the client's wish, max-requests and draining.
+ * @return: 1 to keep the connection, 0 to close it after the response
+ */
+int http_keep_alive(client_info_t *client, const http_request_t *req);
 
 #endif // HTTP_HANDLER_H
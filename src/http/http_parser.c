@@ -0,0 +1,519 @@
+/**
+ * @file http_parser.c
+ * @brief HTTP Server - Incremental HTTP Request Parser Implementation
+ * @version 1.0.0
+ * @date 2025-06-07
+ * @author David Dev (@DavidDevGt)
+ * 
+ * @description
+ * Byte-driven state machine for HTTP/1.x request heads. Every call picks up
+ * at the saved position, so bytes are examined once no matter how the
+ * request was fragmented across recv() calls. Bare LF line endings are
+ * accepted as well as CRLF, and leading empty lines are skipped (RFC 7230
+ * section 3.5).
+ *
+ * The long tokens (path, header names and values) are not walked byte by
+ * byte: a scanner jumps straight to the next delimiter or invalid byte,
+ * 16 or 32 bytes per step with SSE2/AVX2. http_parser_init() picks the
+ * widest variant the CPU supports; before that, and on other
+ * architectures, the scalar loop is used.
+ * 
+ * @license MIT License
+ */
+
+#include "http_parser.h"
+#include <string.h>
+#include <strings.h>  // for strncasecmp
+
+#if defined(__x86_64__) && defined(__SSE2__)
+#include <immintrin.h>
+#define HTTP_PARSER_SIMD 1
+#endif
+
+#define MAX_METHOD_LEN 15
+
+enum {
+    S_START = 0,
+    S_METHOD,
+    S_PATH_START,
+    S_PATH,
+    S_VERSION_START,
+    S_VERSION,
+    S_LINE_LF,
+    S_HEADER_START,
+    S_HEADER_NAME,
+    S_HEADER_VALUE_START,
+    S_HEADER_VALUE,
+    S_HEADER_LF,
+    S_END_LF,
+    S_DONE
+};
+
+// Field names indexed while parsing, in http_known_header_t order
+static const struct {
+    const char *name;
+    size_t len;
+} known_headers[HTTP_HDR_COUNT] = {
+    { "Connection", 10 },
+    { "Host", 4 },
+    { "Accept-Encoding", 15 },
+    { "If-None-Match", 13 },
+    { "If-Modified-Since", 17 },
+    { "If-Range", 8 },
+    { "Range", 5 },
+    { "Content-Length", 14 },
+};
+
+/*
+ * Delimiter scanners. Both return the offset of the first byte in
+ * [pos, len) that ends the current token, or len if there is none.
+ * A token (path, header name) ends at a control byte, space, DEL or the
+ * given delimiter; a header value ends at any control byte other than
+ * HTAB, which includes CR and LF.
+ */
+static size_t scan_token_scalar(const char *buf, size_t pos, size_t len, char stop)
+{
+    for (; pos < len; pos++)
+    {
+        unsigned char c = buf[pos];
+        if (c <= 0x20 || c == 0x7f || c == (unsigned char)stop)
+            break;
+    }
+    return pos;
+}
+
+static size_t scan_value_scalar(const char *buf, size_t pos, size_t len)
+{
+    for (; pos < len; pos++)
+    {
+        unsigned char c = buf[pos];
+        if ((c < 0x20 && c != '\t') || c == 0x7f)
+            break;
+    }
+    return pos;
+}
+
+#ifdef HTTP_PARSER_SIMD
+// SSE2 has no unsigned byte compare; min_epu8(v, n) == v means v <= n
+
+static size_t scan_token_sse2(const char *buf, size_t pos, size_t len, char stop)
+{
+    const __m128i space = _mm_set1_epi8(0x20);
+    const __m128i del = _mm_set1_epi8(0x7f);
+    const __m128i delim = _mm_set1_epi8(stop);
+    for (; pos + 16 <= len; pos += 16)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i *)(buf + pos));
+        __m128i hit = _mm_or_si128(_mm_cmpeq_epi8(_mm_min_epu8(v, space), v),
+                                   _mm_or_si128(_mm_cmpeq_epi8(v, del),
+                                                _mm_cmpeq_epi8(v, delim)));
+        unsigned mask = (unsigned)_mm_movemask_epi8(hit);
+        if (mask)
+            return pos + __builtin_ctz(mask);
+    }
+    return scan_token_scalar(buf, pos, len, stop);
+}
+
+static size_t scan_value_sse2(const char *buf, size_t pos, size_t len)
+{
+    const __m128i ctl = _mm_set1_epi8(0x1f);
+    const __m128i tab = _mm_set1_epi8('\t');
+    const __m128i del = _mm_set1_epi8(0x7f);
+    for (; pos + 16 <= len; pos += 16)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i *)(buf + pos));
+        __m128i hit = _mm_or_si128(_mm_andnot_si128(_mm_cmpeq_epi8(v, tab),
+                                                    _mm_cmpeq_epi8(_mm_min_epu8(v, ctl), v)),
+                                   _mm_cmpeq_epi8(v, del));
+        unsigned mask = (unsigned)_mm_movemask_epi8(hit);
+        if (mask)
+            return pos + __builtin_ctz(mask);
+    }
+    return scan_value_scalar(buf, pos, len);
+}
+
+__attribute__((target("avx2")))
+static size_t scan_token_avx2(const char *buf, size_t pos, size_t len, char stop)
+{
+    const __m256i space = _mm256_set1_epi8(0x20);
+    const __m256i del = _mm256_set1_epi8(0x7f);
+    const __m256i delim = _mm256_set1_epi8(stop);
+    for (; pos + 32 <= len; pos += 32)
+    {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(buf + pos));
+        __m256i hit = _mm256_or_si256(_mm256_cmpeq_epi8(_mm256_min_epu8(v, space), v),
+                                      _mm256_or_si256(_mm256_cmpeq_epi8(v, del),
+                                                      _mm256_cmpeq_epi8(v, delim)));
+        unsigned mask = (unsigned)_mm256_movemask_epi8(hit);
+        if (mask)
+            return pos + __builtin_ctz(mask);
+    }
+    return scan_token_sse2(buf, pos, len, stop);
+}
+
+__attribute__((target("avx2")))
+static size_t scan_value_avx2(const char *buf, size_t pos, size_t len)
+{
+    const __m256i ctl = _mm256_set1_epi8(0x1f);
+    const __m256i tab = _mm256_set1_epi8('\t');
+    const __m256i del = _mm256_set1_epi8(0x7f);
+    for (; pos + 32 <= len; pos += 32)
+    {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(buf + pos));
+        __m256i hit = _mm256_or_si256(_mm256_andnot_si256(_mm256_cmpeq_epi8(v, tab),
+                                                          _mm256_cmpeq_epi8(_mm256_min_epu8(v, ctl), v)),
+                                      _mm256_cmpeq_epi8(v, del));
+        unsigned mask = (unsigned)_mm256_movemask_epi8(hit);
+        if (mask)
+            return pos + __builtin_ctz(mask);
+    }
+    return scan_value_sse2(buf, pos, len);
+}
+#endif // HTTP_PARSER_SIMD
+
+// Chosen once by http_parser_init(), before any worker starts
+static size_t (*scan_token)(const char *, size_t, size_t, char) = scan_token_scalar;
+static size_t (*scan_value)(const char *, size_t, size_t) = scan_value_scalar;
+static const char *scanner_name = "scalar";
+
+void http_parser_init(void)
+{
+#ifdef HTTP_PARSER_SIMD
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+    {
+        scan_token = scan_token_avx2;
+        scan_value = scan_value_avx2;
+        scanner_name = "avx2";
+    }
+    else
+    {
+        scan_token = scan_token_sse2;
+        scan_value = scan_value_sse2;
+        scanner_name = "sse2";
+    }
+#endif
+}
+
+const char *http_parser_scanner(void)
+{
+    return scanner_name;
+}
+
+int http_parser_use_scanner(const char *name)
+{
+    if (strcmp(name, "scalar") == 0)
+    {
+        scan_token = scan_token_scalar;
+        scan_value = scan_value_scalar;
+        scanner_name = "scalar";
+        return 0;
+    }
+#ifdef HTTP_PARSER_SIMD
+    if (strcmp(name, "sse2") == 0)
+    {
+        scan_token = scan_token_sse2;
+        scan_value = scan_value_sse2;
+        scanner_name = "sse2";
+        return 0;
+    }
+    __builtin_cpu_init();
+    if (strcmp(name, "avx2") == 0 && __builtin_cpu_supports("avx2"))
+    {
+        scan_token = scan_token_avx2;
+        scan_value = scan_value_avx2;
+        scanner_name = "avx2";
+        return 0;
+    }
+#endif
+    return -1;
+}
+
+void http_request_reset(http_request_t *req)
+{
+    req->state = S_START;
+    req->pos = 0;
+    req->mark = 0;
+    req->header_count = 0;
+    req->http_version = 11;
+    memset(req->known, 0, sizeof(req->known));
+}
+
+static int parse_version(const char *version, size_t len)
+{
+    if (len != 8 || strncmp(version, "HTTP/1.", 7) != 0)
+        return -1;
+    if (version[7] == '0')
+        return 10;
+    return 11;  // HTTP/1.1 and any later 1.x minor
+}
+
+static void set_slice(http_slice_t *slice, const char *buf, size_t start, size_t end)
+{
+    slice->ptr = buf + start;
+    slice->len = end - start;
+}
+
+/**
+ * Note headers[header_count] in the known-header index if it is one.
+ */
+static void index_known_header(http_request_t *req)
+{
+    const http_slice_t *name = &req->headers[req->header_count].name;
+
+    // The first occurrence wins, as with http_find_header()
+    for (int id = 0; id < HTTP_HDR_COUNT; id++)
+    {
+        if (name->len == known_headers[id].len &&
+            strncasecmp(name->ptr, known_headers[id].name, name->len) == 0)
+        {
+            if (!req->known[id])
+                req->known[id] = (unsigned char)(req->header_count + 1);
+            break;
+        }
+    }
+}
+
+static void finish_header_name(http_request_t *req, const char *buf, size_t end)
+{
+    set_slice(&req->headers[req->header_count].name, buf, req->mark, end);
+    index_known_header(req);
+}
+
+static void finish_header_value(http_request_t *req, const char *buf, size_t end)
+{
+    // Trim trailing whitespace (OWS) off the field value
+    while (end > req->mark && (buf[end - 1] == ' ' || buf[end - 1] == '\t'))
+        end--;
+    set_slice(&req->headers[req->header_count].value, buf, req->mark, end);
+    req->header_count++;
+}
+
+int http_parse_request(http_request_t *req, const char *buf, size_t len)
+{
+    size_t pos = req->pos;
+
+    for (; pos < len; pos++)
+    {
+        char c = buf[pos];
+
+        switch (req->state)
+        {
+        case S_START:
+            if (c == '\r' || c == '\n')
+                break;
+            req->mark = pos;
+            req->state = S_METHOD;
+            // fall through
+        case S_METHOD:
+            if (c == ' ')
+            {
+                if (pos == req->mark)
+                    return HTTP_PARSE_ERROR;
+                set_slice(&req->method, buf, req->mark, pos);
+                req->state = S_PATH_START;
+            }
+            else if (c < 'A' || c > 'Z' || pos - req->mark >= MAX_METHOD_LEN)
+            {
+                return HTTP_PARSE_ERROR;
+            }
+            break;
+
+        case S_PATH_START:
+            if (c == ' ')
+                break;
+            req->mark = pos;
+            req->state = S_PATH;
+            // fall through
+        case S_PATH:
+            pos = scan_token(buf, pos, len, ' ');
+            if (pos == len)
+                goto need_more;
+            if (buf[pos] != ' ')
+                return HTTP_PARSE_ERROR;
+            set_slice(&req->path, buf, req->mark, pos);
+            req->state = S_VERSION_START;
+            break;
+
+        case S_VERSION_START:
+            if (c == ' ')
+                break;
+            req->mark = pos;
+            req->state = S_VERSION;
+            // fall through
+        case S_VERSION:
+            if (c == '\r' || c == '\n')
+            {
+                set_slice(&req->version, buf, req->mark, pos);
+                req->http_version = parse_version(req->version.ptr, req->version.len);
+                if (req->http_version < 0)
+                    return HTTP_PARSE_ERROR;
+                req->state = (c == '\r') ? S_LINE_LF : S_HEADER_START;
+            }
+            break;
+
+        case S_LINE_LF:
+            if (c != '\n')
+                return HTTP_PARSE_ERROR;
+            req->state = S_HEADER_START;
+            break;
+
+        case S_HEADER_START:
+            if (c == '\r')
+            {
+                req->state = S_END_LF;
+                break;
+            }
+            if (c == '\n')
+            {
+                req->state = S_DONE;
+                req->pos = pos + 1;
+                return (int)req->pos;
+            }
+            // obs-fold continuation lines are rejected (RFC 7230 3.2.4)
+            if (c == ' ' || c == '\t' || c == ':')
+                return HTTP_PARSE_ERROR;
+            if (req->header_count >= HTTP_MAX_HEADERS)
+                return HTTP_PARSE_ERROR;
+            req->mark = pos;
+            req->state = S_HEADER_NAME;
+            break;
+
+        case S_HEADER_NAME:
+            pos = scan_token(buf, pos, len, ':');
+            if (pos == len)
+                goto need_more;
+            if (buf[pos] != ':')
+                return HTTP_PARSE_ERROR;
+            finish_header_name(req, buf, pos);
+            req->state = S_HEADER_VALUE_START;
+            break;
+
+        case S_HEADER_VALUE_START:
+            if (c == ' ' || c == '\t')
+                break;
+            req->mark = pos;
+            req->state = S_HEADER_VALUE;
+            // fall through
+        case S_HEADER_VALUE:
+            pos = scan_value(buf, pos, len);
+            if (pos == len)
+                goto need_more;
+            c = buf[pos];
+            if (c != '\r' && c != '\n')
+                return HTTP_PARSE_ERROR;  // control byte inside the value
+            finish_header_value(req, buf, pos);
+            req->state = (c == '\r') ? S_HEADER_LF : S_HEADER_START;
+            break;
+
+        case S_HEADER_LF:
+            if (c != '\n')
+                return HTTP_PARSE_ERROR;
+            req->state = S_HEADER_START;
+            break;
+
+        case S_END_LF:
+            if (c != '\n')
+                return HTTP_PARSE_ERROR;
+            req->state = S_DONE;
+            req->pos = pos + 1;
+            return (int)req->pos;
+
+        case S_DONE:
+            return (int)req->pos;
+        }
+    }
+
+need_more:
+    req->pos = pos;
+    return HTTP_PARSE_AGAIN;
+}
+
+int http_request_add_header(http_request_t *req, const char *name, size_t name_len,
+                            const char *value, size_t value_len)
+{
+    if (req->header_count >= HTTP_MAX_HEADERS)
+        return -1;
+    http_header_t *header = &req->headers[req->header_count];
+    header->name.ptr = name;
+    header->name.len = name_len;
+    header->value.ptr = value;
+    header->value.len = value_len;
+    index_known_header(req);
+    req->header_count++;
+    return 0;
+}
+
+const http_slice_t *http_get_header(const http_request_t *req, http_known_header_t id)
+{
+    int slot = req->known[id];
+    return slot ? &req->headers[slot - 1].value : NULL;
+}
+
+const http_slice_t *http_find_header(const http_request_t *req, const char *name)
+{
+    for (int i = 0; i < req->header_count; i++)
+    {
+        if (http_slice_case_equals(&req->headers[i].name, name))
+            return &req->headers[i].value;
+    }
+    return NULL;
+}
+
+int http_slice_equals(const http_slice_t *slice, const char *str)
+{
+    size_t len = strlen(str);
+    return slice->len == len && memcmp(slice->ptr, str, len) == 0;
+}
+
+int http_slice_case_equals(const http_slice_t *slice, const char *str)
+{
+    size_t len = strlen(str);
+    return slice->len == len && strncasecmp(slice->ptr, str, len) == 0;
+}
+
+int http_has_token(const http_slice_t *list, const char *token, size_t len)
+{
+    const char *p = list->ptr, *end = list->ptr + list->len;
+    while (p < end)
+    {
+        while (p < end && (*p == ',' || *p == ' ' || *p == '\t'))
+            p++;
+        const char *start = p;
+        while (p < end && *p != ',')
+            p++;
+        const char *stop = p;
+        while (stop > start && (stop[-1] == ' ' || stop[-1] == '\t'))
+            stop--;
+        if ((size_t)(stop - start) == len && strncasecmp(start, token, len) == 0)
+            return 1;
+    }
+    return 0;
+}
+
+int http_content_length(const http_request_t *req, uint64_t *len)
+{
+    const http_slice_t *value = NULL;
+    for (int i = 0; i < req->header_count; i++)
+    {
+        if (!http_slice_case_equals(&req->headers[i].name, "Content-Length"))
+            continue;
+        if (value)
+            return -1;
+        value = &req->headers[i].value;
+    }
+    if (!value)
+        return 0;
+
+    uint64_t n = 0;
+    if (value->len == 0 || value->len > 18)
+        return -1;
+    for (size_t i = 0; i < value->len; i++)
+    {
+        if (value->ptr[i] < '0' || value->ptr[i] > '9')
+            return -1;
+        n = n * 10 + (value->ptr[i] - '0');
+    }
+    *len = n;
+    return 1;
+}
@@ -0,0 +1,119 @@
+/**
+ * @file http_parser.h
+ * @brief HTTP Server - Incremental HTTP Request Parser Interface
+ * @version 1.0.0
+ * @date 2025-06-07
+ * @author David Dev (@DavidDevGt)
+ * 
+ * @description
+ * Resumable state-machine parser for HTTP/1.x request heads. The parser is
+ * fed the connection's read buffer after every recv() and continues where
+ * it stopped last time. Method, path, version and headers are returned as
+ * slices pointing into that buffer; nothing is copied.
+ * 
+ * The buffer must not move or be compacted while a request is only
+ * partially parsed. Once a request completes, the caller consumes its
+ * bytes and calls http_request_reset().
+ * 
+ * @license MIT License
+ */
+
+#ifndef HTTP_PARSER_H
+#define HTTP_PARSER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define HTTP_MAX_HEADERS 32
+
+// Return codes of http_parse_request(); a positive value is the length
+// of the complete request head in bytes.
+#define HTTP_PARSE_AGAIN 0
+#define HTTP_PARSE_ERROR -1
+
+typedef struct {
+    const char *ptr;
+    size_t len;
+} http_slice_t;
+
+typedef struct {
+    http_slice_t name;
+    http_slice_t value;
+} http_header_t;
+
+// Headers the server acts on; located once while parsing, so looking
+// one up is an array access rather than a scan of every field name
+typedef enum {
+    HTTP_HDR_CONNECTION = 0,
+    HTTP_HDR_HOST,
+    HTTP_HDR_ACCEPT_ENCODING,
+    HTTP_HDR_IF_NONE_MATCH,
+    HTTP_HDR_IF_MODIFIED_SINCE,
+    HTTP_HDR_IF_RANGE,
+    HTTP_HDR_RANGE,
+    HTTP_HDR_CONTENT_LENGTH,
+    HTTP_HDR_COUNT
+} http_known_header_t;
+
+typedef struct {
+    int state;
+    size_t pos;   // next byte to examine
+    size_t mark;  // start of the token being scanned
+    http_slice_t method;
+    http_slice_t path;
+    http_slice_t version;
+    http_header_t headers[HTTP_MAX_HEADERS];
+    int header_count;
+    int http_version;  // 10 or 11, 20 for an HTTP/2 stream
+    unsigned char known[HTTP_HDR_COUNT];  // index into headers + 1, 0 = absent
+} http_request_t;
+
+/**
+ * Select the fastest delimiter scanner for this CPU; call once at startup.
+ */
+void http_parser_init(void);
+
+/**
+ * Name of the scanner in use: "avx2", "sse2" or "scalar".
+ */
+const char *http_parser_scanner(void);
+
+/**
+ * Force a scanner by name, for tests and benchmarks that compare them;
+ * call before any request is parsed.
+ * @return: 0 on success, -1 if this build or CPU does not have it
+ */
+int http_parser_use_scanner(const char *name);
+
+void http_request_reset(http_request_t *req);
+int http_parse_request(http_request_t *req, const char *buf, size_t len);
+
+/**
+ * Append a header to a request that does not come from the parser (an
+ * HTTP/2 stream); known headers are indexed as the parser would.
+ * @return: 0 on success, -1 if HTTP_MAX_HEADERS are already set
+ */
+int http_request_add_header(http_request_t *req, const char *name, size_t name_len,
+                            const char *value, size_t value_len);
+
+const http_slice_t *http_get_header(const http_request_t *req, http_known_header_t id);
+const http_slice_t *http_find_header(const http_request_t *req, const char *name);
+int http_slice_equals(const http_slice_t *slice, const char *str);
+int http_slice_case_equals(const http_slice_t *slice, const char *str);
+
+/**
+ * Whether a comma-separated header value (Connection, for one) lists the
+ * token; tokens compare case-insensitively, whitespace around them aside.
+ */
+int http_has_token(const http_slice_t *list, const char *token, size_t len);
+
+/**
+ * Body length the request declares. More than one Content-Length field,
+ * or one that is not a plain decimal number, is an error even when the
+ * values agree: whoever framed the body before us may have read another
+ * one (RFC 7230 3.3.3).
+ * @return: 1 with *len set, 0 if there is none, -1 if it is invalid
+ */
+int http_content_length(const http_request_t *req, uint64_t *len);
+
+#endif // HTTP_PARSER_H
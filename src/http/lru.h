@@ -0,0 +1,59 @@
+/**
+ * @file lru.h
+ * @brief HTTP Server - Intrusive LRU List
+ * @version 1.0.0
+ * @date 2025-06-07
+ * @author David Dev (@DavidDevGt)
+ *
+ * @description
+ * The recency list shared by the file cache and the open-file cache. An
+ * entry embeds an lru_link_t and the list links those; LRU_ENTRY() gets
+ * back from a link to its entry. Nothing is allocated and nothing is
+ * locked: each worker keeps its own lists.
+ *
+ * @license MIT License
+ */
+
+#ifndef LRU_H
+#define LRU_H
+
+#include <stddef.h>
+
+typedef struct lru_link {
+    struct lru_link *prev;
+    struct lru_link *next;
+} lru_link_t;
+
+typedef struct {
+    lru_link_t *head;       // most recently used
+    lru_link_t *tail;       // next to evict
+} lru_list_t;
+
+#define LRU_ENTRY(link, type, member) \
+    ((type *)((char *)(link) - offsetof(type, member)))
+
+static inline void lru_unlink(lru_list_t *list, lru_link_t *link)
+{
+    if (link->prev)
+        link->prev->next = link->next;
+    else
+        list->head = link->next;
+    if (link->next)
+        link->next->prev = link->prev;
+    else
+        list->tail = link->prev;
+    link->prev = link->next = NULL;
+}
+
+static inline void lru_push_front(lru_list_t *list, lru_link_t *link)
+{
+    link->prev = NULL;
+    link->next = list->head;
+    if (list->head)
+        list->head->prev = link;
+    list->head = link;
+    if (!list->tail)
+        list->tail = link;
+}
+
+#endif // LRU_H
@@ -0,0 +1,48 @@
+/**
+ * @file mime.c
+ * @brief HTTP Server - MIME Type Lookup Implementation
+ * @version 1.0.0
+ * @date 2025-06-07
+ * @author David Dev (@DavidDevGt)
+ *
+ * @description
+ * The table itself is build/mime_table.h, generated by `make` from
+ * src/http/mime.types; edit that file to add a type.
+ *
+ * @license MIT License
+ */
+
+#include "mime.h"
+#include <string.h>
+#include <strings.h>  // for strncasecmp
+
+typedef struct {
+    const char *ext;        // lower case
+    size_t len;
+    const char *type;
+} mime_entry_t;
+
+#include "mime_table.h"    // MIME_BUCKET_BITS, MIME_SLOT_BITS, mime_entries,
+                           // mime_displace, mime_slots
+
+const char *mime_type(const char *path)
+{
+    const char *dot = strrchr(path, '.');
+    if (!dot)
+        return MIME_DEFAULT;
+    const char *ext = dot + 1;
+    size_t len = strlen(ext);
+    // A dot in a directory name is not an extension
+    if (len == 0 || len >= MIME_EXT_MAX || memchr(ext, '/', len))
+        return MIME_DEFAULT;
+
+    uint64_t hash = mime_ext_hash(ext, len);
+    uint32_t displace = mime_displace[mime_bucket(hash, MIME_BUCKET_BITS)];
+    unsigned index = mime_slots[mime_slot(hash, displace, MIME_SLOT_BITS)];
+    if (index == 0)
+        return MIME_DEFAULT;
+    const mime_entry_t *entry = &mime_entries[index - 1];
+    if (entry->len != len || strncasecmp(entry->ext, ext, len) != 0)
+        return MIME_DEFAULT;
+    return entry->type;
+}
@@ -0,0 +1,73 @@
+/**
+ * @file mime.h
+ * @brief HTTP Server - MIME Type Lookup Interface
+ * @version 1.0.0
+ * @date 2025-06-07
+ * @author David Dev (@DavidDevGt)
+ *
+ * @description
+ * Content-Type by file extension from a perfect-hash table generated at
+ * build time: tools/mimegen.c reads src/http/mime.types (the usual
+ * "type ext ext..." format) and builds a hash-and-displace table. An
+ * extension's hash picks a bucket, and the bucket's displacement, mixed
+ * into the hash, picks a slot; the generator chooses one displacement
+ * per bucket so that every extension gets a slot of its own. A lookup is
+ * one hash over the extension, two table reads, two multiplies and one
+ * string compare, whatever the size of the table.
+ *
+ * @license MIT License
+ */
+
+#ifndef MIME_H
+#define MIME_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "fnv.h"
+
+#define MIME_EXT_MAX 16                         // longer extensions are never in the table
+#define MIME_DEFAULT "application/octet-stream"
+
+/**
+ * FNV-1a over the extension with ASCII letters folded to lower case.
+ * Shared with the generator, so both sides hash alike.
+ */
+static inline uint64_t mime_ext_hash(const char *ext, size_t len)
+{
+    uint64_t hash = FNV_OFFSET;
+    for (size_t i = 0; i < len; i++)
+    {
+        unsigned char c = (unsigned char)ext[i];
+        if (c >= 'A' && c <= 'Z')
+            c += 'a' - 'A';
+        hash = fnv1a_step(hash, c);
+    }
+    return hash;
+}
+
+/**
+ * Bucket of an extension hash in a table of 1 << bits buckets; bits is
+ * 1 to 32, so the shift stays below the width of the hash.
+ */
+static inline uint32_t mime_bucket(uint64_t hash, int bits)
+{
+    return (uint32_t)((hash * 0xff51afd7ed558ccdULL) >> (64 - bits));
+}
+
+/**
+ * Slot of an extension hash under its bucket's displacement, in a table
+ * of 1 << bits slots.
+ */
+static inline uint32_t mime_slot(uint64_t hash, uint32_t displace, int bits)
+{
+    hash ^= (uint64_t)displace * 0x9e3779b97f4a7c15ULL;
+    return (uint32_t)(((hash ^ (hash >> 29)) * 0xc4ceb9fe1a85ec53ULL) >> (64 - bits));
+}
+
+/**
+ * Content-Type for a file path, by the extension after its last '.';
+ * MIME_DEFAULT when there is none or it is unknown.
+ */
+const char *mime_type(const char *path);
+
+#endif // MIME_H
@@ -0,0 +1,195 @@
+/**
+ * @file open_file_cache.c
+ * @brief HTTP Server - Open File Descriptor Cache Implementation
+ * @version 1.0.0
+ * @date 2025-06-07
+ * @author David Dev (@DavidDevGt)
+ *
+ * @description
+ * Same layout as the content cache: a per-worker hash table plus an LRU
+ * list, entries reference counted so a descriptor stays open while a
+ * response still streams from it. Senders share the descriptor; sendfile()
+ * and io_uring reads take explicit offsets, so no file position is shared.
+ *
+ * A file that changes within the validity window is still served with
+ * its old stat data; a body that shrank ends the connection (see
+ * outq_flush), one that changed in place keeps its old ETag until the
+ * next revalidation.
+ *
+ * @license MIT License
+ */
+
+#define _GNU_SOURCE  // for strdup
+
+#include "open_file_cache.h"
+#include "http_handler.h"
+#include "mime.h"
+#include "fnv.h"
+#include "../core/config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+static __thread open_file_t *buckets[OPEN_FILE_CACHE_BUCKETS];
+static __thread lru_list_t lru;
+static __thread int entry_count;
+
+static unsigned int hash_path(const char *path)
+{
+    return fnv1a_str(path) % OPEN_FILE_CACHE_BUCKETS;
+}
+
+static void free_file(open_file_t *file)
+{
+    if (file->fd >= 0)
+        close(file->fd);
+    free(file->url_path);
+    free(file->resolved_path);
+    free(file);
+}
+
+static void detach_file(open_file_t *file)
+{
+    open_file_t **link = &buckets[hash_path(file->url_path)];
+    while (*link && *link != file)
+        link = &(*link)->hash_next;
+    if (*link)
+        *link = file->hash_next;
+    lru_unlink(&lru, &file->lru);
+    entry_count--;
+    file->detached = 1;
+    open_file_release(file);
+}
+
+static int is_fresh(open_file_t *file, time_t now, const runtime_config_t *cfg)
+{
+    if (file->generation != cfg->generation)
+        return 0;
+    if (now - file->validated_at < cfg->open_file_valid)
+        return 1;
+    if (file->fd < 0)
+        return 0; // negative entries just expire
+
+    struct stat st;
+    if (stat(file->resolved_path, &st) < 0 ||
+        st.st_mtime != file->st.st_mtime ||
+        st.st_size != file->st.st_size ||
+        st.st_ino != file->st.st_ino)
+        return 0;
+
+    file->validated_at = now;
+    return 1;
+}
+
+/**
+ * Map a URL path below the document root to an open regular file.
+ * @return: 1 if found, 0 if there is no such file (cacheable),
+ *          -1 on a transient failure such as running out of descriptors
+ */
+static int resolve(open_file_t *file, const char *root)
+{
+    char requested_path[PATH_MAX];
+    int path_len = snprintf(requested_path, sizeof(requested_path), "%s%s",
+                            root, file->url_path);
+    if (path_len < 0 || (size_t)path_len >= sizeof(requested_path))
+        return 0;
+    char resolved_path[PATH_MAX];
+    if (!realpath(requested_path, resolved_path))
+        return errno == ENOMEM ? -1 : 0;
+
+    // The resolved path must stay within the document root
+    size_t root_len = strlen(root);
+    if (strncmp(resolved_path, root, root_len) != 0 ||
+        (resolved_path[root_len] != '/' && resolved_path[root_len] != '\0'))
+        return 0;
+
+    int fd = open(resolved_path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return (errno == EMFILE || errno == ENFILE || errno == ENOMEM) ? -1 : 0;
+    if (fstat(fd, &file->st) < 0 || !S_ISREG(file->st.st_mode))
+    {
+        close(fd);
+        return 0;
+    }
+
+    file->resolved_path = strdup(resolved_path);
+    if (!file->resolved_path)
+    {
+        close(fd);
+        return -1;
+    }
+    file->fd = fd;
+    file->mime = mime_type(resolved_path);
+    return 1;
+}
+
+open_file_t *open_file_get(const char *url_path)
+{
+    const runtime_config_t *cfg = config_current();
+    time_t now = time(NULL);
+
+    open_file_t *file = buckets[hash_path(url_path)];
+    while (file && strcmp(file->url_path, url_path) != 0)
+        file = file->hash_next;
+    if (file && !is_fresh(file, now, cfg))
+    {
+        detach_file(file);
+        file = NULL;
+    }
+    if (file)
+    {
+        lru_unlink(&lru, &file->lru);
+        lru_push_front(&lru, &file->lru);
+        if (file->fd < 0)
+            return NULL;
+        file->refcount++;
+        return file;
+    }
+
+    file = calloc(1, sizeof(*file));
+    if (!file)
+        return NULL;
+    file->fd = -1;
+    file->refcount = 1;
+    file->validated_at = now;
+    file->generation = cfg->generation;
+    file->url_path = strdup(url_path);
+    int found = file->url_path ? resolve(file, cfg->root) : -1;
+
+    if (found < 0 || server_config.open_file_cache == 0)
+    {
+        // Not cached: the caller's reference is the only one
+        file->detached = 1;
+        if (found > 0)
+            return file;
+        free_file(file);
+        return NULL;
+    }
+
+    unsigned int bucket = hash_path(url_path);
+    file->hash_next = buckets[bucket];
+    buckets[bucket] = file;
+    lru_push_front(&lru, &file->lru);
+    entry_count++;
+    while (entry_count > server_config.open_file_cache && lru.tail != &file->lru)
+        detach_file(LRU_ENTRY(lru.tail, open_file_t, lru));
+
+    if (!found)
+        return NULL;
+    file->refcount++;
+    return file;
+}
+
+void open_file_retain(open_file_t *file)
+{
+    file->refcount++;
+}
+
+void open_file_release(open_file_t *file)
+{
+    if (--file->refcount == 0 && file->detached)
+        free_file(file);
+}
@@ -0,0 +1,55 @@
+/**
+ * @file open_file_cache.h
+ * @brief HTTP Server - Open File Descriptor Cache Interface
+ * @version 1.0.0
+ * @date 2025-06-07
+ * @author David Dev (@DavidDevGt)
+ *
+ * @description
+ * Per-worker cache of URL path -> open descriptor, stat data and MIME
+ * type, so files too large for the content cache are served without
+ * realpath/open/fstat/close on every request. Paths that do not lead to
+ * a servable file are cached too, so repeated 404 probes stay out of the
+ * filesystem.
+ *
+ * Entries are revalidated with one stat() per open-file-cache-valid
+ * seconds, negative ones simply expire after that interval. The cache
+ * holds at most open-file-cache entries per worker, evicted in LRU order.
+ *
+ * @license MIT License
+ */
+
+#ifndef OPEN_FILE_CACHE_H
+#define OPEN_FILE_CACHE_H
+
+#include <time.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include "lru.h"
+
+#define OPEN_FILE_CACHE_BUCKETS 1024
+
+typedef struct open_file {
+    char *url_path;
+    char *resolved_path;      // NULL for a negative entry
+    int fd;                   // -1 for a negative entry
+    struct stat st;
+    const char *mime;
+    time_t validated_at;
+    unsigned generation;      // configuration the path was resolved under
+    int refcount;             // cache's own reference plus in-flight sends
+    int detached;             // evicted/stale, freed at refcount 0
+    struct open_file *hash_next;
+    lru_link_t lru;
+} open_file_t;
+
+/**
+ * Resolve a URL path ("/" is not mapped, pass the file's path) below the
+ * document root and open it, answering from the cache when possible.
+ * @return: a referenced entry, or NULL if there is no such regular file
+ */
+open_file_t *open_file_get(const char *url_path);
+void open_file_retain(open_file_t *file);
+void open_file_release(open_file_t *file);
+
+#endif // OPEN_FILE_CACHE_H
@@ -0,0 +1,444 @@
+/**
+ * @file output_queue.c
+ * @brief HTTP Server - Per-Connection Output Queue Implementation
+ * @version 1.0.0
+ * @date 2025-06-07
+ * @author David Dev (@DavidDevGt)
+ * 
+ * @description
+ * Ring of pending response chunks with batched, non-blocking flushing.
+ * outq_flush() returns as soon as the socket stops accepting data; the
+ * caller resumes it on the next writable event. It also stops once the
+ * caller's byte budget is spent, so one connection streaming a large body
+ * cannot hold the event loop; the caller then resumes it on a later pass.
+ * 
+ * @license MIT License
+ */
+
+#define _GNU_SOURCE  // for sendfile and MSG_MORE
+
+#include "output_queue.h"
+#include "../core/metrics.h"
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/sendfile.h>
+#include <sys/uio.h>
+
+void outq_init(output_queue_t *q)
+{
+    q->chunks = NULL;
+    q->head = 0;
+    q->count = 0;
+    q->arena = NULL;
+    q->arena_used = 0;
+    q->total_queued = 0;
+}
+
+void outq_attach(output_queue_t *q, void *storage)
+{
+    q->chunks = storage;
+    q->arena = (char *)storage + OUTQ_MAX_CHUNKS * sizeof(out_chunk_t);
+}
+
+void *outq_detach(output_queue_t *q)
+{
+    void *storage = q->chunks;
+    q->chunks = NULL;
+    q->arena = NULL;
+    return storage;
+}
+
+static out_chunk_t *front(output_queue_t *q)
+{
+    return &q->chunks[q->head];
+}
+
+void outq_chunk_release(out_chunk_t *chunk)
+{
+    if (chunk->type == OUT_FILE && chunk->file)
+        open_file_release(chunk->file);
+    else if (chunk->type == OUT_FILE && chunk->file_fd >= 0)
+        close(chunk->file_fd);
+    if (chunk->type == OUT_MEM && chunk->entry)
+        file_cache_release(chunk->entry);
+    if (chunk->type == OUT_MEM && chunk->owned)
+        free(chunk->owned);
+}
+
+/**
+ * Drop the front chunk; its references are the caller's business.
+ */
+static void unlink_front(output_queue_t *q)
+{
+    q->head = (q->head + 1) % OUTQ_MAX_CHUNKS;
+    q->count--;
+    if (q->count == 0)
+    {
+        q->head = 0;
+        q->arena_used = 0; // nothing points into the arena any more
+    }
+}
+
+static void pop_front(output_queue_t *q)
+{
+    outq_chunk_release(front(q));
+    unlink_front(q);
+}
+
+int outq_pop(output_queue_t *q, out_chunk_t *chunk)
+{
+    if (q->count == 0)
+        return -1;
+    *chunk = *front(q);
+    unlink_front(q);
+    return 0;
+}
+
+void outq_release(output_queue_t *q)
+{
+    while (q->count > 0)
+        pop_front(q);
+}
+
+int outq_empty(const output_queue_t *q)
+{
+    return q->count == 0;
+}
+
+int outq_has_room(const output_queue_t *q)
+{
+    // A response needs at most three chunks (head, body, spare)
+    return q->count <= OUTQ_MAX_CHUNKS - 3 &&
+           q->arena_used + OUTQ_RESERVE <= OUTQ_ARENA_SIZE;
+}
+
+int outq_free_chunks(const output_queue_t *q)
+{
+    return OUTQ_MAX_CHUNKS - q->count;
+}
+
+size_t outq_arena_free(const output_queue_t *q)
+{
+    return OUTQ_ARENA_SIZE - q->arena_used;
+}
+
+static out_chunk_t *push_back(output_queue_t *q)
+{
+    if (q->count == OUTQ_MAX_CHUNKS)
+        return NULL;
+    out_chunk_t *chunk = &q->chunks[(q->head + q->count) % OUTQ_MAX_CHUNKS];
+    q->count++;
+    memset(chunk, 0, sizeof(*chunk));
+    chunk->file_fd = -1;
+    return chunk;
+}
+
+int outq_push_mem(output_queue_t *q, const char *data, size_t len, file_cache_entry_t *entry)
+{
+    out_chunk_t *chunk = push_back(q);
+    if (!chunk)
+        return -1;
+    chunk->type = OUT_MEM;
+    chunk->data = data;
+    chunk->len = len;
+    chunk->entry = entry;
+    q->total_queued += len;
+    return 0;
+}
+
+int outq_push_owned(output_queue_t *q, const char *data, size_t len, char *owned)
+{
+    // `data` may point anywhere inside `owned`; earlier chunks may borrow
+    // from the same block since chunks are retired in order
+    if (outq_push_mem(q, data, len, NULL) < 0)
+    {
+        free(owned);
+        return -1;
+    }
+    q->chunks[(q->head + q->count - 1) % OUTQ_MAX_CHUNKS].owned = owned;
+    return 0;
+}
+
+int outq_push_file(output_queue_t *q, int file_fd, off_t offset, size_t len)
+{
+    out_chunk_t *chunk = push_back(q);
+    if (!chunk)
+        return -1;
+    chunk->type = OUT_FILE;
+    chunk->file_fd = file_fd;
+    chunk->offset = offset;
+    chunk->remaining = len;
+    q->total_queued += len;
+    return 0;
+}
+
+int outq_push_open_file(output_queue_t *q, open_file_t *file, off_t offset, size_t len)
+{
+    // Takes over the caller's reference once queued; the descriptor stays
+    // with the cache
+    if (outq_push_file(q, file->fd, offset, len) < 0)
+        return -1;
+    q->chunks[(q->head + q->count - 1) % OUTQ_MAX_CHUNKS].file = file;
+    return 0;
+}
+
+/**
+ * Queue the n bytes just written at the arena's free end.
+ */
+static int commit_arena(output_queue_t *q, char *dst, size_t n)
+{
+    // Extend the previous arena chunk if these bytes directly follow it
+    if (q->count > 0)
+    {
+        out_chunk_t *last = &q->chunks[(q->head + q->count - 1) % OUTQ_MAX_CHUNKS];
+        if (last->type == OUT_MEM && !last->entry && !last->owned && last->data + last->len == dst)
+        {
+            last->len += n;
+            q->arena_used += n;
+            q->total_queued += n;
+            return 0;
+        }
+    }
+
+    if (outq_push_mem(q, dst, n, NULL) < 0)
+        return -1;
+    q->arena_used += n;
+    return 0;
+}
+
+int outq_printf(output_queue_t *q, const char *fmt, ...)
+{
+    size_t space = OUTQ_ARENA_SIZE - q->arena_used;
+    char *dst = q->arena + q->arena_used;
+    va_list args;
+    va_start(args, fmt);
+    int n = vsnprintf(dst, space, fmt, args);
+    va_end(args);
+    if (n < 0 || (size_t)n >= space)
+        return -1;
+    return commit_arena(q, dst, n);
+}
+
+int outq_write(output_queue_t *q, const void *data, size_t len)
+{
+    if (len > OUTQ_ARENA_SIZE - q->arena_used)
+        return -1;
+    char *dst = q->arena + q->arena_used;
+    memcpy(dst, data, len);
+    return commit_arena(q, dst, len);
+}
+
+out_chunk_t *outq_front(output_queue_t *q)
+{
+    return q->count > 0 ? front(q) : NULL;
+}
+
+int outq_gather(output_queue_t *q, struct iovec *iov, int max_iov, int *file_follows)
+{
+    int iovcnt = 0;
+    *file_follows = 0;
+
+    for (int i = 0; i < q->count && iovcnt < max_iov; i++)
+    {
+        out_chunk_t *chunk = &q->chunks[(q->head + i) % OUTQ_MAX_CHUNKS];
+        if (chunk->type != OUT_MEM)
+        {
+            *file_follows = 1;
+            break;
+        }
+        iov[iovcnt].iov_base = (void *)chunk->data;
+        iov[iovcnt].iov_len = chunk->len;
+        iovcnt++;
+    }
+    return iovcnt;
+}
+
+void outq_consume_mem(output_queue_t *q, size_t sent)
+{
+    metrics_count_bytes_sent(sent);
+    // Retire fully sent chunks, then trim the partially sent one
+    while (q->count > 0 && front(q)->type == OUT_MEM && sent >= front(q)->len)
+    {
+        sent -= front(q)->len;
+        pop_front(q);
+    }
+    if (sent > 0)
+    {
+        front(q)->data += sent;
+        front(q)->len -= sent;
+    }
+}
+
+void outq_consume_file(output_queue_t *q, size_t sent)
+{
+    metrics_count_bytes_sent(sent);
+    out_chunk_t *chunk = front(q);
+    chunk->offset += sent;
+    chunk->remaining -= sent;
+    if (chunk->remaining == 0)
+        pop_front(q);
+}
+
+/**
+ * Send the run of in-memory chunks at the front of the queue with one
+ * sendmsg() call.
+ * @return: bytes sent, or -1 with errno set
+ */
+static ssize_t flush_mem_run(output_queue_t *q, int sockfd)
+{
+    struct iovec iov[OUTQ_MAX_IOV];
+    int file_follows;
+    int iovcnt = outq_gather(q, iov, OUTQ_MAX_IOV, &file_follows);
+
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = iov;
+    msg.msg_iovlen = iovcnt;
+
+    // MSG_MORE lets the kernel coalesce a head with the file body after it
+    return sendmsg(sockfd, &msg, MSG_NOSIGNAL | (file_follows ? MSG_MORE : 0));
+}
+
+int outq_flush(output_queue_t *q, int sockfd, size_t *budget)
+{
+    while (q->count > 0)
+    {
+        if (*budget == 0)
+            return 2;
+        out_chunk_t *chunk = front(q);
+
+        if (chunk->type == OUT_FILE)
+        {
+            if (chunk->remaining == 0)
+            {
+                pop_front(q);
+                continue;
+            }
+            // Zero-copy from the page cache
+            off_t offset = chunk->offset;
+            size_t count = chunk->remaining < *budget ? chunk->remaining : *budget;
+            ssize_t n = sendfile(sockfd, chunk->file_fd, &offset, count);
+            if (n < 0)
+            {
+                if (errno == EINTR)
+                    continue;
+                if (errno == EAGAIN || errno == EWOULDBLOCK)
+                    return 0;
+                return -1;
+            }
+            if (n == 0)
+                return -1; // file shrank underneath us
+            outq_consume_file(q, n);
+            *budget -= n;
+            continue;
+        }
+
+        ssize_t n = flush_mem_run(q, sockfd);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                return 0;
+            return -1;
+        }
+        outq_consume_mem(q, n);
+        // One sendmsg() may overshoot; the budget only decides the next write
+        *budget = (size_t)n < *budget ? *budget - n : 0;
+    }
+    return 1;
+}
+
+/**
+ * Copy the bytes at the front of the queue into buf: memory chunks as
+ * they are, file ranges read with pread(). Nothing is consumed, so a
+ * retry gathers the same bytes again (and possibly more after them).
+ * @return: bytes gathered, or -1 if a file could not be read
+ */
+static ssize_t gather_copy(output_queue_t *q, char *buf, size_t size)
+{
+    size_t len = 0;
+    for (int i = 0; i < q->count && len < size; i++)
+    {
+        const out_chunk_t *chunk = &q->chunks[(q->head + i) % OUTQ_MAX_CHUNKS];
+        size_t room = size - len;
+        if (chunk->type == OUT_MEM)
+        {
+            size_t n = chunk->len < room ? chunk->len : room;
+            memcpy(buf + len, chunk->data, n);
+            len += n;
+            continue;
+        }
+        size_t want = chunk->remaining < room ? chunk->remaining : room;
+        ssize_t n = want ? pread(chunk->file_fd, buf + len, want, chunk->offset) : 0;
+        if (n < 0 || (want > 0 && n == 0))
+            return len > 0 ? (ssize_t)len : -1; // file shrank underneath us
+        len += n;
+        if ((size_t)n < want)
+            break;
+    }
+    return len;
+}
+
+/**
+ * Retire `sent` bytes from the front of the queue, across chunk types.
+ */
+static void consume_copy(output_queue_t *q, size_t sent)
+{
+    metrics_count_bytes_sent(sent);
+    while (q->count > 0)
+    {
+        out_chunk_t *chunk = front(q);
+        size_t left = chunk->type == OUT_MEM ? chunk->len : chunk->remaining;
+        size_t n = sent < left ? sent : left;
+        if (chunk->type == OUT_MEM)
+        {
+            chunk->data += n;
+            chunk->len -= n;
+        }
+        else
+        {
+            chunk->offset += n;
+            chunk->remaining -= n;
+        }
+        sent -= n;
+        if (n < left)
+            break;
+        pop_front(q);
+    }
+}
+
+int outq_flush_copy(output_queue_t *q, outq_write_fn write_fn, void *ctx, size_t *budget)
+{
+    static __thread char bounce[OUTQ_COPY_SIZE];
+    while (q->count > 0)
+    {
+        if (*budget == 0)
+            return 2;
+        ssize_t len = gather_copy(q, bounce, sizeof(bounce));
+        if (len < 0)
+            return -1;
+        if (len == 0)
+        {
+            consume_copy(q, 0); // only empty chunks left
+            continue;
+        }
+        ssize_t n = write_fn(ctx, bounce, len);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                return 0;
+            return -1;
+        }
+        consume_copy(q, n);
+        *budget = (size_t)n < *budget ? *budget - n : 0;
+    }
+    return 1;
+}
@@ -0,0 +1,120 @@
+/**
+ * @file output_queue.h
+ * @brief HTTP Server - Per-Connection Output Queue Interface
+ * @version 1.0.0
+ * @date 2025-06-07
+ * @author David Dev (@DavidDevGt)
+ * 
+ * @description
+ * Ordered queue of response pieces for one connection. Responses to
+ * pipelined requests are appended back to back and flushed together:
+ * consecutive in-memory pieces go out in a single sendmsg() with an
+ * iovec per piece, file bodies go out with sendfile().
+ * 
+ * Small formatted pieces (status lines, headers, error bodies) live in a
+ * per-connection arena that is rewound whenever the queue drains.
+ * 
+ * @license MIT License
+ */
+
+#ifndef OUTPUT_QUEUE_H
+#define OUTPUT_QUEUE_H
+
+#include <stddef.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include "file_cache.h"
+#include "open_file_cache.h"
+
+#define OUTQ_MAX_CHUNKS 64
+#define OUTQ_ARENA_SIZE 4096
+#define OUTQ_COPY_SIZE 16384  // bytes per outq_flush_copy() write, one TLS record
+#define OUTQ_RESERVE 1024  // arena bytes one more response may need (FILE_HEAD_MAX)
+#define OUTQ_MAX_IOV 64
+
+typedef enum {
+    OUT_MEM,
+    OUT_FILE
+} out_chunk_type_t;
+
+typedef struct {
+    out_chunk_type_t type;
+    const char *data;           // OUT_MEM: next byte to send
+    size_t len;                 // OUT_MEM: bytes left
+    file_cache_entry_t *entry;  // OUT_MEM: reference dropped once sent
+    char *owned;                // OUT_MEM: heap block freed once sent
+    int file_fd;                // OUT_FILE: closed once sent, unless borrowed
+    open_file_t *file;          // OUT_FILE: owner of a borrowed fd, released once sent
+    off_t offset;               // OUT_FILE: next file byte
+    size_t remaining;           // OUT_FILE: bytes left
+} out_chunk_t;
+
+// Chunk ring followed by the arena, attached only while the queue is in use
+#define OUTQ_STORAGE_SIZE (OUTQ_MAX_CHUNKS * sizeof(out_chunk_t) + OUTQ_ARENA_SIZE)
+
+typedef struct {
+    out_chunk_t *chunks;        // OUTQ_MAX_CHUNKS entries, NULL while detached
+    int head;                   // ring index of the oldest chunk
+    int count;
+    char *arena;                // OUTQ_ARENA_SIZE bytes
+    size_t arena_used;
+    size_t total_queued;        // bytes ever queued, for per-response sizes
+} output_queue_t;
+
+void outq_init(output_queue_t *q);
+void outq_attach(output_queue_t *q, void *storage);  // OUTQ_STORAGE_SIZE bytes
+void *outq_detach(output_queue_t *q);                // queue must be empty
+void outq_release(output_queue_t *q);
+int outq_empty(const output_queue_t *q);
+int outq_has_room(const output_queue_t *q);
+int outq_free_chunks(const output_queue_t *q);
+size_t outq_arena_free(const output_queue_t *q);
+int outq_printf(output_queue_t *q, const char *fmt, ...);
+int outq_write(output_queue_t *q, const void *data, size_t len);  // copied into the arena
+int outq_push_mem(output_queue_t *q, const char *data, size_t len, file_cache_entry_t *entry);
+int outq_push_owned(output_queue_t *q, const char *data, size_t len, char *owned);
+int outq_push_file(output_queue_t *q, int file_fd, off_t offset, size_t len);
+int outq_push_open_file(output_queue_t *q, open_file_t *file, off_t offset, size_t len);
+/**
+ * Write queued chunks until the queue drains, the socket is full or about
+ * *budget bytes have gone out; the bytes written are taken off *budget.
+ * @return: 1 when empty, 0 when the socket would block, 2 when the budget
+ *          ran out first, -1 on error
+ */
+int outq_flush(output_queue_t *q, int sockfd, size_t *budget);
+
+/**
+ * Take the front chunk off the queue with its references, which pass to
+ * the caller; arena bytes it points to stay intact until the next write.
+ * @return: 0 on success, -1 if the queue is empty
+ */
+int outq_pop(output_queue_t *q, out_chunk_t *chunk);
+
+/**
+ * Drop the references held by a chunk that is no longer queued.
+ */
+void outq_chunk_release(out_chunk_t *chunk);
+
+/**
+ * Byte sink for outq_flush_copy(), with send() semantics: bytes written,
+ * or -1 with errno set (EAGAIN when it would block).
+ */
+typedef ssize_t (*outq_write_fn)(void *ctx, const void *data, size_t len);
+
+/**
+ * outq_flush() for a connection whose bytes must pass through user space
+ * (TLS without kernel offload): up to OUTQ_COPY_SIZE bytes of memory
+ * chunks and file ranges are copied into a per-worker buffer and handed
+ * to write_fn in one call. A partial or blocked write is retried later
+ * with the same bytes at the front.
+ * @return: same as outq_flush()
+ */
+int outq_flush_copy(output_queue_t *q, outq_write_fn write_fn, void *ctx, size_t *budget);
+
+// Building blocks for event backends that submit the I/O themselves
+out_chunk_t *outq_front(output_queue_t *q);
+int outq_gather(output_queue_t *q, struct iovec *iov, int max_iov, int *file_follows);
+void outq_consume_mem(output_queue_t *q, size_t sent);
+void outq_consume_file(output_queue_t *q, size_t sent);
+
+#endif // OUTPUT_QUEUE_H
@@ -0,0 +1,1272 @@
+/**
+ * @file proxy.c
+ * @brief HTTP Server - Reverse Proxy Implementation
+ * @version 1.0.0
+ * @date 2025-06-07
+ * @author David Dev (@DavidDevGt)
+ *
+ * @description
+ * An exchange goes through four phases:
+ * - SEND_REQUEST: the rewritten head, followed by whatever part of the
+ *   body was read with it, is written to the upstream
+ * - SEND_BODY: the rest of the body is spliced client -> pipe -> upstream
+ * - READ_HEAD: the response head is read and rewritten
+ * - SEND_RESPONSE: head and any body bytes read with it go to the client,
+ *   the rest is spliced upstream -> pipe -> client
+ *
+ * A TLS client whose records the kernel does not handle cannot take part
+ * in splice(): its socket carries ciphertext. Such an exchange copies
+ * instead. The body is read with tls_recv() and sent upstream from ibuf;
+ * the response is read into ibuf and goes out through the client's
+ * output queue, which tls_flush() encrypts. Phases and framing are the
+ * same either way.
+ *
+ * Hop-by-hop headers are dropped in both directions, and so are headers
+ * the sender's Connection names; X-Forwarded-For (the client's
+ * list plus its address) and X-Forwarded-Proto are added to the request.
+ * The upstream connection is asked to stay open and goes back to the
+ * pool once the response is complete by its own framing (Content-Length
+ * or chunked); a response delimited by closing the connection closes the
+ * client connection too.
+ * Chunked bodies are forwarded as they are: the chunk framing is tracked
+ * only to find the end, and chunk data is spliced like any other body.
+ *
+ * A request that a pooled connection fails before any response byte
+ * arrived (the upstream closed it while idle) is resent once on a fresh
+ * connection if it has no body and is idempotent. Any other failure
+ * before the response starts is answered with 502; after it started, the
+ * client connection is closed.
+ *
+ * @license MIT License
+ */
+
+#define _GNU_SOURCE  // for splice, memmem and pipe2
+
+#include "proxy.h"
+#include "http_handler.h"
+#include "../core/config.h"
+#include "../core/metrics.h"
+#include "../core/access_log.h"
+#include "../core/pool.h"
+#include "../core/tls.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>  // for strncasecmp
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <netdb.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <netinet/tcp.h>
+
+typedef struct {
+    char *prefix;
+    size_t prefix_len;
+    struct sockaddr_in addr;
+    char *authority;            // "host:port", the Host for requests without one
+} proxy_route_t;
+
+typedef enum {
+    PROXY_SEND_REQUEST,
+    PROXY_SEND_BODY,
+    PROXY_READ_HEAD,
+    PROXY_SEND_RESPONSE
+} proxy_phase_t;
+
+typedef enum {
+    BODY_NONE,                  // HEAD, 204, 304
+    BODY_LENGTH,                // Content-Length
+    BODY_CHUNKED,
+    BODY_UNTIL_CLOSE
+} body_framing_t;
+
+typedef enum {
+    CHUNK_SIZE,
+    CHUNK_EXT,                  // extensions up to the end of the size line
+    CHUNK_DATA,
+    CHUNK_DATA_END,             // CRLF after the data
+    CHUNK_TRAILER_START,
+    CHUNK_TRAILER_LINE,
+    CHUNK_LAST_LF,
+    CHUNK_DONE
+} chunk_state_t;
+
+typedef struct {
+    upstream_conn_t *up;
+    int route;
+    proxy_phase_t phase;
+    int reused;                 // upstream connection came from the pool
+    int copy;                   // client bytes pass through user space (TLS)
+    int retryable;              // no body and idempotent: may be sent again
+    int responded;              // a response byte arrived, no more retries
+    char *obuf;                 // request head, later the rewritten response head
+    size_t olen;
+    size_t osent;
+    char *ibuf;                 // bytes read from the upstream, not yet sent
+    size_t ilen;
+    size_t isent;
+    uint64_t body_left;         // request body bytes still in the client socket
+    int head_request;
+    int http_version;           // client's, also used towards the upstream
+    body_framing_t framing;
+    uint64_t resp_left;         // Content-Length left, or the current chunk's
+    chunk_state_t chunk_state;
+    int chunk_digits;
+    int eof;                    // BODY_UNTIL_CLOSE: the upstream closed
+    int upstream_keep_alive;    // connection can take another request
+    int keep_alive;             // client connection
+    int status;
+    size_t bytes_sent;          // response bytes written to the client
+    int client_reused;          // not the client connection's first request
+    uint64_t start_ns;
+    char method[ACCESS_LOG_METHOD_MAX];
+    size_t method_len;
+    char path[ACCESS_LOG_PATH_MAX];
+    size_t path_len;
+} proxy_exchange_t;
+
+// Outcome of one phase step
+#define STEP_AGAIN 0            // a socket would block
+#define STEP_NEXT 1             // phase done, go on
+#define STEP_YIELD 2            // budget spent
+#define STEP_DONE 3             // response complete
+#define STEP_CLIENT_ERROR -1    // close the client connection
+#define STEP_UPSTREAM_ERROR -2  // retry, or 502 if the response has not started
+
+#define PROXY_CONNECTION_MAX 8  // Connection headers in one response head
+
+static proxy_route_t routes[PROXY_MAX_ROUTES];
+static int route_count = 0;
+
+// Dropped when forwarding, in either direction (RFC 7230 6.1)
+static const char *const hop_by_hop[] = {
+    "Connection", "Keep-Alive", "Proxy-Connection", "TE", "Trailer",
+    "Transfer-Encoding", "Upgrade"
+};
+
+static const char *const idempotent_methods[] = {
+    "GET", "HEAD", "OPTIONS", "PUT", "DELETE", "TRACE"
+};
+
+int proxy_add_route(const char *spec)
+{
+    const char *eq = strchr(spec, '=');
+    const char *colon = eq ? strrchr(eq + 1, ':') : NULL;
+    if (!eq || spec[0] != '/' || !colon || colon == eq + 1 ||
+        route_count == PROXY_MAX_ROUTES)
+        return -1;
+    char *end;
+    long port = strtol(colon + 1, &end, 10);
+    if (colon[1] == '\0' || *end != '\0' || port < 1 || port > 65535)
+        return -1;
+
+    char host[256];
+    size_t host_len = colon - (eq + 1);
+    if (host_len >= sizeof(host))
+        return -1;
+    memcpy(host, eq + 1, host_len);
+    host[host_len] = '\0';
+
+    // Resolved once: a worker must never block on DNS
+    struct addrinfo hints = { .ai_family = AF_INET, .ai_socktype = SOCK_STREAM };
+    struct addrinfo *res;
+    int rc = getaddrinfo(host, NULL, &hints, &res);
+    if (rc != 0)
+    {
+        fprintf(stderr, "Cannot resolve upstream %s: %s\n", host, gai_strerror(rc));
+        return -1;
+    }
+
+    proxy_route_t *route = &routes[route_count];
+    memcpy(&route->addr, res->ai_addr, sizeof(route->addr));
+    route->addr.sin_port = htons((uint16_t)port);
+    freeaddrinfo(res);
+    route->prefix_len = eq - spec;
+    route->prefix = strndup(spec, route->prefix_len);
+    route->authority = strdup(eq + 1);
+    if (!route->prefix || !route->authority)
+    {
+        free(route->prefix);
+        free(route->authority);
+        return -1;
+    }
+    route_count++;
+    return 0;
+}
+
+int proxy_route_count(void)
+{
+    return route_count;
+}
+
+const char *proxy_route_prefix(int route)
+{
+    return routes[route].prefix;
+}
+
+void proxy_print_routes(void)
+{
+    for (int i = 0; i < route_count; i++)
+    {
+        char addr[INET_ADDRSTRLEN];
+        inet_ntop(AF_INET, &routes[i].addr.sin_addr, addr, sizeof(addr));
+        printf("Proxy: %s -> %s:%d\n", routes[i].prefix, addr, ntohs(routes[i].addr.sin_port));
+    }
+}
+
+static int name_equals(const char *name, size_t len, const char *str)
+{
+    return strlen(str) == len && strncasecmp(name, str, len) == 0;
+}
+
+static int is_hop_by_hop(const char *name, size_t len)
+{
+    for (size_t i = 0; i < sizeof(hop_by_hop) / sizeof(hop_by_hop[0]); i++)
+    {
+        if (name_equals(name, len, hop_by_hop[i]))
+            return 1;
+    }
+    return 0;
+}
+
+/**
+ * Whether one of the Connection header values names this header.
+ */
+static int listed_in(const http_slice_t *lists, int count, const char *name, size_t len)
+{
+    for (int i = 0; i < count; i++)
+    {
+        if (http_has_token(&lists[i], name, len))
+            return 1;
+    }
+    return 0;
+}
+
+/**
+ * Whether the client's Connection headers name this header (RFC 7230
+ * section 6.1): it belongs to the client's hop and is not forwarded.
+ */
+static int named_by_connection(const http_request_t *req, const char *name, size_t len)
+{
+    // The body and the route depend on these; no client gets to drop them
+    if (name_equals(name, len, "Content-Length") || name_equals(name, len, "Host"))
+        return 0;
+    for (int i = 0; i < req->header_count; i++)
+    {
+        const http_header_t *h = &req->headers[i];
+        if (name_equals(h->name.ptr, h->name.len, "Connection") &&
+            http_has_token(&h->value, name, len))
+            return 1;
+    }
+    return 0;
+}
+
+static int is_idempotent(const http_slice_t *method)
+{
+    for (size_t i = 0; i < sizeof(idempotent_methods) / sizeof(idempotent_methods[0]); i++)
+    {
+        if (http_slice_equals(method, idempotent_methods[i]))
+            return 1;
+    }
+    return 0;
+}
+
+static int is_digit(char c)
+{
+    return c >= '0' && c <= '9';
+}
+
+static int parse_length(const char *p, size_t len, uint64_t *out)
+{
+    uint64_t n = 0;
+    if (len == 0 || len > 18)
+        return -1;
+    for (size_t i = 0; i < len; i++)
+    {
+        if (!is_digit(p[i]))
+            return -1;
+        n = n * 10 + (p[i] - '0');
+    }
+    *out = n;
+    return 0;
+}
+
+static size_t obuf_size(void)
+{
+    return server_config.buffer_size + PROXY_HEAD_EXTRA;
+}
+
+static proxy_exchange_t *new_exchange(void)
+{
+    proxy_exchange_t *ex = pool_alloc(sizeof(*ex));
+    if (!ex)
+        return NULL;
+    memset(ex, 0, sizeof(*ex));
+    ex->obuf = pool_alloc(obuf_size());
+    ex->ibuf = pool_alloc(server_config.buffer_size);
+    if (!ex->obuf || !ex->ibuf)
+    {
+        pool_free(ex->obuf, obuf_size());
+        pool_free(ex->ibuf, server_config.buffer_size);
+        pool_free(ex, sizeof(*ex));
+        return NULL;
+    }
+    return ex;
+}
+
+static void free_exchange(proxy_exchange_t *ex)
+{
+    pool_free(ex->obuf, obuf_size());
+    pool_free(ex->ibuf, server_config.buffer_size);
+    pool_free(ex, sizeof(*ex));
+}
+
+static int append(proxy_exchange_t *ex, const char *data, size_t len)
+{
+    if (ex->olen + len > obuf_size())
+        return -1;
+    memcpy(ex->obuf + ex->olen, data, len);
+    ex->olen += len;
+    return 0;
+}
+
+static int append_str(proxy_exchange_t *ex, const char *str)
+{
+    return append(ex, str, strlen(str));
+}
+
+static int append_header(proxy_exchange_t *ex, const char *name, size_t name_len,
+                         const char *value, size_t value_len)
+{
+    if (append(ex, name, name_len) < 0 || append(ex, ": ", 2) < 0 ||
+        append(ex, value, value_len) < 0 || append(ex, "\r\n", 2) < 0)
+        return -1;
+    return 0;
+}
+
+/**
+ * Client address as text for X-Forwarded-For.
+ */
+static void peer_address(int fd, char *buf, size_t size)
+{
+    struct sockaddr_storage addr;
+    socklen_t len = sizeof(addr);
+    strcpy(buf, "unknown");
+    if (getpeername(fd, (struct sockaddr *)&addr, &len) < 0)
+        return;
+    if (addr.ss_family == AF_INET)
+        inet_ntop(AF_INET, &((struct sockaddr_in *)&addr)->sin_addr, buf, size);
+    else if (addr.ss_family == AF_INET6)
+        inet_ntop(AF_INET6, &((struct sockaddr_in6 *)&addr)->sin6_addr, buf, size);
+}
+
+/**
+ * Rewrite the request head into obuf, followed by the body bytes that
+ * were read with it. Content-Length is written anew from `length`, the
+ * declared body length, or left out if it is NULL.
+ * @return: 0 on success, -1 if it does not fit
+ */
+static int build_request(proxy_exchange_t *ex, client_info_t *client,
+                         const http_request_t *req, const uint64_t *length,
+                         const char *body, size_t body_len)
+{
+    char line[64];
+    snprintf(line, sizeof(line), " HTTP/1.%d\r\n", ex->http_version % 10);
+    if (append(ex, req->method.ptr, req->method.len) < 0 || append(ex, " ", 1) < 0 ||
+        append(ex, req->path.ptr, req->path.len) < 0 || append_str(ex, line) < 0)
+        return -1;
+
+    for (int i = 0; i < req->header_count; i++)
+    {
+        const http_header_t *h = &req->headers[i];
+        if (is_hop_by_hop(h->name.ptr, h->name.len) ||
+            name_equals(h->name.ptr, h->name.len, "Expect") ||
+            name_equals(h->name.ptr, h->name.len, "Content-Length") ||
+            name_equals(h->name.ptr, h->name.len, "X-Forwarded-Proto") ||
+            name_equals(h->name.ptr, h->name.len, "X-Forwarded-For") ||
+            named_by_connection(req, h->name.ptr, h->name.len))
+            continue;
+        if (append_header(ex, h->name.ptr, h->name.len, h->value.ptr, h->value.len) < 0)
+            return -1;
+    }
+
+    if (length)
+    {
+        char value[24];
+        int n = snprintf(value, sizeof(value), "%llu", (unsigned long long)*length);
+        if (append_header(ex, "Content-Length", 14, value, n) < 0)
+            return -1;
+    }
+
+    const char *authority = routes[ex->route].authority;
+    if (!http_get_header(req, HTTP_HDR_HOST) &&
+        append_header(ex, "Host", 4, authority, strlen(authority)) < 0)
+        return -1;
+
+    char peer[INET6_ADDRSTRLEN];
+    peer_address(client->fd, peer, sizeof(peer));
+    if (append_str(ex, "X-Forwarded-For: ") < 0)
+        return -1;
+    // Every hop so far, in order, then this client
+    for (int i = 0; i < req->header_count; i++)
+    {
+        const http_header_t *h = &req->headers[i];
+        if (name_equals(h->name.ptr, h->name.len, "X-Forwarded-For") && h->value.len > 0 &&
+            (append(ex, h->value.ptr, h->value.len) < 0 || append(ex, ", ", 2) < 0))
+            return -1;
+    }
+    if (append_str(ex, peer) < 0 ||
+        append_str(ex, client->tls ? "\r\nX-Forwarded-Proto: https\r\n"
+                                   : "\r\nX-Forwarded-Proto: http\r\n") < 0 ||
+        append_str(ex, "Connection: keep-alive\r\n\r\n") < 0)
+        return -1;
+    return append(ex, body, body_len);
+}
+
+/**
+ * Count the response as answered and write its access log record.
+ */
+static void record_exchange(client_info_t *client, proxy_exchange_t *ex, size_t bytes)
+{
+    metrics_count_request(ex->status, ex->client_reused);
+    if (!access_log_enabled)
+        return;
+    http_request_t logged;
+    logged.method.ptr = ex->method;
+    logged.method.len = ex->method_len;
+    logged.path.ptr = ex->path;
+    logged.path.len = ex->path_len;
+    access_log_record(&client->peer, client->fd, &logged, ex->status, bytes, ex->start_ns);
+}
+
+/**
+ * End the exchange: the upstream connection goes back to the pool if it
+ * is clean, the client connection carries on unless the response says
+ * otherwise.
+ */
+static void finish_exchange(client_info_t *client, proxy_exchange_t *ex)
+{
+    upstream_conn_t *up = ex->up;
+    if (ex->upstream_keep_alive && up->piped == 0)
+        upstream_release(up);
+    else
+        upstream_discard(up);
+    record_exchange(client, ex, ex->bytes_sent);
+    if (!ex->keep_alive)
+        client->close_after_send = 1;
+    client->proxy = NULL;
+    touch_client(client); // back on the keep-alive timeout
+    free_exchange(ex);
+}
+
+/**
+ * Nothing reached the client yet: answer 502 instead and close.
+ */
+static void fail_exchange(client_info_t *client, proxy_exchange_t *ex)
+{
+    if (log_verbose)
+        printf("Upstream %s failed for fd=%d\n", routes[ex->route].authority, client->fd);
+    if (ex->up)
+        upstream_discard(ex->up);
+    size_t queued_before = client->out.total_queued;
+    send_502(client, 0);
+    ex->status = client->status;
+    record_exchange(client, ex, client->out.total_queued - queued_before);
+    client->close_after_send = 1;
+    client->proxy = NULL;
+    touch_client(client);
+    free_exchange(ex);
+}
+
+int proxy_begin(client_info_t *client, const http_request_t *req, size_t *consumed,
+                int route, uint64_t start_ns)
+{
+    int keep_alive = http_keep_alive(client, req);
+
+    // Bodies must come with a length: the body is spliced through, and a
+    // chunked one would have to be parsed on the way. The upstream gets
+    // the one length the body was framed by, so it cannot read another.
+    uint64_t body_len = 0;
+    int has_length = http_content_length(req, &body_len);
+    if ((req->http_version >= 11 && !http_get_header(req, HTTP_HDR_HOST)) || has_length < 0)
+    {
+        send_400(client, 0);
+        return 0;
+    }
+    if (http_find_header(req, "Transfer-Encoding"))
+    {
+        send_411(client, 0);
+        return 0;
+    }
+    proxy_exchange_t *ex = new_exchange();
+    if (!ex)
+    {
+        fprintf(stderr, "Out of memory, cannot proxy for fd=%d\n", client->fd);
+        send_502(client, 0);
+        return 0;
+    }
+    ex->route = route;
+    // The client socket carries plaintext to splice only when the kernel
+    // handles its TLS records both ways
+    ex->copy = client->tls && !tls_kernel_io(client);
+    ex->http_version = req->http_version;
+    ex->head_request = http_slice_equals(&req->method, "HEAD");
+    ex->keep_alive = keep_alive;
+    ex->client_reused = client->request_count > 1;
+    ex->start_ns = start_ns;
+    ex->method_len = req->method.len < sizeof(ex->method) ? req->method.len : sizeof(ex->method);
+    memcpy(ex->method, req->method.ptr, ex->method_len);
+    ex->path_len = req->path.len < sizeof(ex->path) ? req->path.len : sizeof(ex->path);
+    memcpy(ex->path, req->path.ptr, ex->path_len);
+
+    size_t buffered = client->rlen - *consumed;
+    size_t prefix = body_len < buffered ? (size_t)body_len : buffered;
+    if (build_request(ex, client, req, has_length ? &body_len : NULL,
+                      client->rbuf + *consumed, prefix) < 0)
+    {
+        free_exchange(ex);
+        send_400(client, 0);
+        return 0;
+    }
+    *consumed += prefix;
+    ex->body_left = body_len - prefix;
+    ex->retryable = body_len == 0 && is_idempotent(&req->method);
+
+    ex->up = upstream_acquire(route, &routes[route].addr, &ex->reused);
+    if (!ex->up)
+    {
+        free_exchange(ex);
+        send_502(client, 0);
+        return 0;
+    }
+    ex->up->client = client;
+    metrics_count_upstream(ex->reused);
+
+    // A relayed response goes out in pieces as it arrives; Nagle would
+    // hold each small one back until the client acknowledges the last
+    if (!client->nodelay)
+    {
+        int one = 1;
+        setsockopt(client->fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        client->nodelay = 1;
+    }
+    client->proxy = ex;
+    touch_client(client); // now on the proxy timeout
+
+    // Answered here: the upstream never sees the Expect header
+    if (ex->body_left > 0 && req->http_version >= 11 && http_find_header(req, "Expect"))
+        outq_printf(&client->out, "HTTP/1.1 100 Continue\r\n\r\n");
+
+    if (log_verbose)
+        printf("Proxying %.*s for fd=%d to %s (%s connection)\n",
+               (int)req->path.len, req->path.ptr, client->fd,
+               routes[route].authority, ex->reused ? "pooled" : "new");
+    return keep_alive;
+}
+
+static int ensure_pipe(upstream_conn_t *up)
+{
+    if (up->pipe_fds[0] >= 0)
+        return 0;
+    if (pipe2(up->pipe_fds, O_NONBLOCK | O_CLOEXEC) < 0)
+    {
+        perror("pipe2");
+        up->pipe_fds[0] = up->pipe_fds[1] = -1;
+        return -1;
+    }
+    return 0;
+}
+
+static int would_block(void)
+{
+    return errno == EAGAIN || errno == EWOULDBLOCK;
+}
+
+static int send_request(proxy_exchange_t *ex)
+{
+    // On a connection still being set up this fails with EAGAIN until it
+    // is established, or with the reason it could not be
+    while (ex->osent < ex->olen)
+    {
+        ssize_t n = send(ex->up->fd, ex->obuf + ex->osent, ex->olen - ex->osent, MSG_NOSIGNAL);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return would_block() ? STEP_AGAIN : STEP_UPSTREAM_ERROR;
+        }
+        ex->osent += n;
+    }
+    ex->phase = ex->body_left > 0 ? PROXY_SEND_BODY : PROXY_READ_HEAD;
+    return STEP_NEXT;
+}
+
+/**
+ * send_body() for a copying exchange; ibuf is free until the response.
+ */
+static int send_body_copy(proxy_exchange_t *ex, client_info_t *client)
+{
+    while (ex->isent < ex->ilen || ex->body_left > 0)
+    {
+        ssize_t n;
+        if (ex->isent < ex->ilen)
+        {
+            n = send(ex->up->fd, ex->ibuf + ex->isent, ex->ilen - ex->isent, MSG_NOSIGNAL);
+            if (n < 0)
+            {
+                if (errno == EINTR)
+                    continue;
+                return would_block() ? STEP_AGAIN : STEP_UPSTREAM_ERROR;
+            }
+            ex->isent += n;
+            continue;
+        }
+
+        size_t want = server_config.buffer_size;
+        if (ex->body_left < want)
+            want = ex->body_left;
+        n = tls_recv(client, ex->ibuf, want);
+        if (n == 0)
+            return STEP_CLIENT_ERROR; // gone before the whole body arrived
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return would_block() ? STEP_AGAIN : STEP_CLIENT_ERROR;
+        }
+        ex->ilen = n;
+        ex->isent = 0;
+        ex->body_left -= n;
+    }
+    ex->ilen = ex->isent = 0;
+    ex->phase = PROXY_READ_HEAD;
+    return STEP_NEXT;
+}
+
+static int send_body(proxy_exchange_t *ex, client_info_t *client)
+{
+    if (ex->copy)
+        return send_body_copy(ex, client);
+
+    upstream_conn_t *up = ex->up;
+    if (ensure_pipe(up) < 0)
+        return STEP_UPSTREAM_ERROR;
+
+    while (up->piped > 0 || ex->body_left > 0)
+    {
+        ssize_t n;
+        if (up->piped > 0)
+        {
+            n = splice(up->pipe_fds[0], NULL, up->fd, NULL, up->piped,
+                       SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+            if (n < 0)
+            {
+                if (errno == EINTR)
+                    continue;
+                return would_block() ? STEP_AGAIN : STEP_UPSTREAM_ERROR;
+            }
+            up->piped -= n;
+            continue;
+        }
+
+        size_t want = ex->body_left < PROXY_SPLICE_MAX ? ex->body_left : PROXY_SPLICE_MAX;
+        n = splice(client->fd, NULL, up->pipe_fds[1], NULL, want,
+                   SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+        if (n == 0)
+            return STEP_CLIENT_ERROR; // gone before the whole body arrived
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return would_block() ? STEP_AGAIN : STEP_CLIENT_ERROR;
+        }
+        up->piped += n;
+        ex->body_left -= n;
+    }
+    ex->phase = PROXY_READ_HEAD;
+    return STEP_NEXT;
+}
+
+static int hex_value(char c)
+{
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    return -1;
+}
+
+/**
+ * Follow the chunked framing through len more body bytes.
+ * @return: bytes that belong to the response (fewer than len only once
+ *          it is complete), -1 on malformed framing
+ */
+static ssize_t chunk_feed(proxy_exchange_t *ex, const char *p, size_t len)
+{
+    size_t i = 0;
+    while (i < len && ex->chunk_state != CHUNK_DONE)
+    {
+        char c = p[i];
+        switch (ex->chunk_state)
+        {
+        case CHUNK_SIZE:
+        {
+            int v = hex_value(c);
+            if (v < 0)
+            {
+                if (ex->chunk_digits == 0)
+                    return -1;
+                ex->chunk_state = CHUNK_EXT;
+                break;
+            }
+            if (ex->resp_left >> 56)
+                return -1;
+            ex->resp_left = ex->resp_left * 16 + v;
+            ex->chunk_digits++;
+            i++;
+            break;
+        }
+        case CHUNK_EXT:
+            i++;
+            if (c == '\n')
+            {
+                ex->chunk_digits = 0;
+                ex->chunk_state = ex->resp_left > 0 ? CHUNK_DATA : CHUNK_TRAILER_START;
+            }
+            break;
+        case CHUNK_DATA:
+        {
+            size_t take = len - i < ex->resp_left ? len - i : (size_t)ex->resp_left;
+            i += take;
+            ex->resp_left -= take;
+            if (ex->resp_left == 0)
+                ex->chunk_state = CHUNK_DATA_END;
+            break;
+        }
+        case CHUNK_DATA_END:
+            i++;
+            if (c == '\n')
+                ex->chunk_state = CHUNK_SIZE;
+            else if (c != '\r')
+                return -1;
+            break;
+        case CHUNK_TRAILER_START:
+            i++;
+            if (c == '\n')
+                ex->chunk_state = CHUNK_DONE;
+            else
+                ex->chunk_state = c == '\r' ? CHUNK_LAST_LF : CHUNK_TRAILER_LINE;
+            break;
+        case CHUNK_TRAILER_LINE:
+            i++;
+            if (c == '\n')
+                ex->chunk_state = CHUNK_TRAILER_START;
+            break;
+        case CHUNK_LAST_LF:
+            i++;
+            if (c != '\n')
+                return -1;
+            ex->chunk_state = CHUNK_DONE;
+            break;
+        case CHUNK_DONE:
+            break;
+        }
+    }
+    return i;
+}
+
+/**
+ * Split the header line at p into name and trimmed value; `end` is the
+ * empty line that closes the head.
+ * @return: start of the next line, NULL if the line has no colon
+ */
+static const char *split_field(const char *p, const char *end, http_header_t *field)
+{
+    const char *line_end = memchr(p, '\n', end - p + 1);
+    const char *colon = memchr(p, ':', line_end - p);
+    if (!colon)
+        return NULL;
+    const char *value = colon + 1;
+    const char *value_end = line_end;
+    while (value < value_end && (*value == ' ' || *value == '\t'))
+        value++;
+    while (value_end > value && (value_end[-1] == '\r' || value_end[-1] == ' ' ||
+                                 value_end[-1] == '\t'))
+        value_end--;
+    field->name.ptr = p;
+    field->name.len = colon - p;
+    field->value.ptr = value;
+    field->value.len = value_end - value;
+    return line_end + 1;
+}
+
+/**
+ * Parse the response head at ibuf[0..head_len) and rewrite it into obuf.
+ * The body bytes read along with it stay in ibuf. Interim 1xx responses
+ * are dropped; the 100 Continue a client may wait for comes from
+ * proxy_begin().
+ */
+static int take_response_head(proxy_exchange_t *ex, client_info_t *client, size_t head_len)
+{
+    const char *p = ex->ibuf;
+    const char *end = p + head_len - 2; // the empty line
+    if (head_len < 16 || memcmp(p, "HTTP/1.", 7) != 0 || p[8] != ' ' ||
+        !is_digit(p[9]) || !is_digit(p[10]) || !is_digit(p[11]))
+        return STEP_UPSTREAM_ERROR;
+    int version = p[7] == '1' ? 11 : 10;
+    int status = (p[9] - '0') * 100 + (p[10] - '0') * 10 + (p[11] - '0');
+    const char *line_end = memchr(p, '\n', end - p);
+    if (status < 100 || !line_end)
+        return STEP_UPSTREAM_ERROR;
+
+    size_t leftover = ex->ilen - head_len;
+    if (status < 200)
+    {
+        if (status == 101)
+            return STEP_UPSTREAM_ERROR; // Upgrade is never forwarded
+        memmove(ex->ibuf, ex->ibuf + head_len, leftover);
+        ex->ilen = leftover;
+        return STEP_NEXT;
+    }
+
+    // Status line with the upstream's reason phrase
+    const char *reason = p + 12;
+    size_t reason_len = line_end - reason;
+    if (reason_len > 0 && reason[reason_len - 1] == '\r')
+        reason_len--;
+    char status_line[32];
+    snprintf(status_line, sizeof(status_line), "HTTP/1.1 %d", status);
+    ex->olen = ex->osent = 0;
+    if (append_str(ex, status_line) < 0 || append(ex, reason, reason_len) < 0 ||
+        append(ex, "\r\n", 2) < 0)
+        return STEP_UPSTREAM_ERROR;
+
+    // The upstream's Connection headers first: they decide whether its
+    // connection stays open, and name the fields meant for this hop only
+    http_slice_t connection[PROXY_CONNECTION_MAX];
+    int connection_count = 0;
+    int close_token = 0, keep_alive_token = 0;
+    http_header_t field;
+    const char *fields = line_end + 1;
+    for (p = fields; p < end; )
+    {
+        if (!(p = split_field(p, end, &field)))
+            return STEP_UPSTREAM_ERROR;
+        if (!name_equals(field.name.ptr, field.name.len, "Connection"))
+            continue;
+        if (connection_count == PROXY_CONNECTION_MAX)
+            return STEP_UPSTREAM_ERROR;
+        connection[connection_count++] = field.value;
+        close_token |= http_has_token(&field.value, "close", 5);
+        keep_alive_token |= http_has_token(&field.value, "keep-alive", 10);
+    }
+    int upstream_close = close_token || (version < 11 && !keep_alive_token);
+
+    int has_length = 0;
+    uint64_t length = 0;
+    int has_encoding = 0;
+    int chunked = 0;
+    for (p = fields; p < end; )
+    {
+        p = split_field(p, end, &field);
+        const char *name = field.name.ptr, *value = field.value.ptr;
+        size_t name_len = field.name.len, value_len = field.value.len;
+
+        if (name_equals(name, name_len, "Content-Length"))
+        {
+            uint64_t n;
+            if (parse_length(value, value_len, &n) < 0 || (has_length && n != length))
+                return STEP_UPSTREAM_ERROR;
+            has_length = 1;
+            length = n;
+        }
+        else if (name_equals(name, name_len, "Transfer-Encoding"))
+        {
+            has_encoding = 1;
+            chunked = value_len == 7 && strncasecmp(value, "chunked", 7) == 0;
+            // Passed on as it is: the body is forwarded in its framing
+            if (append_header(ex, name, name_len, value, value_len) < 0)
+                return STEP_UPSTREAM_ERROR;
+            continue;
+        }
+        else if (is_hop_by_hop(name, name_len) ||
+                 listed_in(connection, connection_count, name, name_len))
+        {
+            continue;
+        }
+        if (append_header(ex, name, name_len, value, value_len) < 0)
+            return STEP_UPSTREAM_ERROR;
+    }
+    // Both framings at once is how requests get smuggled
+    if (has_length && has_encoding)
+        return STEP_UPSTREAM_ERROR;
+
+    if (ex->head_request || status == 204 || status == 304)
+        ex->framing = BODY_NONE;
+    else if (chunked)
+        ex->framing = BODY_CHUNKED;
+    else if (has_length && !has_encoding)
+        ex->framing = BODY_LENGTH;
+    else
+        ex->framing = BODY_UNTIL_CLOSE;
+    ex->resp_left = ex->framing == BODY_LENGTH ? length : 0;
+    ex->upstream_keep_alive = !upstream_close && ex->framing != BODY_UNTIL_CLOSE;
+    if (ex->framing == BODY_UNTIL_CLOSE)
+        ex->keep_alive = 0;
+
+    if (append_str(ex, ex->keep_alive ? "Connection: keep-alive\r\n\r\n"
+                                      : "Connection: close\r\n\r\n") < 0)
+        return STEP_UPSTREAM_ERROR;
+
+    // Body bytes that came with the head; anything past the end of the
+    // response means the connection cannot be trusted with another request
+    memmove(ex->ibuf, ex->ibuf + head_len, leftover);
+    ex->ilen = leftover;
+    ex->isent = 0;
+    if (ex->framing == BODY_NONE)
+        ex->ilen = 0;
+    else if (ex->framing == BODY_LENGTH && ex->ilen > ex->resp_left)
+        ex->ilen = ex->resp_left;
+    else if (ex->framing == BODY_CHUNKED)
+    {
+        ssize_t n = chunk_feed(ex, ex->ibuf, ex->ilen);
+        if (n < 0)
+            return STEP_UPSTREAM_ERROR;
+        ex->ilen = n;
+    }
+    if (ex->ilen < leftover)
+        ex->upstream_keep_alive = 0;
+    if (ex->framing == BODY_LENGTH)
+        ex->resp_left -= ex->ilen;
+
+    ex->status = status;
+    client->status = status;
+    ex->phase = PROXY_SEND_RESPONSE;
+    return STEP_NEXT;
+}
+
+static int read_head(proxy_exchange_t *ex, client_info_t *client)
+{
+    while (1)
+    {
+        char *end = memmem(ex->ibuf, ex->ilen, "\r\n\r\n", 4);
+        if (end)
+        {
+            int rc = take_response_head(ex, client, end + 4 - ex->ibuf);
+            if (rc != STEP_NEXT || ex->phase == PROXY_SEND_RESPONSE)
+                return rc;
+            continue; // an interim response, the real one follows
+        }
+        if (ex->ilen == server_config.buffer_size)
+            return STEP_UPSTREAM_ERROR; // head too large
+
+        ssize_t n = recv(ex->up->fd, ex->ibuf + ex->ilen,
+                         server_config.buffer_size - ex->ilen, MSG_DONTWAIT);
+        if (n == 0)
+            return STEP_UPSTREAM_ERROR;
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return would_block() ? STEP_AGAIN : STEP_UPSTREAM_ERROR;
+        }
+        ex->ilen += n;
+        ex->responded = 1;
+    }
+}
+
+static int response_complete(const proxy_exchange_t *ex)
+{
+    switch (ex->framing)
+    {
+    case BODY_NONE:
+        return 1;
+    case BODY_LENGTH:
+        return ex->resp_left == 0;
+    case BODY_CHUNKED:
+        return ex->chunk_state == CHUNK_DONE;
+    case BODY_UNTIL_CLOSE:
+        return ex->eof;
+    }
+    return 1;
+}
+
+static void count_sent(proxy_exchange_t *ex, size_t n, size_t *budget)
+{
+    ex->bytes_sent += n;
+    metrics_count_bytes_sent(n);
+    *budget = n < *budget ? *budget - n : 0;
+}
+
+/**
+ * send_response() for a copying exchange. Head and body bytes are queued
+ * by reference on the client's output queue; ibuf is only refilled once
+ * tls_flush() has drained it, and a flush left waiting is finished by
+ * handle_client() before the exchange runs again.
+ */
+static int send_response_copy(proxy_exchange_t *ex, client_info_t *client, size_t *budget)
+{
+    while (1)
+    {
+        if (ex->osent < ex->olen || ex->isent < ex->ilen)
+        {
+            if (*budget == 0)
+                return STEP_YIELD;
+            size_t head_left = ex->olen - ex->osent;
+            size_t body_left = ex->ilen - ex->isent;
+            if ((head_left > 0 &&
+                 outq_push_mem(&client->out, ex->obuf + ex->osent, head_left, NULL) < 0) ||
+                (body_left > 0 &&
+                 outq_push_mem(&client->out, ex->ibuf + ex->isent, body_left, NULL) < 0))
+                return STEP_CLIENT_ERROR;
+            ex->bytes_sent += head_left + body_left;
+            ex->osent = ex->olen;
+            ex->isent = ex->ilen;
+        }
+        if (!outq_empty(&client->out))
+        {
+            int flushed = tls_flush(client, budget);
+            if (flushed < 0)
+                return STEP_CLIENT_ERROR;
+            if (flushed == 0)
+                return STEP_AGAIN;
+            if (flushed == 2)
+                return STEP_YIELD;
+        }
+        ex->ilen = ex->isent = 0;
+
+        if (response_complete(ex))
+            return STEP_DONE;
+        if (*budget == 0)
+            return STEP_YIELD;
+
+        size_t want = server_config.buffer_size;
+        if (ex->framing == BODY_LENGTH && ex->resp_left < want)
+            want = ex->resp_left;
+        ssize_t n = recv(ex->up->fd, ex->ibuf, want, MSG_DONTWAIT);
+        if (n == 0 && ex->framing == BODY_UNTIL_CLOSE)
+        {
+            ex->eof = 1;
+            continue;
+        }
+        if (n <= 0)
+        {
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n < 0 && would_block())
+                return STEP_AGAIN;
+            return STEP_CLIENT_ERROR; // truncated: the client must notice
+        }
+        if (ex->framing == BODY_CHUNKED)
+        {
+            ssize_t used = chunk_feed(ex, ex->ibuf, n);
+            if (used < 0)
+                return STEP_CLIENT_ERROR;
+            if (used < n)
+                ex->upstream_keep_alive = 0;
+            n = used;
+        }
+        else if (ex->framing == BODY_LENGTH)
+        {
+            ex->resp_left -= n;
+        }
+        ex->ilen = n;
+    }
+}
+
+static int send_response(proxy_exchange_t *ex, client_info_t *client, size_t *budget)
+{
+    if (ex->copy)
+        return send_response_copy(ex, client, budget);
+
+    upstream_conn_t *up = ex->up;
+    while (1)
+    {
+        ssize_t n;
+        // Head and body bytes held in memory go first, then the pipe; new
+        // bytes are only read from the upstream once both are empty
+        if (ex->osent < ex->olen || ex->isent < ex->ilen)
+        {
+            if (*budget == 0)
+                return STEP_YIELD;
+            struct iovec iov[2];
+            int iovcnt = 0;
+            if (ex->osent < ex->olen)
+            {
+                iov[iovcnt].iov_base = ex->obuf + ex->osent;
+                iov[iovcnt++].iov_len = ex->olen - ex->osent;
+            }
+            if (ex->isent < ex->ilen)
+            {
+                iov[iovcnt].iov_base = ex->ibuf + ex->isent;
+                iov[iovcnt++].iov_len = ex->ilen - ex->isent;
+            }
+            struct msghdr msg = { .msg_iov = iov, .msg_iovlen = iovcnt };
+            n = sendmsg(client->fd, &msg, MSG_NOSIGNAL);
+            if (n < 0)
+            {
+                if (errno == EINTR)
+                    continue;
+                return would_block() ? STEP_AGAIN : STEP_CLIENT_ERROR;
+            }
+            count_sent(ex, n, budget);
+            size_t head_part = ex->olen - ex->osent < (size_t)n ? ex->olen - ex->osent : (size_t)n;
+            ex->osent += head_part;
+            ex->isent += n - head_part;
+            continue;
+        }
+        ex->ilen = ex->isent = 0;
+
+        if (up->piped > 0)
+        {
+            if (*budget == 0)
+                return STEP_YIELD;
+            n = splice(up->pipe_fds[0], NULL, client->fd, NULL, up->piped,
+                       SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+            if (n < 0)
+            {
+                if (errno == EINTR)
+                    continue;
+                return would_block() ? STEP_AGAIN : STEP_CLIENT_ERROR;
+            }
+            up->piped -= n;
+            count_sent(ex, n, budget);
+            continue;
+        }
+
+        if (response_complete(ex))
+            return STEP_DONE;
+        if (*budget == 0)
+            return STEP_YIELD;
+
+        // Body bytes are spliced; chunk size lines are read to be parsed
+        if (ex->framing != BODY_CHUNKED || ex->chunk_state == CHUNK_DATA)
+        {
+            if (ensure_pipe(up) < 0)
+                return STEP_CLIENT_ERROR;
+            size_t want = PROXY_SPLICE_MAX;
+            if (ex->framing != BODY_UNTIL_CLOSE && ex->resp_left < want)
+                want = ex->resp_left;
+            n = splice(up->fd, NULL, up->pipe_fds[1], NULL, want,
+                       SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+            if (n == 0 && ex->framing == BODY_UNTIL_CLOSE)
+            {
+                ex->eof = 1;
+                continue;
+            }
+            if (n <= 0)
+            {
+                if (n < 0 && errno == EINTR)
+                    continue;
+                if (n < 0 && would_block())
+                    return STEP_AGAIN;
+                return STEP_CLIENT_ERROR; // truncated: the client must notice
+            }
+            up->piped += n;
+            if (ex->framing != BODY_UNTIL_CLOSE)
+            {
+                ex->resp_left -= n;
+                if (ex->framing == BODY_CHUNKED && ex->resp_left == 0)
+                    ex->chunk_state = CHUNK_DATA_END;
+            }
+            continue;
+        }
+
+        n = recv(up->fd, ex->ibuf, server_config.buffer_size, MSG_DONTWAIT);
+        if (n <= 0)
+        {
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n < 0 && would_block())
+                return STEP_AGAIN;
+            return STEP_CLIENT_ERROR;
+        }
+        ssize_t used = chunk_feed(ex, ex->ibuf, n);
+        if (used < 0)
+            return STEP_CLIENT_ERROR;
+        if (used < n)
+            ex->upstream_keep_alive = 0;
+        ex->ilen = used;
+    }
+}
+
+int proxy_relay(client_info_t *client, size_t *budget)
+{
+    proxy_exchange_t *ex = client->proxy;
+    while (1)
+    {
+        int rc = STEP_CLIENT_ERROR;
+        switch (ex->phase)
+        {
+        case PROXY_SEND_REQUEST:
+            rc = send_request(ex);
+            break;
+        case PROXY_SEND_BODY:
+            rc = send_body(ex, client);
+            break;
+        case PROXY_READ_HEAD:
+            rc = read_head(ex, client);
+            break;
+        case PROXY_SEND_RESPONSE:
+            rc = send_response(ex, client, budget);
+            break;
+        }
+
+        switch (rc)
+        {
+        case STEP_NEXT:
+            continue;
+        case STEP_AGAIN:
+            return 0;
+        case STEP_YIELD:
+            return 2;
+        case STEP_DONE:
+            finish_exchange(client, ex);
+            return 1;
+        case STEP_UPSTREAM_ERROR:
+            if (ex->reused && ex->retryable && !ex->responded)
+            {
+                // Most likely closed by the upstream while it sat in the pool
+                upstream_conn_t *up = upstream_connect(ex->route, &routes[ex->route].addr);
+                upstream_discard(ex->up);
+                ex->reused = 0;
+                ex->up = up;
+                if (up)
+                {
+                    if (log_verbose)
+                        printf("Pooled upstream connection failed, retrying fd=%d\n", client->fd);
+                    up->client = client;
+                    ex->osent = 0;
+                    ex->ilen = 0;
+                    ex->phase = PROXY_SEND_REQUEST;
+                    continue;
+                }
+                ex->up = NULL;
+            }
+            if (ex->phase != PROXY_SEND_RESPONSE)
+            {
+                fail_exchange(client, ex);
+                return 1;
+            }
+            return -1;
+        default:
+            return -1; // proxy_abort() follows when the connection closes
+        }
+    }
+}
+
+void proxy_abort(client_info_t *client)
+{
+    proxy_exchange_t *ex = client->proxy;
+    if (ex->up)
+        upstream_discard(ex->up);
+    if (ex->status)
+        record_exchange(client, ex, ex->bytes_sent);
+    client->proxy = NULL;
+    free_exchange(ex);
+}
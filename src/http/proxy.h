@@ -0,0 +1,70 @@
+/**
+ * @file proxy.h
+ * @brief HTTP Server - Reverse Proxy Interface
+ * @version 1.0.0
+ * @date 2025-06-07
+ * @author David Dev (@DavidDevGt)
+ *
+ * @description
+ * Path-prefix routes checked before serve_file(): a request whose path
+ * starts with a route's prefix is forwarded, path unchanged, to that
+ * route's upstream over a pooled keep-alive connection (upstream_pool.h).
+ * The longest matching prefix wins; router.c does the matching.
+ *
+ * An exchange is relayed in both directions as the sockets become ready;
+ * request and response bodies move between the sockets with splice()
+ * through a per-connection pipe and are never copied to user space.
+ * Responses to later pipelined requests wait until the exchange is done.
+ *
+ * @license MIT License
+ */
+
+#ifndef PROXY_H
+#define PROXY_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "http_parser.h"
+#include "../client/client_manager.h"
+#include "../client/upstream_pool.h"
+
+#define PROXY_MAX_ROUTES UPSTREAM_MAX
+#define PROXY_HEAD_EXTRA 512        // room for the headers a rewrite adds
+#define PROXY_SPLICE_MAX (64 * 1024)
+
+/**
+ * Add a route from "PREFIX=HOST:PORT"; the host is resolved now. Startup
+ * only, routes cannot be reloaded.
+ * @return: 0 on success, -1 on a malformed spec or unknown host
+ */
+int proxy_add_route(const char *spec);
+int proxy_route_count(void);
+const char *proxy_route_prefix(int route);
+void proxy_print_routes(void);
+
+/**
+ * Start forwarding the request at rbuf[0], whose head is *consumed bytes
+ * long. *consumed grows by the body bytes already buffered, which go
+ * upstream with the head. On success client->proxy is set and
+ * proxy_relay() does the rest; if the request cannot be forwarded an
+ * error response is queued on the output queue instead.
+ * @return: keep-alive decision for the client connection
+ */
+int proxy_begin(client_info_t *client, const http_request_t *req, size_t *consumed,
+                int route, uint64_t start_ns);
+
+/**
+ * Move the exchange forward until a socket would block; the bytes sent
+ * to the client are taken off *budget.
+ * @return: 1 once the exchange is done (client->proxy is cleared), 0 to
+ *          wait for the next event, 2 when the budget ran out first, -1
+ *          if the client connection must be closed
+ */
+int proxy_relay(client_info_t *client, size_t *budget);
+
+/**
+ * The client connection is closing with an exchange in progress.
+ */
+void proxy_abort(client_info_t *client);
+
+#endif // PROXY_H
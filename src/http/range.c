@@ -0,0 +1,137 @@
+/**
+ * @file range.c
+ * @brief HTTP Server - Byte Range Requests Implementation
+ * @version 1.0.0
+ * @date 2025-06-07
+ * @author David Dev (@DavidDevGt)
+ *
+ * @description
+ * Accepts "bytes=" with any mix of first-last, first- and -suffix specs.
+ * Specs that start past the end are dropped; if none is left the request
+ * is unsatisfiable. Overlapping and adjacent ranges are merged, in order
+ * of their offsets (RFC 7233 6.1), so no byte is sent twice. Requests
+ * with more than RANGE_MAX ranges get the whole file; together the two
+ * bound the work a single request can cause.
+ *
+ * @license MIT License
+ */
+
+#include "range.h"
+#include <string.h>
+#include <strings.h>  // for strncasecmp
+
+/**
+ * Read a decimal number.
+ * @return: 1 if digits were found, 0 if none, -1 on overflow
+ */
+static int read_number(const char **p, const char *end, off_t *out)
+{
+    const char *start = *p;
+    off_t n = 0;
+    while (*p < end && **p >= '0' && **p <= '9')
+    {
+        if (n > (off_t)(((unsigned long long)1 << 62) / 10))
+            return -1;
+        n = n * 10 + (**p - '0');
+        (*p)++;
+    }
+    *out = n;
+    return *p > start;
+}
+
+static void skip_spaces(const char **p, const char *end)
+{
+    while (*p < end && (**p == ' ' || **p == '\t'))
+        (*p)++;
+}
+
+/**
+ * Sort ranges by start and merge those that overlap or touch.
+ * @return: the number left
+ */
+static int coalesce(byte_range_t *ranges, int count)
+{
+    // At most RANGE_MAX entries: insertion sort
+    for (int i = 1; i < count; i++)
+    {
+        byte_range_t range = ranges[i];
+        int j = i;
+        for (; j > 0 && ranges[j - 1].start > range.start; j--)
+            ranges[j] = ranges[j - 1];
+        ranges[j] = range;
+    }
+    int merged = 0;
+    for (int i = 0; i < count; i++)
+    {
+        if (merged > 0 && ranges[i].start <= ranges[merged - 1].end + 1)
+        {
+            if (ranges[i].end > ranges[merged - 1].end)
+                ranges[merged - 1].end = ranges[i].end;
+            continue;
+        }
+        ranges[merged++] = ranges[i];
+    }
+    return merged;
+}
+
+int parse_range(const http_request_t *req, off_t size, byte_range_t *ranges, int max)
+{
+    const http_slice_t *header = http_get_header(req, HTTP_HDR_RANGE);
+    if (!header || header->len < 6 || strncasecmp(header->ptr, "bytes=", 6) != 0)
+        return RANGE_NONE;
+
+    const char *p = header->ptr + 6;
+    const char *end = header->ptr + header->len;
+    int count = 0;
+    int specs = 0;
+
+    while (p < end)
+    {
+        skip_spaces(&p, end);
+        if (p < end && *p == ',')
+        {
+            p++;
+            continue;
+        }
+        if (p == end)
+            break;
+
+        off_t first = 0, last = 0;
+        int has_first = read_number(&p, end, &first);
+        if (has_first < 0 || p == end || *p != '-')
+            return RANGE_NONE;
+        p++;
+        int has_last = read_number(&p, end, &last);
+        if (has_last < 0 || (!has_first && !has_last))
+            return RANGE_NONE;
+        skip_spaces(&p, end);
+        if (p < end && *p != ',')
+            return RANGE_NONE;
+        if (++specs > max)
+            return RANGE_NONE;
+
+        byte_range_t range;
+        if (!has_first)
+        {
+            // Suffix: the last `last` bytes
+            if (last == 0 || size == 0)
+                continue;
+            range.start = last >= size ? 0 : size - last;
+            range.end = size - 1;
+        }
+        else
+        {
+            if (has_last && last < first)
+                return RANGE_NONE;
+            if (first >= size)
+                continue;
+            range.start = first;
+            range.end = (!has_last || last >= size) ? size - 1 : last;
+        }
+        ranges[count++] = range;
+    }
+
+    if (specs == 0)
+        return RANGE_NONE;
+    return count > 0 ? coalesce(ranges, count) : RANGE_UNSATISFIABLE;
+}
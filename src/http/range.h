@@ -0,0 +1,40 @@
+/**
+ * @file range.h
+ * @brief HTTP Server - Byte Range Requests Interface
+ * @version 1.0.0
+ * @date 2025-06-07
+ * @author David Dev (@DavidDevGt)
+ *
+ * @description
+ * Parser for the Range request header (bytes unit only). Ranges are
+ * resolved against the representation size so callers get absolute,
+ * inclusive offsets ready for sendfile() or a memory slice.
+ *
+ * @license MIT License
+ */
+
+#ifndef RANGE_H
+#define RANGE_H
+
+#include <sys/types.h>
+#include "http_parser.h"
+
+#define RANGE_MAX 8              // more ranges than this: send the whole file
+#define RANGE_NONE 0             // no usable Range header, answer 200
+#define RANGE_UNSATISFIABLE -1   // answer 416
+#define RANGE_BOUNDARY "httpserverc5a1f0e97d3b"
+
+typedef struct {
+    off_t start;
+    off_t end;                   // inclusive
+} byte_range_t;
+
+/**
+ * Parse the Range header against a representation of `size` bytes.
+ * Malformed headers and other units are ignored, as RFC 9110 allows.
+ * Stored ranges are sorted and never overlap or touch.
+ * @return: number of ranges stored, RANGE_NONE or RANGE_UNSATISFIABLE
+ */
+int parse_range(const http_request_t *req, off_t size, byte_range_t *ranges, int max);
+
+#endif // RANGE_H
@@ -0,0 +1,212 @@
+/**
+ * @file router.c
+ * @brief HTTP Server - Request Routing Implementation
+ * @version 1.0.0
+ * @date 2025-06-07
+ * @author David Dev (@DavidDevGt)
+ *
+ * @description
+ * The hash is FNV-1a, which consumes the path byte by byte: its state
+ * after n bytes is the hash of the n-byte prefix, so one pass over the
+ * path gives every prefix hash the table can need. Exact routes are told
+ * apart from prefix routes of the same path by a final mixing step.
+ *
+ * @license MIT License
+ */
+
+#include "router.h"
+#include "fnv.h"
+#include "../core/metrics.h"
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+
+#define EXACT_MIX 0x9e3779b97f4a7c15ULL
+
+static route_t routes[ROUTER_MAX_ROUTES];
+static int route_count = 0;
+static uint64_t route_hash[ROUTER_MAX_ROUTES];
+static uint8_t slots[ROUTER_TABLE_SIZE];        // route index + 1, 0 = empty
+
+// Distinct prefix lengths in use, longest first
+static size_t prefix_lengths[ROUTER_MAX_ROUTES];
+static int prefix_length_count = 0;
+static uint8_t is_prefix_length[ROUTER_PREFIX_MAX + 1];
+
+static const route_t default_route = {
+    .path = "/", .path_len = 1, .exact = 0,
+    .methods = ROUTE_METHOD_GET, .handler = ROUTE_STATIC, .arg = -1
+};
+
+static uint64_t key_hash(const char *path, size_t len, int exact)
+{
+    uint64_t hash = fnv1a(path, len);
+    return exact ? hash ^ EXACT_MIX : hash;
+}
+
+/**
+ * Probe for a route with this key.
+ * @return: the route, or NULL
+ */
+static const route_t *lookup(uint64_t hash, const char *path, size_t len, int exact)
+{
+    for (unsigned i = (unsigned)hash & (ROUTER_TABLE_SIZE - 1);; i = (i + 1) & (ROUTER_TABLE_SIZE - 1))
+    {
+        int index = slots[i];
+        if (index == 0)
+            return NULL;
+        const route_t *route = &routes[index - 1];
+        if (route_hash[index - 1] == hash && route->exact == exact &&
+            route->path_len == len && memcmp(route->path, path, len) == 0)
+            return route;
+    }
+}
+
+int router_add(const char *path, int exact, unsigned methods,
+               route_handler_t handler, int arg)
+{
+    size_t len = strlen(path);
+    if (len > ROUTER_PREFIX_MAX || route_count == ROUTER_MAX_ROUTES)
+        return -1;
+    uint64_t hash = key_hash(path, len, exact);
+    if (lookup(hash, path, len, exact))
+        return 0; // the earlier route keeps the path
+
+    route_t *route = &routes[route_count];
+    route->path = path;
+    route->path_len = len;
+    route->exact = exact;
+    route->methods = methods;
+    route->handler = handler;
+    route->arg = arg;
+    route_hash[route_count] = hash;
+    route_count++;
+
+    unsigned i = (unsigned)hash & (ROUTER_TABLE_SIZE - 1);
+    while (slots[i] != 0)
+        i = (i + 1) & (ROUTER_TABLE_SIZE - 1);
+    slots[i] = (uint8_t)route_count;
+
+    if (!exact && !is_prefix_length[len])
+    {
+        is_prefix_length[len] = 1;
+        int pos = prefix_length_count++;
+        while (pos > 0 && prefix_lengths[pos - 1] < len)
+        {
+            prefix_lengths[pos] = prefix_lengths[pos - 1];
+            pos--;
+        }
+        prefix_lengths[pos] = len;
+    }
+    return 0;
+}
+
+int router_init(void)
+{
+    if (router_add(METRICS_PATH, 1, ROUTE_METHOD_GET, ROUTE_METRICS, -1) < 0)
+        return -1;
+    // Proxy routes come before the document root, so a proxied "/" takes
+    // everything but the internal endpoints
+    for (int i = 0; i < proxy_route_count(); i++)
+    {
+        if (router_add(proxy_route_prefix(i), 0, ROUTE_METHODS_ANY, ROUTE_PROXY, i) < 0)
+        {
+            fprintf(stderr, "Cannot route proxy prefix %s\n", proxy_route_prefix(i));
+            return -1;
+        }
+    }
+    return router_add(default_route.path, 0, default_route.methods, ROUTE_STATIC, -1);
+}
+
+const route_t *route_match(const http_request_t *req)
+{
+    const char *path = req->path.ptr;
+    size_t len = req->path.len;
+
+    // One pass: prefix hashes at every length in use, then the whole path
+    uint64_t prefix_hash[ROUTER_MAX_ROUTES];
+    int wanted = prefix_length_count - 1;   // shortest first while walking
+    while (wanted >= 0 && prefix_lengths[wanted] == 0)
+        prefix_hash[wanted--] = FNV_OFFSET;
+    uint64_t hash = FNV_OFFSET;
+    for (size_t i = 0; i < len; i++)
+    {
+        hash = fnv1a_step(hash, (unsigned char)path[i]);
+        while (wanted >= 0 && prefix_lengths[wanted] == i + 1)
+            prefix_hash[wanted--] = hash;
+    }
+
+    const route_t *route = lookup(hash ^ EXACT_MIX, path, len, 1);
+    if (route)
+        return route;
+    // Lengths the path reached, longest first
+    for (int i = wanted + 1; i < prefix_length_count; i++)
+    {
+        route = lookup(prefix_hash[i], path, prefix_lengths[i], 0);
+        if (route)
+            return route;
+    }
+    return &default_route;
+}
+
+unsigned route_method(const http_slice_t *method)
+{
+    const char *m = method->ptr;
+    switch (method->len)
+    {
+    case 3:
+        if (memcmp(m, "GET", 3) == 0)
+            return ROUTE_METHOD_GET;
+        if (memcmp(m, "PUT", 3) == 0)
+            return ROUTE_METHOD_PUT;
+        break;
+    case 4:
+        if (memcmp(m, "HEAD", 4) == 0)
+            return ROUTE_METHOD_HEAD;
+        if (memcmp(m, "POST", 4) == 0)
+            return ROUTE_METHOD_POST;
+        break;
+    case 5:
+        if (memcmp(m, "PATCH", 5) == 0)
+            return ROUTE_METHOD_PATCH;
+        if (memcmp(m, "TRACE", 5) == 0)
+            return ROUTE_METHOD_TRACE;
+        break;
+    case 6:
+        if (memcmp(m, "DELETE", 6) == 0)
+            return ROUTE_METHOD_DELETE;
+        break;
+    case 7:
+        if (memcmp(m, "OPTIONS", 7) == 0)
+            return ROUTE_METHOD_OPTIONS;
+        if (memcmp(m, "CONNECT", 7) == 0)
+            return ROUTE_METHOD_CONNECT;
+        break;
+    }
+    return ROUTE_METHOD_OTHER;
+}
+
+int route_allows(const route_t *route, const http_request_t *req)
+{
+    return (route->methods & route_method(&req->method)) != 0;
+}
+
+size_t route_allow_header(const route_t *route, char *buf, size_t size)
+{
+    // Indexed by ROUTE_METHOD_* bit
+    static const char *const names[] = {
+        "GET", "HEAD", "POST", "PUT", "DELETE", "PATCH", "OPTIONS", "CONNECT", "TRACE"
+    };
+    size_t len = 0;
+    buf[0] = '\0';
+    for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); i++)
+    {
+        if (!(route->methods & (1u << i)))
+            continue;
+        int n = snprintf(buf + len, size - len, "%s%s", len ? ", " : "", names[i]);
+        if (n < 0 || (size_t)n >= size - len)
+            break;
+        len += n;
+    }
+    return len;
+}
@@ -0,0 +1,101 @@
+/**
+ * @file router.h
+ * @brief HTTP Server - Request Routing Interface
+ * @version 1.0.0
+ * @date 2025-06-07
+ * @author David Dev (@DavidDevGt)
+ *
+ * @description
+ * Picks the handler for a request by method and path: exact routes for
+ * internal endpoints (/metrics), prefix routes for proxy upstreams, and
+ * the document root for everything else. Exact paths win, then the
+ * longest prefix; when two routes name the same path, the one added first
+ * wins.
+ *
+ * The table is built once at startup and only read afterwards, so all
+ * workers share it. Routes sit in an open-addressing hash table keyed by
+ * path; a lookup hashes the request path once, in a single pass that
+ * yields the hash of every prefix length in use, and probes once for the
+ * exact path and once per distinct prefix length, longest first. Its cost
+ * does not grow with the number of routes.
+ *
+ * @license MIT License
+ */
+
+#ifndef ROUTER_H
+#define ROUTER_H
+
+#include <stddef.h>
+#include "http_parser.h"
+#include "proxy.h"
+
+#define ROUTER_MAX_ROUTES (PROXY_MAX_ROUTES + 8)
+#define ROUTER_TABLE_SIZE 128               // slots, power of two, > 2 * ROUTER_MAX_ROUTES
+#define ROUTER_PREFIX_MAX 255               // longest path a route can name
+
+// Methods a route accepts, as a bitmask
+#define ROUTE_METHOD_GET     (1u << 0)
+#define ROUTE_METHOD_HEAD    (1u << 1)
+#define ROUTE_METHOD_POST    (1u << 2)
+#define ROUTE_METHOD_PUT     (1u << 3)
+#define ROUTE_METHOD_DELETE  (1u << 4)
+#define ROUTE_METHOD_PATCH   (1u << 5)
+#define ROUTE_METHOD_OPTIONS (1u << 6)
+#define ROUTE_METHOD_CONNECT (1u << 7)
+#define ROUTE_METHOD_TRACE   (1u << 8)
+#define ROUTE_METHOD_OTHER   (1u << 9)      // extension methods
+#define ROUTE_METHODS_ANY    ((1u << 10) - 1)
+
+typedef enum {
+    ROUTE_STATIC,       // serve_file() from the document root
+    ROUTE_METRICS,      // Prometheus text, loopback peers only
+    ROUTE_PROXY         // forwarded to proxy route `arg`
+} route_handler_t;
+
+typedef struct {
+    const char *path;
+    size_t path_len;
+    int exact;              // the whole path, not a prefix
+    unsigned methods;       // ROUTE_METHOD_* accepted
+    route_handler_t handler;
+    int arg;
+} route_t;
+
+/**
+ * Build the table: /metrics, then one route per proxy prefix, then the
+ * document root. Call once after the configuration is loaded.
+ * @return: 0 on success, -1 if the routes do not fit
+ */
+int router_init(void);
+
+/**
+ * Add a route; path must outlive the router. Startup only.
+ * @return: 0 on success (also when an earlier route has the same path,
+ *          which then stays in place), -1 if the table is full or the
+ *          path too long
+ */
+int router_add(const char *path, int exact, unsigned methods,
+               route_handler_t handler, int arg);
+
+/**
+ * Route for a parsed request, by path alone; check the method with
+ * route_allows().
+ * @return: never NULL, the document root when nothing else matches
+ */
+const route_t *route_match(const http_request_t *req);
+
+/**
+ * ROUTE_METHOD_* bit of a request method.
+ */
+unsigned route_method(const http_slice_t *method);
+
+int route_allows(const route_t *route, const http_request_t *req);
+
+/**
+ * Allow header value for a route, its methods comma-separated in the
+ * order of the ROUTE_METHOD_* bits; extension methods are not listed.
+ * @return: length written to buf, always NUL-terminated
+ */
+size_t route_allow_header(const route_t *route, char *buf, size_t size);
+
+#endif // ROUTER_H
@@ -11,26 +11,156 @@
  * 
  * Features:
  * - HTTP/1.1 with keep-alive connections
- * - Select-based I/O multiplexing
+ * - Epoll-based I/O multiplexing, optional io_uring backend
  * - Concurrent connection handling
- * - Real-time connection monitoring
+ * - Multi-core worker threads (--workers N)
+ * - Prometheus metrics at /metrics, request logging with --verbose
+ * - Config file plus command-line overrides, SIGHUP reload
+ * - Graceful drain on SIGTERM, binary upgrade with listener handover on SIGUSR2
+ * - Static files from a memory-mapped bundle (--bundle)
  * 
  * @license MIT License
  */
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <signal.h>
 
 #include "core/server.h"
+#include "core/config.h"
 #include "core/event_loop.h"
+#include "core/worker.h"
+#include "core/metrics.h"
+#include "core/access_log.h"
+#include "core/lifecycle.h"
+#include "core/tls.h"
+#include "http/file_cache.h"
+#include "http/conditional.h"
+#include "http/http_parser.h"
+#include "http/hpack.h"
+#include "http/router.h"
+#include "http/bundle.h"
 #include "client/client_manager.h"
 
-int main()
+static void usage(const char *prog)
 {
-    init_client_manager();
-    int listen_fd = create_listen_socket(PORT);
-    print_server_info();
-    run_server_loop(listen_fd);
-    
+    fprintf(stderr, "Usage: %s [--config FILE] [--port N] [--workers N] [--cache-mb N]\n"
+                    "          [--backend epoll|io_uring] [--backlog N] [--defer-accept N]\n"
+                    "          [--max-clients N] [--buffer-size N] [--keep-alive-timeout N]\n"
+                    "          [--max-requests N] [--open-file-cache N] [--open-file-cache-valid N]\n"
+                    "          [--root DIR] [--access-log PATH] [--access-log-max-mb N]\n"
+                    "          [--drain-timeout N] [--cache-control PREFIX=VALUE]...\n"
+                    "          [--proxy PREFIX=HOST:PORT]... [--proxy-timeout N]\n"
+                    "          [--tls-port N --tls-cert PATH --tls-key PATH]\n"
+                    "          [--bundle PATH] [--bundle-preload lazy|populate|lock] [--verbose]\n", prog);
+    fprintf(stderr, "  --config FILE  \"name = value\" lines using the option names below;\n"
+                    "                 command-line options override it\n");
+    fprintf(stderr, "  --port N      TCP port to listen on (default %d)\n", CONFIG_DEFAULT_PORT);
+    fprintf(stderr, "  --workers N   event loop threads, one per core (0 = all cores)\n");
+    fprintf(stderr, "  --cache-mb N  static file cache budget per worker (0 = off)\n");
+    fprintf(stderr, "  --backend B   event backend: epoll (default) or io_uring\n");
+    fprintf(stderr, "  --backlog N   listen() backlog (default %d)\n", CONFIG_DEFAULT_BACKLOG);
+    fprintf(stderr, "  --max-clients N  connections per worker (default %d)\n",
+            CONFIG_DEFAULT_MAX_CLIENTS);
+    fprintf(stderr, "  --defer-accept N  seconds the kernel holds a connection that has sent\n"
+                    "                 nothing yet (default %d, 0 = off)\n", CONFIG_DEFAULT_DEFER_ACCEPT);
+    fprintf(stderr, "  --drain-timeout N  seconds SIGTERM waits for responses in progress\n"
+                    "                 before closing them (default %d)\n", CONFIG_DEFAULT_DRAIN_TIMEOUT);
+    fprintf(stderr, "  --buffer-size N  per-connection read buffer, bounds the request head\n"
+                    "                 (default %d)\n", CONFIG_DEFAULT_BUFFER_SIZE);
+    fprintf(stderr, "  --keep-alive-timeout N  idle seconds before close (default %d)*\n",
+            CONFIG_DEFAULT_KEEP_ALIVE_TIMEOUT);
+    fprintf(stderr, "  --max-requests N  requests per connection (default %d)*\n",
+            CONFIG_DEFAULT_MAX_REQUESTS);
+    fprintf(stderr, "  --open-file-cache N  open descriptors and 404s cached per worker\n"
+                    "                 (default %d, 0 = off)\n", CONFIG_DEFAULT_OPEN_FILE_CACHE);
+    fprintf(stderr, "  --open-file-cache-valid N  seconds before a cached entry is rechecked\n"
+                    "                 (default %d)*\n", CONFIG_DEFAULT_OPEN_FILE_VALID);
+    fprintf(stderr, "  --root DIR    document root (default %s)*\n", CONFIG_DEFAULT_ROOT);
+    fprintf(stderr, "  --access-log PATH      JSON-lines access log, written by a background thread\n");
+    fprintf(stderr, "  --access-log-max-mb N  rotate the access log at N MB (default %d, 0 = never)\n",
+            ACCESS_LOG_DEFAULT_MAX_BYTES / (1024 * 1024));
+    fprintf(stderr, "  --cache-control PREFIX=VALUE  Cache-Control for paths under PREFIX\n"
+                    "                (longest prefix wins, default \"%s\")*\n", CACHE_CONTROL_DEFAULT);
+    fprintf(stderr, "  --proxy PREFIX=HOST:PORT  forward requests under PREFIX to an upstream\n"
+                    "                over pooled keep-alive connections (longest prefix wins)\n");
+    fprintf(stderr, "  --proxy-timeout N  seconds a proxied request may wait on a silent\n"
+                    "                upstream before the client is closed (default %d)*\n",
+            CONFIG_DEFAULT_PROXY_TIMEOUT);
+    fprintf(stderr, "  --tls-port N  also serve HTTPS on port N, with kernel TLS where available\n");
+    fprintf(stderr, "  --tls-cert PATH  PEM certificate chain for --tls-port\n");
+    fprintf(stderr, "  --tls-key PATH   PEM private key for --tls-port\n");
+    fprintf(stderr, "  --bundle PATH  serve static files from a bundle built by `make bundle`\n"
+                    "                 instead of --root\n");
+    fprintf(stderr, "  --bundle-preload M  lazy (fault in on use), populate (read at startup,\n"
+                    "                 default) or lock (populate and mlock)\n");
+    fprintf(stderr, "  --verbose     log every request and connection to stdout\n");
+    fprintf(stderr, "  * reapplied from the config file and command line on SIGHUP\n");
+}
+
+int main(int argc, char **argv)
+{
+    if (config_load(argc, argv) < 0)
+    {
+        usage(argv[0]);
+        return 1;
+    }
+
+    http_parser_init();
+    hpack_init();
+    if (router_init() < 0)
+        return 1;
+    lifecycle_init(argv);
+
+    // Peers that hang up mid-response must not kill the process
+    signal(SIGPIPE, SIG_IGN);
+
+    if (server_config.access_log_path &&
+        access_log_open(server_config.access_log_path, server_config.access_log_max) < 0)
+    {
+        perror(server_config.access_log_path);
+        return 1;
+    }
+
+    int port = server_config.port;
+    int workers = resolve_worker_count(server_config.workers);
+    int tls_port = server_config.tls_port;
+    if (tls_port && tls_init() < 0)
+        return 1;
+    // Mapped before the workers start, so they all share the pages
+    if (server_config.bundle_path &&
+        bundle_open(server_config.bundle_path, server_config.bundle_preload) < 0)
+        return 1;
+
+    int inherited = lifecycle_inherit_listeners(port, tls_port);
+    if (inherited > 0 && inherited != workers)
+    {
+        // Each listener has its own accept queue; dropping one would drop
+        // the connections waiting on it
+        printf("Keeping %d workers, one per inherited listener\n", inherited);
+        workers = inherited;
+    }
+    print_server_info(port, workers);
+
+    if (workers == 1)
+    {
+        // Single worker: keep the classic one-thread layout, no SO_REUSEPORT
+        init_client_manager();
+        metrics_init_thread();
+        access_log_init_thread();
+        int listen_fd = create_listen_socket(port, 0);
+        int tls_listen_fd = tls_port ? create_listen_socket(tls_port, 0) : -1;
+        lifecycle_ready();
+        run_server_loop(listen_fd, tls_listen_fd);
+    }
+    else
+    {
+        run_workers(workers, port, tls_port);
+    }
+
+    // Drained: flush what the workers logged
+    access_log_close();
+    printf("Shutdown complete\n");
     return 0;
-}
\ No newline at end of file
+}
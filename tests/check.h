@@ -0,0 +1,80 @@
+/**
+ * @file check.h
+ * @brief HTTP Server - Minimal Test Helpers
+ * @version 1.0.0
+ * @date 2025-06-07
+ * @author David Dev (@DavidDevGt)
+ *
+ * @description
+ * What the programs under tests/ share: a CHECK() that reports the failed
+ * condition and carries on, so one run lists every failure, and a hex
+ * reader for test vectors copied from the RFCs. `make check` builds and
+ * runs every test; each exits non-zero if anything failed.
+ *
+ * @license MIT License
+ */
+
+#ifndef CHECK_H
+#define CHECK_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <ctype.h>
+
+static int check_failures = 0;
+
+#define CHECK(cond, ...)                                              \
+    do {                                                              \
+        if (!(cond))                                                  \
+        {                                                             \
+            fprintf(stderr, "%s:%d: ", __FILE__, __LINE__);           \
+            fprintf(stderr, __VA_ARGS__);                             \
+            fputc('\n', stderr);                                      \
+            check_failures++;                                         \
+        }                                                             \
+    } while (0)
+
+/**
+ * Bytes from hex digits; spaces and line breaks between them are skipped.
+ * @return: number of bytes written to out
+ */
+static inline size_t check_hex(const char *hex, uint8_t *out)
+{
+    size_t n = 0;
+    int high = -1;
+    for (; *hex; hex++)
+    {
+        if (!isxdigit((unsigned char)*hex))
+            continue;
+        int v = isdigit((unsigned char)*hex) ? *hex - '0'
+                                             : tolower((unsigned char)*hex) - 'a' + 10;
+        if (high < 0)
+        {
+            high = v;
+        }
+        else
+        {
+            out[n++] = (uint8_t)(high << 4 | v);
+            high = -1;
+        }
+    }
+    return n;
+}
+
+/**
+ * Print the outcome.
+ * @return: exit status for main()
+ */
+static inline int check_report(const char *name)
+{
+    if (check_failures)
+    {
+        fprintf(stderr, "%s: %d check(s) failed\n", name, check_failures);
+        return 1;
+    }
+    printf("%s: ok\n", name);
+    return 0;
+}
+
+#endif // CHECK_H
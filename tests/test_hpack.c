@@ -0,0 +1,382 @@
+/**
+ * @file test_hpack.c
+ * @brief HTTP Server - HPACK Tests
+ * @version 1.0.0
+ * @date 2025-06-07
+ * @author David Dev (@DavidDevGt)
+ *
+ * @description
+ * The RFC 7541 Appendix C examples: every header block of C.2 to C.6 is
+ * decoded, with and without Huffman coding, and the decoder's dynamic
+ * table is compared with the one printed after each block, evictions
+ * included. The encoder, which never uses Huffman, must reproduce the
+ * C.3 and C.5 blocks byte for byte. Then size updates, and blocks the
+ * decoder has to reject: bad indexes, truncated integers and strings, an
+ * EOS symbol inside a string and Huffman padding that is too long or not
+ * all ones.
+ *
+ * @license MIT License
+ */
+
+#include "check.h"
+#include "http/hpack.h"
+#include <string.h>
+
+#define MAX_FIELDS 16
+#define SCRATCH_SIZE 4096
+
+typedef struct {
+    const char *name;
+    const char *value;
+} field_t;
+
+typedef struct {
+    char names[MAX_FIELDS][256];
+    char values[MAX_FIELDS][256];
+    int count;
+} decoded_t;
+
+static int collect(void *ctx, const char *name, size_t name_len,
+                   const char *value, size_t value_len)
+{
+    decoded_t *out = ctx;
+    if (out->count == MAX_FIELDS || name_len >= 256 || value_len >= 256)
+        return -1;
+    memcpy(out->names[out->count], name, name_len);
+    out->names[out->count][name_len] = '\0';
+    memcpy(out->values[out->count], value, value_len);
+    out->values[out->count][value_len] = '\0';
+    out->count++;
+    return 0;
+}
+
+static int decode_hex(hpack_table_t *table, const char *hex, decoded_t *out)
+{
+    uint8_t block[512];
+    static char scratch[SCRATCH_SIZE];
+    size_t len = check_hex(hex, block);
+    memset(out, 0, sizeof(*out));
+    return hpack_decode(table, block, len, scratch, sizeof(scratch), collect, out);
+}
+
+/**
+ * Decode a block and compare the fields, then the dynamic table, listed
+ * newest first as in the RFC, and its size.
+ */
+static void expect_block(const char *label, hpack_table_t *table, const char *hex,
+                         const field_t *fields, const field_t *entries, size_t size)
+{
+    decoded_t out;
+    int rc = decode_hex(table, hex, &out);
+    CHECK(rc == HPACK_OK, "%s: decode returned %d", label, rc);
+
+    int expected = 0;
+    while (fields[expected].name)
+        expected++;
+    CHECK(out.count == expected, "%s: %d fields, expected %d", label, out.count, expected);
+    for (int i = 0; i < out.count && i < expected; i++)
+        CHECK(strcmp(out.names[i], fields[i].name) == 0 &&
+              strcmp(out.values[i], fields[i].value) == 0,
+              "%s: field %d is %s: %s, expected %s: %s", label, i,
+              out.names[i], out.values[i], fields[i].name, fields[i].value);
+
+    int count = 0;
+    while (entries[count].name)
+        count++;
+    CHECK(table->count == count, "%s: %d table entries, expected %d",
+          label, table->count, count);
+    for (int i = 0; i < table->count && i < count; i++)
+    {
+        int slot = table->count - 1 - i;
+        const char *name = table->data + table->offset[slot];
+        const char *value = name + table->name_len[slot];
+        CHECK(table->name_len[slot] == strlen(entries[i].name) &&
+              memcmp(name, entries[i].name, table->name_len[slot]) == 0 &&
+              table->value_len[slot] == strlen(entries[i].value) &&
+              memcmp(value, entries[i].value, table->value_len[slot]) == 0,
+              "%s: table entry %d differs from %s: %s", label, i + 1,
+              entries[i].name, entries[i].value);
+    }
+    CHECK(table->size == size, "%s: table size %zu, expected %zu", label, table->size, size);
+}
+
+static void expect_error(const char *label, const char *hex)
+{
+    hpack_table_t table;
+    decoded_t out;
+    hpack_table_init(&table, HPACK_TABLE_SIZE);
+    int rc = decode_hex(&table, hex, &out);
+    CHECK(rc == HPACK_ERROR, "%s: decode returned %d, expected an error", label, rc);
+}
+
+static const field_t none[] = { { NULL, NULL } };
+
+// C.2: one field per block, each from a fresh decoder
+static void test_c2(void)
+{
+    hpack_table_t table;
+
+    hpack_table_init(&table, HPACK_TABLE_SIZE);
+    expect_block("C.2.1", &table,
+                 "400a 6375 7374 6f6d 2d6b 6579 0d63 7573 746f 6d2d 6865 6164 6572",
+                 (const field_t[]){ { "custom-key", "custom-header" }, { NULL, NULL } },
+                 (const field_t[]){ { "custom-key", "custom-header" }, { NULL, NULL } },
+                 55);
+
+    hpack_table_init(&table, HPACK_TABLE_SIZE);
+    expect_block("C.2.2", &table, "040c 2f73 616d 706c 652f 7061 7468",
+                 (const field_t[]){ { ":path", "/sample/path" }, { NULL, NULL } },
+                 none, 0);
+
+    hpack_table_init(&table, HPACK_TABLE_SIZE);
+    expect_block("C.2.3", &table, "1008 7061 7373 776f 7264 0673 6563 7265 74",
+                 (const field_t[]){ { "password", "secret" }, { NULL, NULL } },
+                 none, 0);
+
+    hpack_table_init(&table, HPACK_TABLE_SIZE);
+    expect_block("C.2.4", &table, "82",
+                 (const field_t[]){ { ":method", "GET" }, { NULL, NULL } },
+                 none, 0);
+}
+
+static const field_t request1[] = {
+    { ":method", "GET" }, { ":scheme", "http" }, { ":path", "/" },
+    { ":authority", "www.example.com" }, { NULL, NULL }
+};
+static const field_t request2[] = {
+    { ":method", "GET" }, { ":scheme", "http" }, { ":path", "/" },
+    { ":authority", "www.example.com" }, { "cache-control", "no-cache" }, { NULL, NULL }
+};
+static const field_t request3[] = {
+    { ":method", "GET" }, { ":scheme", "https" }, { ":path", "/index.html" },
+    { ":authority", "www.example.com" }, { "custom-key", "custom-value" }, { NULL, NULL }
+};
+static const field_t request_table1[] = {
+    { ":authority", "www.example.com" }, { NULL, NULL }
+};
+static const field_t request_table2[] = {
+    { "cache-control", "no-cache" }, { ":authority", "www.example.com" }, { NULL, NULL }
+};
+static const field_t request_table3[] = {
+    { "custom-key", "custom-value" }, { "cache-control", "no-cache" },
+    { ":authority", "www.example.com" }, { NULL, NULL }
+};
+
+static const char *const c3_blocks[] = {
+    "8286 8441 0f77 7777 2e65 7861 6d70 6c65 2e63 6f6d",
+    "8286 84be 5808 6e6f 2d63 6163 6865",
+    "8287 85bf 400a 6375 7374 6f6d 2d6b 6579 0c63 7573 746f 6d2d 7661 6c75 65",
+};
+static const char *const c4_blocks[] = {
+    "8286 8441 8cf1 e3c2 e5f2 3a6b a0ab 90f4 ff",
+    "8286 84be 5886 a8eb 1064 9cbf",
+    "8287 85bf 4088 25a8 49e9 5ba9 7d7f 8925 a849 e95b b8e8 b4bf",
+};
+
+// C.3 and C.4: three requests on one connection
+static void test_requests(const char *label, const char *const blocks[3])
+{
+    hpack_table_t table;
+    hpack_table_init(&table, HPACK_TABLE_SIZE);
+    char name[16];
+    snprintf(name, sizeof(name), "%s.1", label);
+    expect_block(name, &table, blocks[0], request1, request_table1, 57);
+    snprintf(name, sizeof(name), "%s.2", label);
+    expect_block(name, &table, blocks[1], request2, request_table2, 110);
+    snprintf(name, sizeof(name), "%s.3", label);
+    expect_block(name, &table, blocks[2], request3, request_table3, 164);
+}
+
+static const field_t response1[] = {
+    { ":status", "302" }, { "cache-control", "private" },
+    { "date", "Mon, 21 Oct 2013 20:13:21 GMT" },
+    { "location", "https://www.example.com" }, { NULL, NULL }
+};
+static const field_t response2[] = {
+    { ":status", "307" }, { "cache-control", "private" },
+    { "date", "Mon, 21 Oct 2013 20:13:21 GMT" },
+    { "location", "https://www.example.com" }, { NULL, NULL }
+};
+static const field_t response3[] = {
+    { ":status", "200" }, { "cache-control", "private" },
+    { "date", "Mon, 21 Oct 2013 20:13:22 GMT" },
+    { "location", "https://www.example.com" }, { "content-encoding", "gzip" },
+    { "set-cookie", "foo=ASDJKHQKBZXOQWEOPIUAXQWEOIU; max-age=3600; version=1" },
+    { NULL, NULL }
+};
+static const field_t response_table1[] = {
+    { "location", "https://www.example.com" }, { "date", "Mon, 21 Oct 2013 20:13:21 GMT" },
+    { "cache-control", "private" }, { ":status", "302" }, { NULL, NULL }
+};
+// ":status: 302" was evicted to make room
+static const field_t response_table2[] = {
+    { ":status", "307" }, { "location", "https://www.example.com" },
+    { "date", "Mon, 21 Oct 2013 20:13:21 GMT" }, { "cache-control", "private" },
+    { NULL, NULL }
+};
+// Four entries were evicted to make room for the last three fields
+static const field_t response_table3[] = {
+    { "set-cookie", "foo=ASDJKHQKBZXOQWEOPIUAXQWEOIU; max-age=3600; version=1" },
+    { "content-encoding", "gzip" }, { "date", "Mon, 21 Oct 2013 20:13:22 GMT" },
+    { NULL, NULL }
+};
+
+static const char *const c5_blocks[] = {
+    "4803 3330 3258 0770 7269 7661 7465 611d 4d6f 6e2c 2032 3120 4f63 7420 3230"
+    "3133 2032 303a 3133 3a32 3120 474d 546e 1768 7474 7073 3a2f 2f77 7777 2e65"
+    "7861 6d70 6c65 2e63 6f6d",
+    "4803 3330 37c1 c0bf",
+    "88c1 611d 4d6f 6e2c 2032 3120 4f63 7420 3230 3133 2032 303a 3133 3a32 3220"
+    "474d 54c0 5a04 677a 6970 7738 666f 6f3d 4153 444a 4b48 514b 425a 584f 5157"
+    "454f 5049 5541 5851 5745 4f49 553b 206d 6178 2d61 6765 3d33 3630 303b 2076"
+    "6572 7369 6f6e 3d31",
+};
+static const char *const c6_blocks[] = {
+    "4882 6402 5885 aec3 771a 4b61 96d0 7abe 9410 54d4 44a8 2005 9504 0b81 66e0"
+    "82a6 2d1b ff6e 919d 29ad 1718 63c7 8f0b 97c8 e9ae 82ae 43d3",
+    "4883 640e ffc1 c0bf",
+    "88c1 6196 d07a be94 1054 d444 a820 0595 040b 8166 e084 a62d 1bff c05a 839b"
+    "d9ab 77ad 94e7 821d d7f2 e6c7 b335 dfdf cd5b 3960 d5af 2708 7f36 72c1 ab27"
+    "0fb5 291f 9587 3160 65c0 03ed 4ee5 b106 3d50 07",
+};
+
+// C.5 and C.6: three responses through a 256-byte table
+static void test_responses(const char *label, const char *const blocks[3])
+{
+    hpack_table_t table;
+    hpack_table_init(&table, 256);
+    char name[16];
+    snprintf(name, sizeof(name), "%s.1", label);
+    expect_block(name, &table, blocks[0], response1, response_table1, 222);
+    snprintf(name, sizeof(name), "%s.2", label);
+    expect_block(name, &table, blocks[1], response2, response_table2, 222);
+    snprintf(name, sizeof(name), "%s.3", label);
+    expect_block(name, &table, blocks[2], response3, response_table3, 215);
+}
+
+/**
+ * Encode the fields with indexing and compare with the RFC's raw blocks.
+ */
+static void expect_encoding(const char *label, hpack_table_t *table,
+                            const field_t *fields, const char *hex)
+{
+    uint8_t want[512], got[512];
+    size_t want_len = check_hex(hex, want);
+    size_t len = 0;
+    for (int i = 0; fields[i].name; i++)
+    {
+        int n = hpack_encode_header(table, got + len, sizeof(got) - len,
+                                    fields[i].name, strlen(fields[i].name),
+                                    fields[i].value, strlen(fields[i].value), 1);
+        CHECK(n > 0, "%s: cannot encode %s", label, fields[i].name);
+        if (n <= 0)
+            return;
+        len += n;
+    }
+    CHECK(len == want_len && memcmp(got, want, len) == 0,
+          "%s: encoding differs (%zu bytes, expected %zu)", label, len, want_len);
+}
+
+static void test_encoder(void)
+{
+    hpack_table_t table;
+    hpack_table_init(&table, HPACK_TABLE_SIZE);
+    expect_encoding("encode C.3.1", &table, request1, c3_blocks[0]);
+    expect_encoding("encode C.3.2", &table, request2, c3_blocks[1]);
+    expect_encoding("encode C.3.3", &table, request3, c3_blocks[2]);
+
+    hpack_table_init(&table, 256);
+    expect_encoding("encode C.5.1", &table, response1, c5_blocks[0]);
+    expect_encoding("encode C.5.2", &table, response2, c5_blocks[1]);
+    expect_encoding("encode C.5.3", &table, response3, c5_blocks[2]);
+    CHECK(table.size == 215 && table.count == 3,
+          "encode C.5: table size %zu with %d entries", table.size, table.count);
+
+    // What the encoder writes, the decoder reads back
+    hpack_table_t encoder, decoder;
+    hpack_table_init(&encoder, HPACK_TABLE_SIZE);
+    hpack_table_init(&decoder, HPACK_TABLE_SIZE);
+    uint8_t block[64];
+    int n = hpack_encode_size_update(block, sizeof(block), 100);
+    CHECK(n == 2, "size update to 100 takes %d bytes", n);
+    n += hpack_encode_header(&encoder, block + n, sizeof(block) - n, "x-plain", 7, "1", 1, 0);
+    decoded_t out = { .count = 0 };
+    static char scratch[SCRATCH_SIZE];
+    int rc = hpack_decode(&decoder, block, n, scratch, sizeof(scratch), collect, &out);
+    CHECK(rc == HPACK_OK && out.count == 1 && strcmp(out.values[0], "1") == 0 &&
+          decoder.max_size == 100, "encoded size update and literal do not decode");
+}
+
+static void test_size_updates(void)
+{
+    hpack_table_t table;
+    hpack_table_init(&table, HPACK_TABLE_SIZE);
+    decoded_t out;
+
+    CHECK(decode_hex(&table, c3_blocks[0], &out) == HPACK_OK &&
+          decode_hex(&table, c3_blocks[1], &out) == HPACK_OK && table.count == 2,
+          "size updates: setup failed");
+
+    // Shrinking evicts oldest first: 60 keeps only cache-control (53)
+    CHECK(decode_hex(&table, "3f1d 82", &out) == HPACK_OK, "size update to 60 rejected");
+    CHECK(table.count == 1 && table.size == 53 && table.max_size == 60,
+          "after size update to 60: %d entries, size %zu", table.count, table.size);
+
+    // Zero empties the table; growing back is allowed up to the setting
+    CHECK(decode_hex(&table, "20", &out) == HPACK_OK && table.count == 0 && table.size == 0,
+          "size update to 0 left %d entries", table.count);
+    CHECK(decode_hex(&table, "3fe1 1f", &out) == HPACK_OK && table.max_size == 4096,
+          "size update to 4096 rejected");
+
+    // An entry larger than the whole table empties it and is not added
+    hpack_table_init(&table, 60);
+    CHECK(decode_hex(&table, c3_blocks[0], &out) == HPACK_OK && table.count == 1,
+          "small table: first entry not added");
+    CHECK(decode_hex(&table, "400a 6375 7374 6f6d 2d6b 6579 1e" "41414141414141414141"
+                             "41414141414141414141" "41414141414141414141", &out) == HPACK_OK,
+          "oversized entry rejected");
+    CHECK(table.count == 0 && table.size == 0,
+          "oversized entry left %d entries, size %zu", table.count, table.size);
+
+    expect_error("size update above the setting", "3fe2 1f");
+    expect_error("size update after a field", "82 20");
+}
+
+static void test_malformed(void)
+{
+    expect_error("index 0", "80");
+    expect_error("index past the static table", "be");
+    expect_error("literal name index past the table", "7f00 0161");
+    expect_error("truncated index", "ff");
+    expect_error("truncated index continuation", "ff80");
+    expect_error("index integer overflow", "ff80 8080 8080 8080 8080 01");
+    expect_error("truncated name length", "007f");
+    expect_error("truncated string", "400a 6375 7374");
+    expect_error("missing value", "4001 61");
+    expect_error("EOS inside a string", "0001 6184 ffff ffff");
+    expect_error("padding longer than 7 bits", "0001 6182 1fff");
+    expect_error("padding not all ones", "0001 6181 18");
+
+    // The valid counterparts of the Huffman cases
+    hpack_table_t table;
+    decoded_t out;
+    hpack_table_init(&table, HPACK_TABLE_SIZE);
+    CHECK(decode_hex(&table, "0001 6181 1f", &out) == HPACK_OK && out.count == 1 &&
+          strcmp(out.values[0], "a") == 0, "Huffman \"a\" with 3 bits of padding");
+    CHECK(decode_hex(&table, "0001 6180", &out) == HPACK_OK && out.count == 1 &&
+          out.values[0][0] == '\0', "empty Huffman string");
+}
+
+int main(void)
+{
+    hpack_init();
+    test_c2();
+    test_requests("C.3", c3_blocks);
+    test_requests("C.4", c4_blocks);
+    test_responses("C.5", c5_blocks);
+    test_responses("C.6", c6_blocks);
+    test_encoder();
+    test_size_updates();
+    test_malformed();
+    return check_report("test_hpack");
+}
@@ -0,0 +1,320 @@
+/**
+ * @file test_parser.c
+ * @brief HTTP Server - Request Parser Scanner Tests
+ * @version 1.0.0
+ * @date 2025-06-07
+ * @author David Dev (@DavidDevGt)
+ *
+ * @description
+ * The SIMD scanners must find exactly the delimiters the scalar one
+ * finds. Every request head here is parsed once with the scalar scanner
+ * as the reference, then with each scanner this CPU has:
+ * - copied to every offset within a 64-byte block, so the 16- and
+ *   32-byte loads start unaligned and delimiters land on both sides of
+ *   each vector boundary
+ * - fed in two parts split at every byte, as recv() may deliver it
+ * - ending on the last byte before an unmapped page, so a load past the
+ *   end would fault
+ * Method, path, version, every header and the known-header index must
+ * match the reference, as must the return codes. Besides hand-written
+ * heads (valid and not), sweeps over the path, name and value lengths
+ * move each delimiter across the 16- and 32-byte boundaries. Token lists
+ * as Connection carries them are checked too.
+ *
+ * @license MIT License
+ */
+
+#define _GNU_SOURCE  // for MAP_ANONYMOUS
+
+#include "check.h"
+#include "http/http_parser.h"
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#define MAX_HEAD 1024
+#define ALIGNMENTS 64
+
+// A parse result with slices as offsets from the start of the head
+typedef struct {
+    int rc;
+    size_t method[2], path[2], version[2];
+    int header_count;
+    size_t name[HTTP_MAX_HEADERS][2], value[HTTP_MAX_HEADERS][2];
+    unsigned char known[HTTP_HDR_COUNT];
+    int http_version;
+} result_t;
+
+static const char *const scanners[] = { "scalar", "sse2", "avx2" };
+
+static void slice_at(size_t out[2], const http_slice_t *slice, const char *base)
+{
+    out[0] = slice->ptr ? (size_t)(slice->ptr - base) : 0;
+    out[1] = slice->len;
+}
+
+static void snapshot(result_t *r, int rc, const http_request_t *req, const char *base)
+{
+    memset(r, 0, sizeof(*r));
+    r->rc = rc;
+    if (rc <= 0)
+        return; // slices are only defined for a complete head
+    slice_at(r->method, &req->method, base);
+    slice_at(r->path, &req->path, base);
+    slice_at(r->version, &req->version, base);
+    r->header_count = req->header_count;
+    for (int i = 0; i < req->header_count; i++)
+    {
+        slice_at(r->name[i], &req->headers[i].name, base);
+        slice_at(r->value[i], &req->headers[i].value, base);
+    }
+    memcpy(r->known, req->known, sizeof(r->known));
+    r->http_version = req->http_version;
+}
+
+static int parse_whole(const char *buf, size_t len, result_t *r)
+{
+    http_request_t req;
+    http_request_reset(&req);
+    int rc = http_parse_request(&req, buf, len);
+    snapshot(r, rc, &req, buf);
+    return rc;
+}
+
+/**
+ * Parse with the first `split` bytes delivered first, the rest later.
+ * @return: the return code of the first call
+ */
+static int parse_split(const char *buf, size_t len, size_t split, result_t *r)
+{
+    http_request_t req;
+    http_request_reset(&req);
+    int first = http_parse_request(&req, buf, split);
+    int rc = first == HTTP_PARSE_AGAIN ? http_parse_request(&req, buf, len) : first;
+    snapshot(r, rc, &req, buf);
+    return first;
+}
+
+static int same_result(const result_t *a, const result_t *b)
+{
+    return memcmp(a, b, sizeof(*a)) == 0;
+}
+
+/**
+ * Parse one head every way with every scanner; `ref` is the scalar
+ * result of a plain parse.
+ */
+static void check_head(const char *label, const char *head, size_t len, char *page_end)
+{
+    static char block[ALIGNMENTS + MAX_HEAD];
+    result_t ref, got;
+
+    http_parser_use_scanner("scalar");
+    parse_whole(head, len, &ref);
+
+    for (size_t s = 0; s < sizeof(scanners) / sizeof(scanners[0]); s++)
+    {
+        if (http_parser_use_scanner(scanners[s]) < 0)
+            continue; // not on this CPU
+
+        for (size_t align = 0; align < ALIGNMENTS; align++)
+        {
+            char *buf = block + align;
+            memcpy(buf, head, len);
+            parse_whole(buf, len, &got);
+            CHECK(same_result(&ref, &got), "%s: %s at offset %zu differs from scalar",
+                  label, scanners[s], align);
+        }
+
+        // Split at every byte, from an aligned and an odd start
+        for (size_t align = 0; align < 2; align++)
+        {
+            char *buf = block + align * 17;
+            memcpy(buf, head, len);
+            for (size_t split = 0; split < len; split++)
+            {
+                // Only a prefix holding the whole head (a body follows) completes
+                int first = parse_split(buf, len, split, &got);
+                int complete = ref.rc > 0 && split >= (size_t)ref.rc;
+                CHECK(complete ? first == ref.rc
+                               : first == HTTP_PARSE_AGAIN || first == HTTP_PARSE_ERROR,
+                      "%s: %s returned %d on a %zu-byte prefix", label, scanners[s],
+                      first, split);
+                CHECK(same_result(&ref, &got) ||
+                      (first == HTTP_PARSE_ERROR && ref.rc == HTTP_PARSE_ERROR),
+                      "%s: %s split at %zu differs from scalar", label, scanners[s], split);
+            }
+        }
+
+        // Nothing may be read past the end of the head
+        char *buf = page_end - len;
+        memcpy(buf, head, len);
+        parse_whole(buf, len, &got);
+        CHECK(same_result(&ref, &got), "%s: %s at a page end differs from scalar",
+              label, scanners[s]);
+    }
+}
+
+static void check_str(const char *label, const char *head, char *page_end)
+{
+    check_head(label, head, strlen(head), page_end);
+}
+
+static const char *const heads[] = {
+    "GET / HTTP/1.1\r\nHost: a\r\n\r\n",
+    "GET /static/js/app.0123456789abcdef.bundle.js?v=20250607&lang=en HTTP/1.1\r\n"
+    "Host: example.com\r\n"
+    "User-Agent: Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 (KHTML, like Gecko)"
+    " Chrome/124.0.0.0 Safari/537.36\r\n"
+    "Accept: text/html,application/xhtml+xml,application/xml;q=0.9,*/*;q=0.8\r\n"
+    "Accept-Encoding: gzip, deflate, br\r\n"
+    "Accept-Language: en-US,en;q=0.9\r\n"
+    "If-None-Match: \"5f3c-1a2b3c4d\"\r\n"
+    "If-Modified-Since: Sat, 07 Jun 2025 10:00:00 GMT\r\n"
+    "If-Range: \"5f3c-1a2b3c4d\"\r\n"
+    "Range: bytes=0-1023\r\n"
+    "Connection: keep-alive\r\n"
+    "Cookie: session=0123456789abcdef0123456789abcdef; theme=dark\r\n"
+    "\r\n",
+    "POST /api/items HTTP/1.1\r\nHost: x\r\nContent-Length: 5\r\n\r\nhello",
+    "GET /lf HTTP/1.0\nHost: b\nconnection: close\n\n",
+    "\r\n\r\nGET /after-empty-lines HTTP/1.1\r\nHost: c\r\n\r\n",
+    "GET /tabs HTTP/1.1\r\nX-Tab:\tvalue\twith\ttabs\t\r\nX-Empty:\r\nX-Obs: caf\xc3\xa9 \x80\xff\r\n\r\n",
+    "GET /spaces HTTP/1.1\r\nX-Pad:     padded value     \r\n\r\n",
+    // Rejected: each scanner must stop on the same byte
+    "GET /a\x7f" "b HTTP/1.1\r\nHost: a\r\n\r\n",
+    "GET /a\x01" "b HTTP/1.1\r\n\r\n",
+    "GET / HTTP/1.1\r\nX-Ctl: a\x01" "b\r\n\r\n",
+    "GET / HTTP/1.1\r\nX-Del: a\x7f" "b\r\n\r\n",
+    "GET / HTTP/1.1\r\nBad Name: x\r\n\r\n",
+    "GET / HTTP/1.1\r\nNul\0Name: x\r\n\r\n",
+    "GET / HTTP/1.1\r\n: no name\r\n\r\n",
+    "GET / HTTP/2.0\r\n\r\n",
+};
+static const size_t head_lens[] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    sizeof("GET / HTTP/1.1\r\nNul\0Name: x\r\n\r\n") - 1,
+};
+
+/**
+ * Heads whose path, header name or value grows one byte at a time, so
+ * every delimiter crosses the 16- and 32-byte boundaries at each offset.
+ */
+static void check_sweeps(char *page_end)
+{
+    char head[MAX_HEAD], fill[128], label[64];
+    memset(fill, 'a', sizeof(fill));
+    for (int n = 0; n <= 96; n++)
+    {
+        snprintf(label, sizeof(label), "path length %d", n + 1);
+        snprintf(head, sizeof(head), "GET /%.*s HTTP/1.1\r\nHost: h\r\n\r\n", n, fill);
+        check_str(label, head, page_end);
+
+        snprintf(label, sizeof(label), "name length %d", n + 1);
+        snprintf(head, sizeof(head), "GET / HTTP/1.1\r\nX%.*s: v\r\nRange: bytes=1-\r\n\r\n",
+                 n, fill);
+        check_str(label, head, page_end);
+
+        snprintf(label, sizeof(label), "value length %d", n);
+        snprintf(head, sizeof(head), "GET / HTTP/1.1\r\nHost: %.*s\r\nX: %.*s\r\n\r\n",
+                 n, fill, 96 - n, fill);
+        check_str(label, head, page_end);
+
+        // An invalid byte at every position of a long value
+        snprintf(label, sizeof(label), "control byte at %d", n);
+        snprintf(head, sizeof(head), "GET / HTTP/1.1\r\nX: %.*s\x02%.*s\r\n\r\n",
+                 n, fill, 96 - n, fill);
+        check_str(label, head, page_end);
+    }
+}
+
+/**
+ * The reference itself must be right, or agreeing with it means nothing.
+ */
+static void check_reference(void)
+{
+    http_parser_use_scanner("scalar");
+    http_request_t req;
+    http_request_reset(&req);
+    const char *head = heads[1];
+    int rc = http_parse_request(&req, head, strlen(head));
+    CHECK(rc == (int)strlen(head), "reference head returned %d", rc);
+    CHECK(http_slice_equals(&req.method, "GET") && req.http_version == 11 &&
+          req.header_count == 11, "reference request line or header count wrong");
+    const http_slice_t *host = http_get_header(&req, HTTP_HDR_HOST);
+    const http_slice_t *range = http_get_header(&req, HTTP_HDR_RANGE);
+    const http_slice_t *length = http_get_header(&req, HTTP_HDR_CONTENT_LENGTH);
+    CHECK(host && http_slice_equals(host, "example.com"), "Host not indexed");
+    CHECK(range && http_slice_equals(range, "bytes=0-1023"), "Range not indexed");
+    CHECK(!length, "Content-Length indexed but absent");
+
+    http_request_reset(&req);
+    head = heads[2];
+    rc = http_parse_request(&req, head, strlen(head));
+    CHECK(rc == (int)strlen(head) - 5, "head length with a body after it: %d", rc);
+    length = http_get_header(&req, HTTP_HDR_CONTENT_LENGTH);
+    CHECK(length && http_slice_equals(length, "5"), "Content-Length not indexed");
+}
+
+/**
+ * Token lists as Connection carries them.
+ */
+static void check_tokens(void)
+{
+    static const struct {
+        const char *list;
+        const char *token;
+        int found;
+    } cases[] = {
+        { "close", "close", 1 },
+        { "close, TE", "close", 1 },
+        { "TE,  CLOSE ", "close", 1 },
+        { "keep-alive,Upgrade", "upgrade", 1 },
+        { " , ,close", "close", 1 },
+        { "closed", "close", 0 },
+        { "x-close, keep-alive", "close", 0 },
+        { "", "close", 0 },
+        { "TE\tclose", "close", 0 },
+    };
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++)
+    {
+        http_slice_t list = { cases[i].list, strlen(cases[i].list) };
+        CHECK(http_has_token(&list, cases[i].token, strlen(cases[i].token)) == cases[i].found,
+              "\"%s\" %s \"%s\"", cases[i].list, cases[i].found ? "lacks" : "lists",
+              cases[i].token);
+    }
+}
+
+int main(void)
+{
+    // Two pages, the second unmapped: heads are copied to end at the gap
+    long page = sysconf(_SC_PAGESIZE);
+    char *map = mmap(NULL, 2 * page, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (map == MAP_FAILED || mprotect(map + page, page, PROT_NONE) < 0)
+    {
+        perror("mmap");
+        return 1;
+    }
+    char *page_end = map + page;
+
+    check_reference();
+    check_tokens();
+    for (size_t i = 0; i < sizeof(heads) / sizeof(heads[0]); i++)
+    {
+        char label[32];
+        snprintf(label, sizeof(label), "head %zu", i);
+        size_t len = i < sizeof(head_lens) / sizeof(head_lens[0]) && head_lens[i]
+                     ? head_lens[i] : strlen(heads[i]);
+        check_head(label, heads[i], len, page_end);
+    }
+    check_sweeps(page_end);
+
+    for (size_t s = 0; s < sizeof(scanners) / sizeof(scanners[0]); s++)
+    {
+        if (http_parser_use_scanner(scanners[s]) < 0)
+            printf("test_parser: %s not available, skipped\n", scanners[s]);
+    }
+    return check_report("test_parser");
+}
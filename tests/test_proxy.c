@@ -0,0 +1,589 @@
+/**
+ * @file test_proxy.c
+ * @brief HTTP Server - Reverse Proxy Integration Tests
+ * @version 1.0.0
+ * @date 2025-06-07
+ * @author David Dev (@DavidDevGt)
+ *
+ * @description
+ * Runs the server binary with a proxy route to a stand-in upstream on
+ * loopback and talks to it over plain sockets. The upstream is scripted
+ * by path:
+ * - /up/chunked/N: a chunked response written in two parts split after
+ *   N bytes, for every N, so the relay's chunk parser resumes at each
+ *   byte of the framing
+ * - /up/both: Content-Length and Transfer-Encoding together, which must
+ *   become a 502 rather than a smuggling opportunity
+ * - /up/interim: 100 and 103 responses ahead of the final one, which the
+ *   client must never see
+ * - /up/drop: the upstream reads the request on a pooled connection and
+ *   closes it, the keep-alive race; an idempotent request is retried on
+ *   a new connection, a POST gets 502
+ * - /up/idle-close: answered, then the upstream closes the connection
+ *   while it sits in the pool; the next request must not notice
+ * - /up/hop: a response whose Connection headers name a field for the
+ *   proxy alone and ask, in a token list, for the connection to close
+ * - /up/slow/N: answers after N seconds, longer than the server's
+ *   keep-alive timeout but within its proxy timeout
+ * - /up/lengths: answers with the Content-Length fields it received, so
+ *   the test sees the one normalized length the proxy forwards
+ * - anything else: a small fixed body with Content-Length
+ *
+ * Usage: test_proxy [path/to/httpserver]
+ *
+ * @license MIT License
+ */
+
+#define _GNU_SOURCE  // for strcasestr, memmem and usleep
+
+#include "check.h"
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#define IO_TIMEOUT_SEC 10
+#define KEEP_ALIVE_TIMEOUT "1"      // seconds, as the server is started
+#define PROXY_TIMEOUT "10"
+#define BUF_SIZE 65536
+
+// The chunked body every /up/chunked response carries, and its framing
+#define CHUNKED_BODY "hello, proxied world!"
+static const char chunked_response[] =
+    "HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n"
+    "5;ext=1\r\nhello\r\n"
+    "10\r\n, proxied world!\r\n"
+    "0\r\nX-Trailer: t\r\n\r\n";
+
+static int upstream_listener;
+static int upstream_accepts;        // connections the upstream accepted
+static int upstream_drops;          // requests it closed without answering
+
+static void set_timeouts(int fd)
+{
+    struct timeval tv = { IO_TIMEOUT_SEC, 0 };
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+}
+
+static int send_all(int fd, const char *data, size_t len)
+{
+    while (len > 0)
+    {
+        ssize_t n = send(fd, data, len, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return -1;
+        data += n;
+        len -= n;
+    }
+    return 0;
+}
+
+static int send_str(int fd, const char *str)
+{
+    return send_all(fd, str, strlen(str));
+}
+
+/**
+ * Read one request head (and skip its Content-Length body) from buf/fd.
+ * @return: head length, 0 once the peer closed, -1 on error
+ */
+static ssize_t read_request(int fd, char *buf, size_t *len)
+{
+    char *end;
+    while (!(end = memmem(buf, *len, "\r\n\r\n", 4)))
+    {
+        ssize_t n = recv(fd, buf + *len, BUF_SIZE - 1 - *len, 0);
+        if (n <= 0)
+            return n;
+        *len += n;
+    }
+    size_t head = end + 4 - buf;
+    buf[head - 1] = '\0';
+    size_t body = 0;
+    const char *cl = strcasestr(buf, "\r\nContent-Length:");
+    if (cl)
+        body = strtoul(cl + 17, NULL, 10);
+    while (*len < head + body)
+    {
+        ssize_t n = recv(fd, buf + *len, BUF_SIZE - 1 - *len, 0);
+        if (n <= 0)
+            return -1;
+        *len += n;
+    }
+    return head + body;
+}
+
+static void *upstream_connection(void *arg)
+{
+    int fd = (int)(intptr_t)arg;
+    static char bufs[64][BUF_SIZE];
+    static int next_buf;
+    char *buf = bufs[__atomic_fetch_add(&next_buf, 1, __ATOMIC_RELAXED) % 64];
+    size_t len = 0;
+    int served = 0;
+    set_timeouts(fd);
+
+    while (1)
+    {
+        ssize_t used = read_request(fd, buf, &len);
+        if (used <= 0)
+            break;
+        char path[256] = "", lengths[256] = "";
+        sscanf(buf, "%*s %255s", path);
+        for (const char *h = buf; (h = strcasestr(h, "\r\nContent-Length:")); h += 2)
+        {
+            size_t n = strcspn(h + 2, "\r"), used = strlen(lengths);
+            if (used + n + 1 < sizeof(lengths))
+                snprintf(lengths + used, sizeof(lengths) - used, "%.*s;", (int)n, h + 2);
+        }
+        memmove(buf, buf + used, len - used);
+        len -= used;
+
+        if (strncmp(path, "/up/chunked/", 12) == 0)
+        {
+            size_t split = strtoul(path + 12, NULL, 10);
+            size_t total = sizeof(chunked_response) - 1;
+            if (split > total)
+                split = total;
+            send_all(fd, chunked_response, split);
+            usleep(2000); // arrives as its own segment
+            send_all(fd, chunked_response + split, total - split);
+        }
+        else if (strcmp(path, "/up/both") == 0)
+        {
+            send_str(fd, "HTTP/1.1 200 OK\r\nContent-Length: 5\r\n"
+                         "Transfer-Encoding: chunked\r\n\r\n0\r\n\r\n");
+        }
+        else if (strcmp(path, "/up/interim") == 0)
+        {
+            send_str(fd, "HTTP/1.1 100 Continue\r\n\r\n");
+            usleep(2000);
+            send_str(fd, "HTTP/1.1 103 Early Hints\r\nLink: </style.css>; rel=preload\r\n\r\n"
+                         "HTTP/1.1 200 OK\r\nContent-Length: 5\r\nX-Final: yes\r\n\r\nfinal");
+        }
+        else if (strcmp(path, "/up/drop") == 0 && served > 0)
+        {
+            // Only on a reused connection, as when an idle timeout races
+            __atomic_fetch_add(&upstream_drops, 1, __ATOMIC_RELAXED);
+            break;
+        }
+        else if (strcmp(path, "/up/idle-close") == 0)
+        {
+            send_str(fd, "HTTP/1.1 200 OK\r\nContent-Length: 4\r\n\r\nidle");
+            usleep(20000); // let the server pool it first
+            break;
+        }
+        else if (strcmp(path, "/up/hop") == 0)
+        {
+            send_str(fd, "HTTP/1.1 200 OK\r\nConnection: X-Hop\r\nX-Hop: private\r\n"
+                         "X-End: public\r\nconnection: upgrade , Close\r\nContent-Length: 3"
+                         "\r\n\r\nhop");
+            // Left open: only the proxy's reading of the header closes it
+        }
+        else if (strncmp(path, "/up/slow/", 9) == 0)
+        {
+            sleep(atoi(path + 9));
+            send_str(fd, "HTTP/1.1 200 OK\r\nContent-Length: 4\r\n\r\nslow");
+        }
+        else if (strcmp(path, "/up/lengths") == 0)
+        {
+            char response[512];
+            snprintf(response, sizeof(response), "HTTP/1.1 200 OK\r\nContent-Length: %zu"
+                     "\r\n\r\n%s", strlen(lengths), lengths);
+            send_str(fd, response);
+        }
+        else
+        {
+            send_str(fd, "HTTP/1.1 200 OK\r\nContent-Length: 2\r\n\r\nok");
+        }
+        served++;
+    }
+    close(fd);
+    return NULL;
+}
+
+static void *upstream_main(void *arg)
+{
+    (void)arg;
+    while (1)
+    {
+        int fd = accept(upstream_listener, NULL, NULL);
+        if (fd < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return NULL;
+        }
+        __atomic_fetch_add(&upstream_accepts, 1, __ATOMIC_RELAXED);
+        pthread_t thread;
+        pthread_create(&thread, NULL, upstream_connection, (void *)(intptr_t)fd);
+        pthread_detach(thread);
+    }
+}
+
+/**
+ * A listening socket on a free loopback port.
+ * @return: the socket, its port in *port
+ */
+static int listen_loopback(int *port)
+{
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr = { .sin_family = AF_INET };
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t len = sizeof(addr);
+    if (fd < 0 || bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+        listen(fd, 64) < 0 || getsockname(fd, (struct sockaddr *)&addr, &len) < 0)
+    {
+        perror("upstream listener");
+        exit(1);
+    }
+    *port = ntohs(addr.sin_port);
+    return fd;
+}
+
+static int connect_port(int port)
+{
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr = { .sin_family = AF_INET, .sin_port = htons(port) };
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+    {
+        close(fd);
+        return -1;
+    }
+    set_timeouts(fd);
+    return fd;
+}
+
+static pid_t start_server(const char *binary, int port, int upstream_port)
+{
+    char port_arg[16], route[64];
+    snprintf(port_arg, sizeof(port_arg), "%d", port);
+    snprintf(route, sizeof(route), "/up=127.0.0.1:%d", upstream_port);
+    pid_t pid = fork();
+    if (pid == 0)
+    {
+        int null = open("/dev/null", O_WRONLY);
+        dup2(null, STDOUT_FILENO);
+        execl(binary, binary, "--port", port_arg, "--workers", "1", "--root", "www",
+              "--max-requests", "100000", "--keep-alive-timeout", KEEP_ALIVE_TIMEOUT,
+              "--proxy-timeout", PROXY_TIMEOUT, "--proxy", route, (char *)NULL);
+        perror(binary);
+        _exit(127);
+    }
+    // Ready once it accepts
+    for (int i = 0; i < 200; i++)
+    {
+        int fd = connect_port(port);
+        if (fd >= 0)
+        {
+            close(fd);
+            return pid;
+        }
+        usleep(10000);
+    }
+    fprintf(stderr, "%s did not start on port %d\n", binary, port);
+    kill(pid, SIGKILL);
+    exit(1);
+}
+
+typedef struct {
+    int status;
+    char head[4096];
+    char body[BUF_SIZE];
+    size_t body_len;
+} response_t;
+
+/**
+ * Read one response on a keep-alive connection. Chunked bodies are
+ * decoded, trailers skipped.
+ * @return: 0 on success, -1 if it is cut short or malformed
+ */
+static int read_response(int fd, char *buf, size_t *len, response_t *r)
+{
+    char *end;
+    while (!(end = memmem(buf, *len, "\r\n\r\n", 4)))
+    {
+        ssize_t n = recv(fd, buf + *len, BUF_SIZE - *len, 0);
+        if (n <= 0)
+            return -1;
+        *len += n;
+    }
+    size_t head = end + 4 - buf;
+    if (head >= sizeof(r->head))
+        return -1;
+    memcpy(r->head, buf, head);
+    r->head[head] = '\0';
+    r->status = atoi(buf + 9);
+    r->body_len = 0;
+    memmove(buf, buf + head, *len - head);
+    *len -= head;
+
+    const char *cl = strcasestr(r->head, "\r\nContent-Length:");
+    int chunked = strcasestr(r->head, "\r\nTransfer-Encoding: chunked") != NULL;
+    size_t want = cl ? strtoul(cl + 17, NULL, 10) : 0;
+    while (1)
+    {
+        if (!chunked && *len >= want)
+            break;
+        if (chunked)
+        {
+            // Take every complete chunk that is buffered
+            char *line;
+            while ((line = memmem(buf, *len, "\r\n", 2)))
+            {
+                size_t size = strtoul(buf, NULL, 16);
+                size_t line_len = line + 2 - buf;
+                if (size == 0)
+                {
+                    char *trailers_end = memmem(buf, *len, "\r\n\r\n", 4);
+                    if (!trailers_end && !(line_len == 2 && buf[0] == '\r'))
+                        break;
+                    size_t done = trailers_end ? (size_t)(trailers_end + 4 - buf) : line_len;
+                    memmove(buf, buf + done, *len - done);
+                    *len -= done;
+                    return 0;
+                }
+                if (*len < line_len + size + 2)
+                    break;
+                memcpy(r->body + r->body_len, buf + line_len, size);
+                r->body_len += size;
+                memmove(buf, buf + line_len + size + 2, *len - line_len - size - 2);
+                *len -= line_len + size + 2;
+            }
+        }
+        ssize_t n = recv(fd, buf + *len, BUF_SIZE - *len, 0);
+        if (n <= 0)
+            return -1;
+        *len += n;
+    }
+    memcpy(r->body, buf, want);
+    r->body_len = want;
+    memmove(buf, buf + want, *len - want);
+    *len -= want;
+    return 0;
+}
+
+/**
+ * Send a request on a keep-alive connection and read the response.
+ * @return: as read_response()
+ */
+static int exchange(int fd, const char *request, char *buf, size_t *len, response_t *r)
+{
+    if (send_str(fd, request) < 0)
+        return -1;
+    return read_response(fd, buf, len, r);
+}
+
+static char client_buf[BUF_SIZE];
+
+static void test_chunked_splits(int port)
+{
+    int fd = connect_port(port);
+    size_t len = 0;
+    response_t r;
+    size_t total = sizeof(chunked_response) - 1;
+    size_t head = strstr(chunked_response, "\r\n\r\n") + 4 - chunked_response;
+
+    // Every split from inside the head to the final CRLF, on one connection
+    // (the server is started with a request limit well above this)
+    for (size_t split = 1; split < total; split++)
+    {
+        char request[128];
+        snprintf(request, sizeof(request), "GET /up/chunked/%zu HTTP/1.1\r\nHost: t\r\n\r\n",
+                 split);
+        int rc = exchange(fd, request, client_buf, &len, &r);
+        CHECK(rc == 0 && r.status == 200, "chunked split at %zu (%s): status %d",
+              split, split < head ? "head" : "body", rc == 0 ? r.status : -1);
+        if (rc < 0)
+            break;
+        CHECK(r.body_len == strlen(CHUNKED_BODY) &&
+              memcmp(r.body, CHUNKED_BODY, r.body_len) == 0,
+              "chunked split at %zu: body differs", split);
+    }
+    CHECK(len == 0, "bytes left over after the chunked responses");
+    close(fd);
+}
+
+static void test_both_framings(int port)
+{
+    int fd = connect_port(port);
+    size_t len = 0;
+    response_t r;
+    int rc = exchange(fd, "GET /up/both HTTP/1.1\r\nHost: t\r\n\r\n", client_buf, &len, &r);
+    CHECK(rc == 0 && r.status == 502,
+          "Content-Length with Transfer-Encoding: status %d, expected 502",
+          rc == 0 ? r.status : -1);
+    close(fd);
+}
+
+static void test_request_lengths(int port)
+{
+    int fd = connect_port(port);
+    size_t len = 0;
+    response_t r;
+
+    // One length reaches the upstream, in its plain form
+    int rc = exchange(fd, "POST /up/lengths HTTP/1.1\r\nHost: t\r\ncontent-length:  4\r\n"
+                      "\r\nbody", client_buf, &len, &r);
+    CHECK(rc == 0 && r.status == 200 && r.body_len == 18 &&
+          memcmp(r.body, "Content-Length: 4;", 18) == 0,
+          "POST body length not forwarded as one Content-Length: %.*s",
+          rc == 0 ? (int)r.body_len : 0, r.body);
+    close(fd);
+
+    // Two lengths: the bytes after the first body would be a request the
+    // upstream never framed the same way
+    static const char *const smuggled[] = {
+        "POST /up/lengths HTTP/1.1\r\nHost: t\r\nContent-Length: 0\r\n"
+        "Content-Length: 20\r\n\r\nGET /up/admin HTTP/1.1\r\n\r\n",
+        "POST /up/lengths HTTP/1.1\r\nHost: t\r\nContent-Length: 4\r\n"
+        "Content-Length: 4\r\n\r\nbody",
+        "POST /up/lengths HTTP/1.1\r\nHost: t\r\nContent-Length: 4, 4\r\n\r\nbody",
+    };
+    for (size_t i = 0; i < sizeof(smuggled) / sizeof(smuggled[0]); i++)
+    {
+        fd = connect_port(port);
+        len = 0;
+        rc = exchange(fd, smuggled[i], client_buf, &len, &r);
+        CHECK(rc == 0 && r.status == 400, "conflicting lengths %zu: status %d, expected 400",
+              i, rc == 0 ? r.status : -1);
+        char byte;
+        CHECK(len == 0 && recv(fd, &byte, 1, 0) == 0,
+              "conflicting lengths %zu: connection not closed after the 400", i);
+        close(fd);
+    }
+}
+
+static void test_interim(int port)
+{
+    int fd = connect_port(port);
+    size_t len = 0;
+    response_t r;
+    int rc = exchange(fd, "GET /up/interim HTTP/1.1\r\nHost: t\r\n\r\n", client_buf, &len, &r);
+    CHECK(rc == 0 && r.status == 200, "interim: status %d, expected 200",
+          rc == 0 ? r.status : -1);
+    CHECK(rc == 0 && strstr(r.head, "X-Final: yes") && !strstr(r.head, "Link:") &&
+          r.body_len == 5 && memcmp(r.body, "final", 5) == 0,
+          "interim: final response not relayed as it is");
+    CHECK(len == 0, "interim: %zu bytes after the final response", len);
+
+    // The connection is still in step
+    rc = exchange(fd, "GET /up/next HTTP/1.1\r\nHost: t\r\n\r\n", client_buf, &len, &r);
+    CHECK(rc == 0 && r.status == 200 && r.body_len == 2, "request after interim failed");
+    close(fd);
+}
+
+static void test_response_connection(int port)
+{
+    int fd = connect_port(port);
+    size_t len = 0;
+    response_t r;
+
+    int rc = exchange(fd, "GET /up/hop HTTP/1.1\r\nHost: t\r\n\r\n", client_buf, &len, &r);
+    CHECK(rc == 0 && r.status == 200 && r.body_len == 3, "hop: status %d",
+          rc == 0 ? r.status : -1);
+    CHECK(rc == 0 && !strcasestr(r.head, "X-Hop") && strstr(r.head, "X-End: public") &&
+          strstr(r.head, "Connection: keep-alive"),
+          "hop: fields named by the upstream's Connection reached the client:\n%s", r.head);
+
+    // The upstream asked to close, so its connection is not reused
+    int accepts = __atomic_load_n(&upstream_accepts, __ATOMIC_RELAXED);
+    rc = exchange(fd, "GET /up/next HTTP/1.1\r\nHost: t\r\n\r\n", client_buf, &len, &r);
+    CHECK(rc == 0 && r.status == 200 &&
+          __atomic_load_n(&upstream_accepts, __ATOMIC_RELAXED) == accepts + 1,
+          "hop: connection kept although the upstream said close");
+    close(fd);
+}
+
+static void test_slow_upstream(int port)
+{
+    int fd = connect_port(port);
+    size_t len = 0;
+    response_t r;
+
+    // The keep-alive timeout only counts while no request is in flight
+    int rc = exchange(fd, "GET /up/slow/3 HTTP/1.1\r\nHost: t\r\n\r\n", client_buf, &len, &r);
+    CHECK(rc == 0 && r.status == 200 && r.body_len == 4,
+          "upstream slower than the keep-alive timeout: status %d",
+          rc == 0 ? r.status : -1);
+    close(fd);
+}
+
+static void test_pooled_failures(int port)
+{
+    int fd = connect_port(port);
+    size_t len = 0;
+    response_t r;
+
+    // Closed while idle: dropped from the pool, a new connection serves
+    int rc = exchange(fd, "GET /up/idle-close HTTP/1.1\r\nHost: t\r\n\r\n",
+                      client_buf, &len, &r);
+    CHECK(rc == 0 && r.status == 200, "idle-close: first request failed");
+    usleep(100000);
+    rc = exchange(fd, "GET /up/after-idle HTTP/1.1\r\nHost: t\r\n\r\n", client_buf, &len, &r);
+    CHECK(rc == 0 && r.status == 200 && r.body_len == 2,
+          "request after the upstream closed an idle connection: status %d",
+          rc == 0 ? r.status : -1);
+
+    // Closed with the request in flight: a GET is sent again on a new one
+    int accepts = __atomic_load_n(&upstream_accepts, __ATOMIC_RELAXED);
+    int drops = __atomic_load_n(&upstream_drops, __ATOMIC_RELAXED);
+    rc = exchange(fd, "GET /up/drop HTTP/1.1\r\nHost: t\r\n\r\n", client_buf, &len, &r);
+    CHECK(rc == 0 && r.status == 200 && r.body_len == 2,
+          "GET on a dropped pooled connection: status %d, expected 200 after a retry",
+          rc == 0 ? r.status : -1);
+    CHECK(__atomic_load_n(&upstream_drops, __ATOMIC_RELAXED) == drops + 1 &&
+          __atomic_load_n(&upstream_accepts, __ATOMIC_RELAXED) == accepts + 1,
+          "GET on a dropped pooled connection was not retried on a new one");
+
+    // A POST must not be sent twice
+    rc = exchange(fd, "GET /up/warm HTTP/1.1\r\nHost: t\r\n\r\n", client_buf, &len, &r);
+    CHECK(rc == 0 && r.status == 200, "warm-up before the POST failed");
+    rc = exchange(fd, "POST /up/drop HTTP/1.1\r\nHost: t\r\nContent-Length: 4\r\n\r\nbody",
+                  client_buf, &len, &r);
+    CHECK(rc == 0 && r.status == 502, "POST on a dropped pooled connection: status %d, "
+          "expected 502", rc == 0 ? r.status : -1);
+    close(fd);
+}
+
+int main(int argc, char **argv)
+{
+    const char *binary = argc > 1 ? argv[1] : "build/httpserver";
+    signal(SIGPIPE, SIG_IGN);
+
+    int upstream_port, server_port;
+    upstream_listener = listen_loopback(&upstream_port);
+    int probe = listen_loopback(&server_port);
+    close(probe); // free again for the server
+
+    pthread_t upstream;
+    pthread_create(&upstream, NULL, upstream_main, NULL);
+    pid_t server = start_server(binary, server_port, upstream_port);
+
+    test_chunked_splits(server_port);
+    test_both_framings(server_port);
+    test_request_lengths(server_port);
+    test_interim(server_port);
+    test_response_connection(server_port);
+    test_slow_upstream(server_port);
+    test_pooled_failures(server_port);
+
+    kill(server, SIGKILL);
+    waitpid(server, NULL, 0);
+    return check_report("test_proxy");
+}
@@ -0,0 +1,423 @@
+/**
+ * @file bundlegen.c
+ * @brief HTTP Server C - Asset Bundle Packer
+ * @version 1.0.0
+ * @date 2025-06-07
+ * @author David Dev (@DavidDevGt)
+ *
+ * @description
+ * Build-time tool behind --bundle: packs a document root into the file
+ * format described in src/http/bundle.h. Every regular file becomes an
+ * entry with its MIME type, Last-Modified, an ETag taken from its content,
+ * and the fixed part of its 200 head. gzip and br variants come from
+ * fresh main.js.gz / main.js.br siblings when present, otherwise they are
+ * compressed here, the way the file cache would at run time; a variant
+ * that is not smaller than the original is left out.
+ *
+ * Content ETags, rather than the inode-based ones of the filesystem path,
+ * stay the same across rebuilds and across servers given the same files.
+ * Entries are sorted by path, so the same tree always gives the same
+ * table. The output is written next to the target and renamed over it,
+ * which leaves a server still mapping the old file undisturbed.
+ *
+ * Usage: bundlegen ROOT OUTPUT
+ *
+ * @license MIT License
+ */
+
+#define _GNU_SOURCE  // for realpath and asprintf
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <limits.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include "http/bundle.h"
+#include "http/compress.h"
+#include "http/conditional.h"
+#include "http/mime.h"
+
+typedef struct {
+    char *data;                 // NULL for a coding left out
+    size_t size;
+} body_t;
+
+typedef struct {
+    char *url_path;
+    char *fs_path;
+    struct stat st;
+    const char *mime;
+    body_t variants[ENCODING_COUNT];
+} file_t;
+
+typedef struct {
+    char *data;
+    size_t len;
+    size_t cap;
+} buffer_t;
+
+static file_t *files;
+static size_t file_count = 0;
+static size_t file_cap = 0;
+static char root_real[PATH_MAX];
+
+static void *xrealloc(void *ptr, size_t size)
+{
+    void *p = realloc(ptr, size);
+    if (!p)
+    {
+        perror("realloc");
+        exit(1);
+    }
+    return p;
+}
+
+/**
+ * Append bytes, optionally padded to an alignment first.
+ * @return: offset of the bytes within the buffer
+ */
+static size_t buffer_put(buffer_t *buf, const void *data, size_t len, size_t align)
+{
+    size_t offset = (buf->len + align - 1) / align * align;
+    if (offset + len > buf->cap)
+    {
+        size_t cap = buf->cap ? buf->cap : 4096;
+        while (cap < offset + len)
+            cap *= 2;
+        buf->data = xrealloc(buf->data, cap);
+        buf->cap = cap;
+    }
+    memset(buf->data + buf->len, 0, offset - buf->len);
+    memcpy(buf->data + offset, data, len);
+    buf->len = offset + len;
+    return offset;
+}
+
+static size_t buffer_put_string(buffer_t *buf, const char *str)
+{
+    return buffer_put(buf, str, strlen(str) + 1, 1);
+}
+
+/**
+ * Read a whole file.
+ * @return: 0 with a malloc'd copy in *out, -1 on error (reported)
+ */
+static int read_file(const char *path, size_t size, char **out)
+{
+    FILE *f = fopen(path, "rb");
+    if (!f)
+    {
+        perror(path);
+        return -1;
+    }
+    char *data = malloc(size ? size : 1);
+    if (!data || fread(data, 1, size, f) != size)
+    {
+        fprintf(stderr, "%s: short read\n", path);
+        free(data);
+        fclose(f);
+        return -1;
+    }
+    fclose(f);
+    *out = data;
+    return 0;
+}
+
+static void add_file(const char *url_path, const char *fs_path, const struct stat *st)
+{
+    if (file_count == file_cap)
+    {
+        file_cap = file_cap ? file_cap * 2 : 64;
+        files = xrealloc(files, file_cap * sizeof(file_t));
+    }
+    file_t *f = &files[file_count++];
+    memset(f, 0, sizeof(*f));
+    f->url_path = strdup(url_path);
+    f->fs_path = strdup(fs_path);
+    f->st = *st;
+    if (!f->url_path || !f->fs_path)
+    {
+        perror("strdup");
+        exit(1);
+    }
+}
+
+/**
+ * Collect the regular files under dir; url is its URL path without the
+ * trailing slash. Symlinks are followed only while they stay inside the
+ * root, as realpath() checks at run time.
+ * @return: 0 on success, -1 on error (reported)
+ */
+static int walk(const char *dir, const char *url)
+{
+    struct dirent **names;
+    int n = scandir(dir, &names, NULL, alphasort);
+    if (n < 0)
+    {
+        perror(dir);
+        return -1;
+    }
+    int rc = 0;
+    for (int i = 0; i < n; i++)
+    {
+        const char *name = names[i]->d_name;
+        char fs_path[PATH_MAX];
+        char url_path[PATH_MAX];
+        char real[PATH_MAX];
+        struct stat st;
+        if (strcmp(name, ".") == 0 || strcmp(name, "..") == 0)
+            goto next;
+        if ((size_t)snprintf(fs_path, sizeof(fs_path), "%s/%s", dir, name) >= sizeof(fs_path) ||
+            (size_t)snprintf(url_path, sizeof(url_path), "%s/%s", url, name) >= sizeof(url_path))
+        {
+            fprintf(stderr, "%s/%s: path too long, skipped\n", dir, name);
+            goto next;
+        }
+        size_t root_len = strlen(root_real);
+        if (stat(fs_path, &st) < 0 || !realpath(fs_path, real) ||
+            strncmp(real, root_real, root_len) != 0 ||
+            (real[root_len] != '/' && real[root_len] != '\0'))
+        {
+            fprintf(stderr, "%s: outside the root or unreadable, skipped\n", fs_path);
+            goto next;
+        }
+        if (S_ISDIR(st.st_mode))
+        {
+            if (walk(fs_path, url_path) < 0)
+                rc = -1;
+        }
+        else if (S_ISREG(st.st_mode))
+        {
+            add_file(url_path, fs_path, &st);
+        }
+    next:
+        free(names[i]);
+    }
+    free(names);
+    return rc;
+}
+
+/**
+ * Fill in one coded variant: a fresh sibling file, else compress now.
+ * Leaves the variant empty when it would not save anything.
+ */
+static int load_variant(file_t *f, content_encoding_t encoding)
+{
+    body_t *identity = &f->variants[ENCODING_IDENTITY];
+    body_t *variant = &f->variants[encoding];
+    char sibling[PATH_MAX];
+    struct stat st;
+    snprintf(sibling, sizeof(sibling), "%s%s", f->fs_path, encoding_suffix(encoding));
+    if (stat(sibling, &st) == 0 && S_ISREG(st.st_mode) && st.st_mtime >= f->st.st_mtime)
+    {
+        if (read_file(sibling, st.st_size, &variant->data) < 0)
+            return -1;
+        variant->size = st.st_size;
+    }
+    else if (mime_is_compressible(f->mime) && identity->size >= COMPRESS_MIN_SIZE)
+    {
+        if (compress_buffer(encoding, identity->data, identity->size,
+                            &variant->data, &variant->size) < 0)
+        {
+            fprintf(stderr, "%s: %s compression failed\n", f->fs_path, encoding_name(encoding));
+            return -1;
+        }
+    }
+    else
+    {
+        return 0;
+    }
+    if (variant->size >= identity->size)
+    {
+        free(variant->data);
+        memset(variant, 0, sizeof(*variant));
+    }
+    return 0;
+}
+
+/**
+ * Lay out the bundle in memory: header, slots, entries, strings, bodies.
+ */
+static void build(buffer_t *out)
+{
+    size_t slot_count = 16;
+    while (slot_count < file_count * 2)
+        slot_count *= 2;
+
+    bundle_header_t header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, BUNDLE_MAGIC, sizeof(header.magic));
+    header.version = BUNDLE_VERSION;
+    header.entry_count = (uint32_t)file_count;
+    header.slot_count = (uint32_t)slot_count;
+    header.slots = sizeof(header);
+    header.entries = (header.slots + slot_count * sizeof(uint32_t) + 7) / 8 * 8;
+
+    uint32_t *slots = calloc(slot_count, sizeof(uint32_t));
+    bundle_entry_t *entries = calloc(file_count ? file_count : 1, sizeof(bundle_entry_t));
+    if (!slots || !entries)
+    {
+        perror("calloc");
+        exit(1);
+    }
+
+    // Strings first, then bodies; both are placed after the fixed tables,
+    // so their offsets are rebased once those sizes are known
+    buffer_t strings = { 0 };
+    buffer_t bodies = { 0 };
+    for (size_t i = 0; i < file_count; i++)
+    {
+        file_t *f = &files[i];
+        bundle_entry_t *e = &entries[i];
+        size_t len = strlen(f->url_path);
+        e->path_hash = fnv1a(f->url_path, len);
+        e->path_len = (uint32_t)len;
+        e->path = buffer_put_string(&strings, f->url_path);
+        e->mime = buffer_put_string(&strings, f->mime);
+        char last_modified[HTTP_DATE_MAX];
+        format_http_date(last_modified, sizeof(last_modified), f->st.st_mtime);
+        e->last_modified = buffer_put_string(&strings, last_modified);
+        e->mtime = f->st.st_mtime;
+
+        uint64_t hash = fnv1a(f->variants[ENCODING_IDENTITY].data,
+                              f->variants[ENCODING_IDENTITY].size);
+        for (int c = 0; c < ENCODING_COUNT; c++)
+        {
+            body_t *body = &f->variants[c];
+            if (c != ENCODING_IDENTITY && !body->data)
+                continue;
+            const char *coding = encoding_name(c);
+            char etag[ETAG_MAX];
+            snprintf(etag, sizeof(etag), "\"%016llx-%llx%s%s\"",
+                     (unsigned long long)hash, (unsigned long long)f->st.st_size,
+                     coding ? "-" : "", coding ? coding : "");
+
+            char *head;
+            int head_len = asprintf(&head,
+                                    "HTTP/1.1 200 OK\r\n"
+                                    "Content-Length: %zu\r\n"
+                                    "Content-Type: %s\r\n"
+                                    "%s%s%s"
+                                    "Accept-Ranges: bytes\r\n"
+                                    "ETag: %s\r\n"
+                                    "Last-Modified: %s\r\n",
+                                    body->size, f->mime,
+                                    coding ? "Content-Encoding: " : "",
+                                    coding ? coding : "",
+                                    coding ? "\r\n" : "",
+                                    etag, last_modified);
+            if (head_len < 0)
+            {
+                perror("asprintf");
+                exit(1);
+            }
+            bundle_variant_t *v = &e->variants[c];
+            v->etag = buffer_put_string(&strings, etag);
+            v->head = buffer_put(&strings, head, head_len, 1);
+            v->head_len = (uint32_t)head_len;
+            v->body = buffer_put(&bodies, body->data, body->size, BUNDLE_ALIGN);
+            v->size = body->size;
+            free(head);
+        }
+
+        size_t slot = e->path_hash & (slot_count - 1);
+        while (slots[slot] != 0)
+            slot = (slot + 1) & (slot_count - 1);
+        slots[slot] = (uint32_t)i + 1;
+    }
+
+    size_t strings_at = header.entries + file_count * sizeof(bundle_entry_t);
+    size_t bodies_at = (strings_at + strings.len + BUNDLE_ALIGN - 1) / BUNDLE_ALIGN * BUNDLE_ALIGN;
+    for (size_t i = 0; i < file_count; i++)
+    {
+        bundle_entry_t *e = &entries[i];
+        e->path += strings_at;
+        e->mime += strings_at;
+        e->last_modified += strings_at;
+        for (int c = 0; c < ENCODING_COUNT; c++)
+        {
+            bundle_variant_t *v = &e->variants[c];
+            if (v->head_len == 0)
+                continue;
+            v->etag += strings_at;
+            v->head += strings_at;
+            v->body += bodies_at;
+        }
+    }
+    header.size = bodies_at + bodies.len;
+
+    buffer_put(out, &header, sizeof(header), 1);
+    buffer_put(out, slots, slot_count * sizeof(uint32_t), 1);
+    buffer_put(out, entries, file_count * sizeof(bundle_entry_t), 8);
+    buffer_put(out, strings.data, strings.len, 1);
+    buffer_put(out, bodies.data, bodies.len, BUNDLE_ALIGN);
+    free(slots);
+    free(entries);
+    free(strings.data);
+    free(bodies.data);
+}
+
+static int write_bundle(const char *path, const buffer_t *out)
+{
+    char tmp[PATH_MAX];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    FILE *f = fopen(tmp, "wb");
+    if (!f)
+    {
+        perror(tmp);
+        return -1;
+    }
+    if (fwrite(out->data, 1, out->len, f) != out->len || fclose(f) != 0)
+    {
+        perror(tmp);
+        remove(tmp);
+        return -1;
+    }
+    if (rename(tmp, path) < 0)
+    {
+        perror(path);
+        remove(tmp);
+        return -1;
+    }
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc != 3)
+    {
+        fprintf(stderr, "Usage: %s ROOT OUTPUT\n", argv[0]);
+        return 1;
+    }
+    if (!realpath(argv[1], root_real))
+    {
+        perror(argv[1]);
+        return 1;
+    }
+    if (walk(root_real, "") < 0)
+        return 1;
+
+    size_t coded = 0;
+    for (size_t i = 0; i < file_count; i++)
+    {
+        file_t *f = &files[i];
+        f->mime = mime_type(f->url_path);
+        body_t *identity = &f->variants[ENCODING_IDENTITY];
+        if (read_file(f->fs_path, f->st.st_size, &identity->data) < 0)
+            return 1;
+        identity->size = f->st.st_size;
+        if (load_variant(f, ENCODING_GZIP) < 0 || load_variant(f, ENCODING_BR) < 0)
+            return 1;
+        coded += (f->variants[ENCODING_GZIP].data != NULL) + (f->variants[ENCODING_BR].data != NULL);
+    }
+
+    buffer_t out = { 0 };
+    build(&out);
+    if (write_bundle(argv[2], &out) < 0)
+        return 1;
+    printf("%s: %zu files, %zu compressed variants, %zu bytes\n",
+           argv[2], file_count, coded, out.len);
+    return 0;
+}
@@ -0,0 +1,268 @@
+/**
+ * @file mimegen.c
+ * @brief HTTP Server C - MIME Perfect-Hash Table Generator
+ * @version 1.0.0
+ * @date 2025-06-07
+ * @author David Dev (@DavidDevGt)
+ *
+ * @description
+ * Build-time tool behind src/http/mime.c: reads a mime.types file and
+ * prints the C table the server compiles in. Each extension is hashed
+ * with mime_ext_hash(); mime_bucket() sends it to one of about n/4
+ * buckets. Buckets are placed largest first: for each one the tool tries
+ * displacements 0, 1, 2... until mime_slot() puts all of its extensions
+ * in slots nobody holds yet. With at least two slots per extension the
+ * early buckets find room at once and the late ones hold one extension
+ * each, so the search is quick even for a full /etc/mime.types. The
+ * search has no randomness: the same input always gives the same table.
+ *
+ * Usage: mimegen mime.types > mime_table.h
+ *
+ * @license MIT License
+ */
+
+#define _GNU_SOURCE  // for strdup and strtok_r
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <stdint.h>
+#include "http/mime.h"
+
+#define MAX_ENTRIES 4096
+#define MAX_BITS 16                     // slots and buckets
+#define MAX_DISPLACE 65536              // displacements tried per bucket
+
+typedef struct {
+    char ext[MIME_EXT_MAX];
+    size_t len;
+    char *type;
+    uint64_t hash;
+} entry_t;
+
+static entry_t entries[MAX_ENTRIES];
+static int entry_count = 0;
+
+static uint32_t slots[1 << MAX_BITS];           // entry index + 1, 0 = free
+static uint16_t displace[1 << MAX_BITS];
+static int bucket_first[1 << MAX_BITS];         // chain of entries per bucket
+static int bucket_size[1 << MAX_BITS];
+static int entry_next[MAX_ENTRIES];
+static int order[1 << MAX_BITS];
+
+static int find_entry(const char *ext, size_t len)
+{
+    for (int i = 0; i < entry_count; i++)
+    {
+        if (entries[i].len == len && memcmp(entries[i].ext, ext, len) == 0)
+            return i;
+    }
+    return -1;
+}
+
+/**
+ * Read "type ext ext..." lines; '#' starts a comment, a trailing ';' (the
+ * nginx spelling) is ignored.
+ * @return: 0 on success, -1 on error (reported on stderr)
+ */
+static int load_types(const char *path)
+{
+    FILE *f = fopen(path, "r");
+    if (!f)
+    {
+        perror(path);
+        return -1;
+    }
+    char line[1024];
+    int line_no = 0;
+    while (fgets(line, sizeof(line), f))
+    {
+        line_no++;
+        char *hash = strchr(line, '#');
+        if (hash)
+            *hash = '\0';
+        char *save;
+        char *type = strtok_r(line, " \t\r\n;", &save);
+        if (!type)
+            continue;
+        char *owned = strdup(type);
+        if (!owned)
+        {
+            perror("strdup");
+            fclose(f);
+            return -1;
+        }
+        int used = 0;
+        for (char *ext = strtok_r(NULL, " \t\r\n;", &save); ext;
+             ext = strtok_r(NULL, " \t\r\n;", &save))
+        {
+            size_t len = strlen(ext);
+            if (strchr(ext, '.'))
+                continue; // "tar.gz": lookups only see what follows the last dot
+            if (len >= MIME_EXT_MAX)
+            {
+                fprintf(stderr, "%s:%d: extension %s too long, skipped\n", path, line_no, ext);
+                continue;
+            }
+            for (size_t i = 0; i < len; i++)
+                ext[i] = (char)tolower((unsigned char)ext[i]);
+            if (find_entry(ext, len) >= 0)
+                continue; // the first type listed wins
+            if (entry_count == MAX_ENTRIES)
+            {
+                fprintf(stderr, "%s: more than %d extensions\n", path, MAX_ENTRIES);
+                fclose(f);
+                return -1;
+            }
+            entry_t *e = &entries[entry_count++];
+            memcpy(e->ext, ext, len + 1);
+            e->len = len;
+            e->type = owned;
+            e->hash = mime_ext_hash(ext, len);
+            used = 1;
+        }
+        if (!used)
+            free(owned);
+    }
+    fclose(f);
+    return 0;
+}
+
+static int larger_bucket(const void *a, const void *b)
+{
+    int x = *(const int *)a, y = *(const int *)b;
+    if (bucket_size[x] != bucket_size[y])
+        return bucket_size[y] - bucket_size[x];
+    return x - y;   // stable, so the output is reproducible
+}
+
+/**
+ * Try d as the displacement of a bucket: every entry must land in a free
+ * slot, and no two of them in the same one.
+ * @return: 1 and the entries placed if d works, 0 with nothing placed
+ */
+static int place_bucket(int bucket, uint32_t d, int slot_bits)
+{
+    int e = bucket_first[bucket];
+    for (; e >= 0; e = entry_next[e])
+    {
+        uint32_t slot = mime_slot(entries[e].hash, d, slot_bits);
+        if (slots[slot])
+            break;
+        slots[slot] = (uint32_t)e + 1;
+    }
+    if (e < 0)
+        return 1;
+
+    // Undo the entries placed before the clash
+    for (int u = bucket_first[bucket]; u != e; u = entry_next[u])
+        slots[mime_slot(entries[u].hash, d, slot_bits)] = 0;
+    return 0;
+}
+
+/**
+ * Find a displacement for every bucket.
+ * @return: 0 on success, -1 if some bucket has none
+ */
+static int build_table(int bucket_bits, int slot_bits)
+{
+    int buckets = 1 << bucket_bits;
+    memset(slots, 0, sizeof(slots));
+    memset(displace, 0, sizeof(displace));
+    for (int b = 0; b < buckets; b++)
+    {
+        bucket_first[b] = -1;
+        bucket_size[b] = 0;
+        order[b] = b;
+    }
+    // Chain in reverse so each bucket lists its entries in file order
+    for (int i = entry_count - 1; i >= 0; i--)
+    {
+        uint32_t b = mime_bucket(entries[i].hash, bucket_bits);
+        entry_next[i] = bucket_first[b];
+        bucket_first[b] = i;
+        bucket_size[b]++;
+    }
+    qsort(order, buckets, sizeof(order[0]), larger_bucket);
+
+    for (int i = 0; i < buckets && bucket_size[order[i]] > 0; i++)
+    {
+        uint32_t d = 0;
+        while (d < MAX_DISPLACE && !place_bucket(order[i], d, slot_bits))
+            d++;
+        if (d == MAX_DISPLACE)
+            return -1;
+        displace[order[i]] = (uint16_t)d;
+    }
+    return 0;
+}
+
+static void print_array(const char *type, const char *name, const char *size,
+                        const void *data, int wide, int count)
+{
+    printf("static const %s %s[%s] = {", type, name, size);
+    for (int i = 0; i < count; i++)
+    {
+        unsigned v = wide ? ((const uint32_t *)data)[i] : ((const uint16_t *)data)[i];
+        printf("%s%u,", i % 16 == 0 ? "\n    " : " ", v);
+    }
+    printf("\n};\n");
+}
+
+static void print_table(const char *source, int bucket_bits, int slot_bits)
+{
+    printf("// Generated by tools/mimegen.c from %s; do not edit.\n", source);
+    printf("// %d extensions, %d buckets, %d slots\n\n",
+           entry_count, 1 << bucket_bits, 1 << slot_bits);
+    printf("#define MIME_BUCKET_BITS %d\n", bucket_bits);
+    printf("#define MIME_SLOT_BITS %d\n\n", slot_bits);
+
+    printf("static const mime_entry_t mime_entries[%d] = {\n", entry_count);
+    for (int i = 0; i < entry_count; i++)
+        printf("    { \"%s\", %zu, \"%s\" },\n", entries[i].ext, entries[i].len, entries[i].type);
+    printf("};\n\n");
+
+    print_array("uint16_t", "mime_displace", "1 << MIME_BUCKET_BITS",
+                displace, 0, 1 << bucket_bits);
+    printf("\n");
+    print_array(entry_count < 255 ? "uint8_t" : "uint16_t", "mime_slots",
+                "1 << MIME_SLOT_BITS", slots, 1, 1 << slot_bits);
+}
+
+int main(int argc, char **argv)
+{
+    if (argc != 2)
+    {
+        fprintf(stderr, "Usage: %s mime.types > mime_table.h\n", argv[0]);
+        return 1;
+    }
+    if (load_types(argv[1]) < 0)
+        return 1;
+    if (entry_count == 0)
+    {
+        fprintf(stderr, "%s: no extensions\n", argv[1]);
+        return 1;
+    }
+
+    // About four extensions per bucket and at least two slots per
+    // extension; only widen the slots if some bucket finds no room. Never
+    // fewer than two buckets: mime_bucket() cannot shift by 64.
+    int bucket_bits = 1;
+    while ((1 << bucket_bits) * 4 < entry_count)
+        bucket_bits++;
+    int slot_bits = 1;
+    while ((1 << slot_bits) < entry_count * 2)
+        slot_bits++;
+
+    for (; slot_bits <= MAX_BITS; slot_bits++)
+    {
+        if (build_table(bucket_bits, slot_bits) == 0)
+        {
+            print_table(argv[1], bucket_bits, slot_bits);
+            return 0;
+        }
+    }
+    fprintf(stderr, "%s: no perfect hash found\n", argv[1]);
+    return 1;
+}